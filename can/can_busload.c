@@ -0,0 +1,314 @@
+#include "can_busload.h"
+#include <string.h>
+
+#define BUCKET_US    ((uint32_t)CAN_BUSLOAD_BUCKET_MS * 1000U)
+#define BUCKET_UNITS (BUCKET_US * 10U)          /* 100 ns units */
+#define UNITS_MASK   0x00FFFFFFU
+
+/* Frame fields outside the stuffed region: CRC delimiter, ACK slot and
+ * delimiter, EOF and intermission */
+#define CAN_TAIL_BITS    (1U + 2U + 7U + 3U)
+
+/* Bit stream used for exact stuff bit counting and the classic CRC-15 */
+typedef struct {
+    uint8_t  last;
+    uint8_t  run;
+    uint16_t crc;
+    uint32_t stuffed;
+} CAN_BitStream_t;
+
+static void can_bits_put(CAN_BitStream_t *s, uint32_t value, uint8_t n, uint8_t crc)
+{
+    while (n--) {
+        uint8_t bit = (uint8_t)((value >> n) & 1U);
+        if (crc) {
+            uint8_t nxt = bit ^ (uint8_t)((s->crc >> 14) & 1U);
+            s->crc = (uint16_t)((s->crc << 1) & 0x7FFFU);
+            if (nxt)
+                s->crc ^= 0x4599U;
+        }
+        if (s->run && bit == s->last) {
+            if (++s->run == 5) {
+                /* stuff bit of opposite polarity starts the next run */
+                s->stuffed++;
+                s->last = (uint8_t)!bit;
+                s->run = 1;
+            }
+        } else {
+            s->last = bit;
+            s->run = 1;
+        }
+    }
+}
+
+static const uint8_t can_fd_dlc_len[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+/* FD payloads are padded to the next valid length */
+static uint8_t can_fd_dlc(uint8_t len)
+{
+    uint8_t dlc = 0;
+    while (dlc < 15U && can_fd_dlc_len[dlc] < len)
+        ++dlc;
+    return dlc;
+}
+
+uint32_t CAN_BusLoad_FrameBits(uint32_t id, uint8_t extended, const uint8_t *data,
+                               uint8_t len, uint8_t flags, CAN_StuffMode_t stuff,
+                               uint32_t *data_bits)
+{
+    CAN_BitStream_t s = { 0, 0, 0, 0 };
+    uint8_t fd = (flags & CAN_FRAME_FD) != 0;
+    uint8_t dlc = fd ? can_fd_dlc(len) : (len > 8U ? 8U : len);
+    uint32_t bytes = fd ? can_fd_dlc_len[dlc] : dlc;
+    uint8_t exact = stuff == CAN_STUFF_EXACT;
+    if (!data)
+        exact = 0;
+
+    /* SOF through r0 (classic) or BRS (FD) */
+    uint32_t arb = extended ? (fd ? 36U : 35U) : (fd ? 17U : 15U);
+    if (exact) {
+        can_bits_put(&s, 0, 1, 1);                           /* SOF */
+        if (extended) {
+            can_bits_put(&s, (id >> 18) & 0x7FFU, 11, 1);
+            can_bits_put(&s, 3U, 2, 1);                      /* SRR, IDE */
+            can_bits_put(&s, id & 0x3FFFFU, 18, 1);
+            can_bits_put(&s, 0, 1, 1);                       /* RTR / RRS */
+        } else {
+            can_bits_put(&s, id & 0x7FFU, 11, 1);
+            can_bits_put(&s, 0, 2, 1);                       /* RTR / RRS, IDE */
+        }
+        if (fd)
+            can_bits_put(&s, (flags & CAN_FRAME_BRS) ? 0x5U : 0x4U, 3, 1); /* FDF, res, BRS */
+        else
+            can_bits_put(&s, 0, extended ? 2 : 1, 1);        /* r1, r0 / r0 */
+    }
+    uint32_t arb_stuff = s.stuffed;
+
+    /* Control and data, still dynamically stuffed */
+    uint32_t ctrl = (fd ? 1U : 0U) + 4U + 8U * bytes;        /* ESI, DLC, data */
+    uint32_t dyn = arb + ctrl;
+    uint32_t tail;
+    if (fd)
+        tail = 4U + (bytes > 16U ? 21U + 7U : 17U + 6U);     /* stuff count, CRC, fixed stuff bits */
+    else
+        tail = 15U;
+
+    uint32_t stuffed;
+    if (exact) {
+        if (fd)
+            can_bits_put(&s, 0, 1, 0);                       /* ESI */
+        can_bits_put(&s, dlc, 4, !fd);
+        for (uint32_t i = 0; i < bytes; ++i)
+            can_bits_put(&s, i < len ? data[i] : 0xCCU, 8, !fd);
+        if (!fd)
+            can_bits_put(&s, s.crc, 15, 0);                  /* CRC field is stuffed too */
+        stuffed = s.stuffed;
+    } else if (stuff == CAN_STUFF_WORST) {
+        /* one stuff bit per 4 bits after the first of the stuffed region */
+        stuffed = fd ? (dyn - 1U) / 4U : (dyn + tail - 1U) / 4U;
+        arb_stuff = (arb - 1U) / 4U;
+    } else {
+        stuffed = 0;
+        arb_stuff = 0;
+    }
+
+    uint32_t nominal = arb + ctrl + tail + stuffed + CAN_TAIL_BITS;
+    uint32_t fast = 0;
+    if (fd && (flags & CAN_FRAME_BRS)) {
+        /* bit rate switches after BRS and back at the CRC delimiter */
+        fast = ctrl + tail + 1U + (stuffed - arb_stuff);
+        nominal -= fast;
+    }
+    if (data_bits)
+        *data_bits = fast;
+    return nominal;
+}
+
+static uint32_t can_busload_units(const CAN_BusLoad_t *bl, uint32_t bits, uint32_t data_bits)
+{
+    /* 64-bit: at low bitrates a frame is several ms of nanoseconds */
+    return (uint32_t)(((uint64_t)bits * bl->ns_per_bit +
+                       (uint64_t)data_bits * bl->ns_per_data_bit + 50U) / 100U);
+}
+
+void CAN_BusLoad_Init(CAN_BusLoad_t *bl, const CAN_BusLoadConfig_t *cfg, uint32_t now_us)
+{
+    if (!bl)
+        return;
+    memset(&bl->cfg, 0, sizeof(bl->cfg));
+    if (cfg)
+        bl->cfg = *cfg;
+    bl->ns_per_bit = bl->cfg.bitrate ? 1000000000U / bl->cfg.bitrate : 0;
+    bl->ns_per_data_bit = bl->cfg.data_bitrate ? 1000000000U / bl->cfg.data_bitrate : bl->ns_per_bit;
+    CAN_StuffMode_t table_stuff = bl->cfg.stuff == CAN_STUFF_NONE ? CAN_STUFF_NONE : CAN_STUFF_WORST;
+    for (uint8_t ext = 0; ext < 2U; ++ext)
+        for (uint8_t dlc = 0; dlc <= 8U; ++dlc)
+            bl->classic_units[ext][dlc] = can_busload_units(bl,
+                CAN_BusLoad_FrameBits(0, ext, NULL, dlc, 0, table_stuff, NULL), 0);
+    for (uint32_t i = 0; i < CAN_BUSLOAD_BUCKETS; ++i)
+        atomic_init(&bl->bucket[i], 0);
+    atomic_init(&bl->peak_units, 0);
+    atomic_init(&bl->frames, 0);
+    atomic_init(&bl->top_skipped, 0);
+    atomic_flag_clear(&bl->top_lock);
+    memset(bl->top, 0, sizeof(bl->top));
+    bl->start_us = now_us;
+}
+
+static void can_busload_add(CAN_BusLoad_t *bl, uint32_t units, uint32_t now_us)
+{
+    uint32_t epoch = now_us / BUCKET_US;
+    _Atomic uint32_t *b = &bl->bucket[epoch % CAN_BUSLOAD_BUCKETS];
+    uint32_t tag = (epoch & 0xFFU) << 24;
+    uint32_t old = atomic_load_explicit(b, memory_order_relaxed);
+    uint32_t t;
+    do {
+        /* a bucket left over from an older epoch starts again from zero */
+        t = ((old & ~UNITS_MASK) == tag) ? (old & UNITS_MASK) : 0U;
+        t += units;
+        if (t > UNITS_MASK)
+            t = UNITS_MASK;
+    } while (!atomic_compare_exchange_weak_explicit(b, &old, tag | t,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    uint32_t peak = atomic_load_explicit(&bl->peak_units, memory_order_relaxed);
+    while (t > peak && !atomic_compare_exchange_weak_explicit(&bl->peak_units, &peak, t,
+                                                              memory_order_relaxed,
+                                                              memory_order_relaxed))
+        ;
+    atomic_fetch_add_explicit(&bl->frames, 1, memory_order_relaxed);
+}
+
+/* Space-saving top list: a new ID takes over the least busy entry and
+ * inherits its count, so shares are upper bounds once more than
+ * CAN_BUSLOAD_TOP_N IDs are active. */
+static void can_busload_top(CAN_BusLoad_t *bl, uint32_t id, uint8_t extended, uint32_t units)
+{
+    if (atomic_flag_test_and_set_explicit(&bl->top_lock, memory_order_acquire)) {
+        atomic_fetch_add_explicit(&bl->top_skipped, 1, memory_order_relaxed);
+        return;
+    }
+    CAN_BusLoadTop_t *hit = NULL, *min = &bl->top[0];
+    for (uint32_t i = 0; i < CAN_BUSLOAD_TOP_N; ++i) {
+        CAN_BusLoadTop_t *e = &bl->top[i];
+        if (e->used && e->id == id && e->extended == extended) {
+            hit = e;
+            break;
+        }
+        if (!e->used ? min->used : e->units < min->units)
+            min = e;
+    }
+    if (!hit) {
+        hit = min;
+        hit->id = id;
+        hit->extended = extended;
+        hit->used = 1;
+    }
+    hit->frames++;
+    hit->units += units;
+    atomic_flag_clear_explicit(&bl->top_lock, memory_order_release);
+}
+
+void CAN_BusLoad_Record(CAN_BusLoad_t *bl, const CAN_Message_t *msg, uint32_t now_us)
+{
+    if (!bl || !msg || !bl->ns_per_bit)
+        return;
+    uint8_t ext = msg->extended ? 1 : 0;
+    uint32_t units;
+    if (bl->cfg.stuff == CAN_STUFF_EXACT)
+        units = can_busload_units(bl, CAN_BusLoad_FrameBits(msg->id, ext, msg->data, msg->dlc,
+                                                            0, CAN_STUFF_EXACT, NULL), 0);
+    else
+        units = bl->classic_units[ext][msg->dlc > 8U ? 8U : msg->dlc];
+    can_busload_add(bl, units, now_us);
+    can_busload_top(bl, msg->id, ext, units);
+}
+
+void CAN_BusLoad_RecordBits(CAN_BusLoad_t *bl, uint32_t bits, uint32_t data_bits,
+                            uint32_t now_us)
+{
+    if (!bl || !bl->ns_per_bit)
+        return;
+    can_busload_add(bl, can_busload_units(bl, bits, data_bits), now_us);
+}
+
+static uint16_t can_permille(uint64_t part, uint64_t whole)
+{
+    if (!whole)
+        return 0;
+    uint64_t p = part * 1000U / whole;
+    return (uint16_t)(p > 1000U ? 1000U : p);
+}
+
+void CAN_BusLoad_Report(CAN_BusLoad_t *bl, CAN_BusLoadReport_t *report, uint32_t now_us)
+{
+    if (!bl || !report)
+        return;
+    uint32_t epoch = now_us / BUCKET_US;
+    uint32_t sum = 0, burst = 0;
+    for (uint32_t k = 0; k < CAN_BUSLOAD_BUCKETS; ++k) {
+        uint32_t e = epoch - k;
+        uint32_t v = atomic_load_explicit(&bl->bucket[e % CAN_BUSLOAD_BUCKETS],
+                                          memory_order_relaxed);
+        if ((v >> 24) != (e & 0xFFU))
+            continue; /* stale */
+        uint32_t t = v & UNITS_MASK;
+        sum += t;
+        if (t > burst)
+            burst = t;
+    }
+    /* full older buckets plus the part of the current one, but never more
+     * than the time since the meter started */
+    uint32_t window_us = (CAN_BUSLOAD_BUCKETS - 1U) * BUCKET_US + now_us % BUCKET_US;
+    if (now_us - bl->start_us < window_us)
+        window_us = now_us - bl->start_us;
+    report->window_ms = window_us / 1000U;
+    report->window_permille = can_permille(sum, (uint64_t)window_us * 10U);
+    report->burst_permille = can_permille(burst, BUCKET_UNITS);
+    report->peak_permille = can_permille(atomic_load_explicit(&bl->peak_units,
+                                                              memory_order_relaxed), BUCKET_UNITS);
+    report->frames = atomic_load_explicit(&bl->frames, memory_order_relaxed);
+    report->top_skipped = atomic_load_explicit(&bl->top_skipped, memory_order_relaxed);
+}
+
+uint8_t CAN_BusLoad_TopIds(CAN_BusLoad_t *bl, CAN_BusLoadId_t *out, uint8_t max,
+                           uint8_t reset, uint32_t now_us)
+{
+    if (!bl)
+        return 0;
+    CAN_BusLoadTop_t top[CAN_BUSLOAD_TOP_N];
+    /* recorders never wait for the lock, so holding it briefly is safe */
+    while (atomic_flag_test_and_set_explicit(&bl->top_lock, memory_order_acquire))
+        ;
+    memcpy(top, bl->top, sizeof(top));
+    if (reset)
+        memset(bl->top, 0, sizeof(bl->top));
+    atomic_flag_clear_explicit(&bl->top_lock, memory_order_release);
+
+    uint64_t elapsed = (uint64_t)(now_us - bl->start_us) * 10U;
+    /* compact the used entries and insertion sort them, busiest first */
+    uint8_t used = 0;
+    for (uint32_t i = 0; i < CAN_BUSLOAD_TOP_N; ++i) {
+        if (!top[i].used)
+            continue;
+        CAN_BusLoadTop_t e = top[i];
+        uint8_t j = used++;
+        while (j > 0 && e.units > top[j - 1U].units) {
+            top[j] = top[j - 1U];
+            --j;
+        }
+        top[j] = e;
+    }
+    uint8_t n = used < max ? used : max;
+    for (uint8_t i = 0; i < n && out; ++i) {
+        out[i].id = top[i].id;
+        out[i].extended = top[i].extended;
+        out[i].frames = top[i].frames;
+        out[i].permille = can_permille(top[i].units, elapsed);
+    }
+    if (reset) {
+        atomic_store_explicit(&bl->peak_units, 0, memory_order_relaxed);
+        atomic_store_explicit(&bl->frames, 0, memory_order_relaxed);
+        bl->start_us = now_us;
+    }
+    return n;
+}
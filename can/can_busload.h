@@ -0,0 +1,125 @@
+#ifndef CAN_BUSLOAD_H
+#define CAN_BUSLOAD_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "can_interface.h"
+#include "can_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bus utilisation meter.
+ *
+ * Every observed frame is converted to the time it occupied the bus, from
+ * its exact bit length (ID format, payload, stuff bits, CRC, ACK, EOF and
+ * intermission).  Bus time is summed into CAN_BUSLOAD_BUCKETS buckets of
+ * CAN_BUSLOAD_BUCKET_MS each, giving a sliding window load, the busiest
+ * bucket in the window (burst load) and the busiest bucket since reset.
+ *
+ * Each bucket packs an 8-bit epoch and 24 bits of bus time (100 ns units) in
+ * one word, so recording is a table lookup plus a CAS and safe from several
+ * ISRs.  The per-ID top list uses a try-lock; a contended update is skipped
+ * and counted in `top_skipped`.
+ */
+
+#ifndef CAN_BUSLOAD_BUCKET_MS
+#define CAN_BUSLOAD_BUCKET_MS 10
+#endif
+
+#ifndef CAN_BUSLOAD_BUCKETS
+#define CAN_BUSLOAD_BUCKETS 100
+#endif
+
+#if CAN_BUSLOAD_BUCKETS < 2 || CAN_BUSLOAD_BUCKETS > 255
+#error "CAN_BUSLOAD_BUCKETS must be 2..255 (8-bit bucket epochs)"
+#endif
+#if CAN_BUSLOAD_BUCKET_MS < 1 || CAN_BUSLOAD_BUCKET_MS > 1600
+#error "CAN_BUSLOAD_BUCKET_MS must be 1..1600 (24-bit bucket time)"
+#endif
+
+/* IDs tracked for the top talkers list */
+#ifndef CAN_BUSLOAD_TOP_N
+#define CAN_BUSLOAD_TOP_N 8
+#endif
+
+/* Stuff bit accounting */
+typedef enum {
+    CAN_STUFF_WORST,    /* upper bound from the stuffed length, table driven */
+    CAN_STUFF_EXACT,    /* computed from the actual bit stream */
+    CAN_STUFF_NONE
+} CAN_StuffMode_t;
+
+/* Frame format flags for CAN_BusLoad_FrameBits */
+#define CAN_FRAME_FD  0x01U
+#define CAN_FRAME_BRS 0x02U
+
+typedef struct {
+    uint32_t bitrate;        /* nominal, 0 disables the meter */
+    uint32_t data_bitrate;   /* FD data phase, 0 = nominal */
+    CAN_StuffMode_t stuff;
+} CAN_BusLoadConfig_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t  extended;
+    uint32_t frames;
+    uint16_t permille;       /* share of bus time since the last reset */
+} CAN_BusLoadId_t;
+
+typedef struct {
+    uint16_t window_permille;    /* over the last window_ms */
+    uint16_t burst_permille;     /* busiest bucket within the window */
+    uint16_t peak_permille;      /* busiest bucket since reset */
+    uint32_t window_ms;
+    uint32_t frames;             /* since reset */
+    uint32_t top_skipped;
+} CAN_BusLoadReport_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t  extended;
+    uint8_t  used;
+    uint32_t frames;
+    uint64_t units;
+} CAN_BusLoadTop_t;
+
+typedef struct {
+    CAN_BusLoadConfig_t cfg;
+    uint32_t ns_per_bit;
+    uint32_t ns_per_data_bit;
+    uint32_t classic_units[2][9];            /* worst case, by [extended][dlc] */
+    _Atomic uint32_t bucket[CAN_BUSLOAD_BUCKETS];
+    _Atomic uint32_t peak_units;
+    _Atomic uint32_t frames;
+    uint32_t start_us;
+    atomic_flag top_lock;
+    _Atomic uint32_t top_skipped;
+    CAN_BusLoadTop_t top[CAN_BUSLOAD_TOP_N];
+} CAN_BusLoad_t;
+
+/* Bits on the wire for one data frame including the 3 bit intermission.
+ * Returns the bits sent at the nominal rate; bits of an FD data phase (BRS)
+ * are returned in *data_bits. `data` is only read for CAN_STUFF_EXACT. */
+uint32_t CAN_BusLoad_FrameBits(uint32_t id, uint8_t extended, const uint8_t *data,
+                               uint8_t len, uint8_t flags, CAN_StuffMode_t stuff,
+                               uint32_t *data_bits);
+
+void CAN_BusLoad_Init(CAN_BusLoad_t *bl, const CAN_BusLoadConfig_t *cfg, uint32_t now_us);
+void CAN_BusLoad_Record(CAN_BusLoad_t *bl, const CAN_Message_t *msg, uint32_t now_us);
+/* Bus time of a frame recorded through other means, e.g. FD frames */
+void CAN_BusLoad_RecordBits(CAN_BusLoad_t *bl, uint32_t bits, uint32_t data_bits,
+                            uint32_t now_us);
+void CAN_BusLoad_Report(CAN_BusLoad_t *bl, CAN_BusLoadReport_t *report, uint32_t now_us);
+/* Copies up to `max` top IDs, busiest first. With `reset` the ID counters and
+ * peak start over. Returns the number copied. */
+uint8_t CAN_BusLoad_TopIds(CAN_BusLoad_t *bl, CAN_BusLoadId_t *out, uint8_t max,
+                           uint8_t reset, uint32_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_BUSLOAD_H */
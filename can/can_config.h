@@ -5,12 +5,32 @@
 
 #define CAN_MAX_BITRATES 4
 
+/*
+ * Static configuration: define CAN_STATIC_CONFIG to the name of a header that
+ * provides CAN_STATIC_INSTANCES(X), one X(driver, ops, tx_len, rx_len) entry
+ * per interface in CAN_Manager_AddInterface order.  `driver` is the global
+ * ICANDriver object, `ops` the driver's function prefix (MCP2515, BxCAN,
+ * FDCAN).  The manager then calls ops##_Send/ops##_Receive directly and
+ * reserves exactly the listed queues.
+ */
+#ifdef CAN_STATIC_CONFIG
+#include CAN_STATIC_CONFIG
+#define CAN_STATIC_ONE(drv, ops, tx_len, rx_len) + 1
+#ifndef MAX_CAN_INTERFACES
+#define MAX_CAN_INTERFACES (0 CAN_STATIC_INSTANCES(CAN_STATIC_ONE))
+#endif
+#ifndef CAN_FRAME_POOL_LEN
+#define CAN_FRAME_POOL_LEN 0
+#endif
+#endif
+
 #ifndef MAX_CAN_INTERFACES
 #define MAX_CAN_INTERFACES 4
 #endif
 
 static const uint32_t default_bitrates[CAN_MAX_BITRATES] = {125000, 250000, 500000, 1000000};
 
+/* Default queue depths for CAN_Manager_AddInterface */
 #ifndef CAN_TX_QUEUE_LEN
 #define CAN_TX_QUEUE_LEN 16
 #endif
@@ -19,4 +39,133 @@ static const uint32_t default_bitrates[CAN_MAX_BITRATES] = {125000, 250000, 5000
 #define CAN_RX_QUEUE_LEN 16
 #endif
 
+/* Fast lane: acceptance rules that steer IDs to the controller's FIFO1, and
+ * the depth of the per-interface ring those frames are delivered to (power
+ * of two, stored inside the instance). */
+#ifndef CAN_RX_FAST_FILTERS
+#define CAN_RX_FAST_FILTERS 4
+#endif
+
+#ifndef CAN_RX_FAST_QUEUE_LEN
+#define CAN_RX_FAST_QUEUE_LEN 8
+#endif
+
+/* Frames per interface that can await a TX completion report at once (power
+ * of two). The TX queue waits while the next frame's slot is still taken, so
+ * a value below the controller's TX buffers (3 on bxCAN and MCP2515, the TX
+ * FIFO depth on FDCAN) only limits how many frames are in flight. */
+#ifndef CAN_TX_TRACK_LEN
+#define CAN_TX_TRACK_LEN 8
+#endif
+
+/* CAN_WaitAny and CAN_ReadMerged callers that can block at once with their
+ * own event, woken only by frames for the instances they watch. Further
+ * callers share one event and look again every millisecond. */
+#ifndef CAN_ANY_WAITERS
+#define CAN_ANY_WAITERS 4
+#endif
+
+/* Error handling defaults (see CAN_ErrorPolicy_t). Bus-off recovery waits
+ * CAN_RECOVER_MIN_MS, doubling per failed attempt up to CAN_RECOVER_MAX_MS.
+ * While error-passive one frame is sent at a time, CAN_PASSIVE_TX_GAP_MS
+ * apart. Polled instances and instances out of error-active read the error
+ * counters every CAN_ERROR_POLL_MS. */
+#ifndef CAN_RECOVER_MIN_MS
+#define CAN_RECOVER_MIN_MS 10
+#endif
+
+#ifndef CAN_RECOVER_MAX_MS
+#define CAN_RECOVER_MAX_MS 1000
+#endif
+
+#ifndef CAN_PASSIVE_TX_GAP_MS
+#define CAN_PASSIVE_TX_GAP_MS 10
+#endif
+
+#ifndef CAN_ERROR_POLL_MS
+#define CAN_ERROR_POLL_MS 10
+#endif
+
+/* Interrupt moderation defaults (see CAN_IrqModeration_t). A budget of 0
+ * keeps one interrupt per frame; CAN_IRQ_ENTER_GAP_US of 500 switches to
+ * polling above roughly 2000 RX interrupts per second. */
+#ifndef CAN_IRQ_BUDGET
+#define CAN_IRQ_BUDGET 0
+#endif
+
+#ifndef CAN_IRQ_ENTER_GAP_US
+#define CAN_IRQ_ENTER_GAP_US 500
+#endif
+
+/* Request/response correlation (see CAN_Request). CAN_REQUEST_MAX requests
+ * may be outstanding across all interfaces (power of two, below 32768).
+ * Timeouts run on a wheel of CAN_REQUEST_WHEEL_LEN (power of two) ticks of
+ * CAN_REQUEST_TICK_MS. Matchers whose mask leaves one of the low 8 ID bits
+ * open cannot be indexed and share CAN_REQUEST_MASKED scanned entries. */
+#ifndef CAN_REQUEST_MAX
+#define CAN_REQUEST_MAX 64
+#endif
+
+#ifndef CAN_REQUEST_TICK_MS
+#define CAN_REQUEST_TICK_MS 1
+#endif
+
+#ifndef CAN_REQUEST_WHEEL_LEN
+#define CAN_REQUEST_WHEEL_LEN 64
+#endif
+
+#if CAN_REQUEST_MAX < 1 || CAN_REQUEST_MAX >= 32768 || (CAN_REQUEST_MAX & (CAN_REQUEST_MAX - 1))
+#error "CAN_REQUEST_MAX must be a power of two below 32768 (16-bit request indexes)"
+#endif
+#if CAN_REQUEST_WHEEL_LEN < 1 || (CAN_REQUEST_WHEEL_LEN & (CAN_REQUEST_WHEEL_LEN - 1))
+#error "CAN_REQUEST_WHEEL_LEN must be a power of two"
+#endif
+
+#ifndef CAN_REQUEST_MASKED
+#define CAN_REQUEST_MASKED 8
+#endif
+
+/* J1939 (see can_j1939.h): PGN handlers per node (power of two), transport
+ * sessions per node, and the reassembly pool of J1939_POOL_CHUNKS (at most
+ * 64) chunks of J1939_POOL_CHUNK bytes. A 1785 byte message takes 28 of the
+ * default chunks. DT frames leave J1939_TX_HEADROOM TX queue slots to other
+ * traffic; BAM packets go out J1939_BAM_GAP_MS apart, and a CTS grants up to
+ * J1939_CTS_PACKETS packets. */
+#ifndef J1939_HANDLERS
+#define J1939_HANDLERS 32
+#endif
+
+#ifndef J1939_SESSIONS
+#define J1939_SESSIONS 8
+#endif
+
+#ifndef J1939_POOL_CHUNKS
+#define J1939_POOL_CHUNKS 64
+#endif
+
+#ifndef J1939_POOL_CHUNK
+#define J1939_POOL_CHUNK 64
+#endif
+
+#ifndef J1939_TX_HEADROOM
+#define J1939_TX_HEADROOM 2
+#endif
+
+#ifndef J1939_BAM_GAP_MS
+#define J1939_BAM_GAP_MS 50
+#endif
+
+#ifndef J1939_CTS_PACKETS
+#define J1939_CTS_PACKETS 16
+#endif
+
+/* Frames shared by all interfaces added without caller storage. Each queue
+ * takes its depth from the pool once, at AddInterface, so the pool is the sum
+ * of those quotas. The default covers every MAX_CAN_INTERFACES slot at the
+ * default depths; builds short of RAM may lower it to what they add, and
+ * AddInterface fails once the pool cannot cover an interface. */
+#ifndef CAN_FRAME_POOL_LEN
+#define CAN_FRAME_POOL_LEN (MAX_CAN_INTERFACES * (CAN_TX_QUEUE_LEN + CAN_RX_QUEUE_LEN))
+#endif
+
 #endif /* CAN_CONFIG_H */
@@ -2,16 +2,17 @@
 #define CAN_INTERFACE_H
 
 #include <stdint.h>
+#include "can_config.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef enum {
-    CAN_MODE_NORMAL,
-    CAN_MODE_SILENT,
-    CAN_MODE_LOOPBACK,
-    CAN_MODE_AUTOBAUD
+    CAN_OPMODE_NORMAL,
+    CAN_OPMODE_SILENT,
+    CAN_OPMODE_LOOPBACK,
+    CAN_OPMODE_AUTOBAUD
 } CAN_Mode_t;
 
 typedef struct {
@@ -29,17 +30,62 @@ typedef enum {
 
 typedef struct ICANDriver ICANDriver;
 
+/* RX lanes. The fast lane is the controller's second RX FIFO (FIFO1 on
+ * STM32): IDs steered there by set_fifo_filter bypass the bulk traffic in
+ * the main FIFO. */
+#define CAN_RX_FIFO_MAIN 0U
+#define CAN_RX_FIFO_FAST 1U
+#define CAN_RX_FIFO_COUNT 2U
+#define CAN_RX_FIFO_OFF 0xFFU   /* set_fifo_filter: disable the rule */
+
 typedef struct {
     uint32_t id;
     uint8_t dlc;
     uint8_t data[8];
     uint8_t extended;
+    uint8_t fifo;       /* RX: controller FIFO the frame was read from */
+    uint32_t timestamp; /* us, can_os_now_us() set by the manager: RX when
+                         * drained from the controller (not its receive
+                         * time), TX at enqueue */
 } CAN_Message_t;
 
+/* Fault confinement counters as read from the controller */
+typedef struct {
+    uint16_t tec;      /* transmit error counter */
+    uint16_t rec;      /* receive error counter */
+    uint8_t  bus_off;
+} CAN_BusStatus_t;
+
 typedef struct {
     uint8_t inst_id;
+    uint32_t tx_handle; /* handle of the frame passed to the current send() */
 } CAN_DriverContext_t;
 
+/* Staged reconfiguration: only the parts flagged in `set` change, and all of
+ * them in one go (see CAN_Reconfigure) */
+#define CAN_RECONF_BITRATE 0x01U
+#define CAN_RECONF_MODE    0x02U
+#define CAN_RECONF_FILTER  0x04U   /* filter_id/filter_mask, as set_filter */
+#define CAN_RECONF_FAST    0x08U   /* the fast lane rules flagged in fast_set */
+#define CAN_RECONF_IRQ     0x10U   /* use_interrupts */
+
+typedef struct {
+    uint32_t id;
+    uint32_t mask;
+    uint8_t  fifo;      /* as set_fifo_filter, CAN_RX_FIFO_OFF disables */
+} CAN_FifoRule_t;
+
+typedef struct {
+    uint8_t        set;
+    uint32_t       bitrate;
+    CAN_Mode_t     mode;
+    uint32_t       filter_id;
+    uint32_t       filter_mask;
+    uint8_t        fast_set;    /* one bit per rule index */
+    CAN_FifoRule_t fast[CAN_RX_FAST_FILTERS];
+    uint8_t        use_interrupts;
+} CAN_Reconfig_t;
+
 struct ICANDriver {
     CAN_Result_t (*init)(ICANDriver *driver, const CAN_Config_t *config);
     CAN_Result_t (*send)(ICANDriver *driver, const CAN_Message_t *msg, uint32_t timeout_ms);
@@ -51,6 +97,31 @@ struct ICANDriver {
     void         (*enable_interrupts)(ICANDriver *driver);
     void         (*disable_interrupts)(ICANDriver *driver);
     void         (*irq_handler)(ICANDriver *driver);
+    /* Optional: error counters, and rejoining the bus after bus-off */
+    CAN_Result_t (*get_bus_status)(ICANDriver *driver, CAN_BusStatus_t *status);
+    CAN_Result_t (*recover)(ICANDriver *driver);
+    /* Optional: extra acceptance rule `index` (< CAN_RX_FAST_FILTERS) for
+     * standard IDs, storing matches in `fifo`. Rules take precedence over
+     * set_filter. */
+    CAN_Result_t (*set_fifo_filter)(ICANDriver *driver, uint8_t index, uint32_t id,
+                                    uint32_t mask, uint8_t fifo);
+    /* Optional: interrupt moderation. masked != 0 stops the per-frame RX
+     * interrupts; the controller then only interrupts once a FIFO is nearly
+     * full (FDCAN watermark, bxCAN FIFO full). */
+    void         (*rx_irq_mask)(ICANDriver *driver, uint8_t masked);
+    /* Optional: apply the bitrate, mode and filter parts of `rc` with at most
+     * one stop/start of the controller, and only if bitrate or mode really
+     * change; filters the controller accepts live are written without one.
+     * *offline_us receives the time the controller was off the bus, at least
+     * 1 if it was restarted. Restarts, like recover and auto_baud_detect,
+     * drop the frames in the controller's TX buffers. */
+    CAN_Result_t (*reconfigure)(ICANDriver *driver, const CAN_Reconfig_t *rc,
+                                uint32_t *offline_us);
+    /* Optional: called once per processing pass. While its interrupts are
+     * off the driver reports finished TX frames from here; drivers that
+     * cannot service their interrupt in the ISR finish it here (see
+     * CAN_Manager_RequestService). */
+    void         (*service)(ICANDriver *driver);
     void *ctx; /* driver specific context */
 };
 
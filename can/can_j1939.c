@@ -0,0 +1,653 @@
+#include "can_j1939.h"
+#include "can_manager.h"
+#include "can_os.h"
+#include <stddef.h>
+#include <string.h>
+
+#if J1939_POOL_CHUNKS > 64
+#error "J1939_POOL_CHUNKS must be at most 64"
+#endif
+#if J1939_HANDLERS & (J1939_HANDLERS - 1)
+#error "J1939_HANDLERS must be a power of two"
+#endif
+
+/* TP.CM control bytes and abort reasons (J1939-21) */
+#define TP_RTS   16U
+#define TP_CTS   17U
+#define TP_EOMA  19U
+#define TP_BAM   32U
+#define TP_ABORT 255U
+
+#define TP_ABORT_BUSY     1U
+#define TP_ABORT_TIMEOUT  3U
+#define TP_ABORT_SEQUENCE 7U
+#define TP_ABORT_SIZE     9U
+
+/* Transport timeouts (ms): between packets, after a CTS, after the last
+ * packet of a window, and after a CTS(0) hold */
+#define TP_T1 750U
+#define TP_T2 1250U
+#define TP_T3 1250U
+#define TP_T4 1050U
+#define TP_PRIORITY 7U
+
+#define CLAIM_WAIT_MS 250U
+#define CLAIM_FIRST   128U   /* arbitrary address range */
+#define CLAIM_LAST    247U
+
+enum { SES_FREE, SES_RX_BAM, SES_RX_CMDT, SES_TX_BAM, SES_TX_CMDT };
+
+static inline int j_due(uint32_t now, uint32_t t)
+{
+    return (int32_t)(now - t) >= 0;
+}
+
+static inline uint8_t j_pdu2(uint32_t pgn)
+{
+    return ((pgn >> 8) & 0xFFU) >= 240U;
+}
+
+uint32_t J1939_MakeId(uint8_t priority, uint32_t pgn, uint8_t sa, uint8_t da)
+{
+    uint32_t ps = j_pdu2(pgn) ? (pgn & 0xFFU) : da;
+    return ((uint32_t)(priority & 7U) << 26) | (((pgn >> 8) & 0x3FFU) << 16) | (ps << 8) | sa;
+}
+
+void J1939_ParseId(uint32_t can_id, J1939_Id_t *id)
+{
+    uint32_t pf = (can_id >> 16) & 0xFFU;
+    uint32_t ps = (can_id >> 8) & 0xFFU;
+    id->priority = (uint8_t)((can_id >> 26) & 7U);
+    id->sa = (uint8_t)can_id;
+    id->pgn = ((can_id >> 8) & 0x3FF00U) | (pf >= 240U ? ps : 0U);
+    id->da = pf >= 240U ? J1939_GLOBAL_ADDR : (uint8_t)ps;
+}
+
+static int j_send(J1939_t *j, uint8_t priority, uint32_t pgn, uint8_t sa, uint8_t da,
+                  const uint8_t *data, uint8_t len)
+{
+    CAN_Message_t m;
+    memset(&m, 0, sizeof(m));
+    m.id = J1939_MakeId(priority, pgn, sa, da);
+    m.extended = 1;
+    m.dlc = len;
+    memcpy(m.data, data, len);
+    return CAN_SendMessage(j->inst_id, &m) == CAN_OK ? 0 : -1;
+}
+
+/* ----- Handler table ---------------------------------------------------- */
+
+#define PGN_EMPTY 0xFFFFFFFEU
+
+static inline uint32_t j_hash(uint32_t pgn)
+{
+    return (pgn ^ (pgn >> 8) ^ (pgn >> 13)) & (J1939_HANDLERS - 1U);
+}
+
+static const J1939_HandlerSlot_t *j_lookup(const J1939_t *j, uint32_t pgn)
+{
+    uint32_t h = j_hash(pgn);
+    for (uint32_t k = 0; k < J1939_HANDLERS; ++k) {
+        const J1939_HandlerSlot_t *s = &j->handlers[(h + k) & (J1939_HANDLERS - 1U)];
+        if (s->pgn == pgn)
+            return s;
+        if (s->pgn == PGN_EMPTY)
+            break;
+    }
+    return j->any.fn ? &j->any : NULL;
+}
+
+CAN_Result_t J1939_Register(J1939_t *j, uint32_t pgn, J1939_Handler_t fn, void *user)
+{
+    if (!j)
+        return CAN_ERROR;
+    if (pgn == J1939_PGN_ANY) {
+        j->any = (J1939_HandlerSlot_t){ pgn, fn, user };
+        return CAN_OK;
+    }
+    if (pgn > 0x3FFFFU)
+        return CAN_ERROR;
+    uint32_t h = j_hash(pgn);
+    for (uint32_t k = 0; k < J1939_HANDLERS; ++k) {
+        J1939_HandlerSlot_t *s = &j->handlers[(h + k) & (J1939_HANDLERS - 1U)];
+        if (s->pgn == pgn || s->pgn == PGN_EMPTY) {
+            *s = (J1939_HandlerSlot_t){ pgn, fn, user };
+            return CAN_OK;
+        }
+    }
+    return CAN_ERROR;
+}
+
+static void j_dispatch(J1939_t *j, const J1939_Id_t *id, uint8_t da, const uint8_t *data,
+                       uint16_t len, uint32_t pgn)
+{
+    const J1939_HandlerSlot_t *h = j_lookup(j, pgn);
+    if (!h || !h->fn)
+        return;
+    J1939_Msg_t m = { pgn, id->priority, id->sa, da, len, data };
+    j->stats.dispatched++;
+    h->fn(j, &m, h->user);
+}
+
+/* ----- Reassembly pool -------------------------------------------------- */
+
+static inline uint64_t j_run(uint8_t n)
+{
+    return n >= 64U ? ~0ULL : (1ULL << n) - 1U;
+}
+
+/* First fit over the chunk bitmap; buffers are contiguous */
+static int j_pool_alloc(J1939_t *j, uint16_t len, uint8_t *first, uint8_t *chunks)
+{
+    uint32_t n = (len + J1939_POOL_CHUNK - 1U) / J1939_POOL_CHUNK;
+    if (n == 0 || n > J1939_POOL_CHUNKS)
+        return -1;
+    uint64_t run = j_run((uint8_t)n);
+    for (uint32_t s = 0; s + n <= J1939_POOL_CHUNKS; ++s) {
+        if (!(j->pool_used & (run << s))) {
+            j->pool_used |= run << s;
+            *first = (uint8_t)s;
+            *chunks = (uint8_t)n;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline uint8_t *j_buf(J1939_t *j, const J1939_Session_t *s)
+{
+    return &j->pool[(uint32_t)s->chunk * J1939_POOL_CHUNK];
+}
+
+/* ----- Sessions --------------------------------------------------------- */
+
+static J1939_Session_t *j_open(J1939_t *j, uint8_t state, uint16_t len)
+{
+    for (uint8_t i = 0; i < J1939_SESSIONS; ++i) {
+        J1939_Session_t *s = &j->sessions[i];
+        if (s->state != SES_FREE)
+            continue;
+        if (j_pool_alloc(j, len, &s->chunk, &s->chunks) != 0)
+            break;
+        s->state = state;
+        s->len = len;
+        s->packets = (uint8_t)((len + 6U) / 7U);
+        s->next = 1;
+        s->window_end = 0;
+        s->timed = 0;
+        s->cts_due = 0;
+        return s;
+    }
+    j->stats.no_session++;
+    return NULL;
+}
+
+static void j_close(J1939_t *j, J1939_Session_t *s)
+{
+    j->pool_used &= ~(j_run(s->chunks) << s->chunk);
+    s->state = SES_FREE;
+}
+
+/* RX sessions by sender and destination, TX sessions by destination */
+static J1939_Session_t *j_find(J1939_t *j, uint8_t state, uint8_t sa, uint8_t da)
+{
+    for (uint8_t i = 0; i < J1939_SESSIONS; ++i) {
+        J1939_Session_t *s = &j->sessions[i];
+        if (s->state == state && s->da == da && (state >= SES_TX_BAM || s->sa == sa))
+            return s;
+    }
+    return NULL;
+}
+
+static void j_pgn_bytes(uint8_t *d, uint32_t pgn)
+{
+    d[0] = (uint8_t)pgn;
+    d[1] = (uint8_t)(pgn >> 8);
+    d[2] = (uint8_t)(pgn >> 16);
+}
+
+static void j_cm(J1939_t *j, uint8_t da, uint8_t c0, uint8_t c1, uint8_t c2, uint8_t c3,
+                 uint8_t c4, uint32_t pgn)
+{
+    uint8_t d[8] = { c0, c1, c2, c3, c4 };
+    j_pgn_bytes(&d[5], pgn);
+    j_send(j, TP_PRIORITY, J1939_PGN_TP_CM, j->address, da, d, 8);
+}
+
+static void j_tx_finish(J1939_t *j, J1939_Session_t *s, CAN_Result_t res)
+{
+    if (res == CAN_OK)
+        j->stats.tp_tx_done++;
+    else
+        j->stats.tp_tx_aborted++;
+    uint32_t pgn = s->pgn;
+    uint8_t da = s->da;
+    j_close(j, s);
+    if (j->tx_done)
+        j->tx_done(j, pgn, da, res, j->tx_done_user);
+}
+
+/* End a session early; connections tell the peer why */
+static void j_abort(J1939_t *j, J1939_Session_t *s, uint8_t reason)
+{
+    if (s->state == SES_RX_CMDT)
+        j_cm(j, s->sa, TP_ABORT, reason, 0xFF, 0xFF, 0xFF, s->pgn);
+    else if (s->state == SES_TX_CMDT)
+        j_cm(j, s->da, TP_ABORT, reason, 0xFF, 0xFF, 0xFF, s->pgn);
+    if (s->state >= SES_TX_BAM) {
+        j_tx_finish(j, s, CAN_ERROR);
+    } else {
+        j->stats.tp_rx_aborted++;
+        j_close(j, s);
+    }
+}
+
+static void j_send_cts(J1939_t *j, J1939_Session_t *s, uint32_t now)
+{
+    uint32_t num = (uint32_t)s->packets - s->next + 1U;
+    if (num > J1939_CTS_PACKETS)
+        num = J1939_CTS_PACKETS;
+    if (num > s->max_per_cts)
+        num = s->max_per_cts;
+    uint8_t d[8] = { TP_CTS, (uint8_t)num, (uint8_t)s->next, 0xFF, 0xFF };
+    j_pgn_bytes(&d[5], s->pgn);
+    /* a full TX queue: try again on the next step */
+    s->cts_due = j_send(j, TP_PRIORITY, J1939_PGN_TP_CM, j->address, s->sa, d, 8) != 0;
+    s->window_end = (uint16_t)(s->next + num - 1U);
+    s->timed = 1;
+    s->deadline_us = now + TP_T2 * 1000U;
+}
+
+/* ----- Transport RX ----------------------------------------------------- */
+
+static void j_tp_cm(J1939_t *j, const J1939_Id_t *id, const uint8_t *d, uint32_t now)
+{
+    uint32_t pgn = ((uint32_t)d[5] | ((uint32_t)d[6] << 8) | ((uint32_t)d[7] << 16)) & 0x3FFFFU;
+    uint16_t len = (uint16_t)(d[1] | (d[2] << 8));
+    uint8_t valid = len > 8U && len <= J1939_TP_MAX_LEN && d[3] == (len + 6U) / 7U;
+    J1939_Session_t *s;
+
+    switch (d[0]) {
+    case TP_BAM:
+        if (id->da != J1939_GLOBAL_ADDR)
+            return;
+        /* a new BAM from the same node replaces the old one */
+        s = j_find(j, SES_RX_BAM, id->sa, J1939_GLOBAL_ADDR);
+        if (s)
+            j_abort(j, s, TP_ABORT_BUSY);
+        if (!valid || !(s = j_open(j, SES_RX_BAM, len)))
+            return;
+        break;
+    case TP_RTS:
+        s = j_find(j, SES_RX_CMDT, id->sa, j->address);
+        if (s)
+            j_abort(j, s, TP_ABORT_BUSY);
+        if (!valid) {
+            j_cm(j, id->sa, TP_ABORT, TP_ABORT_SIZE, 0xFF, 0xFF, 0xFF, pgn);
+            return;
+        }
+        if (!(s = j_open(j, SES_RX_CMDT, len))) {
+            j_cm(j, id->sa, TP_ABORT, TP_ABORT_BUSY, 0xFF, 0xFF, 0xFF, pgn);
+            return;
+        }
+        s->max_per_cts = d[4] ? d[4] : 1U;
+        break;
+    case TP_CTS:
+        s = j_find(j, SES_TX_CMDT, j->address, id->sa);
+        if (!s || s->pgn != pgn)
+            return;
+        if (d[1] == 0) {
+            /* hold: the receiver asks for time */
+            s->window_end = (uint16_t)(s->next - 1U);
+            s->timed = 1;
+            s->deadline_us = now + TP_T4 * 1000U;
+        } else if (d[2] == 0 || d[2] > s->packets) {
+            j_abort(j, s, TP_ABORT_SEQUENCE);
+        } else {
+            /* retransmission requests restart from an earlier packet */
+            uint32_t end = (uint32_t)d[2] + d[1] - 1U;
+            s->next = d[2];
+            s->window_end = (uint16_t)(end > s->packets ? s->packets : end);
+            s->timed = 0;
+        }
+        return;
+    case TP_EOMA:
+        s = j_find(j, SES_TX_CMDT, j->address, id->sa);
+        if (s && s->pgn == pgn)
+            j_tx_finish(j, s, CAN_OK);
+        return;
+    case TP_ABORT:
+        s = j_find(j, SES_TX_CMDT, j->address, id->sa);
+        if (!s || s->pgn != pgn)
+            s = j_find(j, SES_RX_CMDT, id->sa, j->address);
+        if (s && s->pgn == pgn) {
+            if (s->state == SES_TX_CMDT) {
+                j_tx_finish(j, s, CAN_ERROR);
+            } else {
+                j->stats.tp_rx_aborted++;
+                j_close(j, s);
+            }
+        }
+        return;
+    default:
+        return;
+    }
+
+    s->sa = id->sa;
+    s->da = id->da;
+    s->priority = id->priority;
+    s->pgn = pgn;
+    if (s->state == SES_RX_CMDT) {
+        j_send_cts(j, s, now);
+    } else {
+        s->timed = 1;
+        s->deadline_us = now + TP_T1 * 1000U;
+    }
+}
+
+static void j_tp_dt(J1939_t *j, const J1939_Id_t *id, const uint8_t *d, uint32_t now)
+{
+    uint8_t bam = id->da == J1939_GLOBAL_ADDR;
+    J1939_Session_t *s = j_find(j, bam ? SES_RX_BAM : SES_RX_CMDT, id->sa, id->da);
+    if (!s)
+        return;
+    if (d[0] != s->next || (!bam && s->next > s->window_end)) {
+        if (!bam && d[0] < s->next)
+            return;   /* duplicate */
+        j_abort(j, s, TP_ABORT_SEQUENCE);
+        return;
+    }
+    uint32_t off = (uint32_t)(s->next - 1U) * 7U;
+    uint32_t n = s->len - off < 7U ? s->len - off : 7U;
+    memcpy(j_buf(j, s) + off, &d[1], n);
+    s->next++;
+
+    if (s->next > s->packets) {
+        if (!bam)
+            j_cm(j, s->sa, TP_EOMA, (uint8_t)s->len, (uint8_t)(s->len >> 8), s->packets, 0xFF,
+                 s->pgn);
+        J1939_Id_t from = { s->pgn, s->priority, s->sa, s->da };
+        j->stats.tp_rx_done++;
+        j_dispatch(j, &from, s->da, j_buf(j, s), s->len, s->pgn);
+        j_close(j, s);
+    } else if (!bam && s->next > s->window_end) {
+        j_send_cts(j, s, now);
+    } else {
+        s->timed = 1;
+        s->deadline_us = now + TP_T1 * 1000U;
+    }
+}
+
+/* ----- Address claim ---------------------------------------------------- */
+
+static void j_send_claim(J1939_t *j)
+{
+    uint8_t d[8];
+    for (uint32_t i = 0; i < 8U; ++i)
+        d[i] = (uint8_t)(j->name >> (8U * i));
+    /* a node without an address answers with Cannot Claim from NULL */
+    j_send(j, 6U, J1939_PGN_ADDRESS_CLAIMED,
+           j->claim_state == J1939_CLAIM_LOST ? J1939_NULL_ADDR : j->address,
+           J1939_GLOBAL_ADDR, d, 8);
+}
+
+static inline int j_taken(const J1939_t *j, uint8_t a)
+{
+    return (j->taken[a >> 5] >> (a & 31U)) & 1U;
+}
+
+/* Lost the address: move to a free one if the NAME allows it */
+static void j_claim_next(J1939_t *j, uint32_t now)
+{
+    for (uint8_t i = 0; i < J1939_SESSIONS; ++i) {
+        if (j->sessions[i].state != SES_FREE)
+            j_abort(j, &j->sessions[i], TP_ABORT_BUSY);
+    }
+    if (j->name & J1939_NAME_ARBITRARY) {
+        for (uint32_t a = CLAIM_FIRST; a <= CLAIM_LAST; ++a) {
+            if (!j_taken(j, (uint8_t)a) && a != j->address) {
+                j->address = (uint8_t)a;
+                j->claim_state = J1939_CLAIM_PENDING;
+                j->claim_us = now + CLAIM_WAIT_MS * 1000U;
+                j_send_claim(j);
+                return;
+            }
+        }
+    }
+    j->claim_state = J1939_CLAIM_LOST;
+    j->address = J1939_NULL_ADDR;
+    j_send_claim(j);
+}
+
+static void j_claim_rx(J1939_t *j, const J1939_Id_t *id, const uint8_t *d, uint32_t now)
+{
+    uint64_t name = 0;
+    for (uint32_t i = 0; i < 8U; ++i)
+        name |= (uint64_t)d[i] << (8U * i);
+    if (name == j->name)
+        return;   /* our own claim, looped back */
+    if (id->sa != j->address ||
+        (j->claim_state != J1939_CLAIM_PENDING && j->claim_state != J1939_CLAIM_DONE)) {
+        if (id->sa < J1939_NULL_ADDR)
+            j->taken[id->sa >> 5] |= 1U << (id->sa & 31U);
+        return;
+    }
+    /* the lower NAME keeps the address */
+    if (j->name < name) {
+        j_send_claim(j);
+        return;
+    }
+    j->taken[id->sa >> 5] |= 1U << (id->sa & 31U);
+    j->stats.claims_lost++;
+    j_claim_next(j, now);
+}
+
+/* ----- Node ------------------------------------------------------------- */
+
+void J1939_Init(J1939_t *j, uint8_t inst_id, uint64_t name, uint8_t preferred)
+{
+    if (!j)
+        return;
+    memset(j, 0, sizeof(*j));
+    j->inst_id = inst_id;
+    j->name = name;
+    j->preferred = preferred;
+    j->address = J1939_NULL_ADDR;
+    j->claim_state = J1939_CLAIM_NONE;
+    for (uint32_t k = 0; k < J1939_HANDLERS; ++k)
+        j->handlers[k].pgn = PGN_EMPTY;
+}
+
+void J1939_SetTxDone(J1939_t *j, J1939_TxDone_t cb, void *user)
+{
+    j->tx_done = cb;
+    j->tx_done_user = user;
+}
+
+void J1939_SetOther(J1939_t *j, J1939_Other_t cb, void *user)
+{
+    j->other = cb;
+    j->other_user = user;
+}
+
+CAN_Result_t J1939_Start(J1939_t *j)
+{
+    if (!j || j->preferred >= J1939_NULL_ADDR)
+        return CAN_ERROR;
+    j->address = j->preferred;
+    j->claim_state = J1939_CLAIM_PENDING;
+    j->claim_us = can_os_now_us() + CLAIM_WAIT_MS * 1000U;
+    j_send_claim(j);
+    return CAN_OK;
+}
+
+J1939_ClaimState_t J1939_GetClaimState(const J1939_t *j, uint8_t *address)
+{
+    if (address)
+        *address = j->address;
+    return (J1939_ClaimState_t)j->claim_state;
+}
+
+int J1939_Input(J1939_t *j, const CAN_Message_t *msg)
+{
+    if (!j || !msg || !msg->extended)
+        return 0;
+    J1939_Id_t id;
+    J1939_ParseId(msg->id, &id);
+    j->stats.rx_frames++;
+    /* PDU1 frames for other nodes are not ours; address claims are global */
+    if (id.da != J1939_GLOBAL_ADDR && id.da != j->address)
+        return 1;
+    uint32_t now = can_os_now_us();
+    uint8_t full = msg->dlc >= 8U;
+
+    switch (id.pgn) {
+    case J1939_PGN_ADDRESS_CLAIMED:
+        if (full)
+            j_claim_rx(j, &id, msg->data, now);
+        break;
+    case J1939_PGN_REQUEST:
+        if (msg->dlc >= 3U && (msg->data[0] | (msg->data[1] << 8) | ((msg->data[2] & 3U) << 16)) ==
+                                  J1939_PGN_ADDRESS_CLAIMED) {
+            if (j->claim_state != J1939_CLAIM_NONE)
+                j_send_claim(j);
+        } else {
+            j_dispatch(j, &id, id.da, msg->data, msg->dlc, id.pgn);
+        }
+        break;
+    case J1939_PGN_TP_CM:
+        if (full && j->claim_state != J1939_CLAIM_LOST)
+            j_tp_cm(j, &id, msg->data, now);
+        break;
+    case J1939_PGN_TP_DT:
+        if (full)
+            j_tp_dt(j, &id, msg->data, now);
+        break;
+    default:
+        j_dispatch(j, &id, id.da, msg->data, msg->dlc, id.pgn);
+        break;
+    }
+    return 1;
+}
+
+/* One DT packet of a TX session */
+static int j_send_dt(J1939_t *j, J1939_Session_t *s)
+{
+    uint8_t d[8] = { (uint8_t)s->next, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    uint32_t off = (uint32_t)(s->next - 1U) * 7U;
+    uint32_t n = s->len - off < 7U ? s->len - off : 7U;
+    memcpy(&d[1], j_buf(j, s) + off, n);
+    if (j_send(j, TP_PRIORITY, J1939_PGN_TP_DT, j->address, s->da, d, 8) != 0)
+        return -1;
+    s->next++;
+    return 0;
+}
+
+static int j_tx_ready(const J1939_Session_t *s, uint32_t now)
+{
+    if (s->state == SES_TX_BAM)
+        return s->next <= s->packets && j_due(now, s->next_tx_us);
+    return s->state == SES_TX_CMDT && s->next <= s->window_end;
+}
+
+/* One DT frame per ready session and round, until only the headroom is
+ * left in the TX queue; the first session moves on every call */
+static void j_tx_pump(J1939_t *j, uint32_t now)
+{
+    uint8_t sent;
+    do {
+        sent = 0;
+        for (uint8_t k = 0; k < J1939_SESSIONS; ++k) {
+            J1939_Session_t *s = &j->sessions[(j->rr + k) % J1939_SESSIONS];
+            if (!j_tx_ready(s, now))
+                continue;
+            if (CAN_GetTxFree(j->inst_id) <= J1939_TX_HEADROOM || j_send_dt(j, s) != 0)
+                goto out;
+            sent = 1;
+            if (s->state == SES_TX_BAM) {
+                s->next_tx_us = now + J1939_BAM_GAP_MS * 1000U;
+                if (s->next > s->packets)
+                    j_tx_finish(j, s, CAN_OK);
+            } else if (s->next > s->window_end) {
+                s->timed = 1;
+                s->deadline_us = now + TP_T3 * 1000U;
+            }
+        }
+    } while (sent);
+out:
+    j->rr = (uint8_t)((j->rr + 1U) % J1939_SESSIONS);
+}
+
+void J1939_Step(J1939_t *j)
+{
+    if (!j)
+        return;
+    uint32_t now = can_os_now_us();
+    if (j->claim_state == J1939_CLAIM_PENDING && j_due(now, j->claim_us))
+        j->claim_state = J1939_CLAIM_DONE;
+    for (uint8_t i = 0; i < J1939_SESSIONS; ++i) {
+        J1939_Session_t *s = &j->sessions[i];
+        if (s->state == SES_FREE)
+            continue;
+        if (s->timed && j_due(now, s->deadline_us))
+            j_abort(j, s, TP_ABORT_TIMEOUT);
+        else if (s->cts_due)
+            j_send_cts(j, s, now);
+    }
+    if (j->claim_state == J1939_CLAIM_DONE)
+        j_tx_pump(j, now);
+}
+
+uint16_t J1939_Process(J1939_t *j)
+{
+    uint16_t n = 0;
+    CAN_Message_t msg;
+    if (!j)
+        return 0;
+    while (CAN_GetMessage(j->inst_id, &msg) == 0) {
+        if (!J1939_Input(j, &msg) && j->other)
+            j->other(j, &msg, j->other_user);
+        n++;
+    }
+    J1939_Step(j);
+    return n;
+}
+
+CAN_Result_t J1939_Send(J1939_t *j, uint32_t pgn, uint8_t priority, uint8_t da,
+                        const uint8_t *data, uint16_t len)
+{
+    if (!j || (!data && len) || len > J1939_TP_MAX_LEN || pgn > 0x3FFFFU ||
+        j->claim_state != J1939_CLAIM_DONE)
+        return CAN_ERROR;
+    if (len <= 8U)
+        return j_send(j, priority, pgn, j->address, da, data, (uint8_t)len) == 0 ? CAN_OK
+                                                                                 : CAN_ERROR;
+
+    /* one BAM per node, one connection per destination */
+    uint8_t bam = da == J1939_GLOBAL_ADDR;
+    uint8_t state = bam ? SES_TX_BAM : SES_TX_CMDT;
+    if (j_find(j, state, j->address, da))
+        return CAN_ERROR;
+    J1939_Session_t *s = j_open(j, state, len);
+    if (!s)
+        return CAN_ERROR;
+    memcpy(j_buf(j, s), data, len);
+    s->sa = j->address;
+    s->da = da;
+    s->priority = priority;
+    s->pgn = pgn;
+    uint8_t d[8] = { bam ? TP_BAM : TP_RTS, (uint8_t)len, (uint8_t)(len >> 8), s->packets, 0xFF };
+    j_pgn_bytes(&d[5], pgn);
+    if (j_send(j, TP_PRIORITY, J1939_PGN_TP_CM, j->address, da, d, 8) != 0) {
+        j_close(j, s);
+        return CAN_ERROR;
+    }
+    uint32_t now = can_os_now_us();
+    if (bam) {
+        s->next_tx_us = now + J1939_BAM_GAP_MS * 1000U;
+    } else {
+        s->timed = 1;
+        s->deadline_us = now + TP_T3 * 1000U;
+    }
+    return CAN_OK;
+}
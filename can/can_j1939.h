@@ -0,0 +1,162 @@
+#ifndef CAN_J1939_H
+#define CAN_J1939_H
+
+#include <stdint.h>
+#include "can_interface.h"
+#include "can_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SAE J1939 node on top of one manager instance.
+ *
+ * Extended IDs are decoded into priority, PGN, source and destination, and
+ * each PGN is dispatched through an open-addressed handler table.  The node
+ * claims its address with NAME arbitration (J1939-81) and runs the
+ * J1939-21 transport protocol: BAM to the global address and RTS/CTS
+ * connections to one node, several of each at once, reassembled into a
+ * chunk pool owned by the node.
+ *
+ * A node belongs to one task: J1939_Process, J1939_Input, J1939_Step and
+ * J1939_Send must not run concurrently.  Handlers run inside them.
+ */
+
+#define J1939_NULL_ADDR   254U
+#define J1939_GLOBAL_ADDR 255U
+#define J1939_TP_MAX_LEN  1785U
+
+#define J1939_PGN_REQUEST         0x0EA00U
+#define J1939_PGN_ADDRESS_CLAIMED 0x0EE00U
+#define J1939_PGN_TP_CM           0x0EC00U
+#define J1939_PGN_TP_DT           0x0EB00U
+#define J1939_PGN_ANY             0xFFFFFFFFU   /* J1939_Register: unhandled PGNs */
+
+/* NAME bit 63: the node may pick another address after losing a claim */
+#define J1939_NAME_ARBITRARY (1ULL << 63)
+
+typedef struct {
+    uint32_t pgn;
+    uint8_t  priority;
+    uint8_t  sa;
+    uint8_t  da;          /* J1939_GLOBAL_ADDR for PDU2 PGNs */
+} J1939_Id_t;
+
+typedef struct {
+    uint32_t       pgn;
+    uint8_t        priority;
+    uint8_t        sa;
+    uint8_t        da;
+    uint16_t       len;
+    const uint8_t *data;  /* only valid during the handler call */
+} J1939_Msg_t;
+
+typedef enum {
+    J1939_CLAIM_NONE,     /* J1939_Start not called yet */
+    J1939_CLAIM_PENDING,  /* claim sent, waiting 250 ms for contention */
+    J1939_CLAIM_DONE,
+    J1939_CLAIM_LOST      /* Cannot Claim sent; the node only listens */
+} J1939_ClaimState_t;
+
+typedef struct J1939 J1939_t;
+
+typedef void (*J1939_Handler_t)(J1939_t *j, const J1939_Msg_t *msg, void *user);
+/* Multi-packet transmission finished: CAN_OK once the data is out (BAM) or
+ * acknowledged (RTS/CTS) */
+typedef void (*J1939_TxDone_t)(J1939_t *j, uint32_t pgn, uint8_t da, CAN_Result_t res,
+                               void *user);
+/* Frames J1939_Process reads that are not J1939 (standard IDs) */
+typedef void (*J1939_Other_t)(J1939_t *j, const CAN_Message_t *msg, void *user);
+
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t dispatched;
+    uint32_t tp_rx_done;
+    uint32_t tp_rx_aborted;  /* timeouts, sequence errors, aborts */
+    uint32_t tp_tx_done;
+    uint32_t tp_tx_aborted;
+    uint32_t no_session;     /* no free session or pool chunks */
+    uint32_t claims_lost;
+} J1939_Stats_t;
+
+typedef struct {
+    uint32_t        pgn;
+    J1939_Handler_t fn;
+    void           *user;
+} J1939_HandlerSlot_t;
+
+/* One transport session; the buffer is `chunks` pool chunks from `chunk` */
+typedef struct {
+    uint8_t  state;
+    uint8_t  sa;
+    uint8_t  da;
+    uint8_t  priority;
+    uint32_t pgn;
+    uint16_t len;
+    uint16_t next;        /* next sequence number to send or receive */
+    uint16_t window_end;  /* RTS/CTS: last packet of the current CTS */
+    uint8_t  packets;
+    uint8_t  max_per_cts; /* receiver: limit from the RTS */
+    uint8_t  chunk;
+    uint8_t  chunks;
+    uint8_t  timed;       /* deadline_us is armed */
+    uint8_t  cts_due;     /* receiver: CTS still to send */
+    uint32_t deadline_us;
+    uint32_t next_tx_us;  /* BAM pacing */
+} J1939_Session_t;
+
+struct J1939 {
+    uint8_t             inst_id;
+    uint8_t             address;     /* current source address */
+    uint8_t             preferred;
+    uint8_t             claim_state;
+    uint64_t            name;
+    uint32_t            claim_us;    /* end of the contention window */
+    uint32_t            taken[8];    /* addresses claimed by other nodes */
+    J1939_HandlerSlot_t handlers[J1939_HANDLERS];
+    J1939_HandlerSlot_t any;
+    J1939_TxDone_t      tx_done;
+    void               *tx_done_user;
+    J1939_Other_t       other;
+    void               *other_user;
+    J1939_Session_t     sessions[J1939_SESSIONS];
+    uint8_t             rr;          /* first session of the next TX round */
+    uint64_t            pool_used;   /* one bit per chunk */
+    uint8_t             pool[J1939_POOL_CHUNKS * J1939_POOL_CHUNK];
+    J1939_Stats_t       stats;
+};
+
+uint32_t J1939_MakeId(uint8_t priority, uint32_t pgn, uint8_t sa, uint8_t da);
+void     J1939_ParseId(uint32_t can_id, J1939_Id_t *id);
+
+void J1939_Init(J1939_t *j, uint8_t inst_id, uint64_t name, uint8_t preferred);
+/* Register `fn` for `pgn` (or J1939_PGN_ANY); a NULL fn mutes the PGN */
+CAN_Result_t J1939_Register(J1939_t *j, uint32_t pgn, J1939_Handler_t fn, void *user);
+void J1939_SetTxDone(J1939_t *j, J1939_TxDone_t cb, void *user);
+void J1939_SetOther(J1939_t *j, J1939_Other_t cb, void *user);
+/* Claim the preferred address. Sending is possible once the state is
+ * J1939_CLAIM_DONE, 250 ms later without contention. */
+CAN_Result_t J1939_Start(J1939_t *j);
+J1939_ClaimState_t J1939_GetClaimState(const J1939_t *j, uint8_t *address);
+
+/* Up to 8 bytes go out as one frame, more (up to J1939_TP_MAX_LEN) as a BAM
+ * to J1939_GLOBAL_ADDR or an RTS/CTS connection to `da`. The data is copied.
+ * Fails without a claimed address, without a free session, or while a BAM
+ * (or a connection to `da`) is still running. */
+CAN_Result_t J1939_Send(J1939_t *j, uint32_t pgn, uint8_t priority, uint8_t da,
+                        const uint8_t *data, uint16_t len);
+
+/* Read the instance's RX queue, handle every frame, then J1939_Step.
+ * Returns the number of frames read. */
+uint16_t J1939_Process(J1939_t *j);
+/* For frames read elsewhere (e.g. a merged stream): 0 if not J1939 */
+int  J1939_Input(J1939_t *j, const CAN_Message_t *msg);
+/* Claim and transport timers, and the paced DT transmission */
+void J1939_Step(J1939_t *j);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_J1939_H */
@@ -0,0 +1,95 @@
+#include "can_mailbox.h"
+#include <stddef.h>
+#include <string.h>
+
+void CAN_Mailbox_Init(CAN_Mailbox_t *mb, uint32_t base_id, uint16_t count, uint8_t extended,
+                      CAN_MailboxEntry_t *entries, _Atomic uint32_t *changed)
+{
+    if (!mb || !entries || !changed)
+        return;
+    mb->base_id = base_id;
+    mb->count = count;
+    mb->extended = extended ? 1 : 0;
+    mb->entries = entries;
+    mb->changed = changed;
+    mb->next = NULL;
+    for (uint16_t i = 0; i < count; ++i)
+        atomic_init(&entries[i].seq, 0);
+    for (uint16_t w = 0; w < CAN_MAILBOX_WORDS(count); ++w)
+        atomic_init(&changed[w], 0);
+}
+
+int CAN_Mailbox_Tracks(const CAN_Mailbox_t *mb, const CAN_Message_t *msg)
+{
+    return mb && msg && msg->extended == mb->extended &&
+           msg->id - mb->base_id < mb->count;
+}
+
+/* Single writer per mailbox (the instance's ISR or process pass). */
+int CAN_Mailbox_Store(CAN_Mailbox_t *mb, const CAN_Message_t *msg)
+{
+    if (!CAN_Mailbox_Tracks(mb, msg))
+        return 0;
+    uint32_t idx = msg->id - mb->base_id;
+    CAN_MailboxEntry_t *e = &mb->entries[idx];
+    uint32_t seq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&e->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    e->msg = *msg;
+    atomic_store_explicit(&e->seq, seq + 2, memory_order_release);
+    atomic_fetch_or_explicit(&mb->changed[idx / 32], 1UL << (idx % 32),
+                             memory_order_release);
+    return 1;
+}
+
+static uint32_t mailbox_copy(const CAN_MailboxEntry_t *e, CAN_Message_t *msg)
+{
+    uint32_t s1, s2;
+    do {
+        s1 = atomic_load_explicit(&e->seq, memory_order_acquire);
+        if (s1 & 1U)
+            continue;
+        *msg = e->msg;
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&e->seq, memory_order_relaxed);
+        if (s1 == s2)
+            break;
+    } while (1);
+    return s1;
+}
+
+int CAN_Mailbox_Read(const CAN_Mailbox_t *mb, uint32_t id, CAN_Message_t *msg, uint32_t *seq)
+{
+    if (!mb || !msg || id - mb->base_id >= mb->count)
+        return -1;
+    const CAN_MailboxEntry_t *e = &mb->entries[id - mb->base_id];
+    if (atomic_load_explicit(&e->seq, memory_order_acquire) == 0)
+        return -1; /* never received */
+    uint32_t s = mailbox_copy(e, msg);
+    if (seq)
+        *seq = s / 2;
+    return 0;
+}
+
+uint16_t CAN_Mailbox_PollChanged(CAN_Mailbox_t *mb, CAN_MailboxVisitor_t visitor, void *user)
+{
+    uint16_t n = 0;
+    if (!mb)
+        return 0;
+    for (uint16_t w = 0; w < CAN_MAILBOX_WORDS(mb->count); ++w) {
+        /* Claim the bits first: a write racing with us sets them again and
+         * is reported on the next poll. */
+        uint32_t bits = atomic_exchange_explicit(&mb->changed[w], 0, memory_order_acquire);
+        while (bits) {
+            uint32_t b = (uint32_t)__builtin_ctz(bits);
+            bits &= bits - 1;
+            CAN_Message_t msg;
+            uint32_t seq = mailbox_copy(&mb->entries[w * 32 + b], &msg);
+            if (visitor)
+                visitor(&msg, seq / 2, user);
+            ++n;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,64 @@
+#ifndef CAN_MAILBOX_H
+#define CAN_MAILBOX_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "can_interface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Latest-value store for a contiguous range of CAN IDs.
+ *
+ * Instead of queuing every copy of a cyclic frame, each tracked ID owns one
+ * entry that is overwritten by the RX path.  Entries are protected by a
+ * sequence counter (odd while a write is in progress) so the ISR never waits
+ * and readers always get a consistent, newest frame.  A bitmap marks the IDs
+ * that changed since the consumer last polled them.
+ *
+ * Memory is caller provided and depends only on the number of tracked IDs,
+ * use CAN_MAILBOX_DEFINE() to reserve it statically.
+ */
+
+typedef struct {
+    _Atomic uint32_t seq;   /* 0 = never written, odd = write in progress */
+    CAN_Message_t    msg;
+} CAN_MailboxEntry_t;
+
+typedef struct CAN_Mailbox {
+    uint32_t            base_id;
+    uint16_t            count;
+    uint8_t             extended;
+    CAN_MailboxEntry_t *entries;
+    _Atomic uint32_t   *changed;   /* one bit per tracked ID */
+    struct CAN_Mailbox *next;      /* further ranges on the same instance */
+} CAN_Mailbox_t;
+
+#define CAN_MAILBOX_WORDS(count) (((count) + 31U) / 32U)
+
+/* Declare a mailbox named `name` together with its static storage. */
+#define CAN_MAILBOX_DEFINE(name, base, cnt, ext)                              \
+    static CAN_MailboxEntry_t name##_entries[(cnt)];                          \
+    static _Atomic uint32_t   name##_changed[CAN_MAILBOX_WORDS(cnt)];         \
+    static CAN_Mailbox_t name = {                                             \
+        .base_id = (base), .count = (cnt), .extended = (ext),                 \
+        .entries = name##_entries, .changed = name##_changed, .next = 0       \
+    }
+
+/* Called for every changed ID by CAN_Mailbox_PollChanged(). */
+typedef void (*CAN_MailboxVisitor_t)(const CAN_Message_t *msg, uint32_t seq, void *user);
+
+void CAN_Mailbox_Init(CAN_Mailbox_t *mb, uint32_t base_id, uint16_t count, uint8_t extended,
+                      CAN_MailboxEntry_t *entries, _Atomic uint32_t *changed);
+int  CAN_Mailbox_Tracks(const CAN_Mailbox_t *mb, const CAN_Message_t *msg);
+int  CAN_Mailbox_Store(CAN_Mailbox_t *mb, const CAN_Message_t *msg);
+int  CAN_Mailbox_Read(const CAN_Mailbox_t *mb, uint32_t id, CAN_Message_t *msg, uint32_t *seq);
+uint16_t CAN_Mailbox_PollChanged(CAN_Mailbox_t *mb, CAN_MailboxVisitor_t visitor, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_MAILBOX_H */
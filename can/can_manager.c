@@ -1,26 +1,268 @@
 #include "can_manager.h"
 #include "can_config.h"
+#include "can_mailbox.h"
+#include "can_busload.h"
+#include "can_merge.h"
+#include "can_queue.h"
+#include "can_request.h"
+#include "can_os.h"
+#include "can_trace.h"
 #include <string.h>
 
+/*
+ * Concurrency model: every instance has exactly one processing context, the
+ * CAN_Manager_Process loop or, once made exclusive, its own thread or core
+ * calling CAN_Manager_ProcessInstance.  TX queues accept any number of
+ * producers (tasks or ISRs); RX queues are filled by the processing context
+ * or the driver ISR and may be drained from any task.
+ */
+
 typedef struct {
-    CAN_Message_t tx_queue[CAN_TX_QUEUE_LEN];
-    uint16_t tx_head, tx_tail;
-    CAN_Message_t rx_queue[CAN_RX_QUEUE_LEN];
-    uint16_t rx_head, rx_tail;
+    CAN_Queue_t tx;
+    CAN_Queue_t rx;
+    CAN_Queue_t rx_fast;        /* fast lane frames, read before rx */
+    uint8_t tx_from_pool, rx_from_pool;
 } CAN_Buffer_t;
 
+/* A frame handed to the controller, waiting for its completion report */
+typedef struct {
+    _Atomic uint8_t busy;   /* 0 free, 1 in flight, 2 being reported */
+    uint32_t handle;
+    uint32_t t_hw;
+    CAN_Message_t msg;  /* timestamp = enqueue time */
+} CAN_TxTrack_t;
+
 typedef struct {
     ICANDriver *driver;
     void *driver_ctx;
-    CAN_Callback_t callbacks[3];
+    CAN_Callback_t callbacks[4];
     CAN_Buffer_t buffers;
+    CAN_QueueSlot_t rx_fast_slots[CAN_RX_FAST_QUEUE_LEN];
+    uint8_t rx_fast_rules;            /* enabled fast lane rules, one bit each */
+    CAN_RxStats_t rx_stats;
+    CAN_Mailbox_t *_Atomic mailboxes; /* latest-value ranges, checked before rx_queue */
     uint32_t filter_id;
     uint32_t filter_mask;
     uint8_t use_interrupts;
+    _Atomic uint8_t exclusive;        /* skipped by CAN_Manager_Process */
+    _Atomic uint8_t in_pass;          /* a processing pass runs, see can_pass_claim */
+    _Atomic uint8_t thread_run;
+    _Atomic uint8_t thread_idle;      /* instance thread waits on work_event */
+    uint32_t thread_period_ms;
+    can_os_thread_t thread;
+    /* Blocking API: events are only signalled while someone waits on them */
+    can_os_event_t rx_event;
+    can_os_event_t tx_event;
+    can_os_event_t work_event;
+    _Atomic uint8_t rx_waiters;
+    _Atomic uint8_t tx_waiters;
+    /* TX completion tracking, indexed by handle */
+    CAN_TxTrack_t tx_track[CAN_TX_TRACK_LEN];
+    CAN_TxStats_t tx_stats;
+    uint32_t tx_last_handle;
+    uint32_t tx_last_us;
+    /* Error state machine; flags are set from ISRs, the rest is owned by
+     * the processing context */
+    _Atomic uint8_t err_pending;
+    _Atomic uint8_t recover_req;
+    CAN_ErrorPolicy_t err_policy;
+    CAN_ErrorEvent_t err;
+    uint32_t err_check_us;
+    uint32_t recover_at_us;
+    uint32_t recover_backoff_ms;
+    CAN_BusLoad_t busload;            /* fed by RX delivery and TX completion */
+    /* Interrupt moderation; rx_polling is set by the RX ISR and cleared by
+     * the processing context once the controller is drained */
+    CAN_IrqModeration_t irq_mod;
+    CAN_IrqStats_t irq_stats;
+    _Atomic uint8_t rx_polling;
+    uint32_t rx_irq_us;               /* last RX interrupt */
+    CAN_RequestSet_t requests;        /* outstanding CAN_Request matchers */
 } CAN_Instance_t;
 
 static CAN_Instance_t can_instances[MAX_CAN_INTERFACES];
-static uint8_t can_instances_count = 0;
+/* Published with release order once an instance is fully set up, so readers
+ * that see the new count also see the instance. */
+static _Atomic uint8_t can_instances_count = 0;
+static can_os_mutex_t can_reg_lock;
+
+/* A blocked CAN_WaitAny or CAN_ReadMerged caller: the instances it watches
+ * and its own event, so a frame only wakes waiters that can take it. */
+#define CAN_WATCH_WORDS ((MAX_CAN_INTERFACES + 31) / 32)
+typedef struct {
+    _Atomic uint8_t  busy;
+    _Atomic uint32_t watch[CAN_WATCH_WORDS];
+    can_os_event_t   event;
+} CAN_AnyWaiter_t;
+
+static CAN_AnyWaiter_t can_any_waiters[CAN_ANY_WAITERS];
+static _Atomic uint8_t can_any_rx_waiters;   /* blocked callers, slot or not */
+/* callers that found every slot taken share this event and poll */
+static can_os_event_t can_any_rx_event;
+static _Atomic uint8_t can_any_rx_shared;
+
+static inline uint8_t can_count(void)
+{
+    return atomic_load_explicit(&can_instances_count, memory_order_acquire);
+}
+
+/* Signal `e` if anyone announced itself in `waiters`. The fence pairs with
+ * the one in can_wait_enter so either the waiter sees the new queue state or
+ * we see the waiter. */
+static inline void can_wake(can_os_event_t *e, _Atomic uint8_t *waiters)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed))
+        can_os_event_signal(e);
+}
+
+static inline void can_wait_enter(_Atomic uint8_t *waiters)
+{
+    atomic_fetch_add_explicit(waiters, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline void can_wait_leave(_Atomic uint8_t *waiters)
+{
+    atomic_fetch_sub_explicit(waiters, 1, memory_order_relaxed);
+}
+
+/* Register a blocking any-instance caller watching `watch`. Returns its
+ * slot, or NULL if all are taken and it has to use the shared event. */
+static CAN_AnyWaiter_t *can_any_enter(const uint32_t *watch)
+{
+    CAN_AnyWaiter_t *w = NULL;
+    for (uint32_t i = 0; i < CAN_ANY_WAITERS && !w; ++i) {
+        uint8_t idle = 0;
+        if (atomic_compare_exchange_strong_explicit(&can_any_waiters[i].busy, &idle, 1,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed))
+            w = &can_any_waiters[i];
+    }
+    if (w) {
+        for (uint32_t k = 0; k < CAN_WATCH_WORDS; ++k)
+            atomic_store_explicit(&w->watch[k], watch[k], memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&can_any_rx_shared, 1, memory_order_relaxed);
+    }
+    can_wait_enter(&can_any_rx_waiters);
+    return w;
+}
+
+static void can_any_leave(CAN_AnyWaiter_t *w)
+{
+    can_wait_leave(&can_any_rx_waiters);
+    if (!w) {
+        atomic_fetch_sub_explicit(&can_any_rx_shared, 1, memory_order_relaxed);
+        return;
+    }
+    for (uint32_t k = 0; k < CAN_WATCH_WORDS; ++k)
+        atomic_store_explicit(&w->watch[k], 0, memory_order_relaxed);
+    atomic_store_explicit(&w->busy, 0, memory_order_release);
+}
+
+static void can_any_wait(CAN_AnyWaiter_t *w, uint32_t left)
+{
+    if (w)
+        can_os_event_wait(&w->event, left);
+    else
+        can_os_event_wait(&can_any_rx_event, left < 1U ? left : 1U);
+}
+
+/* A frame was queued on `inst_id`: wake the waiters watching it */
+static void can_any_wake(uint8_t inst_id)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&can_any_rx_waiters, memory_order_relaxed))
+        return;
+    uint32_t bit = 1UL << (inst_id % 32U);
+    for (uint32_t i = 0; i < CAN_ANY_WAITERS; ++i) {
+        if (atomic_load_explicit(&can_any_waiters[i].watch[inst_id / 32U],
+                                 memory_order_relaxed) & bit)
+            can_os_event_signal(&can_any_waiters[i].event);
+    }
+    if (atomic_load_explicit(&can_any_rx_shared, memory_order_relaxed))
+        can_os_event_signal(&can_any_rx_event);
+}
+
+/* Milliseconds left of `timeout_ms` started at `start_us`, 0 when expired */
+static uint32_t can_time_left(uint32_t start_us, uint32_t timeout_ms)
+{
+    if (timeout_ms == CAN_WAIT_FOREVER)
+        return CAN_WAIT_FOREVER;
+    uint32_t elapsed = (can_os_now_us() - start_us) / 1000U;
+    return elapsed >= timeout_ms ? 0 : timeout_ms - elapsed;
+}
+
+#ifdef CAN_STATIC_INSTANCES
+/* Static configuration: one enum entry, queue pair and direct call per
+ * listed interface. */
+#define CAN_X_ENUM(drv, ops, tx_len, rx_len) CAN_STATIC_ID_##drv,
+#define CAN_X_DECL(drv, ops, tx_len, rx_len)                                 \
+    extern ICANDriver drv;                                                    \
+    CAN_Result_t ops##_Send(ICANDriver *driver, const CAN_Message_t *msg, uint32_t timeout_ms); \
+    CAN_Result_t ops##_Receive(ICANDriver *driver, CAN_Message_t *msg);       \
+    static CAN_QueueSlot_t drv##_txq[tx_len];                                 \
+    static CAN_QueueSlot_t drv##_rxq[rx_len];
+#define CAN_X_QUEUES(drv, ops, tx_len, rx_len) { tx_len, rx_len, drv##_txq, drv##_rxq },
+#define CAN_X_DRIVER(drv, ops, tx_len, rx_len) &drv,
+#define CAN_X_SEND(drv, ops, tx_len, rx_len) \
+    case CAN_STATIC_ID_##drv: return ops##_Send(&drv, msg, 0);
+#define CAN_X_RECEIVE(drv, ops, tx_len, rx_len) \
+    case CAN_STATIC_ID_##drv: return ops##_Receive(&drv, msg);
+
+enum { CAN_STATIC_INSTANCES(CAN_X_ENUM) CAN_STATIC_COUNT };
+CAN_STATIC_INSTANCES(CAN_X_DECL)
+static const CAN_QueueConfig_t can_static_queues[CAN_STATIC_COUNT] = {
+    CAN_STATIC_INSTANCES(CAN_X_QUEUES)
+};
+static ICANDriver *const can_static_drivers[CAN_STATIC_COUNT] = {
+    CAN_STATIC_INSTANCES(CAN_X_DRIVER)
+};
+#endif
+
+/* Hot-path driver calls. With a static configuration these resolve to direct
+ * calls the compiler (or LTO) can inline. */
+static inline CAN_Result_t can_drv_send(uint8_t inst_id, ICANDriver *drv,
+                                        const CAN_Message_t *msg)
+{
+#ifdef CAN_STATIC_INSTANCES
+    (void)drv;
+    switch (inst_id) {
+    CAN_STATIC_INSTANCES(CAN_X_SEND)
+    default:
+        return CAN_ERROR;
+    }
+#else
+    (void)inst_id;
+    return drv->send ? drv->send(drv, msg, 0) : CAN_ERROR;
+#endif
+}
+
+static inline CAN_Result_t can_drv_receive(uint8_t inst_id, ICANDriver *drv,
+                                           CAN_Message_t *msg)
+{
+#ifdef CAN_STATIC_INSTANCES
+    (void)drv;
+    switch (inst_id) {
+    CAN_STATIC_INSTANCES(CAN_X_RECEIVE)
+    default:
+        return CAN_ERROR;
+    }
+#else
+    (void)inst_id;
+    return drv->receive ? drv->receive(drv, msg) : CAN_ERROR;
+#endif
+}
+
+/* Queue storage for interfaces that don't bring their own. Frames are handed
+ * out in contiguous blocks, one per queue, and never returned. */
+#if CAN_FRAME_POOL_LEN > 0
+static CAN_QueueSlot_t can_frame_pool[CAN_FRAME_POOL_LEN];
+#else
+static CAN_QueueSlot_t *const can_frame_pool = NULL;
+#endif
+static uint32_t can_frame_pool_used = 0;
 
 /* Exported so drivers can notify about asynchronous events */
 void CAN_Manager_TriggerEvent(uint8_t inst_id, CAN_Event_t event, void *arg);
@@ -28,66 +270,258 @@ void CAN_Manager_TriggerEvent(uint8_t inst_id, CAN_Event_t event, void *arg);
 void CAN_Manager_Init(void)
 {
     memset(can_instances, 0, sizeof(can_instances));
-    can_instances_count = 0;
+    atomic_store_explicit(&can_instances_count, 0, memory_order_release);
+    can_frame_pool_used = 0;
+    can_os_mutex_init(&can_reg_lock);
+    for (uint32_t i = 0; i < CAN_ANY_WAITERS; ++i) {
+        atomic_init(&can_any_waiters[i].busy, 0);
+        for (uint32_t k = 0; k < CAN_WATCH_WORDS; ++k)
+            atomic_init(&can_any_waiters[i].watch[k], 0);
+        can_os_event_init(&can_any_waiters[i].event);
+    }
+    can_os_event_init(&can_any_rx_event);
+    atomic_init(&can_any_rx_waiters, 0);
+    atomic_init(&can_any_rx_shared, 0);
+    CAN_Requests_Init();
 }
 
-int CAN_Manager_AddInterface(ICANDriver *driver, const CAN_Config_t *config)
+static int can_add_locked(ICANDriver *driver, const CAN_Config_t *config,
+                          const CAN_QueueConfig_t *queues)
 {
-    if (can_instances_count >= MAX_CAN_INTERFACES || !driver || !driver->init) {
+    uint8_t n = atomic_load_explicit(&can_instances_count, memory_order_relaxed);
+    if (n >= MAX_CAN_INTERFACES)
         return -1;
-    }
-    if (driver->init(driver, config) != CAN_OK) {
+#ifdef CAN_STATIC_INSTANCES
+    /* interfaces must be added in table order; default to the table queues */
+    if (driver != can_static_drivers[n])
         return -1;
-    }
-    can_instances[can_instances_count].driver = driver;
-    can_instances[can_instances_count].driver_ctx = driver->ctx;
+    if (!queues)
+        queues = &can_static_queues[n];
+#endif
+    uint16_t tx_len = queues ? queues->tx_len : CAN_TX_QUEUE_LEN;
+    uint16_t rx_len = queues ? queues->rx_len : CAN_RX_QUEUE_LEN;
+    CAN_QueueSlot_t *tx_storage = queues ? queues->tx_storage : NULL;
+    CAN_QueueSlot_t *rx_storage = queues ? queues->rx_storage : NULL;
+    uint32_t pool_need = (tx_storage ? 0U : tx_len) + (rx_storage ? 0U : rx_len);
+    if ((tx_len & (tx_len - 1U)) || (rx_len & (rx_len - 1U)) || tx_len < 2 || rx_len < 2 ||
+        pool_need > CAN_FRAME_POOL_LEN - can_frame_pool_used)
+        return -1;
+    if (driver->init(driver, config) != CAN_OK)
+        return -1;
+
+    CAN_Instance_t *inst = &can_instances[n];
+    inst->driver = driver;
+    inst->driver_ctx = driver->ctx;
     if (config) {
-        can_instances[can_instances_count].filter_id = config->filter_id;
-        can_instances[can_instances_count].filter_mask = config->filter_mask;
-        can_instances[can_instances_count].use_interrupts = config->use_interrupts;
+        inst->filter_id = config->filter_id;
+        inst->filter_mask = config->filter_mask;
+        inst->use_interrupts = config->use_interrupts;
     } else {
-        can_instances[can_instances_count].filter_id = 0;
-        can_instances[can_instances_count].filter_mask = 0;
-        can_instances[can_instances_count].use_interrupts = 0;
-    }
-    memset(can_instances[can_instances_count].callbacks, 0, sizeof(CAN_Callback_t) * 3);
-    CAN_Buffer_t *buf = &can_instances[can_instances_count].buffers;
-    buf->tx_head = buf->tx_tail = 0;
-    buf->rx_head = buf->rx_tail = 0;
+        inst->filter_id = 0;
+        inst->filter_mask = 0;
+        inst->use_interrupts = 0;
+    }
+    memset(inst->callbacks, 0, sizeof(inst->callbacks));
+    CAN_Buffer_t *buf = &inst->buffers;
+    buf->tx_from_pool = tx_storage == NULL;
+    buf->rx_from_pool = rx_storage == NULL;
+    if (!tx_storage) {
+        tx_storage = &can_frame_pool[can_frame_pool_used];
+        can_frame_pool_used += tx_len;
+    }
+    if (!rx_storage) {
+        rx_storage = &can_frame_pool[can_frame_pool_used];
+        can_frame_pool_used += rx_len;
+    }
+    CAN_Queue_Init(&buf->tx, tx_storage, tx_len);
+    CAN_Queue_Init(&buf->rx, rx_storage, rx_len);
+    CAN_Queue_Init(&buf->rx_fast, inst->rx_fast_slots, CAN_RX_FAST_QUEUE_LEN);
+    inst->rx_fast_rules = 0;
+    memset(&inst->rx_stats, 0, sizeof(inst->rx_stats));
+    atomic_init(&inst->mailboxes, NULL);
+    atomic_init(&inst->exclusive, 0);
+    atomic_init(&inst->in_pass, 0);
+    atomic_init(&inst->thread_run, 0);
+    atomic_init(&inst->thread_idle, 0);
+    atomic_init(&inst->rx_waiters, 0);
+    atomic_init(&inst->tx_waiters, 0);
+    can_os_event_init(&inst->rx_event);
+    can_os_event_init(&inst->tx_event);
+    can_os_event_init(&inst->work_event);
+    for (uint32_t k = 0; k < CAN_TX_TRACK_LEN; ++k)
+        atomic_init(&inst->tx_track[k].busy, 0);
+    memset(&inst->tx_stats, 0, sizeof(inst->tx_stats));
+    inst->tx_last_handle = 0;
+    inst->tx_last_us = 0;
+    atomic_init(&inst->err_pending, 0);
+    atomic_init(&inst->recover_req, 0);
+    inst->err_policy.auto_recover = 1;
+    inst->err_policy.recover_min_ms = CAN_RECOVER_MIN_MS;
+    inst->err_policy.recover_max_ms = CAN_RECOVER_MAX_MS;
+    inst->err_policy.passive_tx_gap_ms = CAN_PASSIVE_TX_GAP_MS;
+    memset(&inst->err, 0, sizeof(inst->err));
+    inst->err_check_us = can_os_now_us();
+    inst->recover_at_us = 0;
+    inst->recover_backoff_ms = 0;
+    CAN_BusLoadConfig_t bl_cfg = { config ? config->bitrate : 0, 0, CAN_STUFF_WORST };
+    CAN_BusLoad_Init(&inst->busload, &bl_cfg, inst->err_check_us);
+    /* kept across CAN_RECONF_IRQ, applies while use_interrupts is set */
+    inst->irq_mod.budget = driver->rx_irq_mask ? CAN_IRQ_BUDGET : 0;
+    inst->irq_mod.enter_gap_us = CAN_IRQ_ENTER_GAP_US;
+    memset(&inst->irq_stats, 0, sizeof(inst->irq_stats));
+    atomic_init(&inst->rx_polling, 0);
+    inst->rx_irq_us = inst->err_check_us;
+    CAN_Requests_InitSet(&inst->requests, inst->err_check_us);
     /* store instance id in driver context if available */
     if (driver->ctx) {
         CAN_DriverContext_t *ctx = (CAN_DriverContext_t *)driver->ctx;
-        ctx->inst_id = can_instances_count;
+        ctx->inst_id = n;
     }
-    if (can_instances[can_instances_count].use_interrupts && driver->enable_interrupts)
+    atomic_store_explicit(&can_instances_count, (uint8_t)(n + 1), memory_order_release);
+    if (inst->use_interrupts && driver->enable_interrupts)
         driver->enable_interrupts(driver);
-    return can_instances_count++;
+    return n;
+}
+
+int CAN_Manager_AddInterface(ICANDriver *driver, const CAN_Config_t *config)
+{
+    return CAN_Manager_AddInterfaceEx(driver, config, NULL);
+}
+
+int CAN_Manager_AddInterfaceEx(ICANDriver *driver, const CAN_Config_t *config,
+                               const CAN_QueueConfig_t *queues)
+{
+    if (!driver || !driver->init)
+        return -1;
+    can_os_mutex_lock(&can_reg_lock);
+    int id = can_add_locked(driver, config, queues);
+    can_os_mutex_unlock(&can_reg_lock);
+    return id;
+}
+
+/* Route a received frame to its latest-value slot, or queue it.
+ * Returns -1 if the frame had to be dropped. */
+static int can_rx_deliver(CAN_Instance_t *inst, const CAN_Message_t *msg)
+{
+    uint8_t fast = msg->fifo == CAN_RX_FIFO_FAST;
+    CAN_BusLoad_Record(&inst->busload, msg, msg->timestamp);
+    inst->rx_stats.received[fast]++;
+    if (CAN_Requests_Match(&inst->requests, msg)) {
+        /* the processing context completes the request */
+        can_wake(&inst->work_event, &inst->thread_idle);
+        return 0;
+    }
+    CAN_Mailbox_t *mb = atomic_load_explicit(&inst->mailboxes, memory_order_acquire);
+    for (; mb; mb = mb->next) {
+        if (CAN_Mailbox_Store(mb, msg))
+            return 0;
+    }
+    if (CAN_Queue_Push(fast ? &inst->buffers.rx_fast : &inst->buffers.rx, msg, NULL) != 0) {
+        inst->rx_stats.dropped[fast]++;
+        return -1; /* drop if full */
+    }
+    can_wake(&inst->rx_event, &inst->rx_waiters);
+    can_any_wake((uint8_t)(inst - can_instances));
+    return 0;
+}
+
+/* Fast lane first, so a backlog of bulk frames never delays it */
+static inline int can_rx_pop(CAN_Instance_t *inst, CAN_Message_t *msg)
+{
+    if (CAN_Queue_Pop(&inst->buffers.rx_fast, msg) == 0)
+        return 0;
+    return CAN_Queue_Pop(&inst->buffers.rx, msg);
+}
+
+/* Stamp and enqueue a TX frame; its queue position doubles as the handle */
+static int can_tx_push(CAN_Instance_t *inst, const CAN_Message_t *msg, CAN_TxHandle_t *handle)
+{
+    CAN_Message_t m = *msg;
+    uint32_t pos;
+    m.timestamp = can_os_now_us();
+    if (CAN_Queue_Push(&inst->buffers.tx, &m, &pos) != 0)
+        return -1; /* full */
+    if (handle)
+        *handle = pos;
+    can_wake(&inst->work_event, &inst->thread_idle);
+    return 0;
 }
 
 CAN_Result_t CAN_SendMessage(uint8_t inst_id, const CAN_Message_t *msg)
 {
-    if (inst_id >= can_instances_count) {
+    return CAN_SendMessageEx(inst_id, msg, NULL);
+}
+
+CAN_Result_t CAN_SendMessageEx(uint8_t inst_id, const CAN_Message_t *msg, CAN_TxHandle_t *handle)
+{
+    if (inst_id >= can_count() || !msg) {
         return CAN_ERROR;
     }
-    CAN_Buffer_t *buf = &can_instances[inst_id].buffers;
-    uint16_t next = (buf->tx_head + 1) % CAN_TX_QUEUE_LEN;
-    if (next == buf->tx_tail)
-        return CAN_ERROR; /* full */
-    buf->tx_queue[buf->tx_head] = *msg;
-    buf->tx_head = next;
+    return can_tx_push(&can_instances[inst_id], msg, handle) == 0 ? CAN_OK : CAN_ERROR;
+}
+
+CAN_Result_t CAN_Request(uint8_t inst_id, const CAN_Message_t *tx_msg, uint32_t match_id,
+                         uint32_t match_mask, uint32_t timeout_ms, CAN_RequestCb_t cb, void *user)
+{
+    if (inst_id >= can_count())
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    if (CAN_Requests_Submit(&inst->requests, tx_msg, match_id, match_mask, timeout_ms, cb, user) != 0)
+        return CAN_ERROR;
+    can_wake(&inst->work_event, &inst->thread_idle);
     return CAN_OK;
 }
 
+uint16_t CAN_GetTxFree(uint8_t inst_id)
+{
+    if (inst_id >= can_count())
+        return 0;
+    const CAN_Queue_t *q = &can_instances[inst_id].buffers.tx;
+    uint16_t used = CAN_Queue_Count(q);
+    return used < CAN_Queue_Len(q) ? (uint16_t)(CAN_Queue_Len(q) - used) : 0;
+}
+
+CAN_Result_t CAN_SendMessageTimeout(uint8_t inst_id, const CAN_Message_t *msg,
+                                    uint32_t timeout_ms)
+{
+    if (CAN_SendMessage(inst_id, msg) == CAN_OK)
+        return CAN_OK;
+    if (timeout_ms == 0 || inst_id >= can_count() || !msg)
+        return CAN_ERROR;
+
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    uint32_t start = can_os_now_us();
+    CAN_Result_t res = CAN_ERROR;
+    can_wait_enter(&inst->tx_waiters);
+    for (;;) {
+        if (can_tx_push(inst, msg, NULL) == 0) {
+            res = CAN_OK;
+            break;
+        }
+        uint32_t left = can_time_left(start, timeout_ms);
+        if (left == 0)
+            break;
+        can_os_event_wait(&inst->tx_event, left);
+    }
+    can_wait_leave(&inst->tx_waiters);
+    if (res == CAN_OK) {
+        /* the event wakes one producer; pass it on if there is still room */
+        if (CAN_Queue_Count(&inst->buffers.tx) < CAN_Queue_Len(&inst->buffers.tx))
+            can_wake(&inst->tx_event, &inst->tx_waiters);
+    }
+    return res;
+}
+
 void CAN_RegisterCallback(uint8_t inst_id, CAN_Event_t event, CAN_Callback_t cb)
 {
-    if (inst_id >= can_instances_count || event > CAN_EVENT_ERROR)
+    if (inst_id >= can_count() || event > CAN_EVENT_RX_FAST)
         return;
     can_instances[inst_id].callbacks[event] = cb;
 }
 
 CAN_Result_t CAN_SetFilter(uint8_t inst_id, uint32_t id, uint32_t mask)
 {
-    if (inst_id >= can_instances_count)
+    if (inst_id >= can_count())
         return CAN_ERROR;
     ICANDriver *drv = can_instances[inst_id].driver;
     if (!drv || !drv->set_filter)
@@ -97,65 +531,916 @@ CAN_Result_t CAN_SetFilter(uint8_t inst_id, uint32_t id, uint32_t mask)
     return drv->set_filter(drv, id, mask);
 }
 
+CAN_Result_t CAN_SetFifoFilter(uint8_t inst_id, uint8_t index, uint32_t id, uint32_t mask,
+                              uint8_t fifo)
+{
+    if (inst_id >= can_count() || index >= CAN_RX_FAST_FILTERS ||
+        (fifo >= CAN_RX_FIFO_COUNT && fifo != CAN_RX_FIFO_OFF))
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    ICANDriver *drv = inst->driver;
+    if (!drv->set_fifo_filter || drv->set_fifo_filter(drv, index, id, mask, fifo) != CAN_OK)
+        return CAN_ERROR;
+    if (fifo == CAN_RX_FIFO_FAST)
+        inst->rx_fast_rules |= (uint8_t)(1U << index);
+    else
+        inst->rx_fast_rules &= (uint8_t)~(1U << index);
+    return CAN_OK;
+}
+
+CAN_Result_t CAN_GetRxStats(uint8_t inst_id, CAN_RxStats_t *stats)
+{
+    if (inst_id >= can_count() || !stats)
+        return CAN_ERROR;
+    *stats = can_instances[inst_id].rx_stats;
+    return CAN_OK;
+}
+
+/* Called by drivers when a controller FIFO overflowed and frames were lost */
+void CAN_Manager_RxOverrun(uint8_t inst_id, uint8_t fifo)
+{
+    if (inst_id >= can_count() || fifo >= CAN_RX_FIFO_COUNT)
+        return;
+    can_instances[inst_id].rx_stats.overruns[fifo]++;
+    CAN_TRACE(RX_OVERRUN, inst_id, fifo);
+}
+
+/* Called by drivers on entry to an RX interrupt. Back-to-back interrupts
+ * hand the instance over to the processing context (NAPI style): per-frame
+ * RX interrupts are masked and the frames left in the controller. */
+uint8_t CAN_Manager_RxIrq(uint8_t inst_id)
+{
+    if (inst_id >= can_count())
+        return 1;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    inst->irq_stats.rx_irqs++;
+    if (!inst->irq_mod.budget || !inst->use_interrupts)
+        return 1;
+    if (atomic_load_explicit(&inst->rx_polling, memory_order_acquire)) {
+        /* a watermark interrupt: the poll is late, make sure it runs */
+        inst->irq_stats.watermark_irqs++;
+        can_wake(&inst->work_event, &inst->thread_idle);
+        return 0;
+    }
+    uint32_t now = can_os_now_us();
+    uint32_t gap = now - inst->rx_irq_us;
+    inst->rx_irq_us = now;
+    if (gap >= inst->irq_mod.enter_gap_us)
+        return 1;
+    inst->driver->rx_irq_mask(inst->driver, 1);
+    atomic_store_explicit(&inst->rx_polling, 1, memory_order_release);
+    inst->irq_stats.poll_enter++;
+    CAN_TRACE(IRQ_POLL, inst_id, gap);
+    can_wake(&inst->work_event, &inst->thread_idle);
+    return 0;
+}
+
 int CAN_GetMessage(uint8_t inst_id, CAN_Message_t *msg)
 {
-    if (inst_id >= can_instances_count || !msg)
+    if (inst_id >= can_count() || !msg)
         return -1;
-    CAN_Buffer_t *buf = &can_instances[inst_id].buffers;
-    if (buf->rx_head == buf->rx_tail)
+    return can_rx_pop(&can_instances[inst_id], msg);
+}
+
+int CAN_WaitMessage(uint8_t inst_id, CAN_Message_t *msg, uint32_t timeout_ms)
+{
+    if (CAN_GetMessage(inst_id, msg) == 0)
+        return 0;
+    if (timeout_ms == 0 || inst_id >= can_count() || !msg)
         return -1;
-    *msg = buf->rx_queue[buf->rx_tail];
-    buf->rx_tail = (buf->rx_tail + 1) % CAN_RX_QUEUE_LEN;
-    return 0;
+
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    uint32_t start = can_os_now_us();
+    int rc = -1;
+    can_wait_enter(&inst->rx_waiters);
+    for (;;) {
+        if (can_rx_pop(inst, msg) == 0) {
+            rc = 0;
+            break;
+        }
+        uint32_t left = can_time_left(start, timeout_ms);
+        if (left == 0)
+            break;
+        can_os_event_wait(&inst->rx_event, left);
+    }
+    can_wait_leave(&inst->rx_waiters);
+    if (rc == 0 && (CAN_Queue_Count(&inst->buffers.rx) || CAN_Queue_Count(&inst->buffers.rx_fast)))
+        can_wake(&inst->rx_event, &inst->rx_waiters);
+    return rc;
+}
+
+static int can_get_any(const uint8_t *ids, uint8_t num, CAN_Message_t *msg)
+{
+    uint8_t count = can_count();
+    /* fast lanes of all listed instances before any bulk frame */
+    for (uint8_t i = 0; i < num; ++i) {
+        if (ids[i] < count && CAN_Queue_Pop(&can_instances[ids[i]].buffers.rx_fast, msg) == 0)
+            return ids[i];
+    }
+    for (uint8_t i = 0; i < num; ++i) {
+        if (ids[i] < count && CAN_Queue_Pop(&can_instances[ids[i]].buffers.rx, msg) == 0)
+            return ids[i];
+    }
+    return -1;
+}
+
+int CAN_WaitAny(const uint8_t *ids, uint8_t num, CAN_Message_t *msg, uint32_t timeout_ms)
+{
+    if (!ids || !msg || num == 0)
+        return -1;
+    int id = can_get_any(ids, num, msg);
+    if (id >= 0 || timeout_ms == 0)
+        return id;
+
+    uint32_t watch[CAN_WATCH_WORDS] = { 0 };
+    for (uint8_t i = 0; i < num; ++i) {
+        if (ids[i] < MAX_CAN_INTERFACES)
+            watch[ids[i] / 32U] |= 1UL << (ids[i] % 32U);
+    }
+    uint32_t start = can_os_now_us();
+    CAN_AnyWaiter_t *w = can_any_enter(watch);
+    for (;;) {
+        id = can_get_any(ids, num, msg);
+        if (id >= 0)
+            break;
+        uint32_t left = can_time_left(start, timeout_ms);
+        if (left == 0)
+            break;
+        can_any_wait(w, left);
+    }
+    can_any_leave(w);
+    return id;
+}
+
+CAN_Result_t CAN_OpenMerge(CAN_Merge_t *merge, const uint8_t *ids, uint8_t num,
+                           uint32_t max_delay_us)
+{
+    uint8_t count = can_count();
+    if (!merge || !ids || num == 0 || num > MAX_CAN_INTERFACES)
+        return CAN_ERROR;
+    /* a queue listed twice would have two heap entries peeking one frame */
+    for (uint8_t i = 0; i < num; ++i) {
+        if (ids[i] >= count)
+            return CAN_ERROR;
+        for (uint8_t j = 0; j < i; ++j) {
+            if (ids[j] == ids[i])
+                return CAN_ERROR;
+        }
+    }
+    CAN_Merge_Init(merge, max_delay_us);
+    for (uint8_t i = 0; i < num; ++i) {
+        CAN_Instance_t *inst = &can_instances[ids[i]];
+        /* an idle fast ring would hold every frame for max_delay_us */
+        if (inst->rx_fast_rules)
+            CAN_Merge_AddSource(merge, &inst->buffers.rx_fast, ids[i]);
+        CAN_Merge_AddSource(merge, &inst->buffers.rx, ids[i]);
+    }
+    return CAN_OK;
+}
+
+uint16_t CAN_ReadMerged(CAN_Merge_t *merge, uint16_t max, CAN_MergeVisitor_t visitor,
+                        void *user, uint32_t timeout_ms)
+{
+    if (!merge || !visitor || max == 0)
+        return 0;
+    uint16_t n = CAN_Merge_Read(merge, can_os_now_us(), max, visitor, user);
+    if (n || timeout_ms == 0)
+        return n;
+
+    uint32_t watch[CAN_WATCH_WORDS] = { 0 };
+    for (uint8_t i = 0; i < merge->num_src; ++i)
+        watch[merge->src[i].inst_id / 32U] |= 1UL << (merge->src[i].inst_id % 32U);
+    uint32_t start = can_os_now_us();
+    CAN_AnyWaiter_t *w = can_any_enter(watch);
+    for (;;) {
+        uint32_t now = can_os_now_us();
+        n = CAN_Merge_Read(merge, now, max, visitor, user);
+        if (n)
+            break;
+        uint32_t left = can_time_left(start, timeout_ms);
+        if (left == 0)
+            break;
+        /* a held frame is due once its reorder delay runs out */
+        uint32_t hold = CAN_Merge_HoldTime(merge, now);
+        if (hold) {
+            hold = (hold + 999U) / 1000U;
+            if (hold < left)
+                left = hold;
+        }
+        can_any_wait(w, left);
+    }
+    can_any_leave(w);
+    return n;
+}
+
+CAN_Result_t CAN_AttachMailbox(uint8_t inst_id, CAN_Mailbox_t *mb)
+{
+    if (inst_id >= can_count() || !mb || !mb->entries || !mb->changed)
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    can_os_mutex_lock(&can_reg_lock);
+    /* Fully link the range before publishing it to the RX path */
+    mb->next = atomic_load_explicit(&inst->mailboxes, memory_order_relaxed);
+    atomic_store_explicit(&inst->mailboxes, mb, memory_order_release);
+    can_os_mutex_unlock(&can_reg_lock);
+    return CAN_OK;
+}
+
+int CAN_ReadLatest(uint8_t inst_id, uint32_t id, uint8_t extended,
+                   CAN_Message_t *msg, uint32_t *seq)
+{
+    if (inst_id >= can_count() || !msg)
+        return -1;
+    CAN_Mailbox_t *mb = atomic_load_explicit(&can_instances[inst_id].mailboxes,
+                                             memory_order_acquire);
+    for (; mb; mb = mb->next) {
+        if (mb->extended == (extended ? 1 : 0) && id - mb->base_id < mb->count)
+            return CAN_Mailbox_Read(mb, id, msg, seq);
+    }
+    return -1;
+}
+
+uint16_t CAN_PollChanged(uint8_t inst_id, CAN_MailboxVisitor_t visitor, void *user)
+{
+    uint16_t n = 0;
+    if (inst_id >= can_count())
+        return 0;
+    CAN_Mailbox_t *mb = atomic_load_explicit(&can_instances[inst_id].mailboxes,
+                                             memory_order_acquire);
+    for (; mb; mb = mb->next)
+        n += CAN_Mailbox_PollChanged(mb, visitor, user);
+    return n;
+}
+
+void CAN_Manager_GetMemoryReport(CAN_MemoryReport_t *report)
+{
+    if (!report)
+        return;
+    memset(report, 0, sizeof(*report));
+    report->pool_frames = CAN_FRAME_POOL_LEN;
+    report->pool_used = can_frame_pool_used;
+    report->static_bytes = (uint32_t)(sizeof(can_instances) +
+                                      CAN_FRAME_POOL_LEN * sizeof(CAN_QueueSlot_t));
+    report->instances = can_count();
+    for (uint8_t i = 0; i < report->instances; ++i) {
+        const CAN_Buffer_t *buf = &can_instances[i].buffers;
+        CAN_InstanceMemory_t *m = &report->inst[i];
+        m->tx_len = CAN_Queue_Len(&buf->tx);
+        m->rx_len = CAN_Queue_Len(&buf->rx);
+        m->tx_peak = atomic_load_explicit(&buf->tx.peak, memory_order_relaxed);
+        m->rx_peak = atomic_load_explicit(&buf->rx.peak, memory_order_relaxed);
+        m->tx_from_pool = buf->tx_from_pool;
+        m->rx_from_pool = buf->rx_from_pool;
+        m->rx_fast_peak = atomic_load_explicit(&buf->rx_fast.peak, memory_order_relaxed);
+        m->queue_bytes = (uint32_t)(m->tx_len + m->rx_len) * sizeof(CAN_QueueSlot_t);
+        const CAN_Mailbox_t *mb = atomic_load_explicit(&can_instances[i].mailboxes,
+                                                       memory_order_acquire);
+        for (; mb; mb = mb->next) {
+            m->mailbox_bytes += (uint32_t)(mb->count * sizeof(CAN_MailboxEntry_t) +
+                                           CAN_MAILBOX_WORDS(mb->count) * sizeof(uint32_t));
+        }
+    }
+}
+
+/* The controller was restarted and dropped whatever it still had to send:
+ * fail every frame awaiting its report */
+static void can_tx_fail_all(uint8_t i, CAN_Instance_t *inst)
+{
+    for (uint32_t k = 0; k < CAN_TX_TRACK_LEN; ++k) {
+        CAN_TxTrack_t *t = &inst->tx_track[k];
+        if (atomic_load_explicit(&t->busy, memory_order_acquire) == 1)
+            CAN_Manager_TxDone(i, t->handle, 0);
+    }
 }
 
 CAN_Result_t CAN_StartAutoBaud(uint8_t inst_id, const uint32_t *rates, uint8_t num)
 {
-    if (inst_id >= can_instances_count)
+    if (inst_id >= can_count())
         return CAN_ERROR;
     ICANDriver *drv = can_instances[inst_id].driver;
-    if (drv && drv->auto_baud_detect) {
-        return drv->auto_baud_detect(drv, rates, num);
+    if (!drv || !drv->auto_baud_detect)
+        return CAN_ERROR;
+    CAN_Result_t res = drv->auto_baud_detect(drv, rates, num);
+    can_tx_fail_all(inst_id, &can_instances[inst_id]);
+    return res;
+}
+
+/* Reconfiguration for drivers without the reconfigure hook: one call per
+ * part, so each may restart the controller; the whole time counts as
+ * offline. */
+static CAN_Result_t can_reconfigure_each(ICANDriver *drv, const CAN_Reconfig_t *rc)
+{
+    CAN_Result_t res = CAN_OK;
+    if (rc->set & CAN_RECONF_BITRATE)
+        return CAN_ERROR;
+    if ((rc->set & CAN_RECONF_MODE) && (!drv->set_mode || drv->set_mode(drv, rc->mode) != CAN_OK))
+        res = CAN_ERROR;
+    if ((rc->set & CAN_RECONF_FILTER) &&
+        (!drv->set_filter || drv->set_filter(drv, rc->filter_id, rc->filter_mask) != CAN_OK))
+        res = CAN_ERROR;
+    if (rc->set & CAN_RECONF_FAST) {
+        for (uint8_t i = 0; i < CAN_RX_FAST_FILTERS; ++i) {
+            const CAN_FifoRule_t *r = &rc->fast[i];
+            if ((rc->fast_set & (1U << i)) &&
+                drv->set_fifo_filter(drv, i, r->id, r->mask, r->fifo) != CAN_OK)
+                res = CAN_ERROR;
+        }
     }
-    return CAN_ERROR;
+    return res;
 }
 
-void CAN_Manager_Process(void)
+CAN_Result_t CAN_Reconfigure(uint8_t inst_id, const CAN_Reconfig_t *rc,
+                             CAN_ReconfigReport_t *report)
 {
-    for (uint8_t i = 0; i < can_instances_count; ++i) {
-        CAN_Instance_t *inst = &can_instances[i];
-        ICANDriver *drv = inst->driver;
-        CAN_Buffer_t *buf = &inst->buffers;
-        if (!drv)
-            continue;
+    if (inst_id >= can_count() || !rc)
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    ICANDriver *drv = inst->driver;
+    uint8_t irq = (rc->set & CAN_RECONF_IRQ) ? (rc->use_interrupts ? 1 : 0) : inst->use_interrupts;
+    if (((rc->set & CAN_RECONF_FAST) && !drv->set_fifo_filter) ||
+        (irq != inst->use_interrupts && (!drv->enable_interrupts || !drv->disable_interrupts)))
+        return CAN_ERROR;
 
-        if (buf->tx_head != buf->tx_tail && drv->send) {
-            CAN_Message_t *msg = &buf->tx_queue[buf->tx_tail];
-            if (drv->send(drv, msg, 0) == CAN_OK) {
-                buf->tx_tail = (buf->tx_tail + 1) % CAN_TX_QUEUE_LEN;
-            }
+    uint32_t t0 = can_os_now_us();
+    uint32_t offline = 0;
+    /* Interrupts go off before the controller changes under the ISR, and
+     * come back once it runs with the new settings */
+    if (!irq && inst->use_interrupts) {
+        drv->disable_interrupts(drv);
+        /* the budget stays for when interrupts come back */
+        atomic_store_explicit(&inst->rx_polling, 0, memory_order_release);
+        inst->use_interrupts = 0;
+    }
+    CAN_Result_t res;
+    uint8_t restarted;
+    if (drv->reconfigure) {
+        res = drv->reconfigure(drv, rc, &offline);
+        restarted = offline != 0;
+    } else {
+        res = can_reconfigure_each(drv, rc);
+        offline = can_os_now_us() - t0;
+        restarted = (rc->set & CAN_RECONF_MODE) != 0;   /* set_mode may restart */
+    }
+    if (restarted)
+        can_tx_fail_all(inst_id, inst);
+    if (irq && !inst->use_interrupts) {
+        inst->use_interrupts = 1;
+        drv->enable_interrupts(drv);
+    }
+
+    if (rc->set & CAN_RECONF_FILTER) {
+        inst->filter_id = rc->filter_id;
+        inst->filter_mask = rc->filter_mask;
+    }
+    if (rc->set & CAN_RECONF_FAST) {
+        for (uint8_t i = 0; i < CAN_RX_FAST_FILTERS; ++i) {
+            if (!(rc->fast_set & (1U << i)))
+                continue;
+            if (rc->fast[i].fifo == CAN_RX_FIFO_FAST)
+                inst->rx_fast_rules |= (uint8_t)(1U << i);
+            else
+                inst->rx_fast_rules &= (uint8_t)~(1U << i);
+        }
+    }
+    uint32_t now = can_os_now_us();
+    if (rc->set & CAN_RECONF_BITRATE) {
+        CAN_BusLoadConfig_t bl_cfg = inst->busload.cfg;
+        bl_cfg.bitrate = rc->bitrate;
+        CAN_BusLoad_Init(&inst->busload, &bl_cfg, now);
+    }
+    CAN_TRACE(RECONFIG, inst_id, offline);
+    if (report) {
+        report->offline_us = offline;
+        report->total_us = now - t0;
+    }
+    return res;
+}
+
+CAN_Result_t CAN_SetErrorPolicy(uint8_t inst_id, const CAN_ErrorPolicy_t *policy)
+{
+    if (inst_id >= can_count() || !policy || policy->recover_min_ms == 0 ||
+        policy->recover_max_ms < policy->recover_min_ms)
+        return CAN_ERROR;
+    can_instances[inst_id].err_policy = *policy;
+    return CAN_OK;
+}
+
+CAN_Result_t CAN_GetErrorStatus(uint8_t inst_id, CAN_ErrorEvent_t *status)
+{
+    if (inst_id >= can_count() || !status)
+        return CAN_ERROR;
+    *status = can_instances[inst_id].err;
+    return CAN_OK;
+}
+
+CAN_Result_t CAN_SetIrqModeration(uint8_t inst_id, const CAN_IrqModeration_t *cfg)
+{
+    if (inst_id >= can_count() || !cfg)
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    if (cfg->budget && !inst->driver->rx_irq_mask)
+        return CAN_ERROR;
+    inst->irq_mod = *cfg;
+    /* turning moderation off while polled: back to per-frame interrupts */
+    if (!cfg->budget && atomic_exchange_explicit(&inst->rx_polling, 0, memory_order_acq_rel))
+        inst->driver->rx_irq_mask(inst->driver, 0);
+    return CAN_OK;
+}
+
+CAN_Result_t CAN_GetIrqStats(uint8_t inst_id, CAN_IrqStats_t *stats)
+{
+    if (inst_id >= can_count() || !stats)
+        return CAN_ERROR;
+    *stats = can_instances[inst_id].irq_stats;
+    return CAN_OK;
+}
+
+/* Ask the processing context for a recovery attempt now, regardless of the
+ * backoff and auto_recover */
+CAN_Result_t CAN_RecoverBusOff(uint8_t inst_id)
+{
+    if (inst_id >= can_count())
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    if (!inst->driver->recover)
+        return CAN_ERROR;
+    atomic_store_explicit(&inst->recover_req, 1, memory_order_relaxed);
+    can_wake(&inst->work_event, &inst->thread_idle);
+    return CAN_OK;
+}
+
+static CAN_ErrorState_t can_error_classify(const CAN_BusStatus_t *st)
+{
+    if (st->bus_off || st->tec > 255U)
+        return CAN_STATE_BUS_OFF;
+    if (st->tec >= 128U || st->rec >= 128U)
+        return CAN_STATE_ERROR_PASSIVE;
+    if (st->tec >= 96U || st->rec >= 96U)
+        return CAN_STATE_ERROR_WARNING;
+    return CAN_STATE_ERROR_ACTIVE;
+}
+
+/* Re-read the error counters when the driver reported an error, while the
+ * instance is not error-active and periodically when polled; step the state
+ * machine and run bus-off recovery. */
+static void can_error_step(uint8_t i, CAN_Instance_t *inst, uint32_t now)
+{
+    ICANDriver *drv = inst->driver;
+    uint8_t pending = atomic_exchange_explicit(&inst->err_pending, 0, memory_order_acquire);
+    uint8_t recover = atomic_exchange_explicit(&inst->recover_req, 0, memory_order_relaxed);
+    int due = (now - inst->err_check_us) >= CAN_ERROR_POLL_MS * 1000U &&
+              (!inst->use_interrupts || inst->err.state != CAN_STATE_ERROR_ACTIVE);
+    if (!pending && !recover && !due)
+        return;
+    inst->err_check_us = now;
+
+    CAN_BusStatus_t st = { 0, 0, 0 };
+    if (drv->get_bus_status && drv->get_bus_status(drv, &st) != CAN_OK)
+        return;
+    CAN_ErrorState_t prev = inst->err.state;
+    CAN_ErrorState_t state = can_error_classify(&st);
+    CAN_ErrorEvent_t *e = &inst->err;
+    e->tec = st.tec;
+    e->rec = st.rec;
+
+    if (state == CAN_STATE_BUS_OFF) {
+        const CAN_ErrorPolicy_t *p = &inst->err_policy;
+        if (prev != CAN_STATE_BUS_OFF) {
+            e->bus_off_count++;
+            e->recover_attempts = 0;
+            inst->recover_backoff_ms = p->recover_min_ms;
+            inst->recover_at_us = now + p->recover_min_ms * 1000U;
+        } else if (drv->recover &&
+                   (recover || (p->auto_recover && (int32_t)(now - inst->recover_at_us) >= 0))) {
+            drv->recover(drv);
+            can_tx_fail_all(i, inst);
+            e->recover_attempts++;
+            CAN_TRACE(BUS_OFF_RECOVER, i, e->recover_attempts);
+            inst->recover_at_us = now + inst->recover_backoff_ms * 1000U;
+            inst->recover_backoff_ms = inst->recover_backoff_ms * 2U > p->recover_max_ms ?
+                                       p->recover_max_ms : inst->recover_backoff_ms * 2U;
+        }
+    }
+
+    if (state == prev && !pending)
+        return;
+    if (state != prev)
+        CAN_TRACE(ERR_STATE, i, state);
+    e->prev = prev;
+    e->state = state;
+    e->flags = drv->get_error_state ? drv->get_error_state(drv) : 0;
+    e->timestamp = now;
+    CAN_ErrorEvent_t ev = *e;
+    CAN_Callback_t cb = inst->callbacks[CAN_EVENT_ERROR];
+    if (cb)
+        cb(i, CAN_EVENT_ERROR, &ev);
+}
+
+/* TX throttle: nothing goes out during bus-off, and while error-passive only
+ * one frame at a time, passive_tx_gap_ms apart, so a faulty bus does not
+ * eat the queue in retries while the TEC still gets a chance to drop. */
+static int can_tx_allowed(const CAN_Instance_t *inst, uint32_t now)
+{
+    if (inst->err.state == CAN_STATE_BUS_OFF)
+        return 0;
+    if (inst->err.state != CAN_STATE_ERROR_PASSIVE)
+        return 1;
+    uint32_t gap = inst->err_policy.passive_tx_gap_ms;
+    if (gap == CAN_WAIT_FOREVER)
+        return 0;
+    const CAN_TxTrack_t *t = &inst->tx_track[inst->tx_last_handle & (CAN_TX_TRACK_LEN - 1U)];
+    /* wait for the previous frame */
+    if (atomic_load_explicit(&t->busy, memory_order_acquire) && t->handle == inst->tx_last_handle)
+        return 0;
+    return (now - inst->tx_last_us) >= gap * 1000U;
+}
+
+/* Polled instances with fast lane rules: read until the controller hands
+ * out a main FIFO frame (drivers return the fast lane first) or runs dry.
+ * Returns non-zero if a frame was received. */
+static int can_rx_fast(uint8_t i)
+{
+    CAN_Instance_t *inst = &can_instances[i];
+    CAN_Message_t rx;
+    int work = 0;
+    if (inst->use_interrupts || !inst->rx_fast_rules || !inst->driver)
+        return 0;
+    rx.timestamp = 0;
+    while (can_drv_receive(i, inst->driver, &rx) == CAN_OK) {
+        work = 1;
+        if (!rx.timestamp)
+            rx.timestamp = can_os_now_us();
+        if (can_rx_deliver(inst, &rx) != 0 || rx.fifo != CAN_RX_FIFO_FAST)
+            break;
+    }
+    return work;
+}
+
+/* Poll pass of a moderated instance: drain up to the budget. The driver's
+ * receive() reports each frame through CAN_Manager_TriggerEvent, which
+ * delivers it as for interrupt mode. Once the controller is empty the
+ * per-frame interrupts come back. Returns non-zero if a frame was read. */
+static int can_rx_poll(uint8_t i, CAN_Instance_t *inst)
+{
+    CAN_IrqStats_t *st = &inst->irq_stats;
+    uint16_t budget = inst->irq_mod.budget;
+    uint16_t n = 0;
+    CAN_Message_t rx;
+    while (n < budget && can_drv_receive(i, inst->driver, &rx) == CAN_OK)
+        n++;
+    st->polls++;
+    st->poll_frames += n;
+    if (n == budget) {
+        st->budget_hits++;
+        return 1;
+    }
+    atomic_store_explicit(&inst->rx_polling, 0, memory_order_release);
+    inst->driver->rx_irq_mask(inst->driver, 0);
+    CAN_TRACE(IRQ_UNMASK, i, st->polls);
+    return n != 0;
+}
+
+static int can_request_send(void *ctx, const CAN_Message_t *msg)
+{
+    return can_tx_push((CAN_Instance_t *)ctx, msg, NULL);
+}
+
+/* TX and bulk RX pass for one instance; must only run in its processing
+ * context. Returns non-zero if a frame was sent or received. */
+static int can_process_rest(uint8_t i)
+{
+    CAN_Instance_t *inst = &can_instances[i];
+    ICANDriver *drv = inst->driver;
+    CAN_Buffer_t *buf = &inst->buffers;
+    int work = 0;
+    if (!drv)
+        return 0;
+
+    /* completions first, so freed TX buffers are used in this pass */
+    if (drv->service)
+        drv->service(drv);
+    uint32_t now = can_os_now_us();
+    can_error_step(i, inst, now);
+    /* before the TX queue, so new requests go out in this pass */
+    work |= CAN_Requests_Step(&inst->requests, i, now, can_request_send, inst);
+
+    uint32_t handle;
+    CAN_Message_t *msg = CAN_Queue_Peek(&buf->tx, &handle);
+    CAN_TxTrack_t *t = msg ? &inst->tx_track[handle & (CAN_TX_TRACK_LEN - 1U)] : NULL;
+    /* The slot still tracks a frame CAN_TX_TRACK_LEN handles older: hold the
+     * queue until its completion arrives rather than lose that report */
+    if (msg && (atomic_load_explicit(&t->busy, memory_order_acquire) ||
+                !can_tx_allowed(inst, now)))
+        msg = NULL;
+    if (msg) {
+        /* Record the frame before the driver sees it: the completion IRQ
+         * may fire before send() returns. */
+        t->handle = handle;
+        t->msg = *msg;
+        t->t_hw = now;
+        atomic_store_explicit(&t->busy, 1, memory_order_release);
+        if (inst->driver_ctx)
+            ((CAN_DriverContext_t *)inst->driver_ctx)->tx_handle = handle;
+        if (can_drv_send(i, drv, msg) == CAN_OK) {
+            inst->tx_last_handle = handle;
+            inst->tx_last_us = now;
+            CAN_Queue_Release(&buf->tx);
+            can_wake(&inst->tx_event, &inst->tx_waiters);
+            work = 1;
+        } else {
+            atomic_store_explicit(&t->busy, 0, memory_order_relaxed);
+        }
+    }
+
+    if (!inst->use_interrupts) {
+        CAN_Message_t rx;
+        rx.timestamp = 0;
+        while (can_drv_receive(i, drv, &rx) == CAN_OK) {
+            work = 1;
+            if (!rx.timestamp)
+                rx.timestamp = can_os_now_us();
+            if (can_rx_deliver(inst, &rx) != 0)
+                break;
         }
+    } else if (atomic_load_explicit(&inst->rx_polling, memory_order_acquire)) {
+        work |= can_rx_poll(i, inst);
+    }
+    return work;
+}
+
+static int can_process_one(uint8_t i)
+{
+    int work = can_rx_fast(i);
+    return can_process_rest(i) | work;
+}
+
+/* The queues of an instance have a single consumer: every pass claims the
+ * instance first, and a context that finds it claimed skips it. Sequentially
+ * consistent, so a pass that claims after CAN_Manager_StartThread set
+ * `exclusive` sees it, and StartThread sees a pass that claimed before. */
+static int can_pass_claim(CAN_Instance_t *inst)
+{
+    uint8_t idle = 0;
+    return atomic_compare_exchange_strong(&inst->in_pass, &idle, 1);
+}
+
+static void can_pass_release(CAN_Instance_t *inst)
+{
+    atomic_store_explicit(&inst->in_pass, 0, memory_order_release);
+}
+
+/* Claim a shared instance for CAN_Manager_Process */
+static int can_process_claim(CAN_Instance_t *inst)
+{
+    if (atomic_load_explicit(&inst->exclusive, memory_order_acquire) || !can_pass_claim(inst))
+        return 0;
+    if (atomic_load(&inst->exclusive)) {
+        can_pass_release(inst);
+        return 0;
+    }
+    return 1;
+}
+
+void CAN_Manager_Process(void)
+{
+    uint8_t count = can_count();
+    /* Fast lanes of every instance before any TX or bulk RX work */
+    for (uint8_t i = 0; i < count; ++i) {
+        if (can_process_claim(&can_instances[i])) {
+            can_rx_fast(i);
+            can_pass_release(&can_instances[i]);
+        }
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+        if (can_process_claim(&can_instances[i])) {
+            can_process_rest(i);
+            can_pass_release(&can_instances[i]);
+        }
+    }
+}
+
+void CAN_Manager_ProcessInstance(uint8_t inst_id)
+{
+    if (inst_id >= can_count())
+        return;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    if (!can_pass_claim(inst))
+        return;
+    can_process_one(inst_id);
+    can_pass_release(inst);
+}
+
+CAN_Result_t CAN_Manager_SetExclusive(uint8_t inst_id, uint8_t exclusive)
+{
+    if (inst_id >= can_count())
+        return CAN_ERROR;
+    atomic_store_explicit(&can_instances[inst_id].exclusive, exclusive ? 1 : 0,
+                          memory_order_release);
+    return CAN_OK;
+}
 
-        if (drv->receive && !inst->use_interrupts) {
-            CAN_Message_t rx;
-            while (drv->receive(drv, &rx) == CAN_OK) {
-                uint16_t next = (buf->rx_head + 1) % CAN_RX_QUEUE_LEN;
-                if (next == buf->rx_tail)
-                    break; /* drop if full */
-                buf->rx_queue[buf->rx_head] = rx;
-                buf->rx_head = next;
+static void can_instance_thread(void *arg)
+{
+    CAN_Instance_t *inst = (CAN_Instance_t *)arg;
+    uint8_t id = (uint8_t)(inst - can_instances);
+    uint32_t wait = inst->thread_period_ms ? inst->thread_period_ms : CAN_WAIT_FOREVER;
+    while (atomic_load_explicit(&inst->thread_run, memory_order_acquire)) {
+        if (!can_pass_claim(inst)) {
+            /* a stray CAN_Manager_ProcessInstance is in a pass */
+            can_os_yield();
+            continue;
+        }
+        int work = can_process_one(id);
+        can_pass_release(inst);
+        if (work)
+            continue;
+        /* Nothing to do, or a queued frame waits for a free TX buffer: sleep
+         * until a producer, a completion or the ISR kicks us, or the polling
+         * period expires. Kicks only signal once we are announced, so make
+         * one more pass after that before sleeping. */
+        can_wait_enter(&inst->thread_idle);
+        if (can_pass_claim(inst)) {
+            work = can_process_one(id);
+            can_pass_release(inst);
+        } else {
+            work = 1;
+        }
+        if (!work) {
+            uint32_t t = wait;
+            if (CAN_Requests_Pending(&inst->requests)) {
+                /* timeouts run on the request wheel's tick */
+                t = wait < CAN_REQUEST_TICK_MS ? wait : CAN_REQUEST_TICK_MS;
+            } else if (inst->err.state != CAN_STATE_ERROR_ACTIVE) {
+                /* TX may be held: come back for throttling and recovery */
+                t = wait < CAN_ERROR_POLL_MS ? wait : CAN_ERROR_POLL_MS;
             }
+            can_os_event_wait(&inst->work_event, t);
         }
+        can_wait_leave(&inst->thread_idle);
+    }
+}
+
+CAN_Result_t CAN_Manager_StartThread(uint8_t inst_id, const can_os_thread_attr_t *attr,
+                                     uint32_t period_ms)
+{
+    if (inst_id >= can_count())
+        return CAN_ERROR;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    uint8_t expected = 0;
+    if (!atomic_compare_exchange_strong(&inst->thread_run, &expected, 1))
+        return CAN_ERROR; /* already running */
+    /* take the instance out of CAN_Manager_Process before the thread starts;
+     * a pass that claimed it first still runs, so refuse rather than give the
+     * queues a second consumer */
+    atomic_store(&inst->exclusive, 1);
+    if (!can_pass_claim(inst)) {
+        atomic_store_explicit(&inst->exclusive, 0, memory_order_release);
+        atomic_store_explicit(&inst->thread_run, 0, memory_order_release);
+        return CAN_ERROR;
     }
+    can_pass_release(inst);
+    inst->thread_period_ms = period_ms;
+    if (can_os_thread_create(&inst->thread, attr, can_instance_thread, inst) != 0) {
+        atomic_store_explicit(&inst->thread_run, 0, memory_order_release);
+        atomic_store_explicit(&inst->exclusive, 0, memory_order_release);
+        return CAN_ERROR;
+    }
+    return CAN_OK;
+}
+
+void CAN_Manager_StopThread(uint8_t inst_id)
+{
+    if (inst_id >= can_count())
+        return;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    uint8_t expected = 1;
+    if (!atomic_compare_exchange_strong(&inst->thread_run, &expected, 0))
+        return;
+    can_os_event_signal(&inst->work_event);
+    can_os_thread_join(&inst->thread);
+    atomic_store_explicit(&inst->exclusive, 0, memory_order_release);
+}
+
+/* Called by drivers once a frame has left the controller (ok != 0) or was
+ * given up on. Reports CAN_EVENT_TX_COMPLETE with a CAN_TxReport_t. */
+void CAN_Manager_TxDone(uint8_t inst_id, uint32_t handle, uint8_t ok)
+{
+    if (inst_id >= can_count())
+        return;
+    CAN_Instance_t *inst = &can_instances[inst_id];
+    CAN_TxTrack_t *t = &inst->tx_track[handle & (CAN_TX_TRACK_LEN - 1U)];
+    /* The ISR and the processing context (polled completions, restarts) may
+     * both report a frame: only the one that claims the slot does */
+    uint8_t busy = 1;
+    if (t->handle != handle ||
+        !atomic_compare_exchange_strong_explicit(&t->busy, &busy, 2, memory_order_acquire,
+                                                 memory_order_relaxed))
+        return; /* unknown or already reported */
+    if (t->handle != handle) {
+        /* the slot was reported and reused after the check above */
+        atomic_store_explicit(&t->busy, 1, memory_order_release);
+        return;
+    }
+
+    CAN_TxReport_t report = {
+        .msg = t->msg,
+        .handle = handle,
+        .ok = ok ? 1 : 0,
+        .t_enqueue = t->msg.timestamp,
+        .t_hw = t->t_hw,
+        .t_wire = can_os_now_us()
+    };
+    atomic_store_explicit(&t->busy, 0, memory_order_release);
+
+    CAN_TxStats_t *st = &inst->tx_stats;
+    if (ok) {
+        uint32_t lat = report.t_wire - report.t_enqueue;
+        CAN_BusLoad_Record(&inst->busload, &report.msg, report.t_wire);
+        uint32_t hw_lat = report.t_wire - report.t_hw;
+        st->completed++;
+        st->last_latency_us = lat;
+        st->total_latency_us += lat;
+        if (lat > st->max_latency_us)
+            st->max_latency_us = lat;
+        if (hw_lat > st->max_hw_latency_us)
+            st->max_hw_latency_us = hw_lat;
+    } else {
+        st->failed++;
+        CAN_TRACE(TX_FAILED, inst_id, handle);
+    }
+    CAN_Manager_TriggerEvent(inst_id, CAN_EVENT_TX_COMPLETE, &report);
+}
+
+/* Not synchronised with the RX/TX paths: configure before traffic starts or
+ * while the interface is quiet */
+CAN_Result_t CAN_SetBusLoadConfig(uint8_t inst_id, const CAN_BusLoadConfig_t *cfg)
+{
+    if (inst_id >= can_count() || !cfg)
+        return CAN_ERROR;
+    CAN_BusLoad_Init(&can_instances[inst_id].busload, cfg, can_os_now_us());
+    return CAN_OK;
+}
+
+CAN_Result_t CAN_GetBusLoad(uint8_t inst_id, CAN_BusLoadReport_t *report)
+{
+    if (inst_id >= can_count() || !report)
+        return CAN_ERROR;
+    CAN_BusLoad_Report(&can_instances[inst_id].busload, report, can_os_now_us());
+    return CAN_OK;
+}
+
+uint8_t CAN_GetTopIds(uint8_t inst_id, CAN_BusLoadId_t *ids, uint8_t max, uint8_t reset)
+{
+    if (inst_id >= can_count())
+        return 0;
+    return CAN_BusLoad_TopIds(&can_instances[inst_id].busload, ids, max, reset,
+                              can_os_now_us());
+}
+
+CAN_Result_t CAN_GetTxStats(uint8_t inst_id, CAN_TxStats_t *stats)
+{
+    if (inst_id >= can_count() || !stats)
+        return CAN_ERROR;
+    *stats = can_instances[inst_id].tx_stats;
+    return CAN_OK;
+}
+
+void CAN_Manager_RequestService(uint8_t inst_id)
+{
+    if (inst_id >= can_count())
+        return;
+    can_wake(&can_instances[inst_id].work_event, &can_instances[inst_id].thread_idle);
 }
 
 /* Called by drivers or internal processing to dispatch events to registered
  * callbacks. */
 void CAN_Manager_TriggerEvent(uint8_t inst_id, CAN_Event_t event, void *arg)
 {
-    if (inst_id >= can_instances_count)
+    if (inst_id >= can_count())
+        return;
+    /* In interrupt mode the driver's ISR is the only RX path, so store the
+     * frame here; in polling mode CAN_Manager_Process does it. */
+    if (event == CAN_EVENT_RX && arg) {
+        ((CAN_Message_t *)arg)->timestamp = can_os_now_us();
+        if (can_instances[inst_id].use_interrupts)
+            can_rx_deliver(&can_instances[inst_id], (const CAN_Message_t *)arg);
+    }
+    /* a freed TX slot in the controller may let the instance thread send */
+    if (event == CAN_EVENT_TX_COMPLETE)
+        can_wake(&can_instances[inst_id].work_event, &can_instances[inst_id].thread_idle);
+    /* Driver error interrupts carry no payload: the processing context reads
+     * the counters and reports with a CAN_ErrorEvent_t */
+    if (event == CAN_EVENT_ERROR && !arg) {
+        atomic_store_explicit(&can_instances[inst_id].err_pending, 1, memory_order_release);
+        can_wake(&can_instances[inst_id].work_event, &can_instances[inst_id].thread_idle);
         return;
+    }
     CAN_Callback_t cb = can_instances[inst_id].callbacks[event];
+    if (event == CAN_EVENT_RX && arg && ((CAN_Message_t *)arg)->fifo == CAN_RX_FIFO_FAST &&
+        can_instances[inst_id].callbacks[CAN_EVENT_RX_FAST]) {
+        event = CAN_EVENT_RX_FAST;
+        cb = can_instances[inst_id].callbacks[CAN_EVENT_RX_FAST];
+    }
     if (cb)
         cb(inst_id, event, arg);
 }
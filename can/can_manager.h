@@ -2,6 +2,13 @@
 #define CAN_MANAGER_H
 
 #include "can_interface.h"
+#include "can_mailbox.h"
+#include "can_busload.h"
+#include "can_merge.h"
+#include "can_request.h"
+#include "can_config.h"
+#include "can_queue.h"
+#include "can_os.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,20 +17,227 @@ extern "C" {
 typedef enum {
     CAN_EVENT_RX,
     CAN_EVENT_TX_COMPLETE,
-    CAN_EVENT_ERROR
+    CAN_EVENT_ERROR,
+    CAN_EVENT_RX_FAST   /* fast lane frames; they go to CAN_EVENT_RX if unset */
 } CAN_Event_t;
 
 typedef void (*CAN_Callback_t)(uint8_t inst_id, CAN_Event_t event, void *arg);
 
+/* Identifies one queued frame in its TX completion report */
+typedef uint32_t CAN_TxHandle_t;
+
+/* Argument of CAN_EVENT_TX_COMPLETE. The frame comes first so callbacks that
+ * treat the argument as a CAN_Message_t keep working. Times are in us. */
+typedef struct {
+    CAN_Message_t  msg;
+    CAN_TxHandle_t handle;
+    uint8_t        ok;          /* 0: aborted or failed */
+    uint32_t       t_enqueue;   /* CAN_SendMessage */
+    uint32_t       t_hw;        /* handed to the controller */
+    uint32_t       t_wire;      /* transmission confirmed */
+} CAN_TxReport_t;
+
+typedef struct {
+    uint32_t completed;
+    uint32_t failed;
+    uint32_t last_latency_us;    /* enqueue -> wire */
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+    uint32_t max_hw_latency_us;  /* controller -> wire */
+} CAN_TxStats_t;
+
+/* Per RX lane, indexed by CAN_RX_FIFO_MAIN/CAN_RX_FIFO_FAST */
+typedef struct {
+    uint32_t received[CAN_RX_FIFO_COUNT];
+    uint32_t overruns[CAN_RX_FIFO_COUNT];  /* lost in the controller */
+    uint32_t dropped[CAN_RX_FIFO_COUNT];   /* manager RX ring full */
+} CAN_RxStats_t;
+
+/* Fault confinement state, derived from TEC/REC */
+typedef enum {
+    CAN_STATE_ERROR_ACTIVE,
+    CAN_STATE_ERROR_WARNING,     /* a counter reached 96 */
+    CAN_STATE_ERROR_PASSIVE,     /* a counter reached 128 */
+    CAN_STATE_BUS_OFF
+} CAN_ErrorState_t;
+
+/* Argument of CAN_EVENT_ERROR, sent on every state change and for error
+ * interrupts reported by the driver (then state == prev) */
+typedef struct {
+    CAN_ErrorState_t state;
+    CAN_ErrorState_t prev;
+    uint16_t tec, rec;
+    uint32_t flags;              /* driver get_error_state() */
+    uint32_t timestamp;          /* us */
+    uint16_t bus_off_count;
+    uint16_t recover_attempts;   /* since the last bus-off */
+} CAN_ErrorEvent_t;
+
+typedef struct {
+    uint8_t  auto_recover;       /* leave bus-off without CAN_RecoverBusOff */
+    uint32_t recover_min_ms;     /* first backoff, doubled per attempt */
+    uint32_t recover_max_ms;
+    uint32_t passive_tx_gap_ms;  /* CAN_WAIT_FOREVER: hold TX while passive */
+} CAN_ErrorPolicy_t;
+
+/* Adaptive interrupt moderation for interrupt driven instances. RX
+ * interrupts arriving closer than enter_gap_us apart switch the instance to
+ * polling: per-frame RX interrupts are masked and the processing context
+ * drains the controller, at most `budget` frames per pass, until it finds
+ * it empty. */
+typedef struct {
+    uint16_t budget;             /* 0: one interrupt per frame, no polling */
+    uint32_t enter_gap_us;
+} CAN_IrqModeration_t;
+
+/* Frames taken in interrupts = CAN_RxStats_t received - poll_frames */
+typedef struct {
+    uint32_t rx_irqs;            /* RX interrupts, watermark ones included */
+    uint32_t watermark_irqs;     /* taken while polling: the poll fell behind */
+    uint32_t poll_enter;         /* switches from interrupts to polling */
+    uint32_t polls;              /* poll passes */
+    uint32_t poll_frames;
+    uint32_t budget_hits;        /* passes that stopped at the budget */
+} CAN_IrqStats_t;
+
+/* Outcome of CAN_Reconfigure */
+typedef struct {
+    uint32_t offline_us;         /* controller off the bus, 0: all applied live */
+    uint32_t total_us;           /* the whole call */
+} CAN_ReconfigReport_t;
+
+#define CAN_WAIT_FOREVER CAN_OS_WAIT_FOREVER
+
+/* Queue depths for one interface, each a power of two. A NULL storage pointer
+ * takes that queue from the shared frame pool (CAN_FRAME_POOL_LEN); otherwise
+ * the caller's array of `len` slots is used. */
+typedef struct {
+    uint16_t tx_len;
+    uint16_t rx_len;
+    CAN_QueueSlot_t *tx_storage;
+    CAN_QueueSlot_t *rx_storage;
+} CAN_QueueConfig_t;
+
+typedef struct {
+    uint16_t tx_len, rx_len;
+    uint16_t tx_peak, rx_peak;       /* high watermarks since AddInterface */
+    uint16_t rx_fast_peak;           /* of the CAN_RX_FAST_QUEUE_LEN fast ring */
+    uint8_t  tx_from_pool, rx_from_pool;
+    uint32_t queue_bytes;
+    uint32_t mailbox_bytes;
+} CAN_InstanceMemory_t;
+
+typedef struct {
+    uint32_t pool_frames;            /* CAN_FRAME_POOL_LEN */
+    uint32_t pool_used;
+    uint32_t static_bytes;           /* manager tables plus frame pool */
+    uint8_t  instances;
+    CAN_InstanceMemory_t inst[MAX_CAN_INTERFACES];
+} CAN_MemoryReport_t;
+
 void CAN_Manager_Init(void);
 int  CAN_Manager_AddInterface(ICANDriver *driver, const CAN_Config_t *config);
+int  CAN_Manager_AddInterfaceEx(ICANDriver *driver, const CAN_Config_t *config,
+                                const CAN_QueueConfig_t *queues);
+void CAN_Manager_GetMemoryReport(CAN_MemoryReport_t *report);
 CAN_Result_t CAN_SendMessage(uint8_t inst_id, const CAN_Message_t *msg);
+CAN_Result_t CAN_SendMessageEx(uint8_t inst_id, const CAN_Message_t *msg, CAN_TxHandle_t *handle);
+CAN_Result_t CAN_GetTxStats(uint8_t inst_id, CAN_TxStats_t *stats);
+/* Free TX queue slots right now; a snapshot while other producers run */
+uint16_t CAN_GetTxFree(uint8_t inst_id);
+/* Bus utilisation from received and confirmed transmitted frames. The meter
+ * starts at the configured bitrate; CAN_SetBusLoadConfig changes the rates or
+ * stuff bit accounting (e.g. after autobaud). */
+CAN_Result_t CAN_SetBusLoadConfig(uint8_t inst_id, const CAN_BusLoadConfig_t *cfg);
+CAN_Result_t CAN_GetBusLoad(uint8_t inst_id, CAN_BusLoadReport_t *report);
+uint8_t CAN_GetTopIds(uint8_t inst_id, CAN_BusLoadId_t *ids, uint8_t max, uint8_t reset);
 int CAN_GetMessage(uint8_t inst_id, CAN_Message_t *msg);
+/* Blocking variants: wait up to timeout_ms (or CAN_WAIT_FOREVER) for queue
+ * space or a received frame. CAN_WaitAny returns the instance the frame came
+ * from, or -1 on timeout. */
+CAN_Result_t CAN_SendMessageTimeout(uint8_t inst_id, const CAN_Message_t *msg,
+                                    uint32_t timeout_ms);
+int CAN_WaitMessage(uint8_t inst_id, CAN_Message_t *msg, uint32_t timeout_ms);
+int CAN_WaitAny(const uint8_t *ids, uint8_t num, CAN_Message_t *msg, uint32_t timeout_ms);
+/* Merged RX stream: frames of all listed instances in timestamp order, held
+ * up to max_delay_us for an instance that has none queued. Timestamps are
+ * drain time (can_os_now_us() when the manager takes the frame from the
+ * driver), not the controller's receive time. Fast lanes are included if
+ * their rules are set when the merge is opened; ids must be distinct. The
+ * merge becomes the only reader of those instances' RX queues;
+ * do not use CAN_GetMessage/CAN_WaitAny on them while it is open.
+ * CAN_ReadMerged hands up to `max` frames to the visitor, waiting up to
+ * timeout_ms for the first one, and returns the number handed over. */
+CAN_Result_t CAN_OpenMerge(CAN_Merge_t *merge, const uint8_t *ids, uint8_t num,
+                           uint32_t max_delay_us);
+uint16_t CAN_ReadMerged(CAN_Merge_t *merge, uint16_t max, CAN_MergeVisitor_t visitor,
+                        void *user, uint32_t timeout_ms);
+/* Send `tx_msg` and call `cb` once with the first received frame whose ID
+ * matches match_id under match_mask (same frame format), or on timeout. The
+ * reply is consumed and bypasses mailboxes and RX queues. Any context; the
+ * callback runs in the instance's processing context. CAN_WAIT_FOREVER never
+ * times out; other timeouts are cut to 2^31 - 2 ticks of
+ * CAN_REQUEST_TICK_MS (about 24 days at 1 ms). */
+CAN_Result_t CAN_Request(uint8_t inst_id, const CAN_Message_t *tx_msg, uint32_t match_id,
+                         uint32_t match_mask, uint32_t timeout_ms, CAN_RequestCb_t cb, void *user);
 void CAN_RegisterCallback(uint8_t inst_id, CAN_Event_t event, CAN_Callback_t cb);
 CAN_Result_t CAN_SetFilter(uint8_t inst_id, uint32_t id, uint32_t mask);
+/* Fast lane: rule `index` (< CAN_RX_FAST_FILTERS) steers matching standard
+ * IDs to `fifo`. CAN_RX_FIFO_FAST frames are queued in a separate ring that
+ * the manager and CAN_GetMessage/CAN_WaitAny service first. CAN_RX_FIFO_OFF
+ * removes the rule. */
+CAN_Result_t CAN_SetFifoFilter(uint8_t inst_id, uint8_t index, uint32_t id, uint32_t mask,
+                               uint8_t fifo);
+CAN_Result_t CAN_GetRxStats(uint8_t inst_id, CAN_RxStats_t *stats);
 CAN_Result_t CAN_StartAutoBaud(uint8_t inst_id, const uint32_t *rates, uint8_t num);
+/* Apply the parts of `rc` flagged in rc->set together: bitrate and mode with
+ * at most one controller restart, filters live where the controller allows
+ * it. Call from the instance's processing context or while it is quiet.
+ * `report` is optional. */
+CAN_Result_t CAN_Reconfigure(uint8_t inst_id, const CAN_Reconfig_t *rc,
+                             CAN_ReconfigReport_t *report);
+/* Error state machine. State changes, bus-off recovery and CAN_EVENT_ERROR
+ * callbacks run in the instance's processing context. */
+CAN_Result_t CAN_SetErrorPolicy(uint8_t inst_id, const CAN_ErrorPolicy_t *policy);
+CAN_Result_t CAN_GetErrorStatus(uint8_t inst_id, CAN_ErrorEvent_t *status);
+CAN_Result_t CAN_RecoverBusOff(uint8_t inst_id);
+/* Needs a driver with rx_irq_mask. The setting is kept while the interface
+ * is polled (CAN_RECONF_IRQ) and applies whenever use_interrupts is set.
+ * Configure while the interface is quiet. */
+CAN_Result_t CAN_SetIrqModeration(uint8_t inst_id, const CAN_IrqModeration_t *cfg);
+CAN_Result_t CAN_GetIrqStats(uint8_t inst_id, CAN_IrqStats_t *stats);
+/* Latest-value RX: frames whose ID falls into an attached range bypass the
+ * RX queue and only the newest copy per ID is kept. */
+CAN_Result_t CAN_AttachMailbox(uint8_t inst_id, CAN_Mailbox_t *mb);
+int CAN_ReadLatest(uint8_t inst_id, uint32_t id, uint8_t extended,
+                   CAN_Message_t *msg, uint32_t *seq);
+uint16_t CAN_PollChanged(uint8_t inst_id, CAN_MailboxVisitor_t visitor, void *user);
 void CAN_Manager_Process(void);
+/* Per-instance processing. An exclusive instance is skipped by
+ * CAN_Manager_Process and serviced by its own thread or core through
+ * CAN_Manager_ProcessInstance; StartThread does both. The thread sleeps
+ * until new TX work or a TX completion arrives, and at most period_ms when
+ * the instance polls for RX (0 = interrupt driven, no periodic wakeup).
+ * Passes over one instance never overlap: a context that finds another one
+ * in a pass skips the instance. StartThread fails while a pass runs; call it
+ * before CAN_Manager_Process is scheduled, or retry. */
+void CAN_Manager_ProcessInstance(uint8_t inst_id);
+CAN_Result_t CAN_Manager_SetExclusive(uint8_t inst_id, uint8_t exclusive);
+CAN_Result_t CAN_Manager_StartThread(uint8_t inst_id, const can_os_thread_attr_t *attr,
+                                     uint32_t period_ms);
+void CAN_Manager_StopThread(uint8_t inst_id);
 void CAN_Manager_TriggerEvent(uint8_t inst_id, CAN_Event_t event, void *arg);
+/* For drivers: report the outcome of the frame sent with ctx->tx_handle */
+void CAN_Manager_TxDone(uint8_t inst_id, uint32_t handle, uint8_t ok);
+/* For drivers: frames were lost because a controller FIFO overflowed */
+void CAN_Manager_RxOverrun(uint8_t inst_id, uint8_t fifo);
+/* For drivers: call on entry to an RX interrupt. Non-zero: read the FIFO
+ * now; 0: the instance is (now) polled and the frames are left to it. */
+uint8_t CAN_Manager_RxIrq(uint8_t inst_id);
+/* For drivers: ask for a processing pass, which calls the driver's service
+ * hook, e.g. to handle an interrupt outside the ISR. Wakes the instance
+ * thread; CAN_Manager_Process picks it up on its next call. */
+void CAN_Manager_RequestService(uint8_t inst_id);
 
 #ifdef __cplusplus
 }
@@ -1,67 +1,493 @@
 #include "can_mcp2515.h"
 #include "can_manager.h"
-#include <stdio.h>
+#include "can_trace.h"
+#include <string.h>
 
-typedef struct {
-    CAN_DriverContext_t base;
-    int dummy;
-    CAN_Message_t echo_msg;
-    int echo_pending;
-} MCP2515_Context;
+/*
+ * MCP2515 driver over CAN_SpiBus_t.
+ *
+ * SPI traffic per frame is kept low with the dedicated instructions: one
+ * LOAD TX BUFFER + RTS pair per transmitted frame, READ STATUS to learn about
+ * both RX buffers and all TX buffers in two bytes, and READ RX BUFFER, which
+ * also clears the RX flag.  Transactions belonging to one step are handed to
+ * the bus together so DMA ports can chain them.
+ *
+ * RXB0 rolls over into RXB1.  TX buffers have fixed priorities (TXB0
+ * highest) and a new frame always goes to a buffer below every pending one,
+ * so frames leave in queue order while up to three are in flight.
+ */
 
-static MCP2515_Context mcp_ctx;
+#define MCP_RX_FRAME_LEN 13U   /* SIDH..D7 */
+#define MCP_MODE_POLLS   10
+#define MCP_IRQ_ROUNDS   8     /* CANINTF passes per mcp_service call */
 
-static CAN_Result_t mcp_init(ICANDriver *drv, const CAN_Config_t *cfg)
+static MCP2515_Context mcp_default_ctx;
+
+static int mcp_xfer(MCP2515_Context *ctx, const CAN_SpiXfer_t *x, uint8_t n)
 {
-    (void)cfg;
-    drv->ctx = &mcp_ctx;
-    mcp_ctx.echo_pending = 0;
-    return CAN_OK;
+    return can_spi_transfer(ctx->spi, x, n);
+}
+
+static int mcp_write(MCP2515_Context *ctx, uint8_t addr, const uint8_t *data, uint8_t len)
+{
+    uint8_t buf[2 + 16];
+    if (len > 16U)
+        return -1;
+    buf[0] = MCP_WRITE;
+    buf[1] = addr;
+    memcpy(&buf[2], data, len);
+    CAN_SpiXfer_t x = { buf, NULL, (uint16_t)(2U + len) };
+    return mcp_xfer(ctx, &x, 1);
+}
+
+static int mcp_read(MCP2515_Context *ctx, uint8_t addr, uint8_t *data, uint8_t len)
+{
+    uint8_t tx[2 + 16] = { MCP_READ, addr };
+    uint8_t rx[2 + 16];
+    if (len > 16U)
+        return -1;
+    CAN_SpiXfer_t x = { tx, rx, (uint16_t)(2U + len) };
+    if (mcp_xfer(ctx, &x, 1) != 0)
+        return -1;
+    memcpy(data, &rx[2], len);
+    return 0;
+}
+
+static int mcp_modify(MCP2515_Context *ctx, uint8_t addr, uint8_t mask, uint8_t value)
+{
+    uint8_t buf[4] = { MCP_BIT_MODIFY, addr, mask, value };
+    CAN_SpiXfer_t x = { buf, NULL, 4 };
+    return mcp_xfer(ctx, &x, 1);
+}
+
+static CAN_Result_t mcp_request_mode(MCP2515_Context *ctx, uint8_t mode)
+{
+    if (mcp_modify(ctx, MCP_CANCTRL, MCP_MODE_MASK, mode) != 0)
+        return CAN_ERROR;
+    for (int i = 0; i < MCP_MODE_POLLS; ++i) {
+        uint8_t stat;
+        if (mcp_read(ctx, MCP_CANSTAT, &stat, 1) != 0)
+            return CAN_ERROR;
+        if ((stat & MCP_MODE_MASK) == mode)
+            return CAN_OK;
+    }
+    return CAN_ERROR;
+}
+
+/* CNF3, CNF2, CNF1 are consecutive: one write. Prefers 16 time quanta and a
+ * sample point near 75%. Must be called in configuration mode. */
+static CAN_Result_t mcp_config_bitrate(MCP2515_Context *ctx, uint32_t bitrate)
+{
+    if (!bitrate)
+        return CAN_ERROR;
+    for (uint32_t tq = 16; tq >= 8U; --tq) {
+        uint32_t div = 2U * tq * bitrate;
+        if (ctx->osc_hz % div)
+            continue;
+        uint32_t brp = ctx->osc_hz / div;
+        uint32_t ps2 = (tq + 4U) / 5U < 2U ? 2U : (tq + 4U) / 5U;
+        uint32_t rest = tq - 1U - ps2;
+        uint32_t prop = rest / 2U, ps1 = rest - prop;
+        if (brp == 0 || brp > 64U || ps1 > 8U || prop > 8U || ps2 > 8U)
+            continue;
+        uint8_t cnf[3] = {
+            (uint8_t)(ps2 - 1U),                                   /* CNF3 */
+            (uint8_t)(0x80U | ((ps1 - 1U) << 3) | (prop - 1U)),   /* CNF2: BTLMODE */
+            (uint8_t)(brp - 1U)                                    /* CNF1: SJW 1 */
+        };
+        if (mcp_write(ctx, MCP_CNF3, cnf, 3) != 0)
+            return CAN_ERROR;
+        ctx->bitrate = bitrate;
+        return CAN_OK;
+    }
+    return CAN_ERROR;
+}
+
+/* READ STATUS; reports finished TX buffers to the manager on the way */
+static int mcp_poll_status(MCP2515_Context *ctx, uint8_t *status)
+{
+    uint8_t tx[2] = { MCP_READ_STATUS, 0 };
+    uint8_t rx[2];
+    CAN_SpiXfer_t x = { tx, rx, 2 };
+    if (mcp_xfer(ctx, &x, 1) != 0)
+        return -1;
+    uint8_t st = rx[1];
+    uint8_t done = 0;
+    for (uint8_t b = 0; b < 3U; ++b) {
+        if (!(ctx->tx_busy & (1U << b)))
+            continue;
+        if (st & MCP_STAT_TXIF(b)) {
+            CAN_Manager_TxDone(ctx->base.inst_id, ctx->tx_handles[b], 1);
+        } else if (!(st & MCP_STAT_TXREQ(b))) {
+            /* request cleared without success: aborted */
+            CAN_Manager_TxDone(ctx->base.inst_id, ctx->tx_handles[b], 0);
+        } else {
+            continue;
+        }
+        ctx->tx_busy &= (uint8_t)~(1U << b);
+        done |= (uint8_t)(MCP_TX0IF << b);
+        ctx->tx_frames++;
+    }
+    if (done)
+        mcp_modify(ctx, MCP_CANINTF, done, 0);
+    *status = st;
+    return 0;
 }
 
-static CAN_Result_t mcp_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
+static void mcp_decode(const uint8_t *r, CAN_Message_t *msg)
+{
+    msg->id = mcp_regs_to_id(r, &msg->extended);
+    msg->dlc = r[4] & 0x0FU;
+    if (msg->dlc > 8U)
+        msg->dlc = 8U;
+    memcpy(msg->data, &r[5], 8);
+    msg->fifo = CAN_RX_FIFO_MAIN;
+}
+
+/* Read the RX buffers flagged in `status`, RXB0 (older) first, in one batch.
+ * Returns the number of frames stored in `out`. */
+static uint8_t mcp_read_rx(MCP2515_Context *ctx, uint8_t status, CAN_Message_t *out)
+{
+    static const uint8_t cmd[2][1 + MCP_RX_FRAME_LEN] = {
+        { MCP_READ_RX(0) }, { MCP_READ_RX(1) }
+    };
+    uint8_t rx[2][1 + MCP_RX_FRAME_LEN];
+    CAN_SpiXfer_t x[2];
+    uint8_t n = 0;
+    for (uint8_t b = 0; b < 2U; ++b) {
+        if (status & (MCP_STAT_RX0IF << b)) {
+            x[n].tx = cmd[b];
+            x[n].rx = rx[n];
+            x[n].len = 1U + MCP_RX_FRAME_LEN;
+            ++n;
+        }
+    }
+    if (!n || mcp_xfer(ctx, x, n) != 0)
+        return 0;
+    for (uint8_t i = 0; i < n; ++i) {
+        mcp_decode(&rx[i][1], &out[i]);
+        CAN_TRACE(MCP_RX, out[i].id, n);
+    }
+    ctx->rx_frames += n;
+    return n;
+}
+
+/* Lowest priority buffer below every pending one, 3 if none */
+static uint8_t mcp_tx_slot(const MCP2515_Context *ctx)
+{
+    if (ctx->tx_busy & 0x4U)
+        return 3;
+    if (ctx->tx_busy & 0x2U)
+        return 2;
+    return ctx->tx_busy & 0x1U ? 1 : 0;
+}
+
+CAN_Result_t MCP2515_Send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
 {
     (void)timeout;
     MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
-    if (msg && ctx) {
-        printf("MCP2515 send id: 0x%lx\n", (unsigned long)msg->id);
-        ctx->echo_msg = *msg;
-        ctx->echo_pending = 1;
-        CAN_Manager_TriggerEvent(ctx->base.inst_id,
-                                 CAN_EVENT_TX_COMPLETE, (void *)msg);
+    if (!msg || !ctx)
+        return CAN_ERROR;
+    uint8_t b = mcp_tx_slot(ctx);
+    if (b > 2U) {
+        uint8_t st;
+        if (mcp_poll_status(ctx, &st) != 0)
+            return CAN_ERROR;
+        b = mcp_tx_slot(ctx);
+        if (b > 2U)
+            return CAN_ERROR; /* all buffers in flight */
+    }
+    uint8_t dlc = msg->dlc > 8U ? 8U : msg->dlc;
+    uint8_t load[1 + 5 + 8];
+    load[0] = (uint8_t)MCP_LOAD_TX(b);
+    mcp_id_to_regs(msg->id, msg->extended, &load[1]);
+    load[5] = dlc;
+    memcpy(&load[6], msg->data, dlc);
+    uint8_t rts = (uint8_t)MCP_RTS(b);
+    CAN_SpiXfer_t x[2] = {
+        { load, NULL, (uint16_t)(6U + dlc) },
+        { &rts, NULL, 1 }
+    };
+    /* the handle must be in place before the completion can be seen */
+    ctx->tx_handles[b] = ctx->base.tx_handle;
+    ctx->tx_busy |= (uint8_t)(1U << b);
+    CAN_TRACE(MCP_TX, b, msg->id);
+    if (mcp_xfer(ctx, x, 2) != 0) {
+        ctx->tx_busy &= (uint8_t)~(1U << b);
+        return CAN_ERROR;
     }
     return CAN_OK;
 }
 
-static CAN_Result_t mcp_receive(ICANDriver *drv, CAN_Message_t *msg)
+CAN_Result_t MCP2515_Receive(ICANDriver *drv, CAN_Message_t *msg)
 {
     MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
-    if (ctx && ctx->echo_pending && msg) {
-        *msg = ctx->echo_msg;
-        ctx->echo_pending = 0;
-        CAN_Manager_TriggerEvent(ctx->base.inst_id,
-                                 CAN_EVENT_RX, msg);
-        return CAN_OK;
+    if (!ctx || !msg)
+        return CAN_ERROR;
+    if (ctx->rx_stashed) {
+        *msg = ctx->rx_stash;
+        ctx->rx_stashed = 0;
+    } else {
+        uint8_t st;
+        CAN_Message_t frames[2];
+        if (mcp_poll_status(ctx, &st) != 0)
+            return CAN_ERROR;
+        uint8_t n = mcp_read_rx(ctx, st, frames);
+        if (!n)
+            return CAN_ERROR;
+        *msg = frames[0];
+        if (n > 1U) {
+            ctx->rx_stash = frames[1];
+            ctx->rx_stashed = 1;
+        }
     }
-    return CAN_ERROR;
+    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, msg);
+    return CAN_OK;
+}
+
+/* ERRIF/MERRF with EFLG in f[1]: count RX overflows, report the rest */
+static void mcp_service_errors(MCP2515_Context *ctx, const uint8_t *f)
+{
+    mcp_modify(ctx, MCP_CANINTF, f[0] & (MCP_ERRIF | MCP_MERRF), 0);
+    CAN_TRACE(MCP_ERROR, ctx->base.inst_id, f[0]);
+    /* both RX buffers belong to the main lane */
+    if (f[1] & (MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR)) {
+        mcp_modify(ctx, MCP_EFLG, MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR, 0);
+        CAN_Manager_RxOverrun(ctx->base.inst_id, CAN_RX_FIFO_MAIN);
+        if (!(f[0] & MCP_MERRF) && !(f[1] & (uint8_t)~(MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR)))
+            return;
+    }
+    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_ERROR, NULL);
+}
+
+/* Pin ISR: SPI transfers and tx_busy belong to the processing context, so
+ * only hand the work over to it. */
+static void mcp_irq_handler(ICANDriver *drv)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    if (!ctx)
+        return;
+    atomic_store_explicit(&ctx->irq_pending, 1, memory_order_release);
+    CAN_Manager_RequestService(ctx->base.inst_id);
+}
+
+/* Service the INT line from the processing context: RX, TX completions and
+ * errors, until CANINTF reads 0. INT is usually wired to an edge-triggered
+ * pin and stays low while any flag is set, so a flag left behind would mean
+ * no further interrupts. */
+static void mcp_service(ICANDriver *drv)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    if (!atomic_exchange_explicit(&ctx->irq_pending, 0, memory_order_acquire) || !ctx->irq_on)
+        return;
+    if (ctx->rx_stashed) {
+        ctx->rx_stashed = 0;
+        CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, &ctx->rx_stash);
+    }
+    for (uint8_t round = 0; round < MCP_IRQ_ROUNDS; ++round) {
+        uint8_t f[2]; /* CANINTF, EFLG */
+        if (mcp_read(ctx, MCP_CANINTF, f, 2) != 0)
+            break;
+        if (!f[0])
+            return;
+        if (f[0] & (MCP_ERRIF | MCP_MERRF))
+            mcp_service_errors(ctx, f);
+        uint8_t st;
+        if (mcp_poll_status(ctx, &st) != 0)
+            break;
+        CAN_Message_t frames[2];
+        uint8_t n = mcp_read_rx(ctx, st, frames);
+        for (uint8_t i = 0; i < n; ++i)
+            CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, &frames[i]);
+        /* sources nobody waits for: wake-up, TX flags of aborted buffers */
+        uint8_t stray = (uint8_t)(f[0] & (MCP_WAKIF | (uint8_t)(~(ctx->tx_busy << 2) &
+                                                              (MCP_TX0IF | MCP_TX1IF | MCP_TX2IF))));
+        if (stray)
+            mcp_modify(ctx, MCP_CANINTF, stray, 0);
+    }
+    /* still busy, or the bus failed: come back on the next pass */
+    atomic_store_explicit(&ctx->irq_pending, 1, memory_order_release);
+    CAN_Manager_RequestService(ctx->base.inst_id);
+}
+
+static void mcp_enable_interrupts(ICANDriver *drv)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    uint8_t inte = MCP_RX0IF | MCP_RX1IF | MCP_TX0IF | MCP_TX1IF | MCP_TX2IF |
+                   MCP_ERRIF | MCP_MERRF;
+    ctx->irq_on = 1;
+    mcp_write(ctx, MCP_CANINTE, &inte, 1);
+    /* flags raised while INT was masked produce no new edge */
+    atomic_store_explicit(&ctx->irq_pending, 1, memory_order_release);
+}
+
+static void mcp_disable_interrupts(ICANDriver *drv)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    uint8_t inte = 0;
+    ctx->irq_on = 0;
+    mcp_write(ctx, MCP_CANINTE, &inte, 1);
+}
+
+/* In configuration mode, ahead of a restart: the manager fails the frames
+ * still loaded, so make sure they do not go out afterwards */
+static void mcp_abort_tx(MCP2515_Context *ctx)
+{
+    for (uint8_t b = 0; b < 3U; ++b) {
+        if (ctx->tx_busy & (1U << b))
+            mcp_modify(ctx, MCP_TXBCTRL(b), MCP_TXREQ, 0);
+    }
+    ctx->tx_busy = 0;
+    mcp_modify(ctx, MCP_CANINTF, MCP_TX0IF | MCP_TX1IF | MCP_TX2IF, 0);
+}
+
+/* Standard ID filter on both buffers; mask 0 accepts everything. Must be
+ * called in configuration mode. */
+static void mcp_write_filter(MCP2515_Context *ctx, uint32_t id, uint32_t mask)
+{
+    uint8_t regs[4];
+    uint8_t rxm = mask ? 0x00U : MCP_RXB_RXM_ANY;
+    mcp_id_to_regs(mask & 0x7FFU, 0, regs);
+    mcp_write(ctx, MCP_RXM0SIDH, regs, 4);
+    mcp_write(ctx, MCP_RXM1SIDH, regs, 4);
+    mcp_id_to_regs(id & 0x7FFU, 0, regs);
+    static const uint8_t filters[] = { MCP_RXF0SIDH, MCP_RXF1SIDH, MCP_RXF2SIDH,
+                                       MCP_RXF3SIDH, MCP_RXF4SIDH, MCP_RXF5SIDH };
+    for (uint8_t i = 0; i < sizeof(filters); ++i)
+        mcp_write(ctx, filters[i], regs, 4);
+    uint8_t ctrl0 = rxm | MCP_RXB0_BUKT;
+    mcp_write(ctx, MCP_RXB0CTRL, &ctrl0, 1);
+    mcp_write(ctx, MCP_RXB1CTRL, &rxm, 1);
 }
 
 static CAN_Result_t mcp_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask)
 {
-    (void)drv; (void)id; (void)mask;
-    return CAN_OK;
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    if (mcp_request_mode(ctx, MCP_MODE_CONFIG) != CAN_OK)
+        return CAN_ERROR;
+    mcp_write_filter(ctx, id, mask);
+    return mcp_request_mode(ctx, ctx->mode);
+}
+
+static uint8_t mcp_mode_bits(CAN_Mode_t mode)
+{
+    switch (mode) {
+    case CAN_OPMODE_LOOPBACK:
+        return MCP_MODE_LOOPBACK;
+    case CAN_OPMODE_SILENT:
+    case CAN_OPMODE_AUTOBAUD:
+        return MCP_MODE_LISTEN;
+    case CAN_OPMODE_NORMAL:
+    default:
+        return MCP_MODE_NORMAL;
+    }
 }
 
 static CAN_Result_t mcp_set_mode(ICANDriver *drv, CAN_Mode_t mode)
 {
-    (void)drv; (void)mode;
-    return CAN_OK;
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    ctx->mode = mcp_mode_bits(mode);
+    return mcp_request_mode(ctx, ctx->mode);
+}
+
+/* Filters, masks and CNF1..3 are only writable in configuration mode, so
+ * anything but a mode change takes one pass through it; the new mode is
+ * requested on the way out. */
+static CAN_Result_t mcp_reconfigure(ICANDriver *drv, const CAN_Reconfig_t *rc,
+                                    uint32_t *offline_us)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    CAN_Result_t res = CAN_OK;
+    uint8_t bitrate = (rc->set & CAN_RECONF_BITRATE) && rc->bitrate != ctx->bitrate;
+    uint8_t filter = (rc->set & CAN_RECONF_FILTER) != 0;
+    uint8_t mode = (rc->set & CAN_RECONF_MODE) ? mcp_mode_bits(rc->mode) : ctx->mode;
+    if (offline_us)
+        *offline_us = 0;
+    if (!bitrate && !filter) {
+        if (mode == ctx->mode)
+            return CAN_OK;
+        ctx->mode = mode;
+        return mcp_request_mode(ctx, mode);
+    }
+
+    uint32_t t0 = can_os_now_us();
+    if (mcp_request_mode(ctx, MCP_MODE_CONFIG) != CAN_OK)
+        return CAN_ERROR;
+    mcp_abort_tx(ctx);
+    if (bitrate && mcp_config_bitrate(ctx, rc->bitrate) != CAN_OK)
+        res = CAN_ERROR;
+    if (filter)
+        mcp_write_filter(ctx, rc->filter_id, rc->filter_mask);
+    ctx->mode = mode;
+    if (mcp_request_mode(ctx, mode) != CAN_OK)
+        res = CAN_ERROR;
+    if (offline_us) {
+        uint32_t t = can_os_now_us() - t0;
+        *offline_us = t ? t : 1U;
+    }
+    return res;
 }
 
 static uint32_t mcp_get_error(ICANDriver *drv)
 {
-    (void)drv;
-    return 0;
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    uint8_t eflg = 0;
+    mcp_read(ctx, MCP_EFLG, &eflg, 1);
+    return eflg;
+}
+
+static CAN_Result_t mcp_get_bus_status(ICANDriver *drv, CAN_BusStatus_t *st)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    uint8_t tx[2][4] = { { MCP_READ, MCP_TEC, 0, 0 }, { MCP_READ, MCP_EFLG, 0 } };
+    uint8_t rx[2][4];
+    CAN_SpiXfer_t x[2] = { { tx[0], rx[0], 4 }, { tx[1], rx[1], 3 } };
+    if (mcp_xfer(ctx, x, 2) != 0)
+        return CAN_ERROR;
+    st->tec = rx[0][2];
+    st->rec = rx[0][3];
+    st->bus_off = (rx[1][2] & MCP_EFLG_TXBO) ? 1 : 0;
+    return CAN_OK;
+}
+
+/* The MCP2515 rejoins on its own after 128 x 11 recessive bits; passing
+ * through configuration mode restarts that sequence and clears the
+ * overflow flags. */
+static CAN_Result_t mcp_recover(ICANDriver *drv)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    if (mcp_request_mode(ctx, MCP_MODE_CONFIG) != CAN_OK)
+        return CAN_ERROR;
+    mcp_abort_tx(ctx);
+    mcp_modify(ctx, MCP_EFLG, MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR, 0);
+    return mcp_request_mode(ctx, ctx->mode);
+}
+
+static CAN_Result_t mcp_init(ICANDriver *drv, const CAN_Config_t *cfg)
+{
+    MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    if (!ctx || !ctx->spi)
+        return CAN_ERROR;
+    uint8_t reset = MCP_RESET;
+    CAN_SpiXfer_t x = { &reset, NULL, 1 };
+    if (mcp_xfer(ctx, &x, 1) != 0)
+        return CAN_ERROR;
+    ctx->tx_busy = 0;
+    ctx->rx_stashed = 0;
+    ctx->irq_on = 0;   /* the reset cleared CANINTE */
+    ctx->bitrate = 0;
+    ctx->mode = mcp_mode_bits(cfg ? cfg->mode : CAN_OPMODE_NORMAL);
+    if (mcp_request_mode(ctx, MCP_MODE_CONFIG) != CAN_OK)
+        return CAN_ERROR;
+    if (cfg && cfg->bitrate && mcp_config_bitrate(ctx, cfg->bitrate) != CAN_OK)
+        return CAN_ERROR;
+    /* TXP: TXB0 3, TXB1 2, TXB2 1 (see mcp_tx_slot) */
+    for (uint8_t b = 0; b < 3U; ++b) {
+        uint8_t txp = (uint8_t)(3U - b);
+        mcp_write(ctx, MCP_TXBCTRL(b), &txp, 1);
+    }
+    mcp_write_filter(ctx, cfg ? cfg->filter_id : 0, cfg ? cfg->filter_mask : 0);
+    return mcp_request_mode(ctx, ctx->mode);
 }
 
 static CAN_Result_t mcp_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t num)
@@ -70,6 +496,7 @@ static CAN_Result_t mcp_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
         return CAN_ERROR;
 
     MCP2515_Context *ctx = (MCP2515_Context *)drv->ctx;
+    uint8_t mode = ctx->mode;
     CAN_Message_t msg;
 
     for (uint8_t i = 0; i < num; ++i) {
@@ -77,14 +504,20 @@ static CAN_Result_t mcp_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
         if (br == 0)
             break;
 
-        /* Simulate writing bitrate to MCP2515 CNF registers */
-        ctx->dummy = (int)br;
-        printf("MCP2515 autobaud try %lu\n", (unsigned long)br);
+        if (mcp_request_mode(ctx, MCP_MODE_CONFIG) != CAN_OK)
+            continue;
+        mcp_abort_tx(ctx);
+        if (mcp_config_bitrate(ctx, br) != CAN_OK ||
+            mcp_request_mode(ctx, MCP_MODE_LISTEN) != CAN_OK)
+            continue;
+        CAN_TRACE(MCP_AUTOBAUD_TRY, br, 0);
 
         /* Poll for a received frame at this rate */
         for (int attempt = 0; attempt < 10; ++attempt) {
-            if (mcp_receive(drv, &msg) == CAN_OK) {
-                printf("MCP2515 autobaud detected %lu\n", (unsigned long)br);
+            if (MCP2515_Receive(drv, &msg) == CAN_OK) {
+                CAN_TRACE(MCP_AUTOBAUD_FOUND, br, 0);
+                ctx->mode = mode == MCP_MODE_LISTEN ? MCP_MODE_NORMAL : mode;
+                mcp_request_mode(ctx, ctx->mode);
                 return CAN_OK;
             }
         }
@@ -95,14 +528,33 @@ static CAN_Result_t mcp_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
 
 ICANDriver mcp2515_driver = {
     .init = mcp_init,
-    .send = mcp_send,
-    .receive = mcp_receive,
+    .send = MCP2515_Send,
+    .receive = MCP2515_Receive,
     .set_filter = mcp_set_filter,
     .set_mode = mcp_set_mode,
     .get_error_state = mcp_get_error,
     .auto_baud_detect = mcp_autobaud,
-    .enable_interrupts = NULL,
-    .disable_interrupts = NULL,
-    .irq_handler = NULL,
-    .ctx = NULL
+    .enable_interrupts = mcp_enable_interrupts,
+    .disable_interrupts = mcp_disable_interrupts,
+    .irq_handler = mcp_irq_handler,
+    .get_bus_status = mcp_get_bus_status,
+    .recover = mcp_recover,
+    .reconfigure = mcp_reconfigure,
+    .service = mcp_service,
+    .ctx = &mcp_default_ctx
 };
+
+void MCP2515_SetupDriver(ICANDriver *drv, MCP2515_Context *ctx, CAN_SpiBus_t *spi,
+                         uint32_t osc_hz)
+{
+    if (!drv || !ctx)
+        return;
+
+    if (drv != &mcp2515_driver)
+        *drv = mcp2515_driver;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->spi = spi;
+    ctx->osc_hz = osc_hz;
+    ctx->driver = drv;
+    drv->ctx = ctx;
+}
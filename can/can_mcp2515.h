@@ -1,8 +1,129 @@
 #ifndef CAN_MCP2515_H
 #define CAN_MCP2515_H
 
+#include <stdatomic.h>
 #include "can_interface.h"
+#include "can_spi.h"
+
+/* SPI instructions */
+#define MCP_RESET        0xC0U
+#define MCP_READ         0x03U
+#define MCP_WRITE        0x02U
+#define MCP_BIT_MODIFY   0x05U
+#define MCP_READ_RX(n)   (0x90U | ((n) << 2))   /* from RXBnSIDH, clears RXnIF */
+#define MCP_LOAD_TX(n)   (0x40U | ((n) << 1))   /* from TXBnSIDH */
+#define MCP_RTS(n)       (0x80U | (1U << (n)))
+#define MCP_READ_STATUS  0xA0U
+#define MCP_RX_STATUS    0xB0U
+
+/* Registers */
+#define MCP_RXF0SIDH     0x00U
+#define MCP_RXF1SIDH     0x04U
+#define MCP_RXF2SIDH     0x08U
+#define MCP_RXF3SIDH     0x10U
+#define MCP_RXF4SIDH     0x14U
+#define MCP_RXF5SIDH     0x18U
+#define MCP_RXM0SIDH     0x20U
+#define MCP_RXM1SIDH     0x24U
+#define MCP_CANSTAT      0x0EU
+#define MCP_CANCTRL      0x0FU
+#define MCP_TEC          0x1CU
+#define MCP_REC          0x1DU
+#define MCP_CNF3         0x28U
+#define MCP_CNF2         0x29U
+#define MCP_CNF1         0x2AU
+#define MCP_CANINTE      0x2BU
+#define MCP_CANINTF      0x2CU
+#define MCP_EFLG         0x2DU
+#define MCP_TXBCTRL(n)   (0x30U + 0x10U * (n))
+#define MCP_RXB0CTRL     0x60U
+#define MCP_RXB1CTRL     0x70U
+
+/* CANCTRL.REQOP / CANSTAT.OPMOD */
+#define MCP_MODE_NORMAL   0x00U
+#define MCP_MODE_SLEEP    0x20U
+#define MCP_MODE_LOOPBACK 0x40U
+#define MCP_MODE_LISTEN   0x60U
+#define MCP_MODE_CONFIG   0x80U
+#define MCP_MODE_MASK     0xE0U
+
+/* CANINTF / CANINTE */
+#define MCP_RX0IF 0x01U
+#define MCP_RX1IF 0x02U
+#define MCP_TX0IF 0x04U
+#define MCP_TX1IF 0x08U
+#define MCP_TX2IF 0x10U
+#define MCP_ERRIF 0x20U
+#define MCP_WAKIF 0x40U
+#define MCP_MERRF 0x80U
+
+/* READ STATUS response */
+#define MCP_STAT_RX0IF     0x01U
+#define MCP_STAT_RX1IF     0x02U
+#define MCP_STAT_TXREQ(n)  (0x04U << (2 * (n)))
+#define MCP_STAT_TXIF(n)   (0x08U << (2 * (n)))
+
+/* Other register bits */
+#define MCP_TXREQ        0x08U   /* TXBnCTRL */
+#define MCP_RXB_RXM_ANY  0x60U   /* RXBnCTRL: filters off */
+#define MCP_RXB0_BUKT    0x04U   /* RXB0CTRL: roll over into RXB1 */
+#define MCP_SIDL_EXIDE   0x08U
+#define MCP_EFLG_TXBO    0x20U
+#define MCP_EFLG_RX0OVR  0x40U
+#define MCP_EFLG_RX1OVR  0x80U
+
+/* ID layout of the SIDH, SIDL, EID8, EID0 register group shared by TX/RX
+ * buffers, filters and masks */
+static inline void mcp_id_to_regs(uint32_t id, uint8_t extended, uint8_t *r)
+{
+    if (extended) {
+        r[0] = (uint8_t)(id >> 21);
+        r[1] = (uint8_t)((((id >> 18) & 0x07U) << 5) | MCP_SIDL_EXIDE | ((id >> 16) & 0x03U));
+        r[2] = (uint8_t)(id >> 8);
+        r[3] = (uint8_t)id;
+    } else {
+        r[0] = (uint8_t)(id >> 3);
+        r[1] = (uint8_t)((id & 0x07U) << 5);
+        r[2] = 0;
+        r[3] = 0;
+    }
+}
+
+static inline uint32_t mcp_regs_to_id(const uint8_t *r, uint8_t *extended)
+{
+    uint32_t sid = ((uint32_t)r[0] << 3) | (r[1] >> 5);
+    *extended = (r[1] & MCP_SIDL_EXIDE) ? 1 : 0;
+    if (!*extended)
+        return sid;
+    return (sid << 18) | ((uint32_t)(r[1] & 0x03U) << 16) | ((uint32_t)r[2] << 8) | r[3];
+}
+
+typedef struct {
+    CAN_DriverContext_t base;
+    CAN_SpiBus_t *spi;
+    uint32_t      osc_hz;         /* crystal, e.g. 8 or 16 MHz */
+    ICANDriver   *driver;
+    uint8_t       mode;           /* REQOP of the running mode */
+    uint32_t      bitrate;        /* as programmed into CNF1..3 */
+    uint8_t       tx_busy;        /* TXBn loaded, completion not reported yet */
+    uint32_t      tx_handles[3];
+    CAN_Message_t rx_stash;       /* RXB1 frame read together with RXB0 */
+    uint8_t       rx_stashed;
+    uint8_t       irq_on;         /* CANINTE enabled */
+    _Atomic uint8_t irq_pending;  /* INT seen, mcp_service has not run yet */
+    uint32_t      rx_frames;
+    uint32_t      tx_frames;
+} MCP2515_Context;
 
 extern ICANDriver mcp2515_driver;
 
+/* Bind a driver object to a context and SPI bus; `mcp2515_driver` can be used
+ * as the driver object for a single chip. */
+void MCP2515_SetupDriver(ICANDriver *driver, MCP2515_Context *ctx, CAN_SpiBus_t *spi,
+                         uint32_t osc_hz);
+
+/* Hot-path entry points, called directly under CAN_STATIC_CONFIG */
+CAN_Result_t MCP2515_Send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout);
+CAN_Result_t MCP2515_Receive(ICANDriver *drv, CAN_Message_t *msg);
+
 #endif /* CAN_MCP2515_H */
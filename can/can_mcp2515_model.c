@@ -0,0 +1,246 @@
+#include "can_mcp2515_model.h"
+#include <string.h>
+
+#define REG(m, a) ((m)->regs[(a) & 0x7FU])
+
+static uint8_t model_opmode(const MCP2515_Model_t *m)
+{
+    return m->regs[MCP_CANSTAT] & MCP_MODE_MASK;
+}
+
+static void model_encode(const CAN_Message_t *msg, uint8_t *r)
+{
+    uint8_t dlc = msg->dlc > 8U ? 8U : msg->dlc;
+    mcp_id_to_regs(msg->id, msg->extended, r);
+    r[4] = dlc;
+    memcpy(&r[5], msg->data, 8);
+}
+
+/* Acceptance test of one filter/mask pair. Standard frames compare the 11
+ * SID bits only; the EID mask bits that would match data bytes are not
+ * modelled. */
+static int model_match(const MCP2515_Model_t *m, uint8_t filt, uint8_t mask,
+                       const CAN_Message_t *msg)
+{
+    uint8_t fext;
+    const uint8_t *k = &m->regs[mask];
+    uint32_t f = mcp_regs_to_id(&m->regs[filt], &fext);
+    uint32_t sid_mask = ((uint32_t)k[0] << 3) | (k[1] >> 5);
+    uint32_t km = fext ? (sid_mask << 18) | ((uint32_t)(k[1] & 0x03U) << 16) |
+                         ((uint32_t)k[2] << 8) | k[3]
+                       : sid_mask;
+    if (fext != (msg->extended ? 1U : 0U))
+        return 0;
+    return ((msg->id ^ f) & km) == 0;
+}
+
+static int model_accepts(const MCP2515_Model_t *m, uint8_t rxb, const CAN_Message_t *msg)
+{
+    static const uint8_t rxb0_filters[] = { MCP_RXF0SIDH, MCP_RXF1SIDH };
+    static const uint8_t rxb1_filters[] = { MCP_RXF2SIDH, MCP_RXF3SIDH, MCP_RXF4SIDH, MCP_RXF5SIDH };
+    uint8_t ctrl = rxb ? m->regs[MCP_RXB1CTRL] : m->regs[MCP_RXB0CTRL];
+    if ((ctrl & MCP_RXB_RXM_ANY) == MCP_RXB_RXM_ANY)
+        return 1;
+    const uint8_t *f = rxb ? rxb1_filters : rxb0_filters;
+    uint8_t n = rxb ? 4U : 2U;
+    for (uint8_t i = 0; i < n; ++i)
+        if (model_match(m, f[i], rxb ? MCP_RXM1SIDH : MCP_RXM0SIDH, msg))
+            return 1;
+    return 0;
+}
+
+static void model_store(MCP2515_Model_t *m, uint8_t rxb, const CAN_Message_t *msg)
+{
+    model_encode(msg, &m->regs[(rxb ? MCP_RXB1CTRL : MCP_RXB0CTRL) + 1U]);
+    m->regs[MCP_CANINTF] |= rxb ? MCP_RX1IF : MCP_RX0IF;
+    m->rx_frames++;
+}
+
+int MCP2515_Model_Receive(MCP2515_Model_t *model, const CAN_Message_t *msg)
+{
+    MCP2515_Model_t *m = model;
+    uint8_t mode = model_opmode(m);
+    if (mode == MCP_MODE_CONFIG || mode == MCP_MODE_SLEEP)
+        return -1;
+    uint8_t intf = m->regs[MCP_CANINTF];
+    if (model_accepts(m, 0, msg)) {
+        if (!(intf & MCP_RX0IF)) {
+            model_store(m, 0, msg);
+            return 0;
+        }
+        if ((m->regs[MCP_RXB0CTRL] & MCP_RXB0_BUKT) && !(intf & MCP_RX1IF)) {
+            model_store(m, 1, msg);
+            return 0;
+        }
+        m->regs[MCP_EFLG] |= (m->regs[MCP_RXB0CTRL] & MCP_RXB0_BUKT) ? MCP_EFLG_RX1OVR
+                                                                     : MCP_EFLG_RX0OVR;
+    } else if (model_accepts(m, 1, msg)) {
+        if (!(intf & MCP_RX1IF)) {
+            model_store(m, 1, msg);
+            return 0;
+        }
+        m->regs[MCP_EFLG] |= MCP_EFLG_RX1OVR;
+    } else {
+        m->rx_dropped++;
+        return -1;
+    }
+    m->regs[MCP_CANINTF] |= MCP_ERRIF;
+    m->rx_overflows++;
+    return -1;
+}
+
+static void model_transmit(MCP2515_Model_t *m, uint8_t b)
+{
+    const uint8_t *r = &m->regs[MCP_TXBCTRL(b) + 1U];
+    CAN_Message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.id = mcp_regs_to_id(r, &msg.extended);
+    msg.dlc = r[4] & 0x0FU;
+    if (msg.dlc > 8U)
+        msg.dlc = 8U;
+    memcpy(msg.data, &r[5], 8);
+
+    m->regs[MCP_TXBCTRL(b)] &= (uint8_t)~MCP_TXREQ;
+    m->regs[MCP_CANINTF] |= (uint8_t)(MCP_TX0IF << b);
+    m->tx_frames++;
+    if (model_opmode(m) == MCP_MODE_LOOPBACK)
+        MCP2515_Model_Receive(m, &msg);
+    else if (m->on_tx)
+        m->on_tx(m, &msg, m->user);
+}
+
+/* Send every requested buffer the current mode allows, highest TXP first
+ * (higher buffer number on a tie, as the chip does) */
+static void model_kick(MCP2515_Model_t *m)
+{
+    uint8_t mode = model_opmode(m);
+    if (mode != MCP_MODE_NORMAL && mode != MCP_MODE_LOOPBACK)
+        return;
+    for (;;) {
+        int best = -1;
+        for (int b = 2; b >= 0; --b) {
+            uint8_t ctrl = m->regs[MCP_TXBCTRL(b)];
+            if ((ctrl & MCP_TXREQ) &&
+                (best < 0 || (ctrl & 3U) > (m->regs[MCP_TXBCTRL(best)] & 3U)))
+                best = b;
+        }
+        if (best < 0)
+            return;
+        model_transmit(m, (uint8_t)best);
+    }
+}
+
+static void model_write(MCP2515_Model_t *m, uint8_t addr, uint8_t value, uint8_t mask)
+{
+    addr &= 0x7FU;
+    if (addr == MCP_CANSTAT || (addr & 0x0FU) == 0x0EU)
+        return; /* CANSTAT and its mirrors are read only */
+    m->regs[addr] = (uint8_t)((m->regs[addr] & ~mask) | (value & mask));
+    if ((addr & 0x0FU) == 0x0FU) {
+        /* CANCTRL (and mirrors): mode changes take effect at once */
+        m->regs[MCP_CANCTRL] = m->regs[addr];
+        m->regs[MCP_CANSTAT] = (uint8_t)((m->regs[MCP_CANSTAT] & ~MCP_MODE_MASK) |
+                                         (m->regs[addr] & MCP_MODE_MASK));
+    }
+}
+
+static void model_reset(MCP2515_Model_t *m)
+{
+    memset(m->regs, 0, sizeof(m->regs));
+    m->regs[MCP_CANCTRL] = 0x87U;
+    m->regs[MCP_CANSTAT] = MCP_MODE_CONFIG;
+}
+
+static uint8_t model_status(const MCP2515_Model_t *m)
+{
+    uint8_t intf = m->regs[MCP_CANINTF];
+    uint8_t st = intf & (MCP_RX0IF | MCP_RX1IF);
+    for (uint8_t b = 0; b < 3U; ++b) {
+        if (m->regs[MCP_TXBCTRL(b)] & MCP_TXREQ)
+            st |= (uint8_t)MCP_STAT_TXREQ(b);
+        if (intf & (MCP_TX0IF << b))
+            st |= (uint8_t)MCP_STAT_TXIF(b);
+    }
+    return st;
+}
+
+/* One chip-select framed transaction */
+static void model_transaction(MCP2515_Model_t *m, const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+    if (!len)
+        return;
+    uint8_t ins = tx[0];
+    if (rx)
+        memset(rx, 0xFF, len);
+
+    if (ins == MCP_RESET) {
+        model_reset(m);
+    } else if (ins == MCP_READ && len >= 2U) {
+        uint8_t a = tx[1];
+        for (uint16_t i = 2; i < len; ++i, ++a)
+            if (rx)
+                rx[i] = REG(m, a);
+    } else if (ins == MCP_WRITE && len >= 2U) {
+        uint8_t a = tx[1];
+        for (uint16_t i = 2; i < len; ++i, ++a)
+            model_write(m, a, tx[i], 0xFFU);
+        model_kick(m);
+    } else if (ins == MCP_BIT_MODIFY && len >= 4U) {
+        model_write(m, tx[1], tx[3], tx[2]);
+        model_kick(m);
+    } else if ((ins & 0xF9U) == 0x90U) {
+        /* READ RX BUFFER: n selects the buffer, m starts at D0 */
+        uint8_t n = (ins >> 2) & 1U;
+        uint8_t a = (uint8_t)((n ? MCP_RXB1CTRL : MCP_RXB0CTRL) + ((ins & 0x02U) ? 6U : 1U));
+        for (uint16_t i = 1; i < len; ++i, ++a)
+            if (rx)
+                rx[i] = REG(m, a);
+        m->regs[MCP_CANINTF] &= (uint8_t)~(n ? MCP_RX1IF : MCP_RX0IF); /* on CS release */
+    } else if ((ins & 0xF8U) == 0x40U && (ins & 0x07U) <= 5U) {
+        /* LOAD TX BUFFER: abc = buffer * 2 + start at D0 */
+        uint8_t b = (ins & 0x07U) >> 1;
+        uint8_t a = (uint8_t)(MCP_TXBCTRL(b) + ((ins & 0x01U) ? 6U : 1U));
+        for (uint16_t i = 1; i < len; ++i, ++a)
+            model_write(m, a, tx[i], 0xFFU);
+    } else if ((ins & 0xF8U) == 0x80U) {
+        /* RTS */
+        for (uint8_t b = 0; b < 3U; ++b)
+            if (ins & (1U << b))
+                m->regs[MCP_TXBCTRL(b)] |= MCP_TXREQ;
+        model_kick(m);
+    } else if (ins == MCP_READ_STATUS) {
+        uint8_t st = model_status(m);
+        for (uint16_t i = 1; i < len; ++i)
+            if (rx)
+                rx[i] = st;
+    } else if (ins == MCP_RX_STATUS) {
+        uint8_t intf = m->regs[MCP_CANINTF];
+        uint8_t st = (uint8_t)((intf & MCP_RX0IF) ? 0x40U : 0U) | ((intf & MCP_RX1IF) ? 0x80U : 0U);
+        for (uint16_t i = 1; i < len; ++i)
+            if (rx)
+                rx[i] = st;
+    }
+}
+
+static int model_transfer(CAN_SpiBus_t *bus, const CAN_SpiXfer_t *xfers, uint8_t count)
+{
+    MCP2515_Model_t *m = (MCP2515_Model_t *)bus->ctx;
+    for (uint8_t i = 0; i < count; ++i)
+        model_transaction(m, xfers[i].tx, xfers[i].rx, xfers[i].len);
+    return 0;
+}
+
+void MCP2515_Model_Init(MCP2515_Model_t *model)
+{
+    if (!model)
+        return;
+    memset(model, 0, sizeof(*model));
+    model_reset(model);
+    model->spi.transfer = model_transfer;
+    model->spi.ctx = model;
+}
+
+uint8_t MCP2515_Model_IntPending(const MCP2515_Model_t *model)
+{
+    return (model->regs[MCP_CANINTF] & model->regs[MCP_CANINTE]) ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef CAN_MCP2515_MODEL_H
+#define CAN_MCP2515_MODEL_H
+
+#include "can_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Software MCP2515 for host builds.
+ *
+ * Implements the register file and the SPI instruction set used by the
+ * driver behind a CAN_SpiBus_t, so the real driver runs unmodified on Linux.
+ * The bus is ideal: a requested frame is sent at once and always ACKed.
+ * Sent frames go to `on_tx` (and back into the RX path in loopback mode);
+ * frames from other nodes are injected with MCP2515_Model_Receive.  The SPI
+ * counters of `spi` give the bytes and transactions spent per frame.
+ */
+
+typedef struct MCP2515_Model MCP2515_Model_t;
+
+struct MCP2515_Model {
+    uint8_t      regs[128];
+    CAN_SpiBus_t spi;              /* pass &model.spi to MCP2515_SetupDriver */
+    void       (*on_tx)(MCP2515_Model_t *model, const CAN_Message_t *msg, void *user);
+    void        *user;
+    uint32_t     tx_frames;
+    uint32_t     rx_frames;
+    uint32_t     rx_dropped;       /* filtered out */
+    uint32_t     rx_overflows;
+};
+
+void    MCP2515_Model_Init(MCP2515_Model_t *model);
+/* A frame from the bus. Returns 0 when stored, -1 if filtered or lost. */
+int     MCP2515_Model_Receive(MCP2515_Model_t *model, const CAN_Message_t *msg);
+/* State of the INT pin */
+uint8_t MCP2515_Model_IntPending(const MCP2515_Model_t *model);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_MCP2515_MODEL_H */
@@ -0,0 +1,135 @@
+#include "can_merge.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Timestamps wrap after ~71 minutes; compare them as a signed distance */
+static inline int merge_before(const CAN_Merge_t *m, uint8_t a, uint8_t b)
+{
+    int32_t d = (int32_t)(m->src[a].head->timestamp - m->src[b].head->timestamp);
+    return d < 0 || (d == 0 && a < b);
+}
+
+static void merge_sift_up(CAN_Merge_t *m, uint8_t pos)
+{
+    uint8_t s = m->heap[pos];
+    while (pos > 0) {
+        uint8_t parent = (uint8_t)((pos - 1U) / 2U);
+        if (!merge_before(m, s, m->heap[parent]))
+            break;
+        m->heap[pos] = m->heap[parent];
+        pos = parent;
+    }
+    m->heap[pos] = s;
+}
+
+static void merge_sift_down(CAN_Merge_t *m, uint8_t pos)
+{
+    uint8_t s = m->heap[pos];
+    for (;;) {
+        uint8_t child = (uint8_t)(2U * pos + 1U);
+        if (child >= m->heap_len)
+            break;
+        if (child + 1U < m->heap_len && merge_before(m, m->heap[child + 1U], m->heap[child]))
+            child++;
+        if (!merge_before(m, m->heap[child], s))
+            break;
+        m->heap[pos] = m->heap[child];
+        pos = child;
+    }
+    m->heap[pos] = s;
+}
+
+/* Peek into every source without a frame in the heap. Returns the number of
+ * sources added. */
+static uint8_t merge_refill(CAN_Merge_t *m)
+{
+    uint8_t added = 0;
+    if (m->heap_len == m->num_src)
+        return 0;
+    for (uint8_t i = 0; i < m->num_src; ++i) {
+        CAN_MergeSource_t *s = &m->src[i];
+        if (s->head)
+            continue;
+        s->head = CAN_Queue_Peek(s->queue, NULL);
+        if (!s->head)
+            continue;
+        m->heap[m->heap_len] = i;
+        merge_sift_up(m, m->heap_len++);
+        added++;
+    }
+    return added;
+}
+
+void CAN_Merge_Init(CAN_Merge_t *m, uint32_t max_delay_us)
+{
+    if (!m)
+        return;
+    memset(m, 0, sizeof(*m));
+    m->max_delay_us = max_delay_us;
+}
+
+int CAN_Merge_AddSource(CAN_Merge_t *m, CAN_Queue_t *q, uint8_t inst_id)
+{
+    if (!m || !q || m->num_src >= CAN_MERGE_MAX_SOURCES)
+        return -1;
+    CAN_MergeSource_t *s = &m->src[m->num_src++];
+    s->queue = q;
+    s->head = NULL;
+    s->inst_id = inst_id;
+    return 0;
+}
+
+uint32_t CAN_Merge_HoldTime(const CAN_Merge_t *m, uint32_t now_us)
+{
+    if (!m || !m->heap_len || m->heap_len == m->num_src)
+        return 0;
+    /* holding on would make a full ring drop frames */
+    for (uint8_t k = 0; k < m->heap_len; ++k) {
+        const CAN_Queue_t *q = m->src[m->heap[k]].queue;
+        if (CAN_Queue_Count(q) == CAN_Queue_Len(q))
+            return 0;
+    }
+    int32_t age = (int32_t)(now_us - m->src[m->heap[0]].head->timestamp);
+    if (age < 0)
+        age = 0;
+    return (uint32_t)age >= m->max_delay_us ? 0 : m->max_delay_us - (uint32_t)age;
+}
+
+uint16_t CAN_Merge_Read(CAN_Merge_t *m, uint32_t now_us, uint16_t max,
+                        CAN_MergeVisitor_t visitor, void *user)
+{
+    uint16_t n = 0;
+    if (!m || !visitor)
+        return 0;
+    merge_refill(m);
+    while (n < max && m->heap_len) {
+        /* An empty source may still get an older frame: wait for it, up to
+         * max_delay_us after the head's timestamp */
+        if (CAN_Merge_HoldTime(m, now_us)) {
+            if (merge_refill(m))
+                continue;
+            m->stats.held++;
+            break;
+        }
+        uint8_t i = m->heap[0];
+        CAN_MergeSource_t *s = &m->src[i];
+        uint32_t ts = s->head->timestamp;
+        if (m->emitted && (int32_t)(ts - m->last_ts) < 0)
+            m->stats.late++;
+        else
+            m->last_ts = ts;
+        m->emitted = 1;
+        visitor(s->inst_id, s->head, user);
+        CAN_Queue_Release(s->queue);
+        n++;
+        s->head = CAN_Queue_Peek(s->queue, NULL);
+        if (!s->head)
+            m->heap[0] = m->heap[--m->heap_len];
+        if (m->heap_len)
+            merge_sift_down(m, 0);
+    }
+    m->stats.frames += n;
+    if (n)
+        m->stats.batches++;
+    return n;
+}
@@ -0,0 +1,77 @@
+#ifndef CAN_MERGE_H
+#define CAN_MERGE_H
+
+#include <stdint.h>
+#include "can_config.h"
+#include "can_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timestamp-ordered view of several RX rings.
+ *
+ * Every source ring is already in arrival order, so a k-way merge only needs
+ * the head of each: a small min-heap holds one peeked frame per non-empty
+ * source.  Frames are handed to the visitor in place and released from their
+ * ring afterwards; nothing is copied into an intermediate queue.
+ *
+ * The head of the heap is only emitted once every source has a frame, or
+ * once it is max_delay_us old: a source that is empty now may still receive
+ * a frame stamped earlier.  Frames are stamped with can_os_now_us() when
+ * they are drained from the controller (CAN_Manager_TriggerEvent or the
+ * polling pass), just before they are queued, so the delay only needs to
+ * cover that gap (ISR or process pass latency), not the bus gap between
+ * frames.  The order is therefore drain order across interfaces, not the
+ * controllers' receive order.  It is cut short when a source ring is
+ * full.  Frames delivered later than that are still emitted, and counted as
+ * late.
+ *
+ * The merge must be the only consumer of its source rings.
+ */
+
+#define CAN_MERGE_MAX_SOURCES (2U * MAX_CAN_INTERFACES)
+
+typedef struct {
+    CAN_Queue_t         *queue;
+    const CAN_Message_t *head;     /* peeked frame while in the heap */
+    uint8_t              inst_id;
+} CAN_MergeSource_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t batches;    /* reads that returned frames */
+    uint32_t held;       /* reads that stopped to wait for an empty source */
+    uint32_t late;       /* emitted after a frame with a later timestamp */
+} CAN_MergeStats_t;
+
+typedef struct {
+    CAN_MergeSource_t src[CAN_MERGE_MAX_SOURCES];
+    uint8_t           heap[CAN_MERGE_MAX_SOURCES];  /* source indexes, oldest first */
+    uint8_t           num_src;
+    uint8_t           heap_len;
+    uint8_t           emitted;     /* last_ts is valid */
+    uint32_t          last_ts;
+    uint32_t          max_delay_us;
+    CAN_MergeStats_t  stats;
+} CAN_Merge_t;
+
+/* Called for every merged frame; `msg` is only valid during the call. */
+typedef void (*CAN_MergeVisitor_t)(uint8_t inst_id, const CAN_Message_t *msg, void *user);
+
+void CAN_Merge_Init(CAN_Merge_t *m, uint32_t max_delay_us);
+int  CAN_Merge_AddSource(CAN_Merge_t *m, CAN_Queue_t *q, uint8_t inst_id);
+/* Emit up to `max` frames in timestamp order, `now_us` deciding which held
+ * frames have waited long enough. Returns the number of frames emitted. */
+uint16_t CAN_Merge_Read(CAN_Merge_t *m, uint32_t now_us, uint16_t max,
+                        CAN_MergeVisitor_t visitor, void *user);
+/* Microseconds until the oldest held frame may be emitted without the
+ * missing sources, 0 if it may go now or nothing is held. */
+uint32_t CAN_Merge_HoldTime(const CAN_Merge_t *m, uint32_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_MERGE_H */
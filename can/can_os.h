@@ -0,0 +1,93 @@
+#ifndef CAN_OS_H
+#define CAN_OS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Minimal OS abstraction used by the manager for registration locking,
+ * per-instance processing threads and blocking waits.  One port is selected at compile time:
+ *
+ *   CAN_OS_PTHREAD  - POSIX threads (default on Linux/Unix hosts)
+ *   CAN_OS_FREERTOS - FreeRTOS tasks and mutexes
+ *   CAN_OS_NONE     - bare metal, single thread of execution per core
+ */
+#if !defined(CAN_OS_PTHREAD) && !defined(CAN_OS_FREERTOS) && !defined(CAN_OS_NONE)
+#  if defined(__unix__) || defined(__APPLE__)
+#    define CAN_OS_PTHREAD 1
+#  else
+#    define CAN_OS_NONE 1
+#  endif
+#endif
+
+typedef void (*can_os_thread_fn)(void *arg);
+
+#define CAN_OS_WAIT_FOREVER 0xFFFFFFFFU
+
+/* Thread objects are owned by the caller and must outlive the thread. */
+#if defined(CAN_OS_PTHREAD)
+#include <pthread.h>
+typedef struct { pthread_mutex_t m; } can_os_mutex_t;
+typedef struct { pthread_t t; can_os_thread_fn fn; void *arg; } can_os_thread_t;
+typedef struct { pthread_mutex_t m; pthread_cond_t c; uint8_t set; } can_os_event_t;
+#elif defined(CAN_OS_FREERTOS)
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+typedef struct { SemaphoreHandle_t m; StaticSemaphore_t buf; } can_os_mutex_t;
+typedef struct {
+    TaskHandle_t      t;
+    SemaphoreHandle_t done;       /* given when fn returns, taken by join */
+    StaticSemaphore_t done_buf;
+    can_os_thread_fn  fn;
+    void             *arg;
+} can_os_thread_t;
+typedef struct { SemaphoreHandle_t s; StaticSemaphore_t buf; } can_os_event_t;
+#else
+typedef struct { uint8_t unused; } can_os_mutex_t;
+typedef struct { uint8_t unused; } can_os_thread_t;
+typedef struct { volatile uint8_t set; } can_os_event_t;
+#endif
+
+typedef struct {
+    const char *name;
+    uint32_t    stack_size;   /* bytes, 0 = port default */
+    uint8_t     priority;     /* port specific, 0 = default */
+    int8_t      core;         /* pin to this core, -1 = any */
+} can_os_thread_attr_t;
+
+void     can_os_mutex_init(can_os_mutex_t *m);
+void     can_os_mutex_lock(can_os_mutex_t *m);
+void     can_os_mutex_unlock(can_os_mutex_t *m);
+
+/* Returns 0 on success */
+int      can_os_thread_create(can_os_thread_t *t, const can_os_thread_attr_t *attr,
+                              can_os_thread_fn fn, void *arg);
+void     can_os_thread_join(can_os_thread_t *t);
+
+/* Auto-reset event: a signal wakes one waiter, or the next one to wait if
+ * nobody is waiting yet.  Signal may be called from ISRs. Wait returns 0 when
+ * signalled and -1 on timeout. */
+void     can_os_event_init(can_os_event_t *e);
+void     can_os_event_signal(can_os_event_t *e);
+int      can_os_event_wait(can_os_event_t *e, uint32_t timeout_ms);
+
+void     can_os_sleep_ms(uint32_t ms);
+void     can_os_yield(void);
+uint32_t can_os_now_us(void);
+uint8_t  can_os_core_id(void);
+
+#if defined(CAN_OS_NONE)
+/* Bare metal has no time base of its own: call from a periodic timer ISR,
+ * or override the weak can_os_now_us() with a hardware counter. */
+void     can_os_tick_us(uint32_t elapsed_us);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_OS_H */
@@ -0,0 +1,106 @@
+#include "can_os.h"
+
+#if defined(CAN_OS_FREERTOS)
+
+void can_os_mutex_init(can_os_mutex_t *m)
+{
+    m->m = xSemaphoreCreateMutexStatic(&m->buf);
+}
+
+void can_os_mutex_lock(can_os_mutex_t *m)
+{
+    xSemaphoreTake(m->m, portMAX_DELAY);
+}
+
+void can_os_mutex_unlock(can_os_mutex_t *m)
+{
+    xSemaphoreGive(m->m);
+}
+
+/* FreeRTOS tasks must not return, so signal completion and delete. */
+static void can_os_task_entry(void *p)
+{
+    can_os_thread_t *t = (can_os_thread_t *)p;
+    t->fn(t->arg);
+    xSemaphoreGive(t->done);
+    vTaskDelete(NULL);
+}
+
+int can_os_thread_create(can_os_thread_t *t, const can_os_thread_attr_t *attr,
+                         can_os_thread_fn fn, void *arg)
+{
+    if (!t || !fn)
+        return -1;
+    t->fn = fn;
+    t->arg = arg;
+    t->done = xSemaphoreCreateBinaryStatic(&t->done_buf);
+
+    const char *name = (attr && attr->name) ? attr->name : "can";
+    uint32_t stack = (attr && attr->stack_size) ? attr->stack_size
+                                                : configMINIMAL_STACK_SIZE * sizeof(StackType_t);
+    UBaseType_t prio = (attr && attr->priority) ? attr->priority : tskIDLE_PRIORITY + 1;
+    BaseType_t rc = xTaskCreate(can_os_task_entry, name,
+                                (configSTACK_DEPTH_TYPE)(stack / sizeof(StackType_t)),
+                                t, prio, &t->t);
+    if (rc != pdPASS)
+        return -1;
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1) && (configUSE_CORE_AFFINITY == 1)
+    if (attr && attr->core >= 0)
+        vTaskCoreAffinitySet(t->t, (UBaseType_t)1 << attr->core);
+#endif
+    return 0;
+}
+
+void can_os_thread_join(can_os_thread_t *t)
+{
+    xSemaphoreTake(t->done, portMAX_DELAY);
+}
+
+void can_os_event_init(can_os_event_t *e)
+{
+    e->s = xSemaphoreCreateBinaryStatic(&e->buf);
+}
+
+void can_os_event_signal(can_os_event_t *e)
+{
+    if (xPortIsInsideInterrupt()) {
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(e->s, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xSemaphoreGive(e->s);
+    }
+}
+
+int can_os_event_wait(can_os_event_t *e, uint32_t timeout_ms)
+{
+    TickType_t ticks = timeout_ms == CAN_OS_WAIT_FOREVER ? portMAX_DELAY
+                                                         : pdMS_TO_TICKS(timeout_ms);
+    return xSemaphoreTake(e->s, ticks) == pdTRUE ? 0 : -1;
+}
+
+void can_os_sleep_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void can_os_yield(void)
+{
+    taskYIELD();
+}
+
+uint32_t can_os_now_us(void)
+{
+    return (uint32_t)(xTaskGetTickCount() * (1000000U / configTICK_RATE_HZ));
+}
+
+uint8_t can_os_core_id(void)
+{
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1)
+    return (uint8_t)portGET_CORE_ID();
+#else
+    return 0;
+#endif
+}
+
+#endif /* CAN_OS_FREERTOS */
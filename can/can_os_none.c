@@ -0,0 +1,89 @@
+#include "can_os.h"
+
+#if defined(CAN_OS_NONE)
+
+/*
+ * Bare-metal port: there is no scheduler, so locks are no-ops and threads
+ * cannot be created.  Per-instance processing is done by calling
+ * CAN_Manager_ProcessInstance() from each core's main loop instead.
+ */
+
+static volatile uint32_t can_os_time_us;
+
+void can_os_mutex_init(can_os_mutex_t *m)
+{
+    (void)m;
+}
+
+void can_os_mutex_lock(can_os_mutex_t *m)
+{
+    (void)m;
+}
+
+void can_os_mutex_unlock(can_os_mutex_t *m)
+{
+    (void)m;
+}
+
+int can_os_thread_create(can_os_thread_t *t, const can_os_thread_attr_t *attr,
+                         can_os_thread_fn fn, void *arg)
+{
+    (void)t; (void)attr; (void)fn; (void)arg;
+    return -1;
+}
+
+void can_os_thread_join(can_os_thread_t *t)
+{
+    (void)t;
+}
+
+void can_os_event_init(can_os_event_t *e)
+{
+    e->set = 0;
+}
+
+void can_os_event_signal(can_os_event_t *e)
+{
+    e->set = 1;
+}
+
+/* Without a scheduler the only option is to spin until an ISR signals */
+int can_os_event_wait(can_os_event_t *e, uint32_t timeout_ms)
+{
+    uint32_t start = can_os_now_us();
+    while (!e->set) {
+        if (timeout_ms != CAN_OS_WAIT_FOREVER &&
+            can_os_now_us() - start >= timeout_ms * 1000U)
+            return -1;
+    }
+    e->set = 0;
+    return 0;
+}
+
+void can_os_tick_us(uint32_t elapsed_us)
+{
+    can_os_time_us += elapsed_us;
+}
+
+void can_os_sleep_ms(uint32_t ms)
+{
+    uint32_t start = can_os_now_us();
+    while (can_os_now_us() - start < ms * 1000U)
+        ;
+}
+
+void can_os_yield(void)
+{
+}
+
+__attribute__((weak)) uint32_t can_os_now_us(void)
+{
+    return can_os_time_us;
+}
+
+__attribute__((weak)) uint8_t can_os_core_id(void)
+{
+    return 0;
+}
+
+#endif /* CAN_OS_NONE */
@@ -0,0 +1,138 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* CPU affinity and sched_getcpu */
+#elif !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "can_os.h"
+
+#if defined(CAN_OS_PTHREAD)
+
+#include <sched.h>
+#include <time.h>
+
+void can_os_mutex_init(can_os_mutex_t *m)
+{
+    pthread_mutex_init(&m->m, NULL);
+}
+
+void can_os_mutex_lock(can_os_mutex_t *m)
+{
+    pthread_mutex_lock(&m->m);
+}
+
+void can_os_mutex_unlock(can_os_mutex_t *m)
+{
+    pthread_mutex_unlock(&m->m);
+}
+
+static void *can_os_thread_entry(void *p)
+{
+    can_os_thread_t *t = (can_os_thread_t *)p;
+    t->fn(t->arg);
+    return NULL;
+}
+
+int can_os_thread_create(can_os_thread_t *t, const can_os_thread_attr_t *attr,
+                         can_os_thread_fn fn, void *arg)
+{
+    pthread_attr_t pa;
+
+    if (!t || !fn)
+        return -1;
+    t->fn = fn;
+    t->arg = arg;
+    pthread_attr_init(&pa);
+    if (attr && attr->stack_size)
+        pthread_attr_setstacksize(&pa, attr->stack_size);
+#if defined(__linux__)
+    if (attr && attr->core >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(attr->core, &set);
+        pthread_attr_setaffinity_np(&pa, sizeof(set), &set);
+    }
+#endif
+    int rc = pthread_create(&t->t, &pa, can_os_thread_entry, t);
+    pthread_attr_destroy(&pa);
+    return rc == 0 ? 0 : -1;
+}
+
+void can_os_thread_join(can_os_thread_t *t)
+{
+    pthread_join(t->t, NULL);
+}
+
+void can_os_event_init(can_os_event_t *e)
+{
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&e->m, NULL);
+    pthread_cond_init(&e->c, &ca);
+    pthread_condattr_destroy(&ca);
+    e->set = 0;
+}
+
+void can_os_event_signal(can_os_event_t *e)
+{
+    pthread_mutex_lock(&e->m);
+    e->set = 1;
+    pthread_cond_signal(&e->c);
+    pthread_mutex_unlock(&e->m);
+}
+
+int can_os_event_wait(can_os_event_t *e, uint32_t timeout_ms)
+{
+    struct timespec ts;
+    int rc = 0;
+    if (timeout_ms != CAN_OS_WAIT_FOREVER) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += timeout_ms / 1000U;
+        ts.tv_nsec += (long)(timeout_ms % 1000U) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_mutex_lock(&e->m);
+    while (!e->set && rc == 0) {
+        if (timeout_ms == CAN_OS_WAIT_FOREVER)
+            rc = pthread_cond_wait(&e->c, &e->m);
+        else
+            rc = pthread_cond_timedwait(&e->c, &e->m, &ts);
+    }
+    int got = e->set;
+    e->set = 0;
+    pthread_mutex_unlock(&e->m);
+    return got ? 0 : -1;
+}
+
+void can_os_sleep_ms(uint32_t ms)
+{
+    struct timespec ts = { (time_t)(ms / 1000U), (long)(ms % 1000U) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void can_os_yield(void)
+{
+    sched_yield();
+}
+
+uint32_t can_os_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U);
+}
+
+uint8_t can_os_core_id(void)
+{
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : (uint8_t)cpu;
+#else
+    return 0;
+#endif
+}
+
+#endif /* CAN_OS_PTHREAD */
@@ -0,0 +1,97 @@
+#include "can_queue.h"
+#include <stddef.h>
+
+int CAN_Queue_Init(CAN_Queue_t *q, CAN_QueueSlot_t *slots, uint16_t len)
+{
+    if (!q || !slots || len < 2 || (len & (len - 1U)) != 0)
+        return -1;
+    q->slots = slots;
+    q->mask = len - 1U;
+    for (uint32_t i = 0; i < len; ++i)
+        atomic_init(&slots[i].seq, i);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->peak, 0);
+    return 0;
+}
+
+int CAN_Queue_Push(CAN_Queue_t *q, const CAN_Message_t *msg, uint32_t *out_pos)
+{
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    CAN_QueueSlot_t *slot;
+    for (;;) {
+        slot = &q->slots[pos & q->mask];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -1; /* full */
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    slot->msg = *msg;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    if (out_pos)
+        *out_pos = pos;
+
+    uint16_t fill = (uint16_t)(pos + 1 - atomic_load_explicit(&q->tail, memory_order_relaxed));
+    if (fill > atomic_load_explicit(&q->peak, memory_order_relaxed))
+        atomic_store_explicit(&q->peak, fill, memory_order_relaxed);
+    return 0;
+}
+
+int CAN_Queue_Pop(CAN_Queue_t *q, CAN_Message_t *msg)
+{
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    CAN_QueueSlot_t *slot;
+    for (;;) {
+        slot = &q->slots[pos & q->mask];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -1; /* empty */
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+    *msg = slot->msg;
+    atomic_store_explicit(&slot->seq, pos + q->mask + 1, memory_order_release);
+    return 0;
+}
+
+CAN_Message_t *CAN_Queue_Peek(CAN_Queue_t *q, uint32_t *out_pos)
+{
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    CAN_QueueSlot_t *slot = &q->slots[pos & q->mask];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+        return NULL;
+    if (out_pos)
+        *out_pos = pos;
+    return &slot->msg;
+}
+
+void CAN_Queue_Release(CAN_Queue_t *q)
+{
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, pos + 1, memory_order_relaxed);
+    atomic_store_explicit(&q->slots[pos & q->mask].seq, pos + q->mask + 1,
+                          memory_order_release);
+}
+
+uint16_t CAN_Queue_Count(const CAN_Queue_t *q)
+{
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t n = head - tail;
+    return (uint16_t)(n > q->mask + 1U ? 0U : n);
+}
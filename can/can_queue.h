@@ -0,0 +1,54 @@
+#ifndef CAN_QUEUE_H
+#define CAN_QUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "can_interface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded lock-free frame queue (Vyukov style).  Every slot carries its own
+ * sequence number, so producers claim a slot with one CAS on `head` and the
+ * consumer only sees it once the copy is complete.  Any number of producers
+ * and consumers may use Push/Pop concurrently, including from ISRs.
+ * Peek/Release are for a single consumer that wants to use the frame in
+ * place before removing it.
+ *
+ * The length must be a power of two; all slots are usable.
+ */
+
+typedef struct {
+    _Atomic uint32_t seq;
+    CAN_Message_t    msg;
+} CAN_QueueSlot_t;
+
+typedef struct {
+    CAN_QueueSlot_t *slots;
+    uint32_t         mask;
+    _Atomic uint32_t head;   /* next position to write */
+    _Atomic uint32_t tail;   /* next position to read */
+    _Atomic uint16_t peak;   /* high watermark */
+} CAN_Queue_t;
+
+int  CAN_Queue_Init(CAN_Queue_t *q, CAN_QueueSlot_t *slots, uint16_t len);
+/* `pos` (optional) receives the frame's queue position: positions increase by
+ * one per frame, in the order frames are dequeued. */
+int  CAN_Queue_Push(CAN_Queue_t *q, const CAN_Message_t *msg, uint32_t *pos);
+int  CAN_Queue_Pop(CAN_Queue_t *q, CAN_Message_t *msg);
+CAN_Message_t *CAN_Queue_Peek(CAN_Queue_t *q, uint32_t *pos);
+void CAN_Queue_Release(CAN_Queue_t *q);
+uint16_t CAN_Queue_Count(const CAN_Queue_t *q);
+
+static inline uint16_t CAN_Queue_Len(const CAN_Queue_t *q)
+{
+    return (uint16_t)(q->mask + 1U);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_QUEUE_H */
@@ -0,0 +1,344 @@
+#include "can_request.h"
+#include <stddef.h>
+#include "can_os.h"
+
+#define REQ_NIL   0xFFFFU   /* end of a list, free table entry */
+#define REQ_TOMB  0xFFFEU   /* removed table entry, lookups go on */
+#define REQ_TMASK (CAN_REQUEST_TABLE_LEN - 1U)
+#define REQ_TICK_US (CAN_REQUEST_TICK_MS * 1000U)
+/* deadlines are compared as signed tick differences */
+#define REQ_MAX_TICKS 0x7FFFFFFEU
+
+/* tag: generation << 8 | state */
+enum { REQ_FREE, REQ_QUEUED, REQ_PENDING, REQ_ANSWERED, REQ_EXPIRED };
+#define REQ_STATE(tag)       ((tag) & 0xFFU)
+#define REQ_TAG(tag, state)  (((tag) & ~0xFFU) | (state))
+
+typedef struct {
+    _Atomic uint32_t tag;
+    _Atomic uint16_t link;      /* free, submit or done list */
+    uint16_t         pos;       /* table entry; masked entries follow the table */
+    uint16_t         t_prev;
+    uint16_t         t_next;
+    /* the matcher; a lookup may read it while the slot is being reused,
+     * the generation in `tag` then makes its claim fail */
+    _Atomic uint8_t  extended;
+    _Atomic uint32_t match_id;
+    _Atomic uint32_t match_mask;
+    uint32_t         timeout_ms;
+    uint32_t         deadline;  /* wheel tick */
+    uint8_t          timed;     /* on the wheel; not for CAN_OS_WAIT_FOREVER */
+    CAN_RequestCb_t  cb;
+    void            *user;
+    CAN_Message_t    msg;       /* the request until sent, then the reply */
+} can_req_t;
+
+static can_req_t req_pool[CAN_REQUEST_MAX];
+static _Atomic uint32_t req_free;   /* ABA counter << 16 | first free slot */
+
+static void req_free_push(uint16_t i)
+{
+    uint32_t head = atomic_load_explicit(&req_free, memory_order_relaxed);
+    uint32_t next;
+    do {
+        atomic_store_explicit(&req_pool[i].link, (uint16_t)head, memory_order_relaxed);
+        next = ((head + 0x10000U) & 0xFFFF0000U) | i;
+    } while (!atomic_compare_exchange_weak_explicit(&req_free, &head, next,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static uint16_t req_alloc(void)
+{
+    uint32_t head = atomic_load_explicit(&req_free, memory_order_acquire);
+    for (;;) {
+        uint16_t i = (uint16_t)head;
+        if (i == REQ_NIL)
+            return REQ_NIL;
+        uint16_t link = atomic_load_explicit(&req_pool[i].link, memory_order_relaxed);
+        uint32_t next = ((head + 0x10000U) & 0xFFFF0000U) | link;
+        if (atomic_compare_exchange_weak_explicit(&req_free, &head, next,
+                                                  memory_order_acquire, memory_order_acquire))
+            return i;
+    }
+}
+
+/* Submit and done lists: any number of producers, taken whole by the
+ * processing context */
+static void req_push(_Atomic uint16_t *list, uint16_t i)
+{
+    uint16_t head = atomic_load_explicit(list, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&req_pool[i].link, head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(list, &head, i, memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/* Only the low ID byte is hashed, so masks that leave any part of a J1939
+ * source address or a diagnostic response ID open still index */
+static inline uint32_t req_hash(uint32_t id, uint8_t extended)
+{
+    return ((id & 0xFFU) ^ ((uint32_t)extended << 7)) & REQ_TMASK;
+}
+
+static int req_insert(CAN_RequestSet_t *set, uint16_t i)
+{
+    can_req_t *r = &req_pool[i];
+    uint32_t mask = atomic_load_explicit(&r->match_mask, memory_order_relaxed);
+    if ((mask & 0xFFU) == 0xFFU) {
+        uint32_t h = req_hash(atomic_load_explicit(&r->match_id, memory_order_relaxed),
+                              atomic_load_explicit(&r->extended, memory_order_relaxed));
+        for (uint32_t k = 0; k < CAN_REQUEST_TABLE_LEN; ++k) {
+            uint32_t pos = (h + k) & REQ_TMASK;
+            uint16_t e = atomic_load_explicit(&set->table[pos], memory_order_relaxed);
+            if (e == REQ_NIL || e == REQ_TOMB) {
+                r->pos = (uint16_t)pos;
+                atomic_store_explicit(&set->table[pos], i, memory_order_release);
+                return 0;
+            }
+        }
+        return -1;
+    }
+    for (uint16_t m = 0; m < CAN_REQUEST_MASKED; ++m) {
+        if (atomic_load_explicit(&set->masked[m], memory_order_relaxed) == REQ_NIL) {
+            r->pos = (uint16_t)(CAN_REQUEST_TABLE_LEN + m);
+            atomic_store_explicit(&set->masked[m], i, memory_order_release);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void req_remove(CAN_RequestSet_t *set, const can_req_t *r)
+{
+    if (r->pos >= CAN_REQUEST_TABLE_LEN) {
+        atomic_store_explicit(&set->masked[r->pos - CAN_REQUEST_TABLE_LEN], REQ_NIL,
+                              memory_order_relaxed);
+        return;
+    }
+    uint32_t pos = r->pos;
+    atomic_store_explicit(&set->table[pos], REQ_TOMB, memory_order_relaxed);
+    /* Tombstones at the end of a chain cut no lookup short: free them */
+    while (atomic_load_explicit(&set->table[(pos + 1U) & REQ_TMASK], memory_order_relaxed) == REQ_NIL &&
+           atomic_load_explicit(&set->table[pos], memory_order_relaxed) == REQ_TOMB) {
+        atomic_store_explicit(&set->table[pos], REQ_NIL, memory_order_relaxed);
+        pos = (pos - 1U) & REQ_TMASK;
+    }
+}
+
+static void req_wheel_add(CAN_RequestSet_t *set, uint16_t i)
+{
+    can_req_t *r = &req_pool[i];
+    uint16_t *head = &set->wheel[r->deadline & (CAN_REQUEST_WHEEL_LEN - 1U)];
+    r->t_prev = REQ_NIL;
+    r->t_next = *head;
+    if (*head != REQ_NIL)
+        req_pool[*head].t_prev = i;
+    *head = i;
+}
+
+static void req_wheel_del(CAN_RequestSet_t *set, uint16_t i)
+{
+    can_req_t *r = &req_pool[i];
+    if (r->t_prev != REQ_NIL)
+        req_pool[r->t_prev].t_next = r->t_next;
+    else
+        set->wheel[r->deadline & (CAN_REQUEST_WHEEL_LEN - 1U)] = r->t_next;
+    if (r->t_next != REQ_NIL)
+        req_pool[r->t_next].t_prev = r->t_prev;
+}
+
+/* Report and recycle; `entered` if the request is in the table and wheel */
+static void req_finish(CAN_RequestSet_t *set, uint8_t inst_id, uint16_t i,
+                       CAN_RequestStatus_t status, uint8_t entered)
+{
+    can_req_t *r = &req_pool[i];
+    if (entered) {
+        req_remove(set, r);
+        if (r->timed)
+            req_wheel_del(set, i);
+    }
+    r->cb(inst_id, status, status == CAN_REQUEST_OK ? &r->msg : NULL, r->user);
+    uint32_t tag = atomic_load_explicit(&r->tag, memory_order_relaxed);
+    atomic_store_explicit(&r->tag, REQ_TAG(tag, REQ_FREE), memory_order_relaxed);
+    atomic_fetch_sub_explicit(&set->pending, 1, memory_order_relaxed);
+    req_free_push(i);
+}
+
+void CAN_Requests_Init(void)
+{
+    for (uint16_t i = 0; i < CAN_REQUEST_MAX; ++i) {
+        atomic_init(&req_pool[i].tag, REQ_FREE);
+        atomic_init(&req_pool[i].link, (uint16_t)(i + 1U < CAN_REQUEST_MAX ? i + 1U : REQ_NIL));
+    }
+    atomic_init(&req_free, 0);
+}
+
+void CAN_Requests_InitSet(CAN_RequestSet_t *set, uint32_t now_us)
+{
+    for (uint32_t k = 0; k < CAN_REQUEST_TABLE_LEN; ++k)
+        atomic_init(&set->table[k], REQ_NIL);
+    for (uint16_t m = 0; m < CAN_REQUEST_MASKED; ++m)
+        atomic_init(&set->masked[m], REQ_NIL);
+    atomic_init(&set->submit, REQ_NIL);
+    atomic_init(&set->done, REQ_NIL);
+    atomic_init(&set->pending, 0);
+    for (uint32_t b = 0; b < CAN_REQUEST_WHEEL_LEN; ++b)
+        set->wheel[b] = REQ_NIL;
+    set->tick = 0;
+    set->tick_us = now_us;
+}
+
+int CAN_Requests_Submit(CAN_RequestSet_t *set, const CAN_Message_t *tx, uint32_t match_id,
+                        uint32_t match_mask, uint32_t timeout_ms, CAN_RequestCb_t cb, void *user)
+{
+    if (!set || !tx || !cb)
+        return -1;
+    uint16_t i = req_alloc();
+    if (i == REQ_NIL)
+        return -1;
+    can_req_t *r = &req_pool[i];
+    atomic_store_explicit(&r->extended, tx->extended ? 1 : 0, memory_order_relaxed);
+    atomic_store_explicit(&r->match_id, match_id & match_mask, memory_order_relaxed);
+    atomic_store_explicit(&r->match_mask, match_mask, memory_order_relaxed);
+    r->timeout_ms = timeout_ms;
+    r->cb = cb;
+    r->user = user;
+    r->msg = *tx;
+    /* a new generation: lookups that still hold the old one fail to claim */
+    uint32_t tag = atomic_load_explicit(&r->tag, memory_order_relaxed) + 0x100U;
+    atomic_store_explicit(&r->tag, REQ_TAG(tag, REQ_QUEUED), memory_order_release);
+    atomic_fetch_add_explicit(&set->pending, 1, memory_order_relaxed);
+    req_push(&set->submit, i);
+    return 0;
+}
+
+static int req_claim(can_req_t *r, uint8_t extended, const CAN_Message_t *msg)
+{
+    uint32_t tag = atomic_load_explicit(&r->tag, memory_order_acquire);
+    if (REQ_STATE(tag) != REQ_PENDING ||
+        atomic_load_explicit(&r->extended, memory_order_relaxed) != extended ||
+        ((msg->id ^ atomic_load_explicit(&r->match_id, memory_order_relaxed)) &
+         atomic_load_explicit(&r->match_mask, memory_order_relaxed)))
+        return 0;
+    if (!atomic_compare_exchange_strong_explicit(&r->tag, &tag, REQ_TAG(tag, REQ_ANSWERED),
+                                                 memory_order_acq_rel, memory_order_relaxed))
+        return 0;
+    r->msg = *msg;
+    return 1;
+}
+
+int CAN_Requests_Match(CAN_RequestSet_t *set, const CAN_Message_t *msg)
+{
+    if (!atomic_load_explicit(&set->pending, memory_order_relaxed))
+        return 0;
+    uint8_t ext = msg->extended ? 1 : 0;
+    uint32_t h = req_hash(msg->id, ext);
+    for (uint32_t k = 0; k < CAN_REQUEST_TABLE_LEN; ++k) {
+        uint16_t e = atomic_load_explicit(&set->table[(h + k) & REQ_TMASK], memory_order_acquire);
+        if (e == REQ_NIL)
+            break;
+        if (e != REQ_TOMB && req_claim(&req_pool[e], ext, msg)) {
+            req_push(&set->done, e);
+            return 1;
+        }
+    }
+    for (uint16_t m = 0; m < CAN_REQUEST_MASKED; ++m) {
+        uint16_t e = atomic_load_explicit(&set->masked[m], memory_order_acquire);
+        if (e != REQ_NIL && req_claim(&req_pool[e], ext, msg)) {
+            req_push(&set->done, e);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Enter one submitted request and queue its frame */
+static void req_start(CAN_RequestSet_t *set, uint8_t inst_id, uint16_t i,
+                      CAN_RequestSend_t send, void *send_ctx)
+{
+    can_req_t *r = &req_pool[i];
+    /* once pending, a matching frame may overwrite msg at any time */
+    CAN_Message_t tx = r->msg;
+    /* rounded up without overflow, and cut to what the signed compare in
+     * req_expire can tell apart from a passed deadline */
+    uint32_t ticks = r->timeout_ms / CAN_REQUEST_TICK_MS +
+                     (r->timeout_ms % CAN_REQUEST_TICK_MS != 0U);
+    r->timed = r->timeout_ms != CAN_OS_WAIT_FOREVER;
+    r->deadline = set->tick + 1U + (ticks < REQ_MAX_TICKS ? ticks : REQ_MAX_TICKS);
+    uint32_t tag = atomic_load_explicit(&r->tag, memory_order_relaxed);
+    atomic_store_explicit(&r->tag, REQ_TAG(tag, REQ_PENDING), memory_order_release);
+    if (req_insert(set, i) != 0) {
+        atomic_store_explicit(&r->tag, REQ_TAG(tag, REQ_EXPIRED), memory_order_relaxed);
+        req_finish(set, inst_id, i, CAN_REQUEST_FAILED, 0);
+        return;
+    }
+    if (r->timed)
+        req_wheel_add(set, i);
+    if (send(send_ctx, &tx) != 0) {
+        tag = REQ_TAG(tag, REQ_PENDING);
+        if (atomic_compare_exchange_strong_explicit(&r->tag, &tag, REQ_TAG(tag, REQ_EXPIRED),
+                                                    memory_order_acq_rel, memory_order_relaxed))
+            req_finish(set, inst_id, i, CAN_REQUEST_FAILED, 1);
+    }
+}
+
+static void req_expire(CAN_RequestSet_t *set, uint8_t inst_id, uint32_t now_tick)
+{
+    uint32_t ticks = now_tick - set->tick;
+    uint32_t steps = ticks < CAN_REQUEST_WHEEL_LEN ? ticks : CAN_REQUEST_WHEEL_LEN;
+    for (uint32_t s = 1; s <= steps; ++s) {
+        uint16_t i = set->wheel[(set->tick + s) & (CAN_REQUEST_WHEEL_LEN - 1U)];
+        while (i != REQ_NIL) {
+            can_req_t *r = &req_pool[i];
+            uint16_t next = r->t_next;
+            uint32_t tag = atomic_load_explicit(&r->tag, memory_order_relaxed);
+            /* later laps of the wheel stay; answered ones come through the done list */
+            if ((int32_t)(r->deadline - now_tick) <= 0 && REQ_STATE(tag) == REQ_PENDING &&
+                atomic_compare_exchange_strong_explicit(&r->tag, &tag, REQ_TAG(tag, REQ_EXPIRED),
+                                                        memory_order_acq_rel, memory_order_relaxed))
+                req_finish(set, inst_id, i, CAN_REQUEST_TIMEOUT, 1);
+            i = next;
+        }
+    }
+    set->tick = now_tick;
+}
+
+int CAN_Requests_Step(CAN_RequestSet_t *set, uint8_t inst_id, uint32_t now_us,
+                      CAN_RequestSend_t send, void *send_ctx)
+{
+    int work = 0;
+    uint32_t ticks = (now_us - set->tick_us) / REQ_TICK_US;
+    set->tick_us += ticks * REQ_TICK_US;
+    if (!atomic_load_explicit(&set->pending, memory_order_relaxed)) {
+        set->tick += ticks;
+        return 0;
+    }
+
+    uint16_t i = atomic_exchange_explicit(&set->done, REQ_NIL, memory_order_acquire);
+    while (i != REQ_NIL) {
+        uint16_t next = atomic_load_explicit(&req_pool[i].link, memory_order_relaxed);
+        req_finish(set, inst_id, i, CAN_REQUEST_OK, 1);
+        i = next;
+        work = 1;
+    }
+
+    if (ticks)
+        req_expire(set, inst_id, set->tick + ticks);
+
+    /* The list is newest first: reverse it to start requests in order */
+    uint16_t list = atomic_exchange_explicit(&set->submit, REQ_NIL, memory_order_acquire);
+    uint16_t fifo = REQ_NIL;
+    while (list != REQ_NIL) {
+        uint16_t next = atomic_load_explicit(&req_pool[list].link, memory_order_relaxed);
+        atomic_store_explicit(&req_pool[list].link, fifo, memory_order_relaxed);
+        fifo = list;
+        list = next;
+    }
+    while (fifo != REQ_NIL) {
+        uint16_t next = atomic_load_explicit(&req_pool[fifo].link, memory_order_relaxed);
+        req_start(set, inst_id, fifo, send, send_ctx);
+        fifo = next;
+        work = 1;
+    }
+    return work;
+}
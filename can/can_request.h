@@ -0,0 +1,86 @@
+#ifndef CAN_REQUEST_H
+#define CAN_REQUEST_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "can_interface.h"
+#include "can_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Request/response correlation.
+ *
+ * A request is a frame to send plus a matcher (ID and mask) for its reply.
+ * Requests come from one pool of CAN_REQUEST_MAX for all interfaces and pass
+ * through three contexts:
+ *
+ *  - any task submits: a pool slot is taken and pushed on the interface's
+ *    lock-free submit list;
+ *  - the interface's processing context enters the matcher in the
+ *    ID-indexed table, arms the timeout on the interface's timer wheel and
+ *    queues the frame;
+ *  - the RX path (ISR or processing context) looks the reply up in O(1),
+ *    claims the request and passes it back on the done list; the
+ *    processing context then removes it and calls the completion callback.
+ *
+ * Only the processing context changes an interface's table and wheel.  The table is
+ * open addressed, so a lookup racing with a change never follows a stale
+ * link, and every slot carries a generation in its state word: a lookup
+ * that read a slot just before it was reused cannot claim the new request.
+ */
+
+typedef enum {
+    CAN_REQUEST_OK,        /* `response` is the matching frame */
+    CAN_REQUEST_TIMEOUT,
+    CAN_REQUEST_FAILED     /* TX queue or matcher table full */
+} CAN_RequestStatus_t;
+
+/* Runs in the interface's processing context; `response` is NULL unless the
+ * status is CAN_REQUEST_OK and only valid during the call. */
+typedef void (*CAN_RequestCb_t)(uint8_t inst_id, CAN_RequestStatus_t status,
+                                const CAN_Message_t *response, void *user);
+
+#define CAN_REQUEST_TABLE_LEN (2U * CAN_REQUEST_MAX)
+
+/* Per-interface part: matcher table, submit and done lists, timer wheel */
+typedef struct {
+    _Atomic uint16_t table[CAN_REQUEST_TABLE_LEN];  /* by the low ID byte */
+    _Atomic uint16_t masked[CAN_REQUEST_MASKED];
+    _Atomic uint16_t submit;       /* newest first */
+    _Atomic uint16_t done;
+    _Atomic uint16_t pending;      /* submitted and not yet completed */
+    uint16_t         wheel[CAN_REQUEST_WHEEL_LEN];
+    uint32_t         tick;
+    uint32_t         tick_us;      /* time of `tick` */
+} CAN_RequestSet_t;
+
+/* Queues the frame to send through this callback; 0 on success */
+typedef int (*CAN_RequestSend_t)(void *ctx, const CAN_Message_t *msg);
+
+/* Pool; call once before any interface is added */
+void CAN_Requests_Init(void);
+void CAN_Requests_InitSet(CAN_RequestSet_t *set, uint32_t now_us);
+/* Any context. Replies must have the same frame format as `tx`. A timeout
+ * of CAN_OS_WAIT_FOREVER is never armed. */
+int  CAN_Requests_Submit(CAN_RequestSet_t *set, const CAN_Message_t *tx, uint32_t match_id,
+                         uint32_t match_mask, uint32_t timeout_ms, CAN_RequestCb_t cb, void *user);
+/* RX path: non-zero if `msg` answered a request and was consumed */
+int  CAN_Requests_Match(CAN_RequestSet_t *set, const CAN_Message_t *msg);
+/* Processing context: completions, new submissions, expired timeouts.
+ * Returns non-zero if there was anything to do. */
+int  CAN_Requests_Step(CAN_RequestSet_t *set, uint8_t inst_id, uint32_t now_us,
+                       CAN_RequestSend_t send, void *send_ctx);
+
+static inline uint16_t CAN_Requests_Pending(CAN_RequestSet_t *set)
+{
+    return atomic_load_explicit(&set->pending, memory_order_relaxed);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_REQUEST_H */
@@ -0,0 +1,51 @@
+#ifndef CAN_SPI_H
+#define CAN_SPI_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SPI bus used by SPI attached CAN controllers.
+ *
+ * A transfer is a list of transactions, each framed by its own chip-select
+ * pulse.  Drivers hand over everything they need for one step at once (e.g.
+ * load a TX buffer and request its transmission), so a DMA capable port can
+ * chain the whole list without CPU involvement in between.  `rx` may be NULL
+ * when the response is not needed.
+ */
+
+typedef struct {
+    const uint8_t *tx;
+    uint8_t       *rx;
+    uint16_t       len;
+} CAN_SpiXfer_t;
+
+typedef struct CAN_SpiBus CAN_SpiBus_t;
+
+struct CAN_SpiBus {
+    /* Runs `count` transactions in order, returns 0 on success */
+    int  (*transfer)(CAN_SpiBus_t *bus, const CAN_SpiXfer_t *xfers, uint8_t count);
+    void  *ctx;           /* port specific */
+    /* Statistics, maintained by can_spi_transfer */
+    uint32_t transfers;
+    uint32_t transactions;
+    uint32_t bytes;
+};
+
+static inline int can_spi_transfer(CAN_SpiBus_t *bus, const CAN_SpiXfer_t *xfers, uint8_t count)
+{
+    bus->transfers++;
+    bus->transactions += count;
+    for (uint8_t i = 0; i < count; ++i)
+        bus->bytes += xfers[i].len;
+    return bus->transfer(bus, xfers, count);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_SPI_H */
@@ -1,7 +1,8 @@
 #include "can_stm32_bxcan.h"
 #include "can_manager.h"
-#include <stdio.h>
+#include "can_trace.h"
 #include <stddef.h>
+#include <string.h>
 
 #define GET_CTX(h) ((BxCAN_Context *)((char *)(h) - offsetof(BxCAN_Context, hcan)))
 
@@ -15,35 +16,43 @@
 
 /* ----- Driver implementation -------------------------------------------- */
 
-typedef struct {
-    CAN_DriverContext_t base;
-    CAN_HandleTypeDef   hcan;
-    ICANDriver         *driver;
-} BxCAN_Context;
-
 /* Forward declarations for helpers used in init */
 static CAN_Result_t bx_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask);
-static CAN_Result_t bx_set_mode(ICANDriver *drv, CAN_Mode_t mode);
+static CAN_Result_t bx_set_fifo_filter(ICANDriver *drv, uint8_t index, uint32_t id,
+                                       uint32_t mask, uint8_t fifo);
+static uint32_t     bx_hal_mode(CAN_Mode_t mode);
 static void         bx_config_bitrate(BxCAN_Context *ctx, uint32_t bitrate);
 
+/* CAN1 and CAN2 share one bank of 28 filters: CAN1 owns banks 0..13, CAN2
+ * (the slave) owns 14..27 */
+#define BX_SLAVE_START_BANK 14U
+
+/* Ahead of a restart: the manager fails the frames still in the mailboxes,
+ * so make sure they do not go out afterwards */
+static void bx_abort_tx(BxCAN_Context *ctx)
+{
+    HAL_CAN_AbortTxRequest(&ctx->hcan, CAN_TX_MAILBOX0 | CAN_TX_MAILBOX1 | CAN_TX_MAILBOX2);
+}
+
 static CAN_Result_t bx_init(ICANDriver *drv, const CAN_Config_t *cfg)
 {
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
     if (!ctx)
         return CAN_ERROR;
 
+    /* One HAL_CAN_Init with bitrate and mode; the filter banks do not need
+     * the controller stopped and go in before it joins the bus */
+    ctx->tx_pending = 0;
+    ctx->irq_on = 0;
     bx_config_bitrate(ctx, cfg ? cfg->bitrate : 500000);
-    if (HAL_CAN_Start(&ctx->hcan) != HAL_OK)
-        return CAN_ERROR;
-
-    if (cfg) {
+    ctx->hcan.Init.Mode = bx_hal_mode(cfg ? cfg->mode : CAN_OPMODE_NORMAL);
+    HAL_CAN_Init(&ctx->hcan);
+    if (cfg)
         bx_set_filter(drv, cfg->filter_id, cfg->filter_mask);
-        bx_set_mode(drv, cfg->mode);
-    }
-    return CAN_OK;
+    return HAL_CAN_Start(&ctx->hcan) == HAL_OK ? CAN_OK : CAN_ERROR;
 }
 
-static CAN_Result_t bx_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
+CAN_Result_t BxCAN_Send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
 {
     (void)timeout; (void)drv;
     if (!msg)
@@ -51,75 +60,170 @@ static CAN_Result_t bx_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t
     CAN_TxHeaderTypeDef hdr = {
         .StdId = msg->id,
         .ExtId = msg->id,
-        .IDE   = msg->extended ? 1 : 0,
-        .RTR   = 0,
+        .IDE   = msg->extended ? CAN_ID_EXT : CAN_ID_STD,
+        .RTR   = CAN_RTR_DATA,
         .DLC   = msg->dlc
     };
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
-    HAL_CAN_AddTxMessage(&ctx->hcan, &hdr, (uint8_t *)msg->data, NULL);
-    CAN_Manager_TriggerEvent(ctx->base.inst_id,
-                             CAN_EVENT_TX_COMPLETE, (void *)msg);
+    uint32_t tsr = ctx->hcan.Instance->TSR;
+    if (!(tsr & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)))
+        return CAN_ERROR; /* all mailboxes busy */
+    /* AddTxMessage fills the mailbox TSR.CODE names. The handle must be in
+     * place before the request: the completion IRQ may fire before
+     * AddTxMessage returns. Completion is reported from the mailbox
+     * callbacks below, or by bx_service while interrupts are off. */
+    uint32_t mb = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    uint32_t mailbox;
+    ctx->tx_handles[mb] = ctx->base.tx_handle;
+    if (HAL_CAN_AddTxMessage(&ctx->hcan, &hdr, (uint8_t *)msg->data, &mailbox) != HAL_OK)
+        return CAN_ERROR;
+    ctx->tx_pending |= (uint8_t)(1U << mb);
+    CAN_TRACE(BX_TX, mb, msg->id);
     return CAN_OK;
 }
 
-static CAN_Result_t bx_receive(ICANDriver *drv, CAN_Message_t *msg)
+static int bx_read(CAN_HandleTypeDef *hcan, uint8_t fifo, CAN_Message_t *msg)
 {
     CAN_RxHeaderTypeDef hdr;
+    if (HAL_CAN_GetRxMessage(hcan, fifo == CAN_RX_FIFO_FAST ? CAN_RX_FIFO1 : CAN_RX_FIFO0,
+                             &hdr, msg->data) != HAL_OK)
+        return 0;
+    msg->id       = hdr.IDE ? hdr.ExtId : hdr.StdId;
+    msg->extended = hdr.IDE ? 1 : 0;
+    msg->dlc      = hdr.DLC;
+    msg->fifo     = fifo;
+    return 1;
+}
+
+/* FIFO1 (fast lane) is always drained first */
+CAN_Result_t BxCAN_Receive(ICANDriver *drv, CAN_Message_t *msg)
+{
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
     if (!msg)
         return CAN_ERROR;
-    if (HAL_CAN_GetRxMessage(&ctx->hcan, 0, &hdr, msg->data) == HAL_OK) {
-        msg->id       = hdr.IDE ? hdr.ExtId : hdr.StdId;
-        msg->extended = hdr.IDE ? 1 : 0;
-        msg->dlc      = hdr.DLC;
-        CAN_Manager_TriggerEvent(ctx->base.inst_id,
-                                 CAN_EVENT_RX, msg);
-        return CAN_OK;
+    uint8_t fifo = CAN_RX_FIFO_FAST;
+    if (!HAL_CAN_GetRxFifoFillLevel(&ctx->hcan, CAN_RX_FIFO1)) {
+        if (!HAL_CAN_GetRxFifoFillLevel(&ctx->hcan, CAN_RX_FIFO0))
+            return CAN_ERROR;
+        fifo = CAN_RX_FIFO_MAIN;
     }
-    return CAN_ERROR;
+    if (!bx_read(&ctx->hcan, fifo, msg))
+        return CAN_ERROR;
+    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, msg);
+    return CAN_OK;
 }
 
-static CAN_Result_t bx_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask)
+static uint32_t bx_bank_base(const BxCAN_Context *ctx)
+{
+#ifdef CAN2
+    if (ctx->hcan.Instance == CAN2)
+        return BX_SLAVE_START_BANK;
+#else
+    (void)ctx;
+#endif
+    return 0;
+}
+
+/* On a match in several banks the lowest bank number wins, so the fast lane
+ * rules take the first CAN_RX_FAST_FILTERS banks of the instance and the
+ * general filter the bank after them. */
+static CAN_Result_t bx_config_bank(BxCAN_Context *ctx, uint32_t bank, uint32_t id,
+                                   uint32_t mask, uint8_t fifo)
 {
-    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
     CAN_FilterTypeDef f;
-    f.FilterBank = 0;
+    f.FilterBank = bx_bank_base(ctx) + bank;
     f.FilterMode = CAN_FILTERMODE_IDMASK;
     f.FilterScale = CAN_FILTERSCALE_32BIT;
     f.FilterIdHigh = id << 5;
-    f.FilterIdLow = 0;
+    f.FilterIdLow = CAN_ID_STD;
     f.FilterMaskIdHigh = mask << 5;
-    f.FilterMaskIdLow = 0;
-    f.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    f.FilterActivation = ENABLE;
-    f.SlaveStartFilterBank = 0;
-    HAL_CAN_ConfigFilter(&ctx->hcan, &f);
+    /* fast lane rules take standard IDs only; without IDE in the mask an
+     * extended ID whose top 11 bits equal the rule would match too */
+    f.FilterMaskIdLow = bank < CAN_RX_FAST_FILTERS ? CAN_ID_EXT : 0;
+    f.FilterFIFOAssignment = fifo == CAN_RX_FIFO_FAST ? CAN_FILTER_FIFO1 : CAN_FILTER_FIFO0;
+    f.FilterActivation = fifo == CAN_RX_FIFO_OFF ? DISABLE : ENABLE;
+    f.SlaveStartFilterBank = BX_SLAVE_START_BANK;
+    return HAL_CAN_ConfigFilter(&ctx->hcan, &f) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
+
+static CAN_Result_t bx_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask)
+{
+    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    bx_config_bank(ctx, CAN_RX_FAST_FILTERS, id, mask, CAN_RX_FIFO_MAIN);
     return CAN_OK;
 }
 
-static CAN_Result_t bx_set_mode(ICANDriver *drv, CAN_Mode_t mode)
+static CAN_Result_t bx_set_fifo_filter(ICANDriver *drv, uint8_t index, uint32_t id,
+                                       uint32_t mask, uint8_t fifo)
 {
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
-    uint32_t hal_mode = CAN_MODE_NORMAL;
+    if (index >= CAN_RX_FAST_FILTERS)
+        return CAN_ERROR;
+    return bx_config_bank(ctx, index, id, mask, fifo);
+}
+
+static uint32_t bx_hal_mode(CAN_Mode_t mode)
+{
     switch (mode) {
-    case CAN_MODE_LOOPBACK:
-        hal_mode = CAN_MODE_LOOPBACK;
-        break;
-    case CAN_MODE_SILENT:
-    case CAN_MODE_AUTOBAUD:
-        hal_mode = CAN_MODE_SILENT;
-        break;
-    case CAN_MODE_NORMAL:
+    case CAN_OPMODE_LOOPBACK:
+        return CAN_MODE_LOOPBACK;
+    case CAN_OPMODE_SILENT:
+    case CAN_OPMODE_AUTOBAUD:
+        return CAN_MODE_SILENT;
+    case CAN_OPMODE_NORMAL:
     default:
-        hal_mode = CAN_MODE_NORMAL;
-        break;
+        return CAN_MODE_NORMAL;
     }
+}
+
+/* The filter banks have their own init mode (FMR.FINIT), so filters change
+ * live; only bitrate and mode (BTR) need the controller in init mode. */
+static CAN_Result_t bx_reconfigure(ICANDriver *drv, const CAN_Reconfig_t *rc,
+                                   uint32_t *offline_us)
+{
+    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    CAN_InitTypeDef old = ctx->hcan.Init;
+    CAN_Result_t res = CAN_OK;
+    if (offline_us)
+        *offline_us = 0;
+    if (rc->set & CAN_RECONF_FAST) {
+        for (uint8_t i = 0; i < CAN_RX_FAST_FILTERS; ++i) {
+            if ((rc->fast_set & (1U << i)) &&
+                bx_config_bank(ctx, i, rc->fast[i].id, rc->fast[i].mask, rc->fast[i].fifo) != CAN_OK)
+                res = CAN_ERROR;
+        }
+    }
+    if ((rc->set & CAN_RECONF_FILTER) &&
+        bx_config_bank(ctx, CAN_RX_FAST_FILTERS, rc->filter_id, rc->filter_mask,
+                       CAN_RX_FIFO_MAIN) != CAN_OK)
+        res = CAN_ERROR;
+    if (rc->set & CAN_RECONF_BITRATE)
+        bx_config_bitrate(ctx, rc->bitrate);
+    if (rc->set & CAN_RECONF_MODE)
+        ctx->hcan.Init.Mode = bx_hal_mode(rc->mode);
+    if (memcmp(&old, &ctx->hcan.Init, sizeof(old)) == 0)
+        return res;
+
+    uint32_t t0 = can_os_now_us();
+    bx_abort_tx(ctx);
     HAL_CAN_Stop(&ctx->hcan);
-    ctx->hcan.Init.Mode = hal_mode;
     HAL_CAN_Init(&ctx->hcan);
-    return HAL_CAN_Start(&ctx->hcan) == HAL_OK ? CAN_OK : CAN_ERROR;
+    if (HAL_CAN_Start(&ctx->hcan) != HAL_OK)
+        res = CAN_ERROR;
+    if (offline_us) {
+        uint32_t t = can_os_now_us() - t0;
+        *offline_us = t ? t : 1U;
+    }
+    return res;
+}
+
+static CAN_Result_t bx_set_mode(ICANDriver *drv, CAN_Mode_t mode)
+{
+    CAN_Reconfig_t rc = { .set = CAN_RECONF_MODE, .mode = mode };
+    return bx_reconfigure(drv, &rc, NULL);
 }
 
+/* Timing fields only; HAL_CAN_Init applies them */
 static void bx_config_bitrate(BxCAN_Context *ctx, uint32_t bitrate)
 {
     const uint32_t pclk = 36000000U; /* simulated peripheral clock */
@@ -135,7 +239,6 @@ static void bx_config_bitrate(BxCAN_Context *ctx, uint32_t bitrate)
     ctx->hcan.Init.AutoRetransmission  = DISABLE;
     ctx->hcan.Init.ReceiveFifoLocked   = DISABLE;
     ctx->hcan.Init.TransmitFifoPriority = DISABLE;
-    HAL_CAN_Init(&ctx->hcan);
 }
 
 static uint32_t bx_get_error(ICANDriver *drv)
@@ -144,6 +247,27 @@ static uint32_t bx_get_error(ICANDriver *drv)
     return HAL_CAN_GetError(&ctx->hcan);
 }
 
+static CAN_Result_t bx_get_bus_status(ICANDriver *drv, CAN_BusStatus_t *st)
+{
+    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    uint32_t esr = ctx->hcan.Instance->ESR;
+    st->tec = (uint16_t)((esr >> CAN_ESR_TEC_Pos) & 0xFFU);
+    st->rec = (uint16_t)((esr >> CAN_ESR_REC_Pos) & 0xFFU);
+    st->bus_off = (esr & CAN_ESR_BOFF) ? 1 : 0;
+    return CAN_OK;
+}
+
+/* AutoBusOff is left disabled so the manager decides when to rejoin: passing
+ * through initialisation mode restarts the 128 x 11 recessive bit sequence. */
+static CAN_Result_t bx_recover(ICANDriver *drv)
+{
+    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    bx_abort_tx(ctx);
+    HAL_CAN_Stop(&ctx->hcan);
+    HAL_CAN_ResetError(&ctx->hcan);
+    return HAL_CAN_Start(&ctx->hcan) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
+
 static CAN_Result_t bx_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t num)
 {
     if (!drv || !rates || num == 0)
@@ -152,6 +276,7 @@ static CAN_Result_t bx_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
     CAN_Message_t msg;
 
+    bx_abort_tx(ctx);
     for (uint8_t i = 0; i < num; ++i) {
         uint32_t br = rates[i];
         if (br == 0)
@@ -160,15 +285,17 @@ static CAN_Result_t bx_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
         HAL_CAN_Stop(&ctx->hcan);
         ctx->hcan.Init.Mode = CAN_MODE_SILENT;
         bx_config_bitrate(ctx, br);
+        HAL_CAN_Init(&ctx->hcan);
         HAL_CAN_Start(&ctx->hcan);
-        printf("bxCAN autobaud try %lu\n", (unsigned long)br);
+        CAN_TRACE(BX_AUTOBAUD_TRY, br, 0);
 
         for (int attempt = 0; attempt < 100; ++attempt) {
-            if (bx_receive(drv, &msg) == CAN_OK) {
-                printf("bxCAN autobaud detected %lu\n", (unsigned long)br);
+            if (BxCAN_Receive(drv, &msg) == CAN_OK) {
+                CAN_TRACE(BX_AUTOBAUD_FOUND, br, 0);
                 HAL_CAN_Stop(&ctx->hcan);
                 ctx->hcan.Init.Mode = CAN_MODE_NORMAL;
                 bx_config_bitrate(ctx, br);
+                HAL_CAN_Init(&ctx->hcan);
                 HAL_CAN_Start(&ctx->hcan);
                 return CAN_OK;
             }
@@ -181,10 +308,14 @@ static CAN_Result_t bx_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
 static void bx_enable_interrupts(ICANDriver *drv)
 {
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    ctx->irq_on = 1;
     HAL_CAN_ActivateNotification(&ctx->hcan,
                                  CAN_IT_RX_FIFO0_MSG_PENDING |
+                                 CAN_IT_RX_FIFO1_MSG_PENDING |
+                                 CAN_IT_RX_FIFO0_OVERRUN | CAN_IT_RX_FIFO1_OVERRUN |
                                  CAN_IT_TX_MAILBOX_EMPTY |
-                                 CAN_IT_ERROR);
+                                 CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE |
+                                 CAN_IT_BUSOFF | CAN_IT_ERROR);
 }
 
 static void bx_disable_interrupts(ICANDriver *drv)
@@ -192,52 +323,143 @@ static void bx_disable_interrupts(ICANDriver *drv)
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
     HAL_CAN_DeactivateNotification(&ctx->hcan,
                                    CAN_IT_RX_FIFO0_MSG_PENDING |
+                                   CAN_IT_RX_FIFO1_MSG_PENDING |
+                                   CAN_IT_RX_FIFO0_FULL | CAN_IT_RX_FIFO1_FULL |
+                                   CAN_IT_RX_FIFO0_OVERRUN | CAN_IT_RX_FIFO1_OVERRUN |
                                    CAN_IT_TX_MAILBOX_EMPTY |
-                                   CAN_IT_ERROR);
+                                   CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE |
+                                   CAN_IT_BUSOFF | CAN_IT_ERROR);
+    ctx->irq_on = 0;
+}
+
+/* Polled TX completion: a mailbox that is empty again has finished, TXOK
+ * tells how. Only reads TSR, the next request clears its flags. */
+static void bx_service(ICANDriver *drv)
+{
+    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    if (ctx->irq_on || !ctx->tx_pending)
+        return;
+    uint32_t tsr = ctx->hcan.Instance->TSR;
+    for (uint32_t mb = 0; mb < 3U; ++mb) {
+        if (!(ctx->tx_pending & (1U << mb)) || !(tsr & (CAN_TSR_TME0 << mb)))
+            continue;
+        ctx->tx_pending &= (uint8_t)~(1U << mb);
+        CAN_Manager_TxDone(ctx->base.inst_id, ctx->tx_handles[mb],
+                           (tsr & (CAN_TSR_TXOK0 << (8U * mb))) ? 1 : 0);
+    }
+}
+
+/* The FIFOs are only 3 deep, so "full" is the nearest thing to a watermark */
+static void bx_rx_irq_mask(ICANDriver *drv, uint8_t masked)
+{
+    BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
+    const uint32_t each = CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING;
+    const uint32_t full = CAN_IT_RX_FIFO0_FULL | CAN_IT_RX_FIFO1_FULL;
+    HAL_CAN_DeactivateNotification(&ctx->hcan, masked ? each : full);
+    HAL_CAN_ActivateNotification(&ctx->hcan, masked ? full : each);
 }
 
-static void bx_irq_handler(ICANDriver *drv)
+void BxCAN_IrqHandler(ICANDriver *drv)
 {
     BxCAN_Context *ctx = (BxCAN_Context *)drv->ctx;
     HAL_CAN_IRQHandler(&ctx->hcan);
 }
 
-void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
+/* Drain `fifo` unless the manager has switched the instance to polling */
+static void bx_rx_irq(CAN_HandleTypeDef *hcan, uint8_t fifo)
 {
     BxCAN_Context *ctx = GET_CTX(hcan);
-    CAN_RxHeaderTypeDef hdr;
+    uint32_t hal_fifo = fifo == CAN_RX_FIFO_FAST ? CAN_RX_FIFO1 : CAN_RX_FIFO0;
     CAN_Message_t msg;
-    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &hdr, msg.data) == HAL_OK) {
-        msg.id = hdr.IDE ? hdr.ExtId : hdr.StdId;
-        msg.extended = hdr.IDE ? 1 : 0;
-        msg.dlc = hdr.DLC;
+    if (!CAN_Manager_RxIrq(ctx->base.inst_id))
+        return;
+    while (HAL_CAN_GetRxFifoFillLevel(hcan, hal_fifo) && bx_read(hcan, fifo, &msg))
         CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, &msg);
-    }
 }
 
-void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan)
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
+{
+    bx_rx_irq(hcan, CAN_RX_FIFO_MAIN);
+}
+
+/* FIFO1 has its own interrupt vector (CANx_RX1_IRQn). HAL_CAN_IRQHandler
+ * services every source on either vector, so RX0 and RX1 (and TX, SCE) must
+ * share one preemption priority: a nested handler would write the same
+ * queues and driver state as the one it interrupted. */
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan)
+{
+    bx_rx_irq(hcan, CAN_RX_FIFO_FAST);
+}
+
+/* Only enabled while moderated: a full FIFO stands in for a watermark */
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan)
+{
+    bx_rx_irq(hcan, CAN_RX_FIFO_MAIN);
+}
+
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan)
+{
+    bx_rx_irq(hcan, CAN_RX_FIFO_FAST);
+}
+
+static void bx_tx_done(CAN_HandleTypeDef *hcan, uint32_t mb, uint8_t ok)
 {
     BxCAN_Context *ctx = GET_CTX(hcan);
-    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_TX_COMPLETE, NULL);
+    CAN_Manager_TxDone(ctx->base.inst_id, ctx->tx_handles[mb], ok);
 }
 
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) { bx_tx_done(hcan, 0, 1); }
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) { bx_tx_done(hcan, 1, 1); }
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) { bx_tx_done(hcan, 2, 1); }
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan)    { bx_tx_done(hcan, 0, 0); }
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan)    { bx_tx_done(hcan, 1, 0); }
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan)    { bx_tx_done(hcan, 2, 0); }
+
 void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
 {
     BxCAN_Context *ctx = GET_CTX(hcan);
+    uint32_t err = HAL_CAN_GetError(hcan);
+    /* Without automatic retransmission a lost arbitration or TX error ends
+     * the frame in that mailbox. The HAL keeps these bits too: clear each
+     * one once reported, or a later error on another mailbox would fail the
+     * frame that mailbox 0 is sending now. */
+    for (uint32_t mb = 0; mb < 3U; ++mb) {
+        uint32_t bits = (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_TERR0) << (2U * mb);
+        if (err & bits) {
+            hcan->ErrorCode &= ~bits;
+            bx_tx_done(hcan, mb, 0);
+        }
+    }
+    /* FIFO overruns are counted, not treated as bus errors; the HAL keeps
+     * error bits until reset, so clear these to count each one once */
+    if (err & HAL_CAN_ERROR_RX_FOV0)
+        CAN_Manager_RxOverrun(ctx->base.inst_id, CAN_RX_FIFO_MAIN);
+    if (err & HAL_CAN_ERROR_RX_FOV1)
+        CAN_Manager_RxOverrun(ctx->base.inst_id, CAN_RX_FIFO_FAST);
+    hcan->ErrorCode &= ~(HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1);
+    if (!(err & ~(HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1)))
+        return;
+    CAN_TRACE(BX_ERROR, ctx->base.inst_id, err);
     CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_ERROR, NULL);
 }
 
 static ICANDriver bx_template = {
     .init            = bx_init,
-    .send            = bx_send,
-    .receive         = bx_receive,
+    .send            = BxCAN_Send,
+    .receive         = BxCAN_Receive,
     .set_filter      = bx_set_filter,
     .set_mode        = bx_set_mode,
     .get_error_state = bx_get_error,
     .auto_baud_detect = bx_autobaud,
     .enable_interrupts = bx_enable_interrupts,
     .disable_interrupts = bx_disable_interrupts,
-    .irq_handler     = bx_irq_handler,
+    .irq_handler     = BxCAN_IrqHandler,
+    .get_bus_status  = bx_get_bus_status,
+    .recover         = bx_recover,
+    .set_fifo_filter = bx_set_fifo_filter,
+    .rx_irq_mask     = bx_rx_irq_mask,
+    .reconfigure     = bx_reconfigure,
+    .service         = bx_service,
     .ctx             = NULL
 };
 
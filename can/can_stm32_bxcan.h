@@ -21,8 +21,16 @@ typedef struct {
     CAN_DriverContext_t base;
     CAN_HandleTypeDef   hcan;
     ICANDriver         *driver;
+    uint32_t            tx_handles[3];  /* frame in each TX mailbox */
+    uint8_t             tx_pending;     /* mailboxes to check when polled */
+    uint8_t             irq_on;
 } BxCAN_Context;
 
 void BxCAN_SetupDriver(ICANDriver *driver, BxCAN_Context *ctx, CAN_TypeDef *inst);
 
+/* Hot-path entry points, called directly under CAN_STATIC_CONFIG */
+CAN_Result_t BxCAN_Send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout);
+CAN_Result_t BxCAN_Receive(ICANDriver *drv, CAN_Message_t *msg);
+void         BxCAN_IrqHandler(ICANDriver *drv);
+
 #endif /* CAN_STM32_BXCAN_H */
@@ -1,20 +1,17 @@
 #include "can_stm32_fdcan.h"
 #include "can_manager.h"
-#include <stdio.h>
+#include "can_trace.h"
 #include <stddef.h>
+#include <string.h>
 
 #define GET_CTX(h) ((FDCAN_Context *)((char *)(h) - offsetof(FDCAN_Context, hfdcan)))
 
 /* Simple FDCAN driver based on STM32 HAL */
 
-typedef struct {
-    CAN_DriverContext_t base;
-    FDCAN_HandleTypeDef hfdcan;
-    ICANDriver         *driver;
-} FDCAN_Context;
-
 static CAN_Result_t fd_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask);
-static CAN_Result_t fd_set_mode(ICANDriver *drv, CAN_Mode_t mode);
+static CAN_Result_t fd_set_fifo_filter(ICANDriver *drv, uint8_t index, uint32_t id,
+                                       uint32_t mask, uint8_t fifo);
+static uint32_t     fd_hal_mode(CAN_Mode_t mode);
 static void         fd_config_bitrate(FDCAN_Context *ctx, uint32_t bitrate);
 
 static CAN_Result_t fd_init(ICANDriver *drv, const CAN_Config_t *cfg)
@@ -23,22 +20,54 @@ static CAN_Result_t fd_init(ICANDriver *drv, const CAN_Config_t *cfg)
     if (!ctx)
         return CAN_ERROR;
 
+    /* A planned layout already covers everything below. Unplanned handles
+     * all start at MessageRAMOffset as given, so two of them overlap unless
+     * the caller laid the RAM out by hand. */
+    if (!ctx->ram_planned) {
+        /* Completions are read back from the TX event FIFO */
+        ctx->hfdcan.Init.TxEventsNbr = FDCAN_TX_BUFFERS;
+        /* Room for the fast lane rules and a FIFO1 to steer them into */
+        if (ctx->hfdcan.Init.StdFiltersNbr < CAN_RX_FAST_FILTERS)
+            ctx->hfdcan.Init.StdFiltersNbr = CAN_RX_FAST_FILTERS;
+        if (ctx->hfdcan.Init.RxFifo1ElmtsNbr == 0) {
+            ctx->hfdcan.Init.RxFifo1ElmtsNbr = 8;
+            ctx->hfdcan.Init.RxFifo1ElmtSize = FDCAN_DATA_BYTES_8;
+        }
+        /* A zeroed handle allocates no message RAM at all: give it a FIFO0, a
+         * TX FIFO and the extended element fd_set_filter programs */
+        if (ctx->hfdcan.Init.RxFifo0ElmtsNbr == 0) {
+            ctx->hfdcan.Init.RxFifo0ElmtsNbr = 16;
+            ctx->hfdcan.Init.RxFifo0ElmtSize = FDCAN_DATA_BYTES_8;
+        }
+        if (ctx->hfdcan.Init.TxFifoQueueElmtsNbr == 0) {
+            ctx->hfdcan.Init.TxFifoQueueElmtsNbr = FDCAN_TX_BUFFERS;
+            ctx->hfdcan.Init.TxElmtSize = FDCAN_DATA_BYTES_8;
+        }
+        if (ctx->hfdcan.Init.ExtFiltersNbr == 0)
+            ctx->hfdcan.Init.ExtFiltersNbr = 1;
+    }
+    /* One HAL_FDCAN_Init with bitrate and mode, filters into the fresh
+     * message RAM, one start */
     fd_config_bitrate(ctx, cfg ? cfg->bitrate : 500000);
-    if (HAL_FDCAN_Start(&ctx->hfdcan) != HAL_OK)
+    ctx->hfdcan.Init.Mode = fd_hal_mode(cfg ? cfg->mode : CAN_OPMODE_NORMAL);
+    ctx->filter_set = 0;
+    ctx->fast_rules = 0;
+    ctx->irq_on = 0;
+    if (HAL_FDCAN_Init(&ctx->hfdcan) != HAL_OK)
         return CAN_ERROR;
-
-    if (cfg) {
+    /* Only interrupts while RX is moderated; can only be set in READY state
+     * and survives later re-inits */
+    if (ctx->rx_watermark == 0)
+        ctx->rx_watermark = (uint8_t)(ctx->hfdcan.Init.RxFifo0ElmtsNbr * 3U / 4U);
+    HAL_FDCAN_ConfigFifoWatermark(&ctx->hfdcan, FDCAN_CFG_RX_FIFO0, ctx->rx_watermark);
+    if (cfg)
         fd_set_filter(drv, cfg->filter_id, cfg->filter_mask);
-        fd_set_mode(drv, cfg->mode);
-    }
-    return CAN_OK;
+    return HAL_FDCAN_Start(&ctx->hfdcan) == HAL_OK ? CAN_OK : CAN_ERROR;
 }
 
-static CAN_Result_t fd_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
+static inline FDCAN_TxHeaderTypeDef fd_tx_header(const CAN_Message_t *msg, uint32_t events,
+                                                 uint32_t marker)
 {
-    (void)timeout;
-    if (!msg)
-        return CAN_ERROR;
     FDCAN_TxHeaderTypeDef hdr = {
         .Identifier = msg->id,
         .IdType = msg->extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID,
@@ -47,35 +76,76 @@ static CAN_Result_t fd_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t
         .ErrorStateIndicator = FDCAN_ESI_ACTIVE,
         .BitRateSwitch = FDCAN_BRS_OFF,
         .FDFormat = FDCAN_CLASSIC_CAN,
-        .TxEventFifoControl = FDCAN_NO_TX_EVENTS,
-        .MessageMarker = 0
+        .TxEventFifoControl = events,
+        .MessageMarker = marker
     };
+    return hdr;
+}
+
+/* TX buffers of the FIFO/queue; the dedicated buffers come first */
+static uint32_t fd_fifo_buffers(const FDCAN_Context *ctx)
+{
+    uint32_t n = ctx->hfdcan.Init.TxFifoQueueElmtsNbr;
+    return (n >= 32U ? 0xFFFFFFFFU : (1U << n) - 1U) << ctx->hfdcan.Init.TxBuffersNbr;
+}
+
+/* Ahead of a restart: the manager fails the frames still queued, so make
+ * sure they do not go out afterwards. Dedicated TX buffers are left alone. */
+static void fd_abort_tx(FDCAN_Context *ctx)
+{
+    HAL_FDCAN_AbortTxRequest(&ctx->hfdcan, fd_fifo_buffers(ctx));
+}
+
+CAN_Result_t FDCAN_Send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
+{
+    (void)timeout;
+    if (!msg)
+        return CAN_ERROR;
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
-    if (HAL_FDCAN_AddMessageToTxFifoQ(&ctx->hfdcan, &hdr, msg->data) != HAL_OK)
+    /* The put index is the buffer this frame will occupy; it doubles as the
+     * marker echoed in its TX event. */
+    uint32_t idx = (ctx->hfdcan.Instance->TXFQS >> 16) & (FDCAN_TX_BUFFERS - 1U);
+    FDCAN_TxHeaderTypeDef hdr = fd_tx_header(msg, FDCAN_STORE_TX_EVENTS, idx);
+    ctx->tx_handles[idx] = ctx->base.tx_handle;
+    if (HAL_FDCAN_AddMessageToTxFifoQ(&ctx->hfdcan, &hdr, (uint8_t *)msg->data) != HAL_OK)
         return CAN_ERROR;
-    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_TX_COMPLETE, (void *)msg);
+    CAN_TRACE(FD_TX, idx, msg->id);
     return CAN_OK;
 }
 
-static CAN_Result_t fd_receive(ICANDriver *drv, CAN_Message_t *msg)
+static int fd_read(FDCAN_HandleTypeDef *hfdcan, uint8_t fifo, CAN_Message_t *msg)
 {
     FDCAN_RxHeaderTypeDef hdr;
+    if (HAL_FDCAN_GetRxMessage(hfdcan, fifo == CAN_RX_FIFO_FAST ? FDCAN_RX_FIFO1 : FDCAN_RX_FIFO0,
+                               &hdr, msg->data) != HAL_OK)
+        return 0;
+    msg->id = hdr.Identifier;
+    msg->extended = (hdr.IdType == FDCAN_EXTENDED_ID) ? 1 : 0;
+    msg->dlc = hdr.DataLength >> 16;
+    msg->fifo = fifo;
+    return 1;
+}
+
+/* FIFO1 (fast lane) is always drained first */
+CAN_Result_t FDCAN_Receive(ICANDriver *drv, CAN_Message_t *msg)
+{
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
     if (!msg)
         return CAN_ERROR;
-    if (HAL_FDCAN_GetRxMessage(&ctx->hfdcan, FDCAN_RX_FIFO0, &hdr, msg->data) == HAL_OK) {
-        msg->id = hdr.Identifier;
-        msg->extended = (hdr.IdType == FDCAN_EXTENDED_ID) ? 1 : 0;
-        msg->dlc = hdr.DataLength >> 16;
-        CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, msg);
-        return CAN_OK;
+    uint8_t fifo = CAN_RX_FIFO_FAST;
+    if (!HAL_FDCAN_GetRxFifoFillLevel(&ctx->hfdcan, FDCAN_RX_FIFO1)) {
+        if (!HAL_FDCAN_GetRxFifoFillLevel(&ctx->hfdcan, FDCAN_RX_FIFO0))
+            return CAN_ERROR;
+        fifo = CAN_RX_FIFO_MAIN;
     }
-    return CAN_ERROR;
+    if (!fd_read(&ctx->hfdcan, fifo, msg))
+        return CAN_ERROR;
+    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, msg);
+    return CAN_OK;
 }
 
-static CAN_Result_t fd_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask)
+static CAN_Result_t fd_write_filter(FDCAN_Context *ctx, uint32_t id, uint32_t mask)
 {
-    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
     FDCAN_FilterTypeDef f = {
         .IdType = FDCAN_EXTENDED_ID,
         .FilterIndex = 0,
@@ -84,33 +154,134 @@ static CAN_Result_t fd_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask)
         .FilterID1 = id,
         .FilterID2 = mask
     };
-    HAL_FDCAN_ConfigFilter(&ctx->hfdcan, &f);
-    return CAN_OK;
+    return HAL_FDCAN_ConfigFilter(&ctx->hfdcan, &f) == HAL_OK ? CAN_OK : CAN_ERROR;
 }
 
-static CAN_Result_t fd_set_mode(ICANDriver *drv, CAN_Mode_t mode)
+/* Standard ID filters are checked in index order and the first match wins;
+ * the fast lane rules own indices 0..CAN_RX_FAST_FILTERS-1. */
+static CAN_Result_t fd_write_rule(FDCAN_Context *ctx, uint8_t index, uint32_t id,
+                                  uint32_t mask, uint8_t fifo)
+{
+    FDCAN_FilterTypeDef f = {
+        .IdType = FDCAN_STANDARD_ID,
+        .FilterIndex = index,
+        .FilterType = FDCAN_FILTER_MASK,
+        .FilterConfig = fifo == CAN_RX_FIFO_OFF  ? FDCAN_FILTER_DISABLE :
+                        fifo == CAN_RX_FIFO_FAST ? FDCAN_FILTER_TO_RXFIFO1 :
+                                                   FDCAN_FILTER_TO_RXFIFO0,
+        .FilterID1 = id,
+        .FilterID2 = mask
+    };
+    return HAL_FDCAN_ConfigFilter(&ctx->hfdcan, &f) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
+
+/* Writes the filter RAM back after a HAL_FDCAN_Init */
+static CAN_Result_t fd_restore_filters(FDCAN_Context *ctx)
+{
+    CAN_Result_t res = CAN_OK;
+    if (ctx->filter_set && fd_write_filter(ctx, ctx->filter_id, ctx->filter_mask) != CAN_OK)
+        res = CAN_ERROR;
+    for (uint8_t i = 0; i < CAN_RX_FAST_FILTERS; ++i) {
+        const CAN_FifoRule_t *r = &ctx->fast[i];
+        if ((ctx->fast_rules & (1U << i)) && fd_write_rule(ctx, i, r->id, r->mask, r->fifo) != CAN_OK)
+            res = CAN_ERROR;
+    }
+    return res;
+}
+
+static CAN_Result_t fd_set_filter(ICANDriver *drv, uint32_t id, uint32_t mask)
 {
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
-    uint32_t opmode = FDCAN_OPERATION_MODE_NORMAL;
+    ctx->filter_id = id;
+    ctx->filter_mask = mask;
+    ctx->filter_set = 1;
+    return fd_write_filter(ctx, id, mask);
+}
+
+static CAN_Result_t fd_set_fifo_filter(ICANDriver *drv, uint8_t index, uint32_t id,
+                                       uint32_t mask, uint8_t fifo)
+{
+    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    if (index >= CAN_RX_FAST_FILTERS)
+        return CAN_ERROR;
+    ctx->fast[index] = (CAN_FifoRule_t){ id, mask, fifo };
+    ctx->fast_rules |= (uint8_t)(1U << index);
+    return fd_write_rule(ctx, index, id, mask, fifo);
+}
+
+static uint32_t fd_hal_mode(CAN_Mode_t mode)
+{
     switch (mode) {
-    case CAN_MODE_LOOPBACK:
-        opmode = FDCAN_OPERATION_MODE_INTERNAL_LOOPBACK;
-        break;
-    case CAN_MODE_SILENT:
-    case CAN_MODE_AUTOBAUD:
-        opmode = FDCAN_OPERATION_MODE_BUS_MONITORING;
-        break;
-    case CAN_MODE_NORMAL:
+    case CAN_OPMODE_LOOPBACK:
+        return FDCAN_MODE_INTERNAL_LOOPBACK;
+    case CAN_OPMODE_SILENT:
+    case CAN_OPMODE_AUTOBAUD:
+        return FDCAN_MODE_BUS_MONITORING;
+    case CAN_OPMODE_NORMAL:
     default:
-        opmode = FDCAN_OPERATION_MODE_NORMAL;
-        break;
+        return FDCAN_MODE_NORMAL;
     }
+}
+
+/* Filter elements live in message RAM and can be rewritten while the
+ * controller runs. Bitrate and mode need HAL_FDCAN_Init, which also flushes
+ * the filter RAM, so a restart writes all filters back before the start. */
+static CAN_Result_t fd_reconfigure(ICANDriver *drv, const CAN_Reconfig_t *rc,
+                                   uint32_t *offline_us)
+{
+    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    FDCAN_InitTypeDef old = ctx->hfdcan.Init;
+    CAN_Result_t res = CAN_OK;
+    if (offline_us)
+        *offline_us = 0;
+    if (rc->set & CAN_RECONF_BITRATE)
+        fd_config_bitrate(ctx, rc->bitrate);
+    if (rc->set & CAN_RECONF_MODE)
+        ctx->hfdcan.Init.Mode = fd_hal_mode(rc->mode);
+    uint8_t restart = memcmp(&old, &ctx->hfdcan.Init, sizeof(old)) != 0;
+
+    if (rc->set & CAN_RECONF_FAST) {
+        for (uint8_t i = 0; i < CAN_RX_FAST_FILTERS; ++i) {
+            if (!(rc->fast_set & (1U << i)))
+                continue;
+            ctx->fast[i] = rc->fast[i];
+            ctx->fast_rules |= (uint8_t)(1U << i);
+            if (!restart && fd_write_rule(ctx, i, rc->fast[i].id, rc->fast[i].mask,
+                                          rc->fast[i].fifo) != CAN_OK)
+                res = CAN_ERROR;
+        }
+    }
+    if (rc->set & CAN_RECONF_FILTER) {
+        ctx->filter_id = rc->filter_id;
+        ctx->filter_mask = rc->filter_mask;
+        ctx->filter_set = 1;
+        if (!restart && fd_write_filter(ctx, rc->filter_id, rc->filter_mask) != CAN_OK)
+            res = CAN_ERROR;
+    }
+    if (!restart)
+        return res;
+
+    uint32_t t0 = can_os_now_us();
+    fd_abort_tx(ctx);
     HAL_FDCAN_Stop(&ctx->hfdcan);
-    ctx->hfdcan.Init.Mode = opmode;
-    HAL_FDCAN_Init(&ctx->hfdcan);
-    return HAL_FDCAN_Start(&ctx->hfdcan) == HAL_OK ? CAN_OK : CAN_ERROR;
+    if (HAL_FDCAN_Init(&ctx->hfdcan) != HAL_OK || fd_restore_filters(ctx) != CAN_OK)
+        res = CAN_ERROR;
+    if (HAL_FDCAN_Start(&ctx->hfdcan) != HAL_OK)
+        res = CAN_ERROR;
+    if (offline_us) {
+        uint32_t t = can_os_now_us() - t0;
+        *offline_us = t ? t : 1U;
+    }
+    return res;
 }
 
+static CAN_Result_t fd_set_mode(ICANDriver *drv, CAN_Mode_t mode)
+{
+    CAN_Reconfig_t rc = { .set = CAN_RECONF_MODE, .mode = mode };
+    return fd_reconfigure(drv, &rc, NULL);
+}
+
+/* Timing fields only; HAL_FDCAN_Init applies them */
 static void fd_config_bitrate(FDCAN_Context *ctx, uint32_t bitrate)
 {
     const uint32_t pclk = 48000000U;
@@ -119,7 +290,6 @@ static void fd_config_bitrate(FDCAN_Context *ctx, uint32_t bitrate)
     ctx->hfdcan.Init.NominalSyncJumpWidth = 1;
     ctx->hfdcan.Init.NominalTimeSeg1 = 13;
     ctx->hfdcan.Init.NominalTimeSeg2 = 2;
-    HAL_FDCAN_Init(&ctx->hfdcan);
 }
 
 static uint32_t fd_get_error(ICANDriver *drv)
@@ -128,6 +298,31 @@ static uint32_t fd_get_error(ICANDriver *drv)
     return HAL_FDCAN_GetError(&ctx->hfdcan);
 }
 
+static CAN_Result_t fd_get_bus_status(ICANDriver *drv, CAN_BusStatus_t *st)
+{
+    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    FDCAN_ErrorCountersTypeDef cnt;
+    FDCAN_ProtocolStatusTypeDef ps;
+    if (HAL_FDCAN_GetErrorCounters(&ctx->hfdcan, &cnt) != HAL_OK ||
+        HAL_FDCAN_GetProtocolStatus(&ctx->hfdcan, &ps) != HAL_OK)
+        return CAN_ERROR;
+    st->tec = (uint16_t)cnt.TxErrorCnt;
+    /* REC saturates at 127 in the register; RP flags passive */
+    st->rec = (uint16_t)(cnt.RxErrorPassive ? 128U : cnt.RxErrorCnt);
+    st->bus_off = ps.BusOff ? 1 : 0;
+    return CAN_OK;
+}
+
+/* Bus-off sets CCCR.INIT; restarting clears it and the controller rejoins
+ * after 128 x 11 recessive bits. */
+static CAN_Result_t fd_recover(ICANDriver *drv)
+{
+    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    fd_abort_tx(ctx);
+    HAL_FDCAN_Stop(&ctx->hfdcan);
+    return HAL_FDCAN_Start(&ctx->hfdcan) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
+
 static CAN_Result_t fd_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t num)
 {
     if (!drv || !rates || num == 0)
@@ -136,23 +331,28 @@ static CAN_Result_t fd_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
     CAN_Message_t msg;
 
+    fd_abort_tx(ctx);
     for (uint8_t i = 0; i < num; ++i) {
         uint32_t br = rates[i];
         if (br == 0)
             continue;
 
         HAL_FDCAN_Stop(&ctx->hfdcan);
-        ctx->hfdcan.Init.Mode = FDCAN_OPERATION_MODE_BUS_MONITORING;
+        ctx->hfdcan.Init.Mode = FDCAN_MODE_BUS_MONITORING;
         fd_config_bitrate(ctx, br);
+        HAL_FDCAN_Init(&ctx->hfdcan);
+        fd_restore_filters(ctx);
         HAL_FDCAN_Start(&ctx->hfdcan);
-        printf("FDCAN autobaud try %lu\n", (unsigned long)br);
+        CAN_TRACE(FD_AUTOBAUD_TRY, br, 0);
 
         for (int attempt = 0; attempt < 100; ++attempt) {
-            if (fd_receive(drv, &msg) == CAN_OK) {
-                printf("FDCAN autobaud detected %lu\n", (unsigned long)br);
+            if (FDCAN_Receive(drv, &msg) == CAN_OK) {
+                CAN_TRACE(FD_AUTOBAUD_FOUND, br, 0);
                 HAL_FDCAN_Stop(&ctx->hfdcan);
-                ctx->hfdcan.Init.Mode = FDCAN_OPERATION_MODE_NORMAL;
+                ctx->hfdcan.Init.Mode = FDCAN_MODE_NORMAL;
                 fd_config_bitrate(ctx, br);
+                HAL_FDCAN_Init(&ctx->hfdcan);
+                fd_restore_filters(ctx);
                 HAL_FDCAN_Start(&ctx->hfdcan);
                 return CAN_OK;
             }
@@ -165,10 +365,21 @@ static CAN_Result_t fd_autobaud(ICANDriver *drv, const uint32_t *rates, uint8_t
 static void fd_enable_interrupts(ICANDriver *drv)
 {
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    ctx->irq_on = 1;
+    /* Every source stays on line 0. HAL_FDCAN_IRQHandler services all of
+     * them whichever line fired, so if a board routes some to line 1, both
+     * FDCANx_IT0/IT1_IRQn must run at the same preemption priority. */
     HAL_FDCAN_ActivateNotification(&ctx->hfdcan,
                                    FDCAN_IT_RX_FIFO0_NEW_MESSAGE |
-                                   FDCAN_IT_TX_FIFO_EMPTY |
-                                   FDCAN_IT_ERROR_WARNING);
+                                   FDCAN_IT_RX_FIFO1_NEW_MESSAGE |
+                                   FDCAN_IT_RX_FIFO0_MESSAGE_LOST |
+                                   FDCAN_IT_RX_FIFO1_MESSAGE_LOST |
+                                   FDCAN_IT_TX_EVT_FIFO_NEW_DATA |
+                                   FDCAN_IT_TX_ABORT_COMPLETE |
+                                   FDCAN_IT_ERROR_WARNING |
+                                   FDCAN_IT_ERROR_PASSIVE |
+                                   FDCAN_IT_BUS_OFF,
+                                   fd_fifo_buffers(ctx));
 }
 
 static void fd_disable_interrupts(ICANDriver *drv)
@@ -176,53 +387,136 @@ static void fd_disable_interrupts(ICANDriver *drv)
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
     HAL_FDCAN_DeactivateNotification(&ctx->hfdcan,
                                      FDCAN_IT_RX_FIFO0_NEW_MESSAGE |
-                                     FDCAN_IT_TX_FIFO_EMPTY |
-                                     FDCAN_IT_ERROR_WARNING);
+                                     FDCAN_IT_RX_FIFO1_NEW_MESSAGE |
+                                     FDCAN_IT_RX_FIFO0_WATERMARK |
+                                     FDCAN_IT_RX_FIFO1_FULL |
+                                     FDCAN_IT_RX_FIFO0_MESSAGE_LOST |
+                                     FDCAN_IT_RX_FIFO1_MESSAGE_LOST |
+                                     FDCAN_IT_TX_EVT_FIFO_NEW_DATA |
+                                     FDCAN_IT_TX_ABORT_COMPLETE |
+                                     FDCAN_IT_ERROR_WARNING |
+                                     FDCAN_IT_ERROR_PASSIVE |
+                                     FDCAN_IT_BUS_OFF);
+    ctx->irq_on = 0;
 }
 
-static void fd_irq_handler(ICANDriver *drv)
+/* Moderated: FIFO0 interrupts at its watermark, the small FIFO1 when full */
+static void fd_rx_irq_mask(ICANDriver *drv, uint8_t masked)
+{
+    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    const uint32_t each = FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE;
+    const uint32_t level = FDCAN_IT_RX_FIFO0_WATERMARK | FDCAN_IT_RX_FIFO1_FULL;
+    HAL_FDCAN_DeactivateNotification(&ctx->hfdcan, masked ? each : level);
+    HAL_FDCAN_ActivateNotification(&ctx->hfdcan, masked ? level : each, 0);
+}
+
+void FDCAN_IrqHandler(ICANDriver *drv)
 {
     FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
     HAL_FDCAN_IRQHandler(&ctx->hfdcan);
 }
 
-void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
+/* The new message flag is set once per burst, not per frame, so drain the
+ * FIFO; unless the manager has switched the instance to polling */
+static void fd_rx_irq(FDCAN_HandleTypeDef *hfdcan, uint8_t fifo)
 {
-    (void)RxFifo0ITs;
     FDCAN_Context *ctx = GET_CTX(hfdcan);
-    FDCAN_RxHeaderTypeDef hdr;
+    uint32_t hal_fifo = fifo == CAN_RX_FIFO_FAST ? FDCAN_RX_FIFO1 : FDCAN_RX_FIFO0;
     CAN_Message_t msg;
-    if (HAL_FDCAN_GetRxMessage(hfdcan, FDCAN_RX_FIFO0, &hdr, msg.data) == HAL_OK) {
-        msg.id = hdr.Identifier;
-        msg.extended = (hdr.IdType == FDCAN_EXTENDED_ID) ? 1 : 0;
-        msg.dlc = hdr.DataLength >> 16;
+    if (!CAN_Manager_RxIrq(ctx->base.inst_id))
+        return;
+    while (HAL_FDCAN_GetRxFifoFillLevel(hfdcan, hal_fifo) && fd_read(hfdcan, fifo, &msg))
         CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_RX, &msg);
+}
+
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
+{
+    FDCAN_Context *ctx = GET_CTX(hfdcan);
+    if (RxFifo0ITs & FDCAN_IT_RX_FIFO0_MESSAGE_LOST)
+        CAN_Manager_RxOverrun(ctx->base.inst_id, CAN_RX_FIFO_MAIN);
+    if (RxFifo0ITs & (FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO0_WATERMARK))
+        fd_rx_irq(hfdcan, CAN_RX_FIFO_MAIN);
+}
+
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs)
+{
+    FDCAN_Context *ctx = GET_CTX(hfdcan);
+    if (RxFifo1ITs & FDCAN_IT_RX_FIFO1_MESSAGE_LOST)
+        CAN_Manager_RxOverrun(ctx->base.inst_id, CAN_RX_FIFO_FAST);
+    if (RxFifo1ITs & (FDCAN_IT_RX_FIFO1_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_FULL))
+        fd_rx_irq(hfdcan, CAN_RX_FIFO_FAST);
+}
+
+static void fd_tx_events(FDCAN_Context *ctx)
+{
+    FDCAN_TxEventFifoTypeDef ev;
+    /* fill level first: an empty read would latch HAL_FDCAN_ERROR_FIFO_EMPTY */
+    while ((ctx->hfdcan.Instance->TXEFS & FDCAN_TXEFS_EFFL) &&
+           HAL_FDCAN_GetTxEvent(&ctx->hfdcan, &ev) == HAL_OK) {
+        uint32_t idx = ev.MessageMarker & (FDCAN_TX_BUFFERS - 1U);
+        CAN_Manager_TxDone(ctx->base.inst_id, ctx->tx_handles[idx], 1);
     }
 }
 
-void HAL_FDCAN_TxFifoEmptyCallback(FDCAN_HandleTypeDef *hfdcan)
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t TxEventFifoITs)
+{
+    (void)TxEventFifoITs;
+    fd_tx_events(GET_CTX(hfdcan));
+}
+
+/* Polled TX completion: the TX event FIFO fills whether or not its
+ * interrupt is enabled */
+static void fd_service(ICANDriver *drv)
+{
+    FDCAN_Context *ctx = (FDCAN_Context *)drv->ctx;
+    if (!ctx->irq_on)
+        fd_tx_events(ctx);
+}
+
+void HAL_FDCAN_TxBufferAbortCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes)
 {
     FDCAN_Context *ctx = GET_CTX(hfdcan);
-    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_TX_COMPLETE, NULL);
+    BufferIndexes &= fd_fifo_buffers(ctx);
+    while (BufferIndexes) {
+        uint32_t idx = (uint32_t)__builtin_ctz(BufferIndexes);
+        BufferIndexes &= BufferIndexes - 1U;
+        CAN_Manager_TxDone(ctx->base.inst_id, ctx->tx_handles[idx], 0);
+    }
 }
 
 void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan)
 {
     FDCAN_Context *ctx = GET_CTX(hfdcan);
+    CAN_TRACE(FD_ERROR, ctx->base.inst_id, HAL_FDCAN_GetError(hfdcan));
+    CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_ERROR, NULL);
+}
+
+/* Warning, passive and bus-off transitions */
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t ErrorStatusITs)
+{
+    (void)ErrorStatusITs;
+    FDCAN_Context *ctx = GET_CTX(hfdcan);
+    CAN_TRACE(FD_ERROR, ctx->base.inst_id, ErrorStatusITs);
     CAN_Manager_TriggerEvent(ctx->base.inst_id, CAN_EVENT_ERROR, NULL);
 }
 
 static ICANDriver fd_template = {
     .init            = fd_init,
-    .send            = fd_send,
-    .receive         = fd_receive,
+    .send            = FDCAN_Send,
+    .receive         = FDCAN_Receive,
     .set_filter      = fd_set_filter,
     .set_mode        = fd_set_mode,
     .get_error_state = fd_get_error,
     .auto_baud_detect = fd_autobaud,
     .enable_interrupts = fd_enable_interrupts,
     .disable_interrupts = fd_disable_interrupts,
-    .irq_handler     = fd_irq_handler,
+    .irq_handler     = FDCAN_IrqHandler,
+    .get_bus_status  = fd_get_bus_status,
+    .recover         = fd_recover,
+    .set_fifo_filter = fd_set_fifo_filter,
+    .rx_irq_mask     = fd_rx_irq_mask,
+    .reconfigure     = fd_reconfigure,
+    .service         = fd_service,
     .ctx             = NULL
 };
 
@@ -232,8 +526,120 @@ void FDCAN_SetupDriver(ICANDriver *drv, FDCAN_Context *ctx, FDCAN_GlobalTypeDef
         return;
 
     *drv = fd_template;
+    /* ram_planned, rx_watermark and the filter copies start out clear */
+    memset(ctx, 0, sizeof(*ctx));
     ctx->hfdcan.Instance = inst;
     ctx->driver = drv;
     drv->ctx = ctx;
 }
 
+
+/* Element sizes the controller has; words per element are 2 header words
+ * plus the data */
+static const uint8_t fd_elmt_bytes[] = { 8, 12, 16, 20, 24, 32, 48, 64 };
+static const uint32_t fd_elmt_code[] = {
+    FDCAN_DATA_BYTES_8,  FDCAN_DATA_BYTES_12, FDCAN_DATA_BYTES_16, FDCAN_DATA_BYTES_20,
+    FDCAN_DATA_BYTES_24, FDCAN_DATA_BYTES_32, FDCAN_DATA_BYTES_48, FDCAN_DATA_BYTES_64
+};
+
+/* Returns words per element, 0 if `bytes` is above 64 */
+static uint32_t fd_elmt(uint8_t bytes, uint32_t *code)
+{
+    if (bytes == 0)
+        bytes = 8;
+    for (uint32_t i = 0; i < sizeof(fd_elmt_bytes); ++i) {
+        if (bytes <= fd_elmt_bytes[i]) {
+            if (code)
+                *code = fd_elmt_code[i];
+            return 2U + fd_elmt_bytes[i] / 4U;
+        }
+    }
+    return 0;
+}
+
+static uint32_t fd_std_filters(const FDCAN_RamNeeds_t *n)
+{
+    return n->std_filters < CAN_RX_FAST_FILTERS ? CAN_RX_FAST_FILTERS : n->std_filters;
+}
+
+static uint32_t fd_ext_filters(const FDCAN_RamNeeds_t *n)
+{
+    return n->ext_filters ? n->ext_filters : 1U;
+}
+
+/* Same order as the HAL lays the sections out: filters, RX FIFO0, RX FIFO1,
+ * RX buffers, TX events (one per FIFO element), TX buffers and FIFO */
+uint32_t FDCAN_RamWords(const FDCAN_RamNeeds_t *n)
+{
+    if (!n)
+        return 0;
+    uint32_t f0 = fd_elmt(n->rx_fifo0_bytes, NULL);
+    uint32_t f1 = fd_elmt(n->rx_fifo1_bytes, NULL);
+    uint32_t rb = fd_elmt(n->rx_buffer_bytes, NULL);
+    uint32_t tx = fd_elmt(n->tx_bytes, NULL);
+    if (!f0 || !f1 || !rb || !tx || fd_std_filters(n) > 128U || fd_ext_filters(n) > 64U ||
+        n->rx_fifo0_len == 0 || n->rx_fifo0_len > 64U || n->rx_fifo1_len > 64U ||
+        n->rx_buffers > 64U || n->tx_fifo_len == 0 || n->tx_buffers + n->tx_fifo_len > 32U)
+        return 0;
+    return fd_std_filters(n) + 2U * fd_ext_filters(n) + n->rx_fifo0_len * f0 +
+           n->rx_fifo1_len * f1 + n->rx_buffers * rb + 2U * n->tx_fifo_len +
+           (uint32_t)(n->tx_buffers + n->tx_fifo_len) * tx;
+}
+
+static void fd_apply_layout(FDCAN_InitTypeDef *init, const FDCAN_RamNeeds_t *n, uint32_t offset)
+{
+    init->MessageRAMOffset = offset;
+    init->StdFiltersNbr = fd_std_filters(n);
+    init->ExtFiltersNbr = fd_ext_filters(n);
+    init->RxFifo0ElmtsNbr = n->rx_fifo0_len;
+    fd_elmt(n->rx_fifo0_bytes, &init->RxFifo0ElmtSize);
+    init->RxFifo1ElmtsNbr = n->rx_fifo1_len;
+    fd_elmt(n->rx_fifo1_bytes, &init->RxFifo1ElmtSize);
+    init->RxBuffersNbr = n->rx_buffers;
+    fd_elmt(n->rx_buffer_bytes, &init->RxBufferSize);
+    /* dedicated buffers store no events, so one per FIFO element will do */
+    init->TxEventsNbr = n->tx_fifo_len;
+    init->TxBuffersNbr = n->tx_buffers;
+    init->TxFifoQueueElmtsNbr = n->tx_fifo_len;
+    fd_elmt(n->tx_bytes, &init->TxElmtSize);
+}
+
+uint32_t FDCAN_PlanMessageRam(FDCAN_Context *const *ctx, const FDCAN_RamNeeds_t *needs,
+                              uint8_t num)
+{
+    uint32_t total = 0;
+    if (!ctx || !needs || num == 0)
+        return 0;
+    for (uint8_t i = 0; i < num; ++i) {
+        uint32_t words = FDCAN_RamWords(&needs[i]);
+        if (!ctx[i] || !words)
+            return 0;
+        total += words;
+    }
+    if (total > FDCAN_MESSAGE_RAM_WORDS)
+        return 0;
+    uint32_t offset = 0;
+    for (uint8_t i = 0; i < num; ++i) {
+        fd_apply_layout(&ctx[i]->hfdcan.Init, &needs[i], offset);
+        ctx[i]->ram_planned = 1;
+        offset += FDCAN_RamWords(&needs[i]);
+    }
+    return total;
+}
+
+CAN_Result_t FDCAN_TxBuffer_Write(FDCAN_Context *ctx, uint8_t index, const CAN_Message_t *msg)
+{
+    if (!ctx || !msg || index >= ctx->hfdcan.Init.TxBuffersNbr)
+        return CAN_ERROR;
+    FDCAN_TxHeaderTypeDef hdr = fd_tx_header(msg, FDCAN_NO_TX_EVENTS, 0);
+    return HAL_FDCAN_AddMessageToTxBuffer(&ctx->hfdcan, &hdr, (uint8_t *)msg->data,
+                                          1U << index) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
+
+CAN_Result_t FDCAN_TxBuffer_Request(FDCAN_Context *ctx, uint32_t mask)
+{
+    if (!ctx || !mask || (ctx->hfdcan.Init.TxBuffersNbr < 32U &&
+                          (mask >> ctx->hfdcan.Init.TxBuffersNbr)))
+        return CAN_ERROR;
+    return HAL_FDCAN_EnableTxBufferRequest(&ctx->hfdcan, mask) == HAL_OK ? CAN_OK : CAN_ERROR;
+}
@@ -10,12 +10,72 @@
 #error "Unsupported STM32 family for FDCAN"
 #endif
 
+/* TX FIFO/queue buffers tracked for completion (the H7 has up to 32) */
+#define FDCAN_TX_BUFFERS 32U
+
+/* Message RAM shared by FDCAN1 and FDCAN2 on H7, in 32-bit words */
+#ifndef FDCAN_MESSAGE_RAM_WORDS
+#define FDCAN_MESSAGE_RAM_WORDS 2560U
+#endif
+
+/* Message RAM needs of one instance, see FDCAN_PlanMessageRam. Element sizes
+ * are data bytes (8..64), rounded up to the next size the controller has;
+ * 0 means 8. */
+typedef struct {
+    uint8_t std_filters;      /* raised to CAN_RX_FAST_FILTERS, max 128 */
+    uint8_t ext_filters;      /* raised to 1, max 64 */
+    uint8_t rx_fifo0_len;     /* 1..64 */
+    uint8_t rx_fifo0_bytes;
+    uint8_t rx_fifo1_len;     /* 0..64; 0 leaves the fast lane without a FIFO */
+    uint8_t rx_fifo1_bytes;
+    uint8_t rx_buffers;       /* dedicated RX buffers, 0..64 */
+    uint8_t rx_buffer_bytes;
+    uint8_t tx_buffers;       /* dedicated TX buffers, see FDCAN_TxBuffer_Write */
+    uint8_t tx_fifo_len;      /* at least 1; tx_buffers + tx_fifo_len <= 32 */
+    uint8_t tx_bytes;         /* dedicated buffers and FIFO alike */
+} FDCAN_RamNeeds_t;
+
 typedef struct {
     CAN_DriverContext_t base;
     FDCAN_HandleTypeDef hfdcan;
     ICANDriver         *driver;
+    uint32_t            tx_handles[FDCAN_TX_BUFFERS];  /* by TX buffer index */
+    uint8_t             rx_watermark;  /* FIFO0 level for moderated RX, 0: 3/4 full */
+    uint8_t             ram_planned;   /* Init layout set by FDCAN_PlanMessageRam */
+    uint8_t             irq_on;        /* else fd_service reads the TX events */
+    /* Filters as last programmed: HAL_FDCAN_Init flushes the filter RAM */
+    uint8_t             filter_set;
+    uint8_t             fast_rules;    /* programmed rules, one bit each */
+    uint32_t            filter_id;
+    uint32_t            filter_mask;
+    CAN_FifoRule_t      fast[CAN_RX_FAST_FILTERS];
 } FDCAN_Context;
 
+/* Clears `ctx`: set rx_watermark and plan the message RAM afterwards */
 void FDCAN_SetupDriver(ICANDriver *driver, FDCAN_Context *ctx, FDCAN_GlobalTypeDef *inst);
 
+/* Words `needs` takes in message RAM, 0 if it is out of range */
+uint32_t FDCAN_RamWords(const FDCAN_RamNeeds_t *needs);
+/* Lay the message RAM out back to back for `num` instances and write each
+ * layout and MessageRAMOffset into its handle. Nothing is written unless
+ * every entry is valid and all fit into FDCAN_MESSAGE_RAM_WORDS. Call after
+ * FDCAN_SetupDriver and before the interfaces are added. Returns the words
+ * used, or 0. */
+uint32_t FDCAN_PlanMessageRam(FDCAN_Context *const *ctx, const FDCAN_RamNeeds_t *needs,
+                              uint8_t num);
+
+/* Dedicated TX buffers hold fixed-ID frames, e.g. cyclic ones, in message
+ * RAM. Write updates buffer `index` (< tx_buffers) in place and fails while
+ * it still waits for the bus; Request sends every buffer in `mask` with one
+ * register write, once the controller is started. These frames bypass the
+ * manager's TX queue and get no completion reports. HAL_FDCAN_Init clears
+ * the message RAM, so write them again after a bitrate or mode change. */
+CAN_Result_t FDCAN_TxBuffer_Write(FDCAN_Context *ctx, uint8_t index, const CAN_Message_t *msg);
+CAN_Result_t FDCAN_TxBuffer_Request(FDCAN_Context *ctx, uint32_t mask);
+
+/* Hot-path entry points, called directly under CAN_STATIC_CONFIG */
+CAN_Result_t FDCAN_Send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout);
+CAN_Result_t FDCAN_Receive(ICANDriver *drv, CAN_Message_t *msg);
+void         FDCAN_IrqHandler(ICANDriver *drv);
+
 #endif /* CAN_STM32_FDCAN_H */
@@ -1,11 +1,16 @@
 #include "can_manager.h"
 #include "can_mcp2515.h"
+#include "can_mcp2515_model.h"
 #include "can_stm32_bxcan.h"
 #include "can_stm32_fdcan.h"
 #include "can_autobaud.h"
 #include "can_config.h"
 #include <stdio.h>
 
+/* The MCP2515 sits behind the register model here; on a board, pass the
+ * CAN_SpiBus_t of the SPI port it is wired to instead */
+static MCP2515_Model_t board_mcp;
+
 static void on_rx(uint8_t id, CAN_Event_t ev, void *arg)
 {
     CAN_Message_t *m = (CAN_Message_t *)arg;
@@ -14,44 +19,55 @@ static void on_rx(uint8_t id, CAN_Event_t ev, void *arg)
 
 static void on_tx(uint8_t id, CAN_Event_t ev, void *arg)
 {
-    CAN_Message_t *m = (CAN_Message_t *)arg;
-    printf("TX complete iface %u id 0x%lx\n", id, (unsigned long)m->id);
+    CAN_TxReport_t *r = (CAN_TxReport_t *)arg;
+    printf("TX %s iface %u id 0x%lx handle %lu latency %lu us\n",
+           r->ok ? "complete" : "failed", id, (unsigned long)r->msg.id,
+           (unsigned long)r->handle, (unsigned long)(r->t_wire - r->t_enqueue));
 }
 
 static void on_err(uint8_t id, CAN_Event_t ev, void *arg)
 {
-    (void)ev; (void)arg;
-    printf("Error on iface %u\n", id);
+    (void)ev;
+    static const char *const names[] = { "active", "warning", "passive", "bus-off" };
+    CAN_ErrorEvent_t *e = (CAN_ErrorEvent_t *)arg;
+    printf("Error on iface %u: %s -> %s TEC %u REC %u\n", id, names[e->prev],
+           names[e->state], e->tec, e->rec);
 }
 
 int main(void)
 {
     CAN_Config_t cfg0 = {
-        .mode = CAN_MODE_AUTOBAUD,
+        .mode = CAN_OPMODE_AUTOBAUD,
         .bitrate = 0,
         .filter_id = 0x100,
         .filter_mask = 0x700,
         .use_interrupts = 0
     };
     CAN_Config_t cfg1 = {
-        .mode = CAN_MODE_NORMAL,
+        .mode = CAN_OPMODE_NORMAL,
         .bitrate = 500000,
         .filter_id = 0,
         .filter_mask = 0,
         .use_interrupts = 1
     };
 
+    /* four interfaces share the default frame pool */
+    CAN_QueueConfig_t q = { .tx_len = 8, .rx_len = 8 };
+
     CAN_Manager_Init();
-    int id0 = CAN_Manager_AddInterface(&mcp2515_driver, &cfg0);
+    MCP2515_Context mcp;
+    MCP2515_Model_Init(&board_mcp);
+    MCP2515_SetupDriver(&mcp2515_driver, &mcp, &board_mcp.spi, 8000000);
+    int id0 = CAN_Manager_AddInterfaceEx(&mcp2515_driver, &cfg0, &q);
     BxCAN_Context bx1, bx2;
     FDCAN_Context fd1;
     ICANDriver bx_drv1, bx_drv2, fd_drv;
     BxCAN_SetupDriver(&bx_drv1, &bx1, CAN1);
     BxCAN_SetupDriver(&bx_drv2, &bx2, CAN2);
     FDCAN_SetupDriver(&fd_drv, &fd1, FDCAN1);
-    int id1 = CAN_Manager_AddInterface(&bx_drv1, &cfg1);
-    int id2 = CAN_Manager_AddInterface(&bx_drv2, &cfg1);
-    int id3 = CAN_Manager_AddInterface(&fd_drv, &cfg1);
+    int id1 = CAN_Manager_AddInterfaceEx(&bx_drv1, &cfg1, &q);
+    int id2 = CAN_Manager_AddInterfaceEx(&bx_drv2, &cfg1, &q);
+    int id3 = CAN_Manager_AddInterfaceEx(&fd_drv, &cfg1, &q);
     printf("Interfaces %d %d %d %d added\n", id0, id1, id2, id3);
 
     CAN_RegisterCallback(id0, CAN_EVENT_RX, on_rx);
@@ -73,7 +89,7 @@ int main(void)
 
     /* Adjust filter and loopback mode directly via driver */
     mcp2515_driver.set_filter(&mcp2515_driver, 0x200, 0x7FF);
-    mcp2515_driver.set_mode(&mcp2515_driver, CAN_MODE_LOOPBACK);
+    mcp2515_driver.set_mode(&mcp2515_driver, CAN_OPMODE_LOOPBACK);
 
     CAN_Message_t msg = { .id = 0x123, .dlc = 2, .data = {0x55, 0xAA}, .extended = 0 };
     CAN_SendMessage(id0, &msg);
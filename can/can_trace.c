@@ -0,0 +1,122 @@
+#include "can_trace.h"
+#include "can_os.h"
+#include <stdatomic.h>
+
+#if defined(CAN_TRACE_ENABLE) && CAN_TRACE_ENABLE
+
+#if (CAN_TRACE_RING_LEN & (CAN_TRACE_RING_LEN - 1)) != 0
+#error "CAN_TRACE_RING_LEN must be a power of two"
+#endif
+
+/*
+ * Each slot carries a sequence number: 0 while being written, position + 1
+ * once complete.  Writers reserve a position with one fetch_add, so ISRs and
+ * threads that share a core (or a ring, when there are more cores than
+ * CAN_TRACE_CORES) never block each other.  The reader checks the sequence
+ * before and after copying and counts overwritten slots as lost.
+ */
+typedef struct {
+    _Atomic uint32_t  seq;
+    CAN_TraceRecord_t rec;
+} CAN_TraceSlot_t;
+
+typedef struct {
+    _Atomic uint32_t head;     /* next position to write */
+    uint32_t         tail;     /* next position to read */
+    CAN_TraceSlot_t  slots[CAN_TRACE_RING_LEN];
+} CAN_TraceRing_t;
+
+/* Not static, so a debugger can dump the rings of a halted target */
+CAN_TraceRing_t can_trace_rings[CAN_TRACE_CORES];
+
+volatile uint8_t can_trace_level = CAN_TRACE_INFO;
+volatile uint8_t can_trace_mask = CAN_TRACE_CAT_ALL;
+
+void can_trace_write(uint8_t event, uint32_t ts, uint32_t a0, uint32_t a1)
+{
+    uint8_t core = can_os_core_id();
+    CAN_TraceRing_t *r = &can_trace_rings[core % CAN_TRACE_CORES];
+    uint32_t pos = atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+    CAN_TraceSlot_t *s = &r->slots[pos & (CAN_TRACE_RING_LEN - 1U)];
+
+    atomic_store_explicit(&s->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->rec.ts = ts;
+    s->rec.event = event;
+    s->rec.core = core;
+    s->rec.pad = 0;
+    s->rec.arg[0] = a0;
+    s->rec.arg[1] = a1;
+    atomic_store_explicit(&s->seq, pos + 1U, memory_order_release);
+}
+
+void CAN_Trace_SetLevel(uint8_t level)
+{
+    can_trace_level = level;
+}
+
+void CAN_Trace_SetMask(uint8_t mask)
+{
+    can_trace_mask = mask;
+}
+
+uint32_t CAN_Trace_Read(uint8_t core, CAN_TraceRecord_t *out, uint32_t max, uint32_t *lost)
+{
+    uint32_t n = 0, missed = 0;
+    if (core >= CAN_TRACE_CORES || !out) {
+        if (lost)
+            *lost = 0;
+        return 0;
+    }
+    CAN_TraceRing_t *r = &can_trace_rings[core];
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    if (head - r->tail > CAN_TRACE_RING_LEN) {
+        missed += head - r->tail - CAN_TRACE_RING_LEN;
+        r->tail = head - CAN_TRACE_RING_LEN;
+    }
+    while (n < max && r->tail != head) {
+        const CAN_TraceSlot_t *s = &r->slots[r->tail & (CAN_TRACE_RING_LEN - 1U)];
+        uint32_t s1 = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (s1 == 0)
+            break;                  /* reserved but still being written */
+        if (s1 == r->tail + 1U) {
+            out[n] = s->rec;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&s->seq, memory_order_relaxed) == s1)
+                n++;
+            else
+                missed++;
+        } else {
+            missed++;               /* overwritten by a newer lap */
+        }
+        r->tail++;
+    }
+    if (lost)
+        *lost = missed;
+    return n;
+}
+
+#else
+
+void CAN_Trace_SetLevel(uint8_t level)
+{
+    (void)level;
+}
+
+void CAN_Trace_SetMask(uint8_t mask)
+{
+    (void)mask;
+}
+
+uint32_t CAN_Trace_Read(uint8_t core, CAN_TraceRecord_t *out, uint32_t max, uint32_t *lost)
+{
+    (void)core;
+    (void)out;
+    (void)max;
+    if (lost)
+        *lost = 0;
+    return 0;
+}
+
+#endif
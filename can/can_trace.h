@@ -0,0 +1,145 @@
+#ifndef CAN_TRACE_H
+#define CAN_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary trace log for driver and manager hot paths.
+ *
+ * A trace point stores a fixed 16 byte record (timestamp, event id, two
+ * arguments) in the ring of the calling core and returns; there is no
+ * formatting and no I/O on the target.  Records are drained with
+ * CAN_Trace_Read and turned into text on the host by can_trace_decode.c,
+ * which knows the format string of every event.
+ *
+ * Build with -DCAN_TRACE_ENABLE=1 to enable.  Without it every CAN_TRACE() point
+ * compiles to nothing, including its arguments.  CAN_TRACE_LEVEL_MAX drops
+ * points above a level at compile time; CAN_Trace_SetLevel and
+ * CAN_Trace_SetMask filter the rest at runtime.
+ */
+
+#define CAN_TRACE_ERROR 0
+#define CAN_TRACE_WARN  1
+#define CAN_TRACE_INFO  2
+#define CAN_TRACE_DEBUG 3
+
+/* Categories, combined in the runtime mask */
+#define CAN_TRACE_CAT_TX       0x01U
+#define CAN_TRACE_CAT_RX       0x02U
+#define CAN_TRACE_CAT_ERR      0x04U
+#define CAN_TRACE_CAT_AUTOBAUD 0x08U
+#define CAN_TRACE_CAT_CFG      0x10U
+#define CAN_TRACE_CAT_ALL      0xFFU
+
+/*
+ * Event table: X(name, level, category, format).  The format takes the two
+ * arguments as unsigned ints and is only compiled into the host decoder.
+ * Append new events at the end so existing logs keep decoding.
+ */
+#define CAN_TRACE_EVENTS(X)                                                                                \
+    X(MCP_AUTOBAUD_TRY,   CAN_TRACE_INFO,  CAN_TRACE_CAT_AUTOBAUD, "MCP2515 autobaud try %u")              \
+    X(MCP_AUTOBAUD_FOUND, CAN_TRACE_INFO,  CAN_TRACE_CAT_AUTOBAUD, "MCP2515 autobaud detected %u")         \
+    X(MCP_TX,             CAN_TRACE_DEBUG, CAN_TRACE_CAT_TX,       "MCP2515 TXB%u id 0x%x")                \
+    X(MCP_RX,             CAN_TRACE_DEBUG, CAN_TRACE_CAT_RX,       "MCP2515 RX id 0x%x batch %u")          \
+    X(MCP_ERROR,          CAN_TRACE_WARN,  CAN_TRACE_CAT_ERR,      "MCP2515 iface %u CANINTF 0x%x")        \
+    X(BX_AUTOBAUD_TRY,    CAN_TRACE_INFO,  CAN_TRACE_CAT_AUTOBAUD, "bxCAN autobaud try %u")                \
+    X(BX_AUTOBAUD_FOUND,  CAN_TRACE_INFO,  CAN_TRACE_CAT_AUTOBAUD, "bxCAN autobaud detected %u")           \
+    X(BX_TX,              CAN_TRACE_DEBUG, CAN_TRACE_CAT_TX,       "bxCAN mailbox %u id 0x%x")             \
+    X(BX_ERROR,           CAN_TRACE_WARN,  CAN_TRACE_CAT_ERR,      "bxCAN iface %u error 0x%x")            \
+    X(FD_AUTOBAUD_TRY,    CAN_TRACE_INFO,  CAN_TRACE_CAT_AUTOBAUD, "FDCAN autobaud try %u")                \
+    X(FD_AUTOBAUD_FOUND,  CAN_TRACE_INFO,  CAN_TRACE_CAT_AUTOBAUD, "FDCAN autobaud detected %u")           \
+    X(FD_TX,              CAN_TRACE_DEBUG, CAN_TRACE_CAT_TX,       "FDCAN TX buffer %u id 0x%x")           \
+    X(FD_ERROR,           CAN_TRACE_WARN,  CAN_TRACE_CAT_ERR,      "FDCAN iface %u error 0x%x")            \
+    X(TX_FAILED,          CAN_TRACE_WARN,  CAN_TRACE_CAT_TX,       "iface %u TX handle %u failed")         \
+    X(ERR_STATE,          CAN_TRACE_WARN,  CAN_TRACE_CAT_ERR,      "iface %u error state %u")              \
+    X(BUS_OFF_RECOVER,    CAN_TRACE_INFO,  CAN_TRACE_CAT_ERR,      "iface %u bus-off recovery attempt %u") \
+    X(RX_OVERRUN,         CAN_TRACE_WARN,  CAN_TRACE_CAT_RX,       "iface %u RX FIFO%u overrun")           \
+    X(IRQ_POLL,           CAN_TRACE_DEBUG, CAN_TRACE_CAT_RX,       "iface %u RX polled, IRQ gap %u us")    \
+    X(IRQ_UNMASK,         CAN_TRACE_DEBUG, CAN_TRACE_CAT_RX,       "iface %u RX IRQs back after %u polls") \
+    X(RECONFIG,           CAN_TRACE_INFO,  CAN_TRACE_CAT_CFG,      "iface %u reconfigured, %u us offline")
+
+enum {
+#define CAN_TRACE_ENUM(name, lvl, cat, fmt) CAN_TEV_##name,
+    CAN_TRACE_EVENTS(CAN_TRACE_ENUM)
+#undef CAN_TRACE_ENUM
+    CAN_TEV_COUNT
+};
+
+/* Level and category of each event as compile time constants */
+#define CAN_TRACE_ATTR(name, lvl, cat, fmt) \
+    CAN_TEV_##name##_LVL = (lvl), CAN_TEV_##name##_CAT = (cat),
+enum { CAN_TRACE_EVENTS(CAN_TRACE_ATTR) CAN_TEV_ATTR_END };
+#undef CAN_TRACE_ATTR
+
+typedef struct {
+    uint32_t ts;        /* CAN_TRACE_CLOCK() */
+    uint8_t  event;     /* CAN_TEV_* */
+    uint8_t  core;
+    uint16_t pad;
+    uint32_t arg[2];
+} CAN_TraceRecord_t;
+
+/* Records per core, power of two */
+#ifndef CAN_TRACE_RING_LEN
+#define CAN_TRACE_RING_LEN 256
+#endif
+
+#ifndef CAN_TRACE_CORES
+#define CAN_TRACE_CORES 2
+#endif
+
+#ifndef CAN_TRACE_LEVEL_MAX
+#define CAN_TRACE_LEVEL_MAX CAN_TRACE_DEBUG
+#endif
+
+/* Timestamp source, e.g. a cycle counter on the target */
+#ifndef CAN_TRACE_CLOCK
+#define CAN_TRACE_CLOCK() can_os_now_us()
+#endif
+
+#if defined(CAN_TRACE_ENABLE) && CAN_TRACE_ENABLE
+
+#include "can_os.h"
+
+extern volatile uint8_t can_trace_level;
+extern volatile uint8_t can_trace_mask;
+
+void can_trace_write(uint8_t event, uint32_t ts, uint32_t a0, uint32_t a1);
+
+#define CAN_TRACE(ev, a0, a1)                                                  \
+    do {                                                                       \
+        if (CAN_TEV_##ev##_LVL <= CAN_TRACE_LEVEL_MAX &&                       \
+            CAN_TEV_##ev##_LVL <= can_trace_level &&                           \
+            (CAN_TEV_##ev##_CAT & can_trace_mask))                             \
+            can_trace_write(CAN_TEV_##ev, CAN_TRACE_CLOCK(),                   \
+                            (uint32_t)(a0), (uint32_t)(a1));                   \
+    } while (0)
+
+#else
+#define CAN_TRACE(ev, a0, a1) ((void)0)
+#endif
+
+/* Runtime filters: points above `level` or outside `mask` are skipped
+ * (defaults: CAN_TRACE_INFO, CAN_TRACE_CAT_ALL). */
+void     CAN_Trace_SetLevel(uint8_t level);
+void     CAN_Trace_SetMask(uint8_t mask);
+
+/* Copy up to `max` unread records of one core's ring, oldest first. Returns
+ * the number copied. Records overwritten before they were read are counted
+ * in `lost` (may be NULL). One reader per ring. */
+uint32_t CAN_Trace_Read(uint8_t core, CAN_TraceRecord_t *out, uint32_t max, uint32_t *lost);
+
+/* Host side: format one record, returns the length written (snprintf
+ * semantics). Implemented in can_trace_decode.c. */
+int      CAN_Trace_Format(const CAN_TraceRecord_t *rec, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_TRACE_H */
@@ -0,0 +1,67 @@
+/*
+ * Host side decoder for can_trace.h records.
+ *
+ * Build as a tool with -DCAN_TRACE_DECODE_MAIN; it reads raw records (as
+ * returned by CAN_Trace_Read, in target byte order) from a file or stdin and
+ * prints one line per record:
+ *
+ *     cc -DCAN_TRACE_DECODE_MAIN -o can_trace_decode can_trace_decode.c
+ *     ./can_trace_decode trace.bin
+ */
+#include "can_trace.h"
+#include <stdio.h>
+
+static const char *const trace_names[CAN_TEV_COUNT] = {
+#define CAN_TRACE_NAME(name, lvl, cat, fmt) #name,
+    CAN_TRACE_EVENTS(CAN_TRACE_NAME)
+#undef CAN_TRACE_NAME
+};
+
+static const char *const trace_formats[CAN_TEV_COUNT] = {
+#define CAN_TRACE_FMT(name, lvl, cat, fmt) fmt,
+    CAN_TRACE_EVENTS(CAN_TRACE_FMT)
+#undef CAN_TRACE_FMT
+};
+
+int CAN_Trace_Format(const CAN_TraceRecord_t *rec, char *buf, size_t len)
+{
+    if (rec->event >= CAN_TEV_COUNT)
+        return snprintf(buf, len, "%10lu [%u] unknown event %u (0x%lx 0x%lx)",
+                        (unsigned long)rec->ts, rec->core, rec->event,
+                        (unsigned long)rec->arg[0], (unsigned long)rec->arg[1]);
+
+    int n = snprintf(buf, len, "%10lu [%u] %-18s ", (unsigned long)rec->ts, rec->core,
+                     trace_names[rec->event]);
+    if (n < 0 || (size_t)n >= len)
+        return n;
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+    int m = snprintf(buf + n, len - (size_t)n, trace_formats[rec->event],
+                     (unsigned)rec->arg[0], (unsigned)rec->arg[1]);
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+    return m < 0 ? m : n + m;
+}
+
+#ifdef CAN_TRACE_DECODE_MAIN
+int main(int argc, char **argv)
+{
+    FILE *f = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    CAN_TraceRecord_t rec;
+    char line[160];
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        CAN_Trace_Format(&rec, line, sizeof(line));
+        puts(line);
+    }
+    if (f != stdin)
+        fclose(f);
+    return 0;
+}
+#endif
@@ -0,0 +1,95 @@
+#include "hal_emu.h"
+#include <string.h>
+
+static const char *const emu_names[HAL_EMU_CALL_COUNT] = {
+#define HAL_EMU_NAME(name, cycles) #name,
+    HAL_EMU_CALLS(HAL_EMU_NAME)
+#undef HAL_EMU_NAME
+};
+
+static uint32_t emu_cost[HAL_EMU_CALL_COUNT] = {
+#define HAL_EMU_COST(name, cycles) cycles,
+    HAL_EMU_CALLS(HAL_EMU_COST)
+#undef HAL_EMU_COST
+};
+
+static uint32_t emu_calls[HAL_EMU_CALL_COUNT];
+static uint64_t emu_cycles;
+static uint32_t emu_frames;
+
+void hal_emu_charge(uint32_t call)
+{
+    emu_calls[call]++;
+    emu_cycles += emu_cost[call];
+}
+
+void hal_emu_frame(void)
+{
+    emu_frames++;
+}
+
+void HAL_Emu_SetCost(uint32_t call, uint32_t cycles)
+{
+    if (call < HAL_EMU_CALL_COUNT)
+        emu_cost[call] = cycles;
+}
+
+int HAL_Emu_SetCostByName(const char *name, uint32_t cycles)
+{
+    for (uint32_t i = 0; name && i < HAL_EMU_CALL_COUNT; ++i) {
+        if (strcmp(name, emu_names[i]) == 0) {
+            emu_cost[i] = cycles;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+uint32_t HAL_Emu_GetCost(uint32_t call)
+{
+    return call < HAL_EMU_CALL_COUNT ? emu_cost[call] : 0;
+}
+
+const char *HAL_Emu_CallName(uint32_t call)
+{
+    return call < HAL_EMU_CALL_COUNT ? emu_names[call] : NULL;
+}
+
+uint32_t HAL_Emu_Calls(uint32_t call)
+{
+    return call < HAL_EMU_CALL_COUNT ? emu_calls[call] : 0;
+}
+
+uint64_t HAL_Emu_Cycles(void)
+{
+    return emu_cycles;
+}
+
+uint32_t HAL_Emu_Frames(void)
+{
+    return emu_frames;
+}
+
+void HAL_Emu_ResetStats(void)
+{
+    memset(emu_calls, 0, sizeof(emu_calls));
+    emu_cycles = 0;
+    emu_frames = 0;
+}
+
+void HAL_Emu_Report(FILE *f)
+{
+    fprintf(f, "%-28s %8s %10s %12s\n", "call", "cost", "calls", "cycles");
+    for (uint32_t i = 0; i < HAL_EMU_CALL_COUNT; ++i) {
+        if (!emu_calls[i])
+            continue;
+        fprintf(f, "%-28s %8lu %10lu %12llu\n", emu_names[i], (unsigned long)emu_cost[i],
+                (unsigned long)emu_calls[i],
+                (unsigned long long)emu_calls[i] * emu_cost[i]);
+    }
+    fprintf(f, "total %llu cycles, %lu frames", (unsigned long long)emu_cycles,
+            (unsigned long)emu_frames);
+    if (emu_frames)
+        fprintf(f, ", %.1f cycles/frame", (double)emu_cycles / emu_frames);
+    fputc('\n', f);
+}
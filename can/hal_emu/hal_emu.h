@@ -0,0 +1,124 @@
+#ifndef HAL_EMU_H
+#define HAL_EMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "can_interface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host emulation of the STM32 HAL subset used by can_stm32_bxcan.c and
+ * can_stm32_fdcan.c.
+ *
+ * The headers in this directory stand in for the HAL and device headers, so
+ * the real driver sources build on Linux with
+ *
+ *     cc -Ican -Ican/hal_emu -DSTM32F4xx -DSTM32H7xx ...
+ *
+ * The peripherals are behavioural models: TX mailboxes and buffers, RX FIFOs
+ * with overrun, filter banks and elements, error counters, interrupt flags
+ * and the HAL IRQ handlers that dispatch to the driver's callbacks.  Never
+ * put this directory on a target include path.
+ *
+ * Every emulated HAL call is charged a cycle cost from HAL_EMU_CALLS.  After
+ * a run HAL_Emu_Cycles / HAL_Emu_Frames estimates the HAL share of each
+ * frame's CPU cost.  Register reads done directly by a driver are not
+ * charged.  The emulation is not thread safe; drive it from one thread.
+ */
+
+#ifndef __weak
+#define __weak __attribute__((weak))
+#endif
+
+typedef enum {
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    DISABLE = 0U,
+    ENABLE  = !DISABLE
+} FunctionalState;
+
+/*
+ * Cost table: X(name, cycles).  The defaults are rough figures for the HAL
+ * built with -O2 on a Cortex-M4 (bxCAN) or Cortex-M7 (FDCAN), including
+ * the peripheral register accesses.  Calibrate them with DWT->CYCCNT on the
+ * target and override with HAL_Emu_SetCost.  IRQ_ENTRY is charged once per
+ * IRQ handler call for exception entry and exit.
+ */
+#define HAL_EMU_CALLS(X)                    \
+    X(IRQ_ENTRY,                  24)       \
+    X(CAN_INIT,                 1200)       \
+    X(CAN_START,                 600)       \
+    X(CAN_STOP,                  600)       \
+    X(CAN_CONFIG_FILTER,         160)       \
+    X(CAN_ADD_TX,                110)       \
+    X(CAN_ABORT_TX,               40)       \
+    X(CAN_GET_RX,                130)       \
+    X(CAN_FIFO_LEVEL,             14)       \
+    X(CAN_ACTIVATE_IT,            30)       \
+    X(CAN_DEACTIVATE_IT,          30)       \
+    X(CAN_IRQ_HANDLER,            80)       \
+    X(CAN_GET_ERROR,               6)       \
+    X(CAN_RESET_ERROR,            10)       \
+    X(FDCAN_INIT,               3000)       \
+    X(FDCAN_START,               200)       \
+    X(FDCAN_STOP,                800)       \
+    X(FDCAN_CONFIG_FILTER,        60)       \
+    X(FDCAN_CONFIG_GLOBAL_FILTER, 30)       \
+    X(FDCAN_CONFIG_WATERMARK,     30)       \
+    X(FDCAN_ADD_TX,              160)       \
+    X(FDCAN_ADD_TX_BUFFER,       150)       \
+    X(FDCAN_TX_BUFFER_REQUEST,    20)       \
+    X(FDCAN_ABORT_TX,             40)       \
+    X(FDCAN_TX_FREE_LEVEL,        14)       \
+    X(FDCAN_GET_RX,              170)       \
+    X(FDCAN_FIFO_LEVEL,           16)       \
+    X(FDCAN_GET_TX_EVENT,         90)       \
+    X(FDCAN_ACTIVATE_IT,          60)       \
+    X(FDCAN_DEACTIVATE_IT,        40)       \
+    X(FDCAN_CONFIG_IT_LINES,      30)       \
+    X(FDCAN_IRQ_HANDLER,         140)       \
+    X(FDCAN_GET_ERROR,             6)       \
+    X(FDCAN_GET_ERROR_COUNTERS,   20)       \
+    X(FDCAN_GET_PROTOCOL_STATUS,  40)
+
+enum {
+#define HAL_EMU_ENUM(name, cycles) HAL_EMU_##name,
+    HAL_EMU_CALLS(HAL_EMU_ENUM)
+#undef HAL_EMU_ENUM
+    HAL_EMU_CALL_COUNT
+};
+
+void        HAL_Emu_SetCost(uint32_t call, uint32_t cycles);
+/* By table name without the prefix, e.g. "CAN_ADD_TX"; for cost files.
+ * Returns 0, or -1 for an unknown name. */
+int         HAL_Emu_SetCostByName(const char *name, uint32_t cycles);
+uint32_t    HAL_Emu_GetCost(uint32_t call);
+const char *HAL_Emu_CallName(uint32_t call);
+
+/* Counters since the last HAL_Emu_ResetStats.  A frame is counted when the
+ * driver hands it to the HAL (AddTxMessage) or takes it out (GetRxMessage). */
+uint32_t    HAL_Emu_Calls(uint32_t call);
+uint64_t    HAL_Emu_Cycles(void);
+uint32_t    HAL_Emu_Frames(void);
+void        HAL_Emu_ResetStats(void);
+/* Per-call table and estimated cycles per frame */
+void        HAL_Emu_Report(FILE *f);
+
+/* Used by the peripheral models */
+void        hal_emu_charge(uint32_t call);
+void        hal_emu_frame(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_EMU_H */
@@ -0,0 +1,755 @@
+#include "stm32f4xx_hal_can.h"
+#include <string.h>
+
+CAN_TypeDef hal_emu_can[3];
+
+#define BX_BANKS      28U
+#define BX_CAN3_BANKS 14U
+#define BX_LEC_ACK    3U
+
+#define BX_TSR_MB(flags, mb) ((uint32_t)(flags) << ((mb) * 8U))
+#define BX_TSR_TME(mb)       (CAN_TSR_TME0 << (mb))
+
+static uint8_t bx_powered;
+
+/* Register reset values; the filter registers only matter in CAN1/CAN3 */
+static void bx_reset_regs(CAN_TypeDef *can)
+{
+    can->MCR = CAN_MCR_SLEEP;
+    can->MSR = CAN_MSR_INAK;
+    can->TSR = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+    can->RF0R = 0;
+    can->RF1R = 0;
+    can->IER = 0;
+    can->ESR = 0;
+    can->BTR = 0x01230000U;
+    memset(can->sTxMailBox, 0, sizeof(can->sTxMailBox));
+    can->FMR = (14U << CAN_FMR_CAN2SB_Pos) | CAN_FMR_FINIT;
+    can->FM1R = 0;
+    can->FS1R = 0;
+    can->FFA1R = 0;
+    can->FA1R = 0;
+    memset(can->sFilterRegister, 0, sizeof(can->sFilterRegister));
+    memset(can->fifo, 0, sizeof(can->fifo));
+    can->fifo_head[0] = 0;
+    can->fifo_head[1] = 0;
+    can->tx_next = 0;
+}
+
+/* Instances are statics; bring them to reset state on first use */
+static void bx_power(void)
+{
+    if (bx_powered)
+        return;
+    for (uint32_t i = 0; i < 3U; ++i)
+        bx_reset_regs(&hal_emu_can[i]);
+    bx_powered = 1;
+}
+
+static int bx_ready(const CAN_HandleTypeDef *hcan)
+{
+    return hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING;
+}
+
+/* On the bus: out of initialisation and sleep, not bus-off */
+static int bx_online(const CAN_TypeDef *can)
+{
+    return !(can->MSR & CAN_MSR_INAK) && !(can->MCR & CAN_MCR_SLEEP) &&
+           !(can->ESR & CAN_ESR_BOFF);
+}
+
+/* ----- Error counters --------------------------------------------------- */
+
+static void bx_set_counters(CAN_TypeDef *can, uint32_t tec, uint32_t rec)
+{
+    uint32_t old = can->ESR;
+    uint32_t esr = old & CAN_ESR_LEC;
+    if (rec > 255U)
+        rec = 255U;
+    if (tec > 255U) {
+        esr |= CAN_ESR_BOFF | CAN_ESR_EPVF | CAN_ESR_EWGF;
+        tec = 255U;
+    } else {
+        if (tec >= 96U || rec >= 96U)
+            esr |= CAN_ESR_EWGF;
+        if (tec > 127U || rec > 127U)
+            esr |= CAN_ESR_EPVF;
+    }
+    esr |= (tec << CAN_ESR_TEC_Pos) | (rec << CAN_ESR_REC_Pos);
+    can->ESR = esr;
+
+    uint32_t rise = esr & ~old;
+    if (((rise & CAN_ESR_EWGF) && (can->IER & CAN_IER_EWGIE)) ||
+        ((rise & CAN_ESR_EPVF) && (can->IER & CAN_IER_EPVIE)) ||
+        ((rise & CAN_ESR_BOFF) && (can->IER & CAN_IER_BOFIE)))
+        can->MSR |= CAN_MSR_ERRI;
+}
+
+static uint32_t bx_tec(const CAN_TypeDef *can)
+{
+    return (can->ESR & CAN_ESR_BOFF) ? 256U : (can->ESR >> CAN_ESR_TEC_Pos) & 0xFFU;
+}
+
+static uint32_t bx_rec(const CAN_TypeDef *can)
+{
+    return (can->ESR >> CAN_ESR_REC_Pos) & 0xFFU;
+}
+
+static void bx_set_lec(CAN_TypeDef *can, uint32_t lec)
+{
+    can->ESR = (can->ESR & ~CAN_ESR_LEC) | (lec << CAN_ESR_LEC_Pos);
+    if (lec && (can->IER & CAN_IER_LECIE))
+        can->MSR |= CAN_MSR_ERRI;
+}
+
+/* ----- Filters ---------------------------------------------------------- */
+
+static CAN_TypeDef *bx_filter_regs(CAN_TypeDef *can)
+{
+    return can == CAN2 ? CAN1 : can;
+}
+
+static void bx_bank_range(CAN_TypeDef *can, uint32_t *first, uint32_t *end)
+{
+    uint32_t sb = (CAN1->FMR & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+    if (sb > BX_BANKS)
+        sb = BX_BANKS;
+    if (can == CAN3) {
+        *first = 0;
+        *end = BX_CAN3_BANKS;
+    } else if (can == CAN2) {
+        *first = sb;
+        *end = BX_BANKS;
+    } else {
+        *first = 0;
+        *end = sb;
+    }
+}
+
+/* Filter numbers a bank takes in its FIFO's match index space */
+static uint32_t bx_bank_width(const CAN_TypeDef *fr, uint32_t b)
+{
+    uint32_t scale32 = (fr->FS1R >> b) & 1U, list = (fr->FM1R >> b) & 1U;
+    return scale32 ? (list ? 2U : 1U) : (list ? 4U : 2U);
+}
+
+/* Index of the matching filter within bank `b`, or -1 */
+static int bx_bank_match(const CAN_TypeDef *fr, uint32_t b, uint32_t rir)
+{
+    uint32_t fr1 = fr->sFilterRegister[b].FR1, fr2 = fr->sFilterRegister[b].FR2;
+    uint32_t list = (fr->FM1R >> b) & 1U;
+    if ((fr->FS1R >> b) & 1U) {
+        uint32_t w = rir & ~CAN_TI0R_TXRQ;
+        if (!list)
+            return ((w ^ fr1) & fr2 & ~CAN_TI0R_TXRQ) == 0 ? 0 : -1;
+        if (((w ^ fr1) & ~CAN_TI0R_TXRQ) == 0)
+            return 0;
+        return ((w ^ fr2) & ~CAN_TI0R_TXRQ) == 0 ? 1 : -1;
+    }
+    /* 16-bit: STID[10:0] RTR IDE EXID[17:15] */
+    uint32_t w = ((rir >> 21) << 5) | (((rir >> 1) & 1U) << 4) | (((rir >> 2) & 1U) << 3) |
+                 ((rir >> 18) & 7U);
+    if (!list) {
+        if (((w ^ fr1) & (fr1 >> 16) & 0xFFFFU) == 0)
+            return 0;
+        return ((w ^ fr2) & (fr2 >> 16) & 0xFFFFU) == 0 ? 1 : -1;
+    }
+    const uint32_t ids[4] = { fr1 & 0xFFFFU, fr1 >> 16, fr2 & 0xFFFFU, fr2 >> 16 };
+    for (int i = 0; i < 4; ++i)
+        if (ids[i] == w)
+            return i;
+    return -1;
+}
+
+/*
+ * 32-bit filters win over 16-bit ones, list mode over mask mode, then the
+ * lowest bank.  Returns the FIFO or -1; *fmi gets the filter match index.
+ */
+static int bx_accept(CAN_TypeDef *can, uint32_t rir, uint32_t *fmi)
+{
+    static const uint8_t order[4][2] = { { 1, 1 }, { 1, 0 }, { 0, 1 }, { 0, 0 } };
+    CAN_TypeDef *fr = bx_filter_regs(can);
+    uint32_t first, end;
+    if (fr->FMR & CAN_FMR_FINIT)
+        return -1;
+    bx_bank_range(can, &first, &end);
+    for (uint32_t c = 0; c < 4U; ++c) {
+        for (uint32_t b = first; b < end; ++b) {
+            if (!((fr->FA1R >> b) & 1U) || ((fr->FS1R >> b) & 1U) != order[c][0] ||
+                ((fr->FM1R >> b) & 1U) != order[c][1])
+                continue;
+            int idx = bx_bank_match(fr, b, rir);
+            if (idx < 0)
+                continue;
+            uint32_t fifo = (fr->FFA1R >> b) & 1U, n = 0;
+            for (uint32_t p = first; p < b; ++p)
+                if (((fr->FFA1R >> p) & 1U) == fifo)
+                    n += bx_bank_width(fr, p);
+            *fmi = n + (uint32_t)idx;
+            return (int)fifo;
+        }
+    }
+    return -1;
+}
+
+/* ----- RX --------------------------------------------------------------- */
+
+static void bx_encode(const CAN_Message_t *msg, CAN_FIFOMailBox_TypeDef *m)
+{
+    m->RIR = msg->extended ? ((msg->id & 0x1FFFFFFFU) << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE
+                           : (msg->id & 0x7FFU) << CAN_TI0R_STID_Pos;
+    m->RDTR = msg->dlc & 0x0FU;
+    m->RDLR = (uint32_t)msg->data[0] | ((uint32_t)msg->data[1] << 8) |
+              ((uint32_t)msg->data[2] << 16) | ((uint32_t)msg->data[3] << 24);
+    m->RDHR = (uint32_t)msg->data[4] | ((uint32_t)msg->data[5] << 8) |
+              ((uint32_t)msg->data[6] << 16) | ((uint32_t)msg->data[7] << 24);
+}
+
+static void bx_unpack(uint32_t lo, uint32_t hi, uint8_t *data)
+{
+    for (uint32_t i = 0; i < 4U; ++i) {
+        data[i] = (uint8_t)(lo >> (8U * i));
+        data[i + 4U] = (uint8_t)(hi >> (8U * i));
+    }
+}
+
+/* Past filtering: store in FIFO `f`, honouring RFLM when it is full */
+static int bx_store(CAN_TypeDef *can, uint32_t f, const CAN_FIFOMailBox_TypeDef *m)
+{
+    volatile uint32_t *rfr = f ? &can->RF1R : &can->RF0R;
+    uint32_t n = *rfr & CAN_RF0R_FMP0;
+    if (n == 3U) {
+        *rfr |= CAN_RF0R_FOVR0;
+        can->rx_overruns++;
+        if (!(can->MCR & CAN_MCR_RFLM))    /* not locked: the newest is replaced */
+            can->fifo[f][(can->fifo_head[f] + 2U) % 3U] = *m;
+        return -1;
+    }
+    can->fifo[f][(can->fifo_head[f] + n) % 3U] = *m;
+    n++;
+    *rfr = (*rfr & ~CAN_RF0R_FMP0) | n | (n == 3U ? CAN_RF0R_FULL0 : 0U);
+    can->rx_frames++;
+    uint32_t rec = bx_rec(can);
+    if (rec)
+        bx_set_counters(can, bx_tec(can), rec - 1U);
+    return 0;
+}
+
+static int bx_deliver(CAN_TypeDef *can, const CAN_Message_t *msg)
+{
+    CAN_FIFOMailBox_TypeDef m;
+    uint32_t fmi = 0;
+    bx_encode(msg, &m);
+    int fifo = bx_accept(can, m.RIR, &fmi);
+    if (fifo < 0) {
+        can->rx_dropped++;
+        return -1;
+    }
+    m.RDTR |= fmi << 8;
+    return bx_store(can, (uint32_t)fifo, &m);
+}
+
+int HAL_Emu_CAN_Receive(CAN_TypeDef *can, const CAN_Message_t *msg)
+{
+    bx_power();
+    if (!can || !msg)
+        return -1;
+    /* Loopback mode disconnects RX from the bus */
+    if (!bx_online(can) || (can->BTR & CAN_BTR_LBKM)) {
+        can->rx_dropped++;
+        return -1;
+    }
+    return bx_deliver(can, msg);
+}
+
+/* ----- TX --------------------------------------------------------------- */
+
+static void bx_update_code(CAN_TypeDef *can)
+{
+    uint32_t code = 0;
+    for (uint32_t mb = 0; mb < 3U; ++mb) {
+        if (can->TSR & BX_TSR_TME(mb)) {
+            code = mb;
+            break;
+        }
+    }
+    can->TSR = (can->TSR & ~CAN_TSR_CODE) | (code << CAN_TSR_CODE_Pos);
+}
+
+/* Arbitration key: base ID, then standard before extended, then the rest */
+static uint32_t bx_arb_key(uint32_t tir)
+{
+    uint32_t key = (tir >> CAN_TI0R_STID_Pos) << 20;
+    if (tir & CAN_TI0R_IDE)
+        key |= (1U << 19) | ((tir >> CAN_TI0R_EXID_Pos) & 0x3FFFFU);
+    return key;
+}
+
+static int bx_next_mailbox(const CAN_TypeDef *can)
+{
+    int best = -1;
+    for (int mb = 0; mb < 3; ++mb) {
+        if (!(can->sTxMailBox[mb].TIR & CAN_TI0R_TXRQ))
+            continue;
+        if (best < 0)
+            best = mb;
+        else if ((can->MCR & CAN_MCR_TXFP) ? can->tx_seq[mb] - can->tx_seq[best] > 0x7FFFFFFFU
+                                         : bx_arb_key(can->sTxMailBox[mb].TIR) <
+                                               bx_arb_key(can->sTxMailBox[best].TIR))
+            best = mb;
+    }
+    return best;
+}
+
+/* Put one mailbox on the bus. Returns 0 if it is still pending. */
+static int bx_send_one(CAN_TypeDef *can, uint32_t mb)
+{
+    const CAN_TxMailBox_TypeDef *t = &can->sTxMailBox[mb];
+    CAN_Message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.extended = (t->TIR & CAN_TI0R_IDE) ? 1U : 0U;
+    msg.id = msg.extended ? t->TIR >> CAN_TI0R_EXID_Pos : t->TIR >> CAN_TI0R_STID_Pos;
+    msg.dlc = (uint8_t)(t->TDTR & 0x0FU);
+    bx_unpack(t->TDLR, t->TDHR, msg.data);
+
+    int err = 0;
+    if (!(can->BTR & CAN_BTR_SILM) && can->on_tx)
+        err = can->on_tx(can, &msg, can->user);
+    if (err) {
+        can->tx_errors++;
+        bx_set_lec(can, BX_LEC_ACK);
+        bx_set_counters(can, bx_tec(can) + 8U, bx_rec(can));
+        if (!(can->MCR & CAN_MCR_NART) && !(can->ESR & CAN_ESR_BOFF))
+            return 0;   /* retransmitted later */
+        can->sTxMailBox[mb].TIR &= ~CAN_TI0R_TXRQ;
+        can->TSR |= BX_TSR_MB(CAN_TSR_RQCP0 | CAN_TSR_TERR0, mb) | BX_TSR_TME(mb);
+        bx_update_code(can);
+        return 1;
+    }
+    can->sTxMailBox[mb].TIR &= ~CAN_TI0R_TXRQ;
+    can->TSR |= BX_TSR_MB(CAN_TSR_RQCP0 | CAN_TSR_TXOK0, mb) | BX_TSR_TME(mb);
+    bx_update_code(can);
+    can->tx_frames++;
+    uint32_t tec = bx_tec(can);
+    if (tec)
+        bx_set_counters(can, tec - 1U, bx_rec(can));
+    if (can->BTR & CAN_BTR_LBKM)
+        bx_deliver(can, &msg);
+    return 1;
+}
+
+static uint32_t bx_transmit(CAN_TypeDef *can, uint32_t max)
+{
+    uint32_t sent = 0;
+    /* Silent mode alone cannot start a frame */
+    if ((can->BTR & (CAN_BTR_SILM | CAN_BTR_LBKM)) == CAN_BTR_SILM)
+        return 0;
+    while (sent < max && bx_online(can)) {
+        int mb = bx_next_mailbox(can);
+        if (mb < 0 || !bx_send_one(can, (uint32_t)mb))
+            break;
+        sent++;
+    }
+    return sent;
+}
+
+static void bx_kick(CAN_TypeDef *can)
+{
+    if (!can->tx_hold)
+        bx_transmit(can, 3U);
+}
+
+uint32_t HAL_Emu_CAN_Transmit(CAN_TypeDef *can, uint32_t max)
+{
+    bx_power();
+    return can ? bx_transmit(can, max) : 0;
+}
+
+void HAL_Emu_CAN_SetErrorCounters(CAN_TypeDef *can, uint16_t tec, uint8_t rec)
+{
+    bx_power();
+    if (can)
+        bx_set_counters(can, tec, rec);
+}
+
+uint8_t HAL_Emu_CAN_IntPending(const CAN_TypeDef *can)
+{
+    uint32_t ier = can->IER;
+    if ((ier & CAN_IER_TMEIE) &&
+        (can->TSR & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2)))
+        return 1;
+    if (((ier & CAN_IER_FMPIE0) && (can->RF0R & CAN_RF0R_FMP0)) ||
+        ((ier & CAN_IER_FFIE0) && (can->RF0R & CAN_RF0R_FULL0)) ||
+        ((ier & CAN_IER_FOVIE0) && (can->RF0R & CAN_RF0R_FOVR0)))
+        return 1;
+    if (((ier & CAN_IER_FMPIE1) && (can->RF1R & CAN_RF1R_FMP1)) ||
+        ((ier & CAN_IER_FFIE1) && (can->RF1R & CAN_RF1R_FULL1)) ||
+        ((ier & CAN_IER_FOVIE1) && (can->RF1R & CAN_RF1R_FOVR1)))
+        return 1;
+    return (ier & CAN_IER_ERRIE) && (can->MSR & CAN_MSR_ERRI) ? 1 : 0;
+}
+
+void HAL_Emu_CAN_Reset(CAN_TypeDef *can)
+{
+    bx_power();
+    if (!can)
+        return;
+    memset(can, 0, sizeof(*can));
+    bx_reset_regs(can);
+}
+
+/* ----- HAL API ---------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan)
+{
+    bx_power();
+    hal_emu_charge(HAL_EMU_CAN_INIT);
+    if (!hcan || !hcan->Instance)
+        return HAL_ERROR;
+    CAN_TypeDef *can = hcan->Instance;
+    can->MCR = (can->MCR & ~CAN_MCR_SLEEP) | CAN_MCR_INRQ;
+    can->MSR |= CAN_MSR_INAK;
+
+    uint32_t mcr = can->MCR & ~(CAN_MCR_TTCM | CAN_MCR_ABOM | CAN_MCR_AWUM | CAN_MCR_NART |
+                                CAN_MCR_RFLM | CAN_MCR_TXFP);
+    if (hcan->Init.TimeTriggeredMode == ENABLE)
+        mcr |= CAN_MCR_TTCM;
+    if (hcan->Init.AutoBusOff == ENABLE)
+        mcr |= CAN_MCR_ABOM;
+    if (hcan->Init.AutoWakeUp == ENABLE)
+        mcr |= CAN_MCR_AWUM;
+    if (hcan->Init.AutoRetransmission != ENABLE)
+        mcr |= CAN_MCR_NART;
+    if (hcan->Init.ReceiveFifoLocked == ENABLE)
+        mcr |= CAN_MCR_RFLM;
+    if (hcan->Init.TransmitFifoPriority == ENABLE)
+        mcr |= CAN_MCR_TXFP;
+    can->MCR = mcr;
+    can->BTR = hcan->Init.Mode | hcan->Init.SyncJumpWidth | hcan->Init.TimeSeg1 |
+               hcan->Init.TimeSeg2 | ((hcan->Init.Prescaler - 1U) & 0x3FFU);
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig)
+{
+    hal_emu_charge(HAL_EMU_CAN_CONFIG_FILTER);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    CAN_TypeDef *fr = bx_filter_regs(hcan->Instance);
+    uint32_t bank = sFilterConfig->FilterBank;
+    if (bank >= (fr == CAN3 ? BX_CAN3_BANKS : BX_BANKS) ||
+        sFilterConfig->SlaveStartFilterBank > BX_BANKS) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;  /* assert_param on the target */
+        return HAL_ERROR;
+    }
+    uint32_t bit = 1U << bank;
+
+    fr->FMR |= CAN_FMR_FINIT;
+    if (fr == CAN1)
+        fr->FMR = (fr->FMR & ~CAN_FMR_CAN2SB) |
+                  (sFilterConfig->SlaveStartFilterBank << CAN_FMR_CAN2SB_Pos);
+    fr->FA1R &= ~bit;
+    if (sFilterConfig->FilterScale == CAN_FILTERSCALE_16BIT) {
+        fr->FS1R &= ~bit;
+        fr->sFilterRegister[bank].FR1 = ((sFilterConfig->FilterMaskIdLow & 0xFFFFU) << 16) |
+                                        (sFilterConfig->FilterIdLow & 0xFFFFU);
+        fr->sFilterRegister[bank].FR2 = ((sFilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) |
+                                        (sFilterConfig->FilterIdHigh & 0xFFFFU);
+    } else {
+        fr->FS1R |= bit;
+        fr->sFilterRegister[bank].FR1 = ((sFilterConfig->FilterIdHigh & 0xFFFFU) << 16) |
+                                        (sFilterConfig->FilterIdLow & 0xFFFFU);
+        fr->sFilterRegister[bank].FR2 = ((sFilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) |
+                                        (sFilterConfig->FilterMaskIdLow & 0xFFFFU);
+    }
+    if (sFilterConfig->FilterMode == CAN_FILTERMODE_IDMASK)
+        fr->FM1R &= ~bit;
+    else
+        fr->FM1R |= bit;
+    if (sFilterConfig->FilterFIFOAssignment == CAN_FILTER_FIFO0)
+        fr->FFA1R &= ~bit;
+    else
+        fr->FFA1R |= bit;
+    if (sFilterConfig->FilterActivation == CAN_FILTER_ENABLE)
+        fr->FA1R |= bit;
+    fr->FMR &= ~CAN_FMR_FINIT;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan)
+{
+    hal_emu_charge(HAL_EMU_CAN_START);
+    if (hcan->State != HAL_CAN_STATE_READY) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    CAN_TypeDef *can = hcan->Instance;
+    hcan->State = HAL_CAN_STATE_LISTENING;
+    can->MCR &= ~CAN_MCR_INRQ;
+    can->MSR &= ~CAN_MSR_INAK;
+    /* Leaving initialisation ends bus-off once 128 x 11 recessive bits have
+     * been seen; the emulated bus is idle, so that is immediate */
+    if (can->ESR & CAN_ESR_BOFF)
+        bx_set_counters(can, 0, 0);
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    bx_kick(can);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan)
+{
+    hal_emu_charge(HAL_EMU_CAN_STOP);
+    if (hcan->State != HAL_CAN_STATE_LISTENING) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    hcan->Instance->MCR = (hcan->Instance->MCR & ~CAN_MCR_SLEEP) | CAN_MCR_INRQ;
+    hcan->Instance->MSR |= CAN_MSR_INAK;
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader,
+                                       uint8_t aData[], uint32_t *pTxMailbox)
+{
+    hal_emu_charge(HAL_EMU_CAN_ADD_TX);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    CAN_TypeDef *can = hcan->Instance;
+    if (!(can->TSR & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2))) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    uint32_t mb = (can->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    CAN_TxMailBox_TypeDef *t = &can->sTxMailBox[mb];
+    *pTxMailbox = 1U << mb;
+
+    /* As the HAL writes it: IDE and RTR are ORed in as given */
+    if (pHeader->IDE == CAN_ID_STD)
+        t->TIR = (pHeader->StdId << CAN_TI0R_STID_Pos) | pHeader->RTR;
+    else
+        t->TIR = (pHeader->ExtId << CAN_TI0R_EXID_Pos) | pHeader->IDE | pHeader->RTR;
+    t->TDTR = pHeader->DLC & 0x0FU;
+    t->TDLR = (uint32_t)aData[0] | ((uint32_t)aData[1] << 8) | ((uint32_t)aData[2] << 16) |
+              ((uint32_t)aData[3] << 24);
+    t->TDHR = (uint32_t)aData[4] | ((uint32_t)aData[5] << 8) | ((uint32_t)aData[6] << 16) |
+              ((uint32_t)aData[7] << 24);
+
+    /* A new request clears the previous completion flags of the mailbox */
+    can->TSR &= ~(BX_TSR_MB(CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0, mb) |
+                  BX_TSR_TME(mb));
+    can->tx_seq[mb] = can->tx_next++;
+    t->TIR |= CAN_TI0R_TXRQ;
+    bx_update_code(can);
+    hal_emu_frame();
+    bx_kick(can);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes)
+{
+    hal_emu_charge(HAL_EMU_CAN_ABORT_TX);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    CAN_TypeDef *can = hcan->Instance;
+    for (uint32_t mb = 0; mb < 3U; ++mb) {
+        if (!(TxMailboxes & (1U << mb)) || !(can->sTxMailBox[mb].TIR & CAN_TI0R_TXRQ))
+            continue;
+        can->sTxMailBox[mb].TIR &= ~CAN_TI0R_TXRQ;
+        can->TSR |= BX_TSR_MB(CAN_TSR_RQCP0, mb) | BX_TSR_TME(mb);
+    }
+    bx_update_code(can);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo,
+                                       CAN_RxHeaderTypeDef *pHeader, uint8_t aData[])
+{
+    hal_emu_charge(HAL_EMU_CAN_GET_RX);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    CAN_TypeDef *can = hcan->Instance;
+    uint32_t f = RxFifo == CAN_RX_FIFO0 ? 0U : 1U;
+    volatile uint32_t *rfr = f ? &can->RF1R : &can->RF0R;
+    uint32_t n = *rfr & CAN_RF0R_FMP0;
+    if (!n) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    const CAN_FIFOMailBox_TypeDef *m = &can->fifo[f][can->fifo_head[f]];
+    pHeader->IDE = m->RIR & CAN_TI0R_IDE;
+    if (pHeader->IDE == CAN_ID_STD)
+        pHeader->StdId = m->RIR >> CAN_TI0R_STID_Pos;
+    else
+        pHeader->ExtId = m->RIR >> CAN_TI0R_EXID_Pos;
+    pHeader->RTR = m->RIR & CAN_TI0R_RTR;
+    pHeader->DLC = m->RDTR & 0x0FU;
+    pHeader->FilterMatchIndex = (m->RDTR >> 8) & 0xFFU;
+    pHeader->Timestamp = m->RDTR >> 16;
+    bx_unpack(m->RDLR, m->RDHR, aData);
+
+    /* Release the output mailbox */
+    can->fifo_head[f] = (uint8_t)((can->fifo_head[f] + 1U) % 3U);
+    *rfr = (*rfr & ~CAN_RF0R_FMP0) | (n - 1U);
+    hal_emu_frame();
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef *hcan, uint32_t RxFifo)
+{
+    hal_emu_charge(HAL_EMU_CAN_FIFO_LEVEL);
+    if (!bx_ready(hcan))
+        return 0;
+    return (RxFifo == CAN_RX_FIFO0 ? hcan->Instance->RF0R : hcan->Instance->RF1R) &
+           CAN_RF0R_FMP0;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs)
+{
+    hal_emu_charge(HAL_EMU_CAN_ACTIVATE_IT);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    hcan->Instance->IER |= ActiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs)
+{
+    hal_emu_charge(HAL_EMU_CAN_DEACTIVATE_IT);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    hcan->Instance->IER &= ~InactiveITs;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *hcan)
+{
+    hal_emu_charge(HAL_EMU_CAN_GET_ERROR);
+    return hcan->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan)
+{
+    hal_emu_charge(HAL_EMU_CAN_RESET_ERROR);
+    if (!bx_ready(hcan)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+static void bx_tx_irq(CAN_HandleTypeDef *hcan, uint32_t mb, uint32_t tsr, uint32_t *errorcode)
+{
+    static void (*const complete[3])(CAN_HandleTypeDef *) = {
+        HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback,
+        HAL_CAN_TxMailbox2CompleteCallback
+    };
+    static void (*const aborted[3])(CAN_HandleTypeDef *) = {
+        HAL_CAN_TxMailbox0AbortCallback, HAL_CAN_TxMailbox1AbortCallback,
+        HAL_CAN_TxMailbox2AbortCallback
+    };
+    if (!(tsr & BX_TSR_MB(CAN_TSR_RQCP0, mb)))
+        return;
+    hcan->Instance->TSR &= ~BX_TSR_MB(CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 |
+                                      CAN_TSR_TERR0, mb);
+    if (tsr & BX_TSR_MB(CAN_TSR_TXOK0, mb))
+        complete[mb](hcan);
+    else if (tsr & BX_TSR_MB(CAN_TSR_ALST0, mb))
+        *errorcode |= HAL_CAN_ERROR_TX_ALST0 << (2U * mb);
+    else if (tsr & BX_TSR_MB(CAN_TSR_TERR0, mb))
+        *errorcode |= HAL_CAN_ERROR_TX_TERR0 << (2U * mb);
+    else
+        aborted[mb](hcan);
+}
+
+/* Same order and flag handling as the HAL handler */
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan)
+{
+    hal_emu_charge(HAL_EMU_IRQ_ENTRY);
+    hal_emu_charge(HAL_EMU_CAN_IRQ_HANDLER);
+    CAN_TypeDef *can = hcan->Instance;
+    uint32_t errorcode = HAL_CAN_ERROR_NONE;
+    uint32_t ier = can->IER, msr = can->MSR, esr = can->ESR;
+
+    if (ier & CAN_IER_TMEIE) {
+        uint32_t tsr = can->TSR;
+        for (uint32_t mb = 0; mb < 3U; ++mb)
+            bx_tx_irq(hcan, mb, tsr, &errorcode);
+    }
+
+    if ((ier & CAN_IER_FOVIE0) && (can->RF0R & CAN_RF0R_FOVR0)) {
+        errorcode |= HAL_CAN_ERROR_RX_FOV0;
+        can->RF0R &= ~CAN_RF0R_FOVR0;
+    }
+    if ((ier & CAN_IER_FFIE0) && (can->RF0R & CAN_RF0R_FULL0)) {
+        can->RF0R &= ~CAN_RF0R_FULL0;
+        HAL_CAN_RxFifo0FullCallback(hcan);
+    }
+    if ((ier & CAN_IER_FMPIE0) && (can->RF0R & CAN_RF0R_FMP0))
+        HAL_CAN_RxFifo0MsgPendingCallback(hcan);
+
+    if ((ier & CAN_IER_FOVIE1) && (can->RF1R & CAN_RF1R_FOVR1)) {
+        errorcode |= HAL_CAN_ERROR_RX_FOV1;
+        can->RF1R &= ~CAN_RF1R_FOVR1;
+    }
+    if ((ier & CAN_IER_FFIE1) && (can->RF1R & CAN_RF1R_FULL1)) {
+        can->RF1R &= ~CAN_RF1R_FULL1;
+        HAL_CAN_RxFifo1FullCallback(hcan);
+    }
+    if ((ier & CAN_IER_FMPIE1) && (can->RF1R & CAN_RF1R_FMP1))
+        HAL_CAN_RxFifo1MsgPendingCallback(hcan);
+
+    if (ier & CAN_IER_ERRIE) {
+        if (msr & CAN_MSR_ERRI) {
+            static const uint32_t lec_codes[8] = {
+                0, HAL_CAN_ERROR_STF, HAL_CAN_ERROR_FOR, HAL_CAN_ERROR_ACK,
+                HAL_CAN_ERROR_BR, HAL_CAN_ERROR_BD, HAL_CAN_ERROR_CRC, 0
+            };
+            if ((ier & CAN_IER_EWGIE) && (esr & CAN_ESR_EWGF))
+                errorcode |= HAL_CAN_ERROR_EWG;
+            if ((ier & CAN_IER_EPVIE) && (esr & CAN_ESR_EPVF))
+                errorcode |= HAL_CAN_ERROR_EPV;
+            if ((ier & CAN_IER_BOFIE) && (esr & CAN_ESR_BOFF))
+                errorcode |= HAL_CAN_ERROR_BOF;
+            if ((ier & CAN_IER_LECIE) && (esr & CAN_ESR_LEC)) {
+                errorcode |= lec_codes[(esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos];
+                can->ESR &= ~CAN_ESR_LEC;
+            }
+        }
+        can->MSR &= ~CAN_MSR_ERRI;
+    }
+
+    if (errorcode != HAL_CAN_ERROR_NONE) {
+        hcan->ErrorCode |= errorcode;
+        HAL_CAN_ErrorCallback(hcan);
+    }
+}
+
+/* ----- Weak callbacks --------------------------------------------------- */
+
+__weak void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+__weak void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan)    { (void)hcan; }
+__weak void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan)    { (void)hcan; }
+__weak void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan)    { (void)hcan; }
+__weak void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)  { (void)hcan; }
+__weak void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan)        { (void)hcan; }
+__weak void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan)  { (void)hcan; }
+__weak void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan)        { (void)hcan; }
+__weak void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)              { (void)hcan; }
@@ -0,0 +1,987 @@
+#include "stm32h7xx_hal_fdcan.h"
+#include <string.h>
+
+FDCAN_GlobalTypeDef hal_emu_fdcan[2];
+
+#define FD_LEC_ACK      3U
+#define FD_R0_XTD       0x40000000U
+#define FD_R0_RTR       0x20000000U
+#define FD_R1_ANMF      0x80000000U
+#define FD_T1_EFC       0x00800000U
+#define FD_ET_TX        0x00400000U   /* TX event type: transmitted */
+#define FD_IR_TX_EVENTS (FDCAN_IR_TEFN | FDCAN_IR_TEFW | FDCAN_IR_TEFF | FDCAN_IR_TEFL)
+#define FD_IR_FIFO0     (FDCAN_IR_RF0N | FDCAN_IR_RF0W | FDCAN_IR_RF0F | FDCAN_IR_RF0L)
+#define FD_IR_FIFO1     (FDCAN_IR_RF1N | FDCAN_IR_RF1W | FDCAN_IR_RF1F | FDCAN_IR_RF1L)
+#define FD_IR_STATUS    (FDCAN_IR_EP | FDCAN_IR_EW | FDCAN_IR_BO)
+#define FD_IR_ERRORS    (FDCAN_IR_ELO | FDCAN_IR_WDI | FDCAN_IR_PEA | FDCAN_IR_PED | FDCAN_IR_ARA)
+
+static uint8_t fd_powered;
+
+static void fd_update_txfqs(FDCAN_GlobalTypeDef *fd);
+
+/* Message RAM contents are undefined after reset; the model zeroes them */
+static void fd_reset_regs(FDCAN_GlobalTypeDef *fd)
+{
+    fd->CCCR = FDCAN_CCCR_INIT;
+    fd->NBTP = 0x06000A03U;
+    fd->TEST = 0;
+    fd->ECR = 0;
+    fd->PSR = 0x00000707U;
+    fd->IR = 0;
+    fd->IE = 0;
+    fd->ILS = 0;
+    fd->ILE = 0;
+    fd->GFC = 0;
+    fd->XIDAM = 0x1FFFFFFFU;
+    fd->RXF0S = 0;
+    fd->RXF1S = 0;
+    fd->TXBC = 0;
+    fd->TXBRP = 0;
+    fd->TXBTO = 0;
+    fd->TXBCF = 0;
+    fd->TXBTIE = 0;
+    fd->TXBCIE = 0;
+    fd->TXEFS = 0;
+    memset(fd->std_filters, 0, sizeof(fd->std_filters));
+    memset(fd->ext_filters, 0, sizeof(fd->ext_filters));
+    fd->std_nbr = fd->ext_nbr = 0;
+    fd->rx_len[0] = fd->rx_len[1] = 0;
+    fd->rx_get[0] = fd->rx_get[1] = 0;
+    fd->rx_wm[0] = fd->rx_wm[1] = 0;
+    fd->tx_ded = fd->tx_fq = fd->tx_get = 0;
+    fd->ev_len = fd->ev_get = fd->ev_wm = 0;
+    fd->mode = FDCAN_MODE_NORMAL;
+    fd_update_txfqs(fd);
+}
+
+static void fd_power(void)
+{
+    if (fd_powered)
+        return;
+    for (uint32_t i = 0; i < 2U; ++i)
+        fd_reset_regs(&hal_emu_fdcan[i]);
+    fd_powered = 1;
+}
+
+static int fd_ready_or_busy(const FDCAN_HandleTypeDef *hfdcan)
+{
+    return hfdcan->State == HAL_FDCAN_STATE_READY || hfdcan->State == HAL_FDCAN_STATE_BUSY;
+}
+
+static int fd_online(const FDCAN_GlobalTypeDef *fd)
+{
+    return !(fd->CCCR & FDCAN_CCCR_INIT) && !(fd->PSR & FDCAN_PSR_BO);
+}
+
+/* ----- Error counters --------------------------------------------------- */
+
+static void fd_set_counters(FDCAN_GlobalTypeDef *fd, uint32_t tec, uint32_t rec)
+{
+    uint32_t old = fd->PSR;
+    uint32_t psr = old & ~(FDCAN_PSR_EP | FDCAN_PSR_EW | FDCAN_PSR_BO);
+    if (rec > 255U)
+        rec = 255U;
+    if (tec > 255U) {
+        psr |= FDCAN_PSR_BO | FDCAN_PSR_EP | FDCAN_PSR_EW;
+        tec = 255U;
+    } else {
+        if (tec >= 96U || rec >= 96U)
+            psr |= FDCAN_PSR_EW;
+        if (tec > 127U || rec > 127U)
+            psr |= FDCAN_PSR_EP;
+    }
+    /* REC saturates at 127, RP flags a passive receiver */
+    fd->ECR = (fd->ECR & FDCAN_ECR_CEL) | tec |
+              ((rec > 127U ? 127U : rec) << FDCAN_ECR_REC_Pos) | (rec > 127U ? FDCAN_ECR_RP : 0U);
+    fd->PSR = psr;
+
+    uint32_t changed = psr ^ old;
+    if (changed & FDCAN_PSR_EW)
+        fd->IR |= FDCAN_IR_EW;
+    if (changed & FDCAN_PSR_EP)
+        fd->IR |= FDCAN_IR_EP;
+    if (changed & FDCAN_PSR_BO)
+        fd->IR |= FDCAN_IR_BO;
+    if (psr & ~old & FDCAN_PSR_BO)
+        fd->CCCR |= FDCAN_CCCR_INIT;   /* bus-off puts the controller in INIT */
+}
+
+static uint32_t fd_tec(const FDCAN_GlobalTypeDef *fd)
+{
+    return (fd->PSR & FDCAN_PSR_BO) ? 256U : fd->ECR & FDCAN_ECR_TEC;
+}
+
+static uint32_t fd_rec(const FDCAN_GlobalTypeDef *fd)
+{
+    return (fd->ECR & FDCAN_ECR_RP) ? 128U : (fd->ECR & FDCAN_ECR_REC) >> FDCAN_ECR_REC_Pos;
+}
+
+static void fd_error(FDCAN_GlobalTypeDef *fd, uint32_t lec)
+{
+    uint32_t cel = ((fd->ECR & FDCAN_ECR_CEL) >> FDCAN_ECR_CEL_Pos) + 1U;
+    if (cel > 255U) {
+        cel = 0;
+        fd->IR |= FDCAN_IR_ELO;
+    }
+    fd->ECR = (fd->ECR & ~FDCAN_ECR_CEL) | (cel << FDCAN_ECR_CEL_Pos);
+    fd->PSR = (fd->PSR & ~FDCAN_PSR_LEC) | lec;
+}
+
+/* ----- Filters ---------------------------------------------------------- */
+
+/* Returns the FIFO (0/1), or -1 to drop the frame */
+static int fd_config_target(uint32_t cfg)
+{
+    switch (cfg) {
+    case FDCAN_FILTER_TO_RXFIFO0:
+    case FDCAN_FILTER_TO_RXFIFO0_HP:
+        return 0;
+    case FDCAN_FILTER_TO_RXFIFO1:
+    case FDCAN_FILTER_TO_RXFIFO1_HP:
+        return 1;
+    default:
+        return -1;   /* reject, priority only, or dedicated RX buffer (not modelled) */
+    }
+}
+
+static int fd_std_match(uint32_t w, uint32_t id)
+{
+    uint32_t id1 = (w >> 16) & 0x7FFU, id2 = w & 0x7FFU;
+    switch (w >> 30) {
+    case FDCAN_FILTER_RANGE:
+        return id >= id1 && id <= id2;
+    case FDCAN_FILTER_DUAL:
+        return id == id1 || id == id2;
+    case FDCAN_FILTER_MASK:
+        return (id & id2) == (id1 & id2);
+    default:
+        return 0;
+    }
+}
+
+static int fd_ext_match(const uint32_t *w, uint32_t id, uint32_t xidam)
+{
+    uint32_t id1 = w[0] & 0x1FFFFFFFU, id2 = w[1] & 0x1FFFFFFFU;
+    uint32_t type = w[1] >> 30;
+    if (type != FDCAN_FILTER_RANGE_NO_EIDM)
+        id &= xidam;
+    switch (type) {
+    case FDCAN_FILTER_RANGE:
+    case FDCAN_FILTER_RANGE_NO_EIDM:
+        return id >= id1 && id <= id2;
+    case FDCAN_FILTER_DUAL:
+        return id == id1 || id == id2;
+    default:
+        return (id & id2) == (id1 & id2);
+    }
+}
+
+/* Elements in index order, first enabled match decides; then GFC */
+static int fd_accept(const FDCAN_GlobalTypeDef *fd, const CAN_Message_t *msg, uint32_t *r1)
+{
+    if (!msg->extended) {
+        for (uint32_t i = 0; i < fd->std_nbr; ++i) {
+            uint32_t w = fd->std_filters[i];
+            uint32_t cfg = (w >> 27) & 7U;
+            if (cfg == FDCAN_FILTER_DISABLE || !fd_std_match(w, msg->id & 0x7FFU))
+                continue;
+            *r1 = i << 24;
+            return fd_config_target(cfg);
+        }
+    } else {
+        for (uint32_t i = 0; i < fd->ext_nbr; ++i) {
+            const uint32_t *w = fd->ext_filters[i];
+            uint32_t cfg = w[0] >> 29;
+            if (cfg == FDCAN_FILTER_DISABLE || !fd_ext_match(w, msg->id, fd->XIDAM))
+                continue;
+            *r1 = i << 24;
+            return fd_config_target(cfg);
+        }
+    }
+    *r1 = FD_R1_ANMF;
+    uint32_t anf = msg->extended ? (fd->GFC >> 2) & 3U : (fd->GFC >> 4) & 3U;
+    return anf < 2U ? (int)anf : -1;
+}
+
+/* ----- RX --------------------------------------------------------------- */
+
+static void fd_update_rxfs(FDCAN_GlobalTypeDef *fd, uint32_t f, uint32_t n)
+{
+    volatile uint32_t *s = f ? &fd->RXF1S : &fd->RXF0S;
+    uint32_t len = fd->rx_len[f];
+    uint32_t put = len ? (fd->rx_get[f] + n) % len : 0U;
+    *s = (*s & FDCAN_RXFS_RFL) | n | ((uint32_t)fd->rx_get[f] << FDCAN_RXFS_GI_Pos) |
+         (put << FDCAN_RXFS_PI_Pos) | (len && n == len ? FDCAN_RXFS_F : 0U);
+}
+
+static int fd_deliver(FDCAN_GlobalTypeDef *fd, const CAN_Message_t *msg)
+{
+    uint32_t r1;
+    int f = fd_accept(fd, msg, &r1);
+    if (f < 0 || !fd->rx_len[f]) {
+        fd->rx_dropped++;
+        return -1;
+    }
+    volatile uint32_t *s = f ? &fd->RXF1S : &fd->RXF0S;
+    uint32_t shift = f ? 4U : 0U;
+    uint32_t len = fd->rx_len[f], n = *s & FDCAN_RXFS_FL;
+    if (n == len) {
+        /* Blocking mode: the new message is lost */
+        *s |= FDCAN_RXFS_RFL;
+        fd->IR |= FDCAN_IR_RF0L << shift;
+        fd->rx_overruns++;
+        return -1;
+    }
+    FDCAN_EmuElement_t *e = &fd->rx_fifo[f][(fd->rx_get[f] + n) % len];
+    e->r0 = msg->extended ? FD_R0_XTD | (msg->id & 0x1FFFFFFFU) : (msg->id & 0x7FFU) << 18;
+    e->r1 = r1 | ((uint32_t)(msg->dlc & 0x0FU) << 16);
+    memcpy(e->data, msg->data, 8);
+    n++;
+    fd_update_rxfs(fd, (uint32_t)f, n);
+    fd->IR |= FDCAN_IR_RF0N << shift;
+    if (n == fd->rx_wm[f])
+        fd->IR |= FDCAN_IR_RF0W << shift;
+    if (n == len)
+        fd->IR |= FDCAN_IR_RF0F << shift;
+    fd->rx_frames++;
+    uint32_t rec = fd_rec(fd);
+    if (rec)
+        fd_set_counters(fd, fd_tec(fd), rec - 1U);
+    return 0;
+}
+
+int HAL_Emu_FDCAN_Receive(FDCAN_GlobalTypeDef *fd, const CAN_Message_t *msg)
+{
+    fd_power();
+    if (!fd || !msg)
+        return -1;
+    if (!fd_online(fd) || fd->mode == FDCAN_MODE_INTERNAL_LOOPBACK) {
+        fd->rx_dropped++;
+        return -1;
+    }
+    return fd_deliver(fd, msg);
+}
+
+/* ----- TX --------------------------------------------------------------- */
+
+static uint32_t fd_fq_mask(const FDCAN_GlobalTypeDef *fd)
+{
+    uint32_t n = fd->tx_fq;
+    return (n >= 32U ? 0xFFFFFFFFU : ((1U << n) - 1U)) << fd->tx_ded;
+}
+
+/* Put index: next FIFO slot, or the lowest free queue buffer */
+static void fd_update_txfqs(FDCAN_GlobalTypeDef *fd)
+{
+    uint32_t mask = fd_fq_mask(fd);
+    uint32_t used = (uint32_t)__builtin_popcount(fd->TXBRP & mask);
+    uint32_t free = fd->tx_fq - used, put = 0;
+    if (free) {
+        if (fd->TXBC & FDCAN_TXBC_TFQM)
+            put = (uint32_t)__builtin_ctz(~fd->TXBRP & mask);
+        else
+            put = fd->tx_ded + (fd->tx_get - fd->tx_ded + used) % fd->tx_fq;
+    }
+    fd->TXFQS = free | ((uint32_t)fd->tx_get << FDCAN_TXFQS_TFGI_Pos) |
+                (put << FDCAN_TXFQS_TFQPI_Pos) | (free ? 0U : FDCAN_TXFQS_TFQF);
+}
+
+/* Lowest ID among pending dedicated buffers and the FIFO head (or the whole
+ * queue); standard before extended on the same base ID */
+static int fd_next_buffer(const FDCAN_GlobalTypeDef *fd)
+{
+    uint32_t cand = fd->TXBRP;
+    if (!(fd->TXBC & FDCAN_TXBC_TFQM) && (cand & fd_fq_mask(fd)))
+        cand = (cand & ~fd_fq_mask(fd)) | (1U << fd->tx_get);
+    int best = -1;
+    uint32_t best_key = 0;
+    while (cand) {
+        uint32_t i = (uint32_t)__builtin_ctz(cand);
+        uint32_t r0 = fd->tx_buf[i].r0;
+        cand &= cand - 1U;
+        uint32_t key = (r0 & FD_R0_XTD) ? ((r0 & 0x1FFFFFFFU) >> 18) << 20 | (1U << 19) |
+                                              (r0 & 0x3FFFFU)
+                                        : ((r0 >> 18) & 0x7FFU) << 20;
+        if (best < 0 || key < best_key) {
+            best = (int)i;
+            best_key = key;
+        }
+    }
+    return best;
+}
+
+static void fd_tx_event(FDCAN_GlobalTypeDef *fd, const FDCAN_EmuElement_t *t)
+{
+    uint32_t n = fd->TXEFS & FDCAN_TXEFS_EFFL;
+    if (!fd->ev_len)
+        return;
+    if (n == fd->ev_len) {
+        fd->TXEFS |= FDCAN_TXEFS_TEFL;
+        fd->IR |= FDCAN_IR_TEFL;
+        return;
+    }
+    FDCAN_EmuElement_t *e = &fd->tx_event[(fd->ev_get + n) % fd->ev_len];
+    e->r0 = t->r0;
+    e->r1 = (t->r1 & 0xFF0F0000U) | FD_ET_TX;
+    n++;
+    fd->TXEFS = (fd->TXEFS & FDCAN_TXEFS_TEFL) | n | ((uint32_t)fd->ev_get << 8) |
+                (((fd->ev_get + n) % fd->ev_len) << 16) | (n == fd->ev_len ? FDCAN_TXEFS_EFF : 0U);
+    fd->IR |= FDCAN_IR_TEFN;
+    if (n == fd->ev_wm)
+        fd->IR |= FDCAN_IR_TEFW;
+    if (n == fd->ev_len)
+        fd->IR |= FDCAN_IR_TEFF;
+}
+
+/* Buffer `i` leaves the pending set; advance the FIFO get index past it */
+static void fd_tx_end(FDCAN_GlobalTypeDef *fd, uint32_t i)
+{
+    fd->TXBRP &= ~(1U << i);
+    if (!(fd->TXBC & FDCAN_TXBC_TFQM) && i == fd->tx_get && fd->tx_fq)
+        fd->tx_get = (uint8_t)(fd->tx_ded + (fd->tx_get - fd->tx_ded + 1U) % fd->tx_fq);
+    if ((1U << i) & fd_fq_mask(fd) && !(fd->TXBRP & fd_fq_mask(fd)))
+        fd->IR |= FDCAN_IR_TFE;
+    fd_update_txfqs(fd);
+}
+
+/* Put one buffer on the bus. Returns 0 if it is still pending. */
+static int fd_send_one(FDCAN_GlobalTypeDef *fd, uint32_t i)
+{
+    const FDCAN_EmuElement_t *t = &fd->tx_buf[i];
+    CAN_Message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.extended = (t->r0 & FD_R0_XTD) ? 1U : 0U;
+    msg.id = msg.extended ? t->r0 & 0x1FFFFFFFU : (t->r0 >> 18) & 0x7FFU;
+    msg.dlc = (uint8_t)((t->r1 >> 16) & 0x0FU);
+    memcpy(msg.data, t->data, 8);
+
+    int err = 0;
+    if (fd->mode != FDCAN_MODE_INTERNAL_LOOPBACK && fd->on_tx)
+        err = fd->on_tx(fd, &msg, fd->user);
+    if (err) {
+        fd->tx_errors++;
+        fd_error(fd, FD_LEC_ACK);
+        fd_set_counters(fd, fd_tec(fd) + 8U, fd_rec(fd));
+        if (!(fd->CCCR & FDCAN_CCCR_DAR) && fd_online(fd))
+            return 0;   /* retransmitted later */
+        fd->TXBCF |= 1U << i;
+        if (fd->TXBCIE & (1U << i))
+            fd->IR |= FDCAN_IR_TCF;
+        fd_tx_end(fd, i);
+        return 1;
+    }
+    fd->TXBTO |= 1U << i;
+    if (fd->TXBTIE & (1U << i))
+        fd->IR |= FDCAN_IR_TC;
+    if (t->r1 & FD_T1_EFC)
+        fd_tx_event(fd, t);
+    fd_tx_end(fd, i);
+    fd->tx_frames++;
+    uint32_t tec = fd_tec(fd);
+    if (tec)
+        fd_set_counters(fd, tec - 1U, fd_rec(fd));
+    if (fd->mode == FDCAN_MODE_INTERNAL_LOOPBACK || fd->mode == FDCAN_MODE_EXTERNAL_LOOPBACK)
+        fd_deliver(fd, &msg);
+    return 1;
+}
+
+static uint32_t fd_transmit(FDCAN_GlobalTypeDef *fd, uint32_t max)
+{
+    uint32_t sent = 0;
+    if (fd->mode == FDCAN_MODE_BUS_MONITORING)
+        return 0;
+    while (sent < max && fd_online(fd)) {
+        int i = fd_next_buffer(fd);
+        if (i < 0 || !fd_send_one(fd, (uint32_t)i))
+            break;
+        sent++;
+    }
+    return sent;
+}
+
+static void fd_kick(FDCAN_GlobalTypeDef *fd)
+{
+    if (!fd->tx_hold)
+        fd_transmit(fd, 32U);
+}
+
+uint32_t HAL_Emu_FDCAN_Transmit(FDCAN_GlobalTypeDef *fd, uint32_t max)
+{
+    fd_power();
+    return fd ? fd_transmit(fd, max) : 0;
+}
+
+void HAL_Emu_FDCAN_SetErrorCounters(FDCAN_GlobalTypeDef *fd, uint16_t tec, uint8_t rec)
+{
+    fd_power();
+    if (fd)
+        fd_set_counters(fd, tec, rec);
+}
+
+uint8_t HAL_Emu_FDCAN_IntPending(const FDCAN_GlobalTypeDef *fd)
+{
+    uint32_t act = fd->IR & fd->IE;
+    uint8_t lines = 0;
+    if ((act & ~fd->ILS) && (fd->ILE & FDCAN_ILE_EINT0))
+        lines |= 1U;
+    if ((act & fd->ILS) && (fd->ILE & FDCAN_ILE_EINT1))
+        lines |= 2U;
+    return lines;
+}
+
+void HAL_Emu_FDCAN_Reset(FDCAN_GlobalTypeDef *fd)
+{
+    fd_power();
+    if (!fd)
+        return;
+    memset(fd, 0, sizeof(*fd));
+    fd_reset_regs(fd);
+}
+
+/* ----- HAL API ---------------------------------------------------------- */
+
+static uint32_t fd_ram_words(const FDCAN_InitTypeDef *init)
+{
+    return init->StdFiltersNbr + 2U * init->ExtFiltersNbr +
+           init->RxFifo0ElmtsNbr * init->RxFifo0ElmtSize +
+           init->RxFifo1ElmtsNbr * init->RxFifo1ElmtSize +
+           init->RxBuffersNbr * init->RxBufferSize + 2U * init->TxEventsNbr +
+           (init->TxBuffersNbr + init->TxFifoQueueElmtsNbr) * init->TxElmtSize;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef *hfdcan)
+{
+    fd_power();
+    hal_emu_charge(HAL_EMU_FDCAN_INIT);
+    if (!hfdcan || !hfdcan->Instance)
+        return HAL_ERROR;
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    const FDCAN_InitTypeDef *init = &hfdcan->Init;
+
+    /* assert_param on the target; the emulation reports them */
+    if (init->StdFiltersNbr > 128U || init->ExtFiltersNbr > 64U ||
+        init->RxFifo0ElmtsNbr > 64U || init->RxFifo1ElmtsNbr > 64U ||
+        init->RxBuffersNbr > 64U || init->TxEventsNbr > 32U ||
+        init->TxBuffersNbr + init->TxFifoQueueElmtsNbr > 32U ||
+        init->Mode > FDCAN_MODE_EXTERNAL_LOOPBACK) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+
+    fd->CCCR |= FDCAN_CCCR_INIT | FDCAN_CCCR_CCE;
+    if (init->AutoRetransmission == ENABLE)
+        fd->CCCR &= ~FDCAN_CCCR_DAR;
+    else
+        fd->CCCR |= FDCAN_CCCR_DAR;
+    fd->mode = init->Mode;
+    fd->NBTP = ((init->NominalSyncJumpWidth - 1U) << 25) | ((init->NominalPrescaler - 1U) << 16) |
+               ((init->NominalTimeSeg1 - 1U) << 8) | (init->NominalTimeSeg2 - 1U);
+
+    /* As FDCAN_CalcultateRamBlockAddresses: check the end address, then
+     * flush the allocated area */
+    if (init->MessageRAMOffset + fd_ram_words(init) > FDCAN_MESSAGE_RAM_WORDS) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    memset(fd->std_filters, 0, sizeof(fd->std_filters));
+    memset(fd->ext_filters, 0, sizeof(fd->ext_filters));
+    memset(fd->tx_buf, 0, sizeof(fd->tx_buf));
+    fd->std_nbr = (uint8_t)init->StdFiltersNbr;
+    fd->ext_nbr = (uint8_t)init->ExtFiltersNbr;
+    fd->rx_len[0] = (uint8_t)init->RxFifo0ElmtsNbr;
+    fd->rx_len[1] = (uint8_t)init->RxFifo1ElmtsNbr;
+    fd->rx_get[0] = fd->rx_get[1] = 0;
+    /* The HAL only rewrites start addresses and sizes: the FIFO watermarks
+     * (RXFnC.FnWM, TXEFC.EFWM) survive a re-init */
+    fd->RXF0S = fd->RXF1S = 0;
+    fd->ev_len = (uint8_t)init->TxEventsNbr;
+    fd->ev_get = 0;
+    fd->TXEFS = 0;
+    fd->tx_ded = (uint8_t)init->TxBuffersNbr;
+    fd->tx_fq = (uint8_t)init->TxFifoQueueElmtsNbr;
+    fd->tx_get = fd->tx_ded;
+    fd->TXBC = init->TxFifoQueueMode & FDCAN_TXBC_TFQM;
+    fd->TXBRP = fd->TXBTO = fd->TXBCF = 0;
+    fd_update_txfqs(fd);
+
+    hfdcan->LatestTxFifoQRequest = 0;
+    hfdcan->ErrorCode = HAL_FDCAN_ERROR_NONE;
+    hfdcan->State = HAL_FDCAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef *hfdcan, FDCAN_FilterTypeDef *sFilterConfig)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_CONFIG_FILTER);
+    if (!fd_ready_or_busy(hfdcan)) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t idx = sFilterConfig->FilterIndex;
+    uint32_t id2 = sFilterConfig->FilterConfig == FDCAN_FILTER_TO_RXBUFFER
+                       ? sFilterConfig->RxBufferIndex : sFilterConfig->FilterID2;
+    if (sFilterConfig->IdType == FDCAN_STANDARD_ID) {
+        if (idx >= fd->std_nbr) {
+            hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+            return HAL_ERROR;
+        }
+        fd->std_filters[idx] = (sFilterConfig->FilterType << 30) |
+                               (sFilterConfig->FilterConfig << 27) |
+                               ((sFilterConfig->FilterID1 & 0x7FFU) << 16) | (id2 & 0x7FFU);
+    } else {
+        if (idx >= fd->ext_nbr) {
+            hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+            return HAL_ERROR;
+        }
+        fd->ext_filters[idx][0] = (sFilterConfig->FilterConfig << 29) |
+                                  (sFilterConfig->FilterID1 & 0x1FFFFFFFU);
+        fd->ext_filters[idx][1] = (sFilterConfig->FilterType << 30) | (id2 & 0x1FFFFFFFU);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan, uint32_t NonMatchingStd,
+                                               uint32_t NonMatchingExt, uint32_t RejectRemoteStd,
+                                               uint32_t RejectRemoteExt)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_CONFIG_GLOBAL_FILTER);
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    hfdcan->Instance->GFC = (NonMatchingStd << 4) | (NonMatchingExt << 2) |
+                            (RejectRemoteStd << 1) | RejectRemoteExt;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigFifoWatermark(FDCAN_HandleTypeDef *hfdcan, uint32_t FIFO,
+                                                uint32_t Watermark)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_CONFIG_WATERMARK);
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    if (FIFO == FDCAN_CFG_TX_EVENT_FIFO)
+        fd->ev_wm = (uint8_t)(Watermark > 32U ? 0U : Watermark);
+    else
+        fd->rx_wm[FIFO == FDCAN_CFG_RX_FIFO1] = (uint8_t)(Watermark > 64U ? 0U : Watermark);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_START);
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    hfdcan->State = HAL_FDCAN_STATE_BUSY;
+    fd->CCCR &= ~(FDCAN_CCCR_INIT | FDCAN_CCCR_CCE);
+    /* Bus-off ends after 128 x 11 recessive bits, at once on the idle bus */
+    if (fd->PSR & FDCAN_PSR_BO) {
+        fd_set_counters(fd, 0, 0);
+        fd->CCCR &= ~FDCAN_CCCR_INIT;
+    }
+    hfdcan->ErrorCode = HAL_FDCAN_ERROR_NONE;
+    fd_kick(fd);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *hfdcan)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_STOP);
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    hfdcan->Instance->CCCR |= FDCAN_CCCR_INIT;
+    hfdcan->LatestTxFifoQRequest = 0;
+    hfdcan->State = HAL_FDCAN_STATE_READY;
+    return HAL_OK;
+}
+
+static void fd_write_tx(FDCAN_EmuElement_t *t, const FDCAN_TxHeaderTypeDef *pTxHeader,
+                        const uint8_t *pTxData)
+{
+    if (pTxHeader->IdType == FDCAN_STANDARD_ID)
+        t->r0 = pTxHeader->ErrorStateIndicator | pTxHeader->TxFrameType |
+                ((pTxHeader->Identifier & 0x7FFU) << 18);
+    else
+        t->r0 = pTxHeader->ErrorStateIndicator | FD_R0_XTD | pTxHeader->TxFrameType |
+                (pTxHeader->Identifier & 0x1FFFFFFFU);
+    t->r1 = (pTxHeader->MessageMarker << 24) | pTxHeader->TxEventFifoControl |
+            pTxHeader->FDFormat | pTxHeader->BitRateSwitch | pTxHeader->DataLength;
+    uint32_t len = (pTxHeader->DataLength >> 16) & 0x0FU;
+    memset(t->data, 0, sizeof(t->data));
+    memcpy(t->data, pTxData, len > 8U ? 8U : len);
+}
+
+/* TXBAR: a new request resets the buffers' completion flags */
+static void fd_request(FDCAN_GlobalTypeDef *fd, uint32_t mask)
+{
+    fd->TXBTO &= ~mask;
+    fd->TXBCF &= ~mask;
+    fd->TXBRP |= mask;
+    fd_update_txfqs(fd);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan,
+                                                FDCAN_TxHeaderTypeDef *pTxHeader, uint8_t *pTxData)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_ADD_TX);
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    if (fd->TXFQS & FDCAN_TXFQS_TFQF) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_FULL;
+        return HAL_ERROR;
+    }
+    uint32_t put = (fd->TXFQS >> FDCAN_TXFQS_TFQPI_Pos) & 0x1FU;
+    fd_write_tx(&fd->tx_buf[put], pTxHeader, pTxData);
+    fd_request(fd, 1U << put);
+    hfdcan->LatestTxFifoQRequest = 1U << put;
+    hal_emu_frame();
+    fd_kick(fd);
+    return HAL_OK;
+}
+
+/* BufferIndex is one FDCAN_TX_BUFFERx bit; the buffer must be dedicated and
+ * have no request pending */
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxBuffer(FDCAN_HandleTypeDef *hfdcan,
+                                                 FDCAN_TxHeaderTypeDef *pTxHeader, uint8_t *pTxData,
+                                                 uint32_t BufferIndex)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_ADD_TX_BUFFER);
+    if (!fd_ready_or_busy(hfdcan)) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    if (!BufferIndex || (BufferIndex & (BufferIndex - 1U)) ||
+        (uint32_t)__builtin_ctz(BufferIndex) >= fd->tx_ded) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    if (fd->TXBRP & BufferIndex) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PENDING;
+        return HAL_ERROR;
+    }
+    fd_write_tx(&fd->tx_buf[__builtin_ctz(BufferIndex)], pTxHeader, pTxData);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_EnableTxBufferRequest(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndex)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_TX_BUFFER_REQUEST);
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    fd_request(fd, BufferIndex);
+    for (uint32_t m = BufferIndex; m; m &= m - 1U)
+        hal_emu_frame();
+    fd_kick(fd);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndex)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_ABORT_TX);
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t cancel = BufferIndex & fd->TXBRP;
+    while (cancel) {
+        uint32_t i = (uint32_t)__builtin_ctz(cancel);
+        cancel &= cancel - 1U;
+        fd->TXBCF |= 1U << i;
+        if (fd->TXBCIE & (1U << i))
+            fd->IR |= FDCAN_IR_TCF;
+        fd_tx_end(fd, i);
+    }
+    return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(FDCAN_HandleTypeDef *hfdcan)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_TX_FREE_LEVEL);
+    return hfdcan->Instance->TXFQS & FDCAN_TXFQS_TFFL;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan, uint32_t RxLocation,
+                                         FDCAN_RxHeaderTypeDef *pRxHeader, uint8_t *pRxData)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_GET_RX);
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    if (RxLocation != FDCAN_RX_FIFO0 && RxLocation != FDCAN_RX_FIFO1) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_SUPPORTED;   /* RX buffers not modelled */
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t f = RxLocation == FDCAN_RX_FIFO1 ? 1U : 0U;
+    volatile uint32_t *s = f ? &fd->RXF1S : &fd->RXF0S;
+    uint32_t n = *s & FDCAN_RXFS_FL;
+    if (!n) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+        return HAL_ERROR;
+    }
+    const FDCAN_EmuElement_t *e = &fd->rx_fifo[f][fd->rx_get[f]];
+    pRxHeader->IdType = e->r0 & FD_R0_XTD ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    pRxHeader->Identifier = pRxHeader->IdType == FDCAN_EXTENDED_ID ? e->r0 & 0x1FFFFFFFU
+                                                                   : (e->r0 >> 18) & 0x7FFU;
+    pRxHeader->RxFrameType = e->r0 & FD_R0_RTR;
+    pRxHeader->ErrorStateIndicator = e->r0 & FDCAN_ESI_PASSIVE;
+    pRxHeader->DataLength = e->r1 & 0x000F0000U;
+    pRxHeader->BitRateSwitch = FDCAN_BRS_OFF;
+    pRxHeader->FDFormat = FDCAN_CLASSIC_CAN;
+    pRxHeader->RxTimestamp = 0;
+    pRxHeader->FilterIndex = (e->r1 >> 24) & 0x7FU;
+    pRxHeader->IsFilterMatchingFrame = (e->r1 & FD_R1_ANMF) ? 1U : 0U;
+    uint32_t len = pRxHeader->DataLength >> 16;
+    memcpy(pRxData, e->data, len > 8U ? 8U : len);
+
+    /* Acknowledge the element */
+    fd->rx_get[f] = (uint8_t)((fd->rx_get[f] + 1U) % fd->rx_len[f]);
+    fd_update_rxfs(fd, f, n - 1U);
+    hal_emu_frame();
+    return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_FIFO_LEVEL);
+    return (RxFifo == FDCAN_RX_FIFO1 ? hfdcan->Instance->RXF1S : hfdcan->Instance->RXF0S) &
+           FDCAN_RXFS_FL;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan, FDCAN_TxEventFifoTypeDef *pTxEvent)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_GET_TX_EVENT);
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t n = fd->TXEFS & FDCAN_TXEFS_EFFL;
+    if (!n) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+        return HAL_ERROR;
+    }
+    const FDCAN_EmuElement_t *e = &fd->tx_event[fd->ev_get];
+    pTxEvent->IdType = e->r0 & FD_R0_XTD ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    pTxEvent->Identifier = pTxEvent->IdType == FDCAN_EXTENDED_ID ? e->r0 & 0x1FFFFFFFU
+                                                                 : (e->r0 >> 18) & 0x7FFU;
+    pTxEvent->TxFrameType = e->r0 & FD_R0_RTR;
+    pTxEvent->ErrorStateIndicator = e->r0 & FDCAN_ESI_PASSIVE;
+    pTxEvent->DataLength = e->r1 & 0x000F0000U;
+    pTxEvent->BitRateSwitch = e->r1 & FDCAN_BRS_ON;
+    pTxEvent->FDFormat = e->r1 & FDCAN_FD_CAN;
+    pTxEvent->TxTimestamp = 0;
+    pTxEvent->MessageMarker = e->r1 >> 24;
+    pTxEvent->EventType = e->r1 & 0x00C00000U;
+
+    fd->ev_get = (uint8_t)((fd->ev_get + 1U) % fd->ev_len);
+    n--;
+    fd->TXEFS = (fd->TXEFS & FDCAN_TXEFS_TEFL) | n | ((uint32_t)fd->ev_get << 8) |
+                (((fd->ev_get + n) % fd->ev_len) << 16);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetErrorCounters(FDCAN_HandleTypeDef *hfdcan,
+                                             FDCAN_ErrorCountersTypeDef *ErrorCounters)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_GET_ERROR_COUNTERS);
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t ecr = fd->ECR;
+    ErrorCounters->TxErrorCnt = ecr & FDCAN_ECR_TEC;
+    ErrorCounters->RxErrorCnt = (ecr & FDCAN_ECR_REC) >> FDCAN_ECR_REC_Pos;
+    ErrorCounters->RxErrorPassive = (ecr & FDCAN_ECR_RP) ? 1U : 0U;
+    ErrorCounters->ErrorLogging = (ecr & FDCAN_ECR_CEL) >> FDCAN_ECR_CEL_Pos;
+    fd->ECR = ecr & ~FDCAN_ECR_CEL;    /* CEL clears on read */
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(FDCAN_HandleTypeDef *hfdcan,
+                                              FDCAN_ProtocolStatusTypeDef *ProtocolStatus)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_GET_PROTOCOL_STATUS);
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t psr = fd->PSR;
+    memset(ProtocolStatus, 0, sizeof(*ProtocolStatus));
+    ProtocolStatus->LastErrorCode = psr & FDCAN_PSR_LEC;
+    ProtocolStatus->DataLastErrorCode = (psr & FDCAN_PSR_DLEC) >> 8;
+    ProtocolStatus->Activity = psr & FDCAN_PSR_ACT;
+    ProtocolStatus->ErrorPassive = (psr & FDCAN_PSR_EP) ? 1U : 0U;
+    ProtocolStatus->Warning = (psr & FDCAN_PSR_EW) ? 1U : 0U;
+    ProtocolStatus->BusOff = (psr & FDCAN_PSR_BO) ? 1U : 0U;
+    fd->PSR = psr | FDCAN_PSR_LEC | FDCAN_PSR_DLEC;   /* LEC reads back "no change" */
+    return HAL_OK;
+}
+
+static void fd_update_lines(FDCAN_GlobalTypeDef *fd)
+{
+    uint32_t line0 = fd->IE & ~fd->ILS, line1 = fd->IE & fd->ILS;
+    fd->ILE = (line0 ? FDCAN_ILE_EINT0 : 0U) | (line1 ? FDCAN_ILE_EINT1 : 0U);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigInterruptLines(FDCAN_HandleTypeDef *hfdcan, uint32_t ITList,
+                                                 uint32_t InterruptLine)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_CONFIG_IT_LINES);
+    if (!fd_ready_or_busy(hfdcan)) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    if (InterruptLine == FDCAN_INTERRUPT_LINE0)
+        hfdcan->Instance->ILS &= ~ITList;
+    else
+        hfdcan->Instance->ILS |= ITList;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan, uint32_t ActiveITs,
+                                                 uint32_t BufferIndexes)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_ACTIVATE_IT);
+    if (!fd_ready_or_busy(hfdcan)) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    if (ActiveITs & FDCAN_IT_TX_COMPLETE)
+        fd->TXBTIE |= BufferIndexes;
+    if (ActiveITs & FDCAN_IT_TX_ABORT_COMPLETE)
+        fd->TXBCIE |= BufferIndexes;
+    fd->IE |= ActiveITs;
+    fd_update_lines(fd);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef *hfdcan, uint32_t InactiveITs)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_DEACTIVATE_IT);
+    if (!fd_ready_or_busy(hfdcan)) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    if (InactiveITs & FDCAN_IT_TX_COMPLETE)
+        fd->TXBTIE = 0;
+    if (InactiveITs & FDCAN_IT_TX_ABORT_COMPLETE)
+        fd->TXBCIE = 0;
+    fd->IE &= ~InactiveITs;
+    fd_update_lines(fd);
+    return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetError(FDCAN_HandleTypeDef *hfdcan)
+{
+    hal_emu_charge(HAL_EMU_FDCAN_GET_ERROR);
+    return hfdcan->ErrorCode;
+}
+
+/* Same grouping as the HAL handler; the completed and cancelled buffer sets
+ * passed to the callbacks are the sticky TXBTO/TXBCF registers */
+void HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef *hfdcan)
+{
+    hal_emu_charge(HAL_EMU_IRQ_ENTRY);
+    hal_emu_charge(HAL_EMU_FDCAN_IRQ_HANDLER);
+    FDCAN_GlobalTypeDef *fd = hfdcan->Instance;
+    uint32_t ie = fd->IE;
+    uint32_t ir = fd->IR & ie;
+
+    if (ir & FDCAN_IR_TCF) {
+        fd->IR &= ~FDCAN_IR_TCF;
+        HAL_FDCAN_TxBufferAbortCallback(hfdcan, fd->TXBCF & fd->TXBCIE);
+    }
+    if (ir & FD_IR_TX_EVENTS) {
+        fd->IR &= ~(ir & FD_IR_TX_EVENTS);
+        HAL_FDCAN_TxEventFifoCallback(hfdcan, ir & FD_IR_TX_EVENTS);
+    }
+    if (ir & FD_IR_FIFO0) {
+        fd->IR &= ~(ir & FD_IR_FIFO0);
+        HAL_FDCAN_RxFifo0Callback(hfdcan, ir & FD_IR_FIFO0);
+    }
+    if (ir & FD_IR_FIFO1) {
+        fd->IR &= ~(ir & FD_IR_FIFO1);
+        HAL_FDCAN_RxFifo1Callback(hfdcan, ir & FD_IR_FIFO1);
+    }
+    if (ir & FDCAN_IR_TFE) {
+        fd->IR &= ~FDCAN_IR_TFE;
+        HAL_FDCAN_TxFifoEmptyCallback(hfdcan);
+    }
+    if (ir & FDCAN_IR_TC) {
+        fd->IR &= ~FDCAN_IR_TC;
+        HAL_FDCAN_TxBufferCompleteCallback(hfdcan, fd->TXBTO & fd->TXBTIE);
+    }
+    if (ir & FD_IR_STATUS) {
+        fd->IR &= ~(ir & FD_IR_STATUS);
+        HAL_FDCAN_ErrorStatusCallback(hfdcan, ir & FD_IR_STATUS);
+    }
+    if (ir & FD_IR_ERRORS) {
+        fd->IR &= ~(ir & FD_IR_ERRORS);
+        hfdcan->ErrorCode |= ir & FD_IR_ERRORS;
+    }
+    if (hfdcan->ErrorCode != HAL_FDCAN_ERROR_NONE && (ir & FD_IR_ERRORS))
+        HAL_FDCAN_ErrorCallback(hfdcan);
+}
+
+/* ----- Weak callbacks --------------------------------------------------- */
+
+__weak void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
+{
+    (void)hfdcan;
+    (void)RxFifo0ITs;
+}
+
+__weak void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs)
+{
+    (void)hfdcan;
+    (void)RxFifo1ITs;
+}
+
+__weak void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t TxEventFifoITs)
+{
+    (void)hfdcan;
+    (void)TxEventFifoITs;
+}
+
+__weak void HAL_FDCAN_TxFifoEmptyCallback(FDCAN_HandleTypeDef *hfdcan)
+{
+    (void)hfdcan;
+}
+
+__weak void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes)
+{
+    (void)hfdcan;
+    (void)BufferIndexes;
+}
+
+__weak void HAL_FDCAN_TxBufferAbortCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes)
+{
+    (void)hfdcan;
+    (void)BufferIndexes;
+}
+
+__weak void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan)
+{
+    (void)hfdcan;
+}
+
+__weak void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t ErrorStatusITs)
+{
+    (void)hfdcan;
+    (void)ErrorStatusITs;
+}
@@ -0,0 +1,8 @@
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+/* Host stand-in for the STM32F4 HAL: only the CAN module is emulated */
+#include "hal_emu.h"
+#include "stm32f4xx_hal_can.h"
+
+#endif /* STM32F4XX_HAL_H */
@@ -0,0 +1,367 @@
+#ifndef STM32F4XX_HAL_CAN_H
+#define STM32F4XX_HAL_CAN_H
+
+#include "hal_emu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Emulated bxCAN peripheral and HAL CAN API (STM32F4 HAL naming).
+ *
+ * CAN1 and CAN2 share 28 filter banks held in CAN1; FMR.CAN2SB is the first
+ * bank of CAN2.  CAN3 has its own 14 banks.  Each instance has three TX
+ * mailboxes and two 3-deep RX FIFOs with the RFLM overrun policy.
+ *
+ * The bus is ideal unless on_tx says otherwise: a requested mailbox is sent
+ * at once (lowest identifier first, or request order with TXFP), unless
+ * tx_hold is set, in which case HAL_Emu_CAN_Transmit sends them.  on_tx
+ * returns 0 for an acknowledged frame; anything else is a TX error that
+ * adds 8 to TEC, and ends the frame with TERR when automatic retransmission
+ * is disabled.  Silent mode keeps requests pending; loopback mode also
+ * receives its own frames and ignores the bus.
+ */
+
+/* ----- Registers -------------------------------------------------------- */
+
+typedef struct {
+    uint32_t TIR;
+    uint32_t TDTR;
+    uint32_t TDLR;
+    uint32_t TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct {
+    uint32_t RIR;
+    uint32_t RDTR;
+    uint32_t RDLR;
+    uint32_t RDHR;
+} CAN_FIFOMailBox_TypeDef;
+
+typedef struct {
+    uint32_t FR1;
+    uint32_t FR2;
+} CAN_FilterRegister_TypeDef;
+
+typedef struct CAN_Emu CAN_TypeDef;
+
+struct CAN_Emu {
+    volatile uint32_t          MCR;
+    volatile uint32_t          MSR;
+    volatile uint32_t          TSR;
+    volatile uint32_t          RF0R;
+    volatile uint32_t          RF1R;
+    volatile uint32_t          IER;
+    volatile uint32_t          ESR;
+    volatile uint32_t          BTR;
+    CAN_TxMailBox_TypeDef      sTxMailBox[3];
+    volatile uint32_t          FMR;
+    volatile uint32_t          FM1R;
+    volatile uint32_t          FS1R;
+    volatile uint32_t          FFA1R;
+    volatile uint32_t          FA1R;
+    CAN_FilterRegister_TypeDef sFilterRegister[28];
+
+    /* Emulation state */
+    CAN_FIFOMailBox_TypeDef    fifo[2][3];
+    uint8_t                    fifo_head[2];
+    uint32_t                   tx_seq[3];      /* request order, for TXFP */
+    uint32_t                   tx_next;
+    int                      (*on_tx)(CAN_TypeDef *can, const CAN_Message_t *msg, void *user);
+    void                      *user;
+    uint8_t                    tx_hold;
+    uint32_t                   tx_frames;
+    uint32_t                   tx_errors;
+    uint32_t                   rx_frames;
+    uint32_t                   rx_dropped;     /* no filter match, or offline */
+    uint32_t                   rx_overruns;
+};
+
+extern CAN_TypeDef hal_emu_can[3];
+#define CAN1 (&hal_emu_can[0])
+#define CAN2 (&hal_emu_can[1])
+#define CAN3 (&hal_emu_can[2])
+
+#define CAN_MCR_INRQ          0x00000001U
+#define CAN_MCR_SLEEP         0x00000002U
+#define CAN_MCR_TXFP          0x00000004U
+#define CAN_MCR_RFLM          0x00000008U
+#define CAN_MCR_NART          0x00000010U
+#define CAN_MCR_AWUM          0x00000020U
+#define CAN_MCR_ABOM          0x00000040U
+#define CAN_MCR_TTCM          0x00000080U
+
+#define CAN_MSR_INAK          0x00000001U
+#define CAN_MSR_ERRI          0x00000004U
+
+#define CAN_TSR_RQCP0         0x00000001U
+#define CAN_TSR_TXOK0         0x00000002U
+#define CAN_TSR_ALST0         0x00000004U
+#define CAN_TSR_TERR0         0x00000008U
+#define CAN_TSR_ABRQ0         0x00000080U
+#define CAN_TSR_RQCP1         0x00000100U
+#define CAN_TSR_TXOK1         0x00000200U
+#define CAN_TSR_ALST1         0x00000400U
+#define CAN_TSR_TERR1         0x00000800U
+#define CAN_TSR_ABRQ1         0x00008000U
+#define CAN_TSR_RQCP2         0x00010000U
+#define CAN_TSR_TXOK2         0x00020000U
+#define CAN_TSR_ALST2         0x00040000U
+#define CAN_TSR_TERR2         0x00080000U
+#define CAN_TSR_ABRQ2         0x00800000U
+#define CAN_TSR_CODE_Pos      24U
+#define CAN_TSR_CODE          0x03000000U
+#define CAN_TSR_TME0          0x04000000U
+#define CAN_TSR_TME1          0x08000000U
+#define CAN_TSR_TME2          0x10000000U
+
+#define CAN_RF0R_FMP0         0x00000003U
+#define CAN_RF0R_FULL0        0x00000008U
+#define CAN_RF0R_FOVR0        0x00000010U
+#define CAN_RF1R_FMP1         0x00000003U
+#define CAN_RF1R_FULL1        0x00000008U
+#define CAN_RF1R_FOVR1        0x00000010U
+
+#define CAN_IER_TMEIE         0x00000001U
+#define CAN_IER_FMPIE0        0x00000002U
+#define CAN_IER_FFIE0         0x00000004U
+#define CAN_IER_FOVIE0        0x00000008U
+#define CAN_IER_FMPIE1        0x00000010U
+#define CAN_IER_FFIE1         0x00000020U
+#define CAN_IER_FOVIE1        0x00000040U
+#define CAN_IER_EWGIE         0x00000100U
+#define CAN_IER_EPVIE         0x00000200U
+#define CAN_IER_BOFIE         0x00000400U
+#define CAN_IER_LECIE         0x00000800U
+#define CAN_IER_ERRIE         0x00008000U
+
+#define CAN_ESR_EWGF          0x00000001U
+#define CAN_ESR_EPVF          0x00000002U
+#define CAN_ESR_BOFF          0x00000004U
+#define CAN_ESR_LEC_Pos       4U
+#define CAN_ESR_LEC           0x00000070U
+#define CAN_ESR_TEC_Pos       16U
+#define CAN_ESR_REC_Pos       24U
+
+#define CAN_BTR_LBKM          0x40000000U
+#define CAN_BTR_SILM          0x80000000U
+
+#define CAN_TI0R_TXRQ         0x00000001U
+#define CAN_TI0R_RTR          0x00000002U
+#define CAN_TI0R_IDE          0x00000004U
+#define CAN_TI0R_EXID_Pos     3U
+#define CAN_TI0R_STID_Pos     21U
+
+#define CAN_FMR_FINIT         0x00000001U
+#define CAN_FMR_CAN2SB_Pos    8U
+#define CAN_FMR_CAN2SB        0x00003F00U
+
+/* ----- HAL types and constants ------------------------------------------ */
+
+typedef enum {
+    HAL_CAN_STATE_RESET         = 0x00U,
+    HAL_CAN_STATE_READY         = 0x01U,
+    HAL_CAN_STATE_LISTENING     = 0x02U,
+    HAL_CAN_STATE_SLEEP_PENDING = 0x03U,
+    HAL_CAN_STATE_SLEEP_ACTIVE  = 0x04U,
+    HAL_CAN_STATE_ERROR         = 0x05U
+} HAL_CAN_StateTypeDef;
+
+typedef struct {
+    uint32_t        Prescaler;
+    uint32_t        Mode;
+    uint32_t        SyncJumpWidth;
+    uint32_t        TimeSeg1;
+    uint32_t        TimeSeg2;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoBusOff;
+    FunctionalState AutoWakeUp;
+    FunctionalState AutoRetransmission;
+    FunctionalState ReceiveFifoLocked;
+    FunctionalState TransmitFifoPriority;
+} CAN_InitTypeDef;
+
+typedef struct {
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+
+typedef struct {
+    uint32_t        StdId;
+    uint32_t        ExtId;
+    uint32_t        IDE;
+    uint32_t        RTR;
+    uint32_t        DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+typedef struct {
+    CAN_TypeDef                   *Instance;
+    CAN_InitTypeDef                Init;
+    volatile HAL_CAN_StateTypeDef  State;
+    volatile uint32_t              ErrorCode;
+} CAN_HandleTypeDef;
+
+#define HAL_CAN_ERROR_NONE            0x00000000U
+#define HAL_CAN_ERROR_EWG             0x00000001U
+#define HAL_CAN_ERROR_EPV             0x00000002U
+#define HAL_CAN_ERROR_BOF             0x00000004U
+#define HAL_CAN_ERROR_STF             0x00000008U
+#define HAL_CAN_ERROR_FOR             0x00000010U
+#define HAL_CAN_ERROR_ACK             0x00000020U
+#define HAL_CAN_ERROR_BR              0x00000040U
+#define HAL_CAN_ERROR_BD              0x00000080U
+#define HAL_CAN_ERROR_CRC             0x00000100U
+#define HAL_CAN_ERROR_RX_FOV0         0x00000200U
+#define HAL_CAN_ERROR_RX_FOV1         0x00000400U
+#define HAL_CAN_ERROR_TX_ALST0        0x00000800U
+#define HAL_CAN_ERROR_TX_TERR0        0x00001000U
+#define HAL_CAN_ERROR_TX_ALST1        0x00002000U
+#define HAL_CAN_ERROR_TX_TERR1        0x00004000U
+#define HAL_CAN_ERROR_TX_ALST2        0x00008000U
+#define HAL_CAN_ERROR_TX_TERR2        0x00010000U
+#define HAL_CAN_ERROR_TIMEOUT         0x00020000U
+#define HAL_CAN_ERROR_NOT_INITIALIZED 0x00040000U
+#define HAL_CAN_ERROR_NOT_READY       0x00080000U
+#define HAL_CAN_ERROR_NOT_STARTED     0x00100000U
+#define HAL_CAN_ERROR_PARAM           0x00200000U
+
+#define CAN_MODE_NORMAL               0x00000000U
+#define CAN_MODE_LOOPBACK             CAN_BTR_LBKM
+#define CAN_MODE_SILENT               CAN_BTR_SILM
+#define CAN_MODE_SILENT_LOOPBACK      (CAN_BTR_LBKM | CAN_BTR_SILM)
+
+#define CAN_SJW_1TQ                   0x00000000U
+#define CAN_SJW_2TQ                   0x01000000U
+#define CAN_SJW_3TQ                   0x02000000U
+#define CAN_SJW_4TQ                   0x03000000U
+#define CAN_BS1_TQ(n)                 ((uint32_t)((n) - 1U) << 16)
+#define CAN_BS2_TQ(n)                 ((uint32_t)((n) - 1U) << 20)
+#define CAN_BS1_1TQ                   CAN_BS1_TQ(1U)
+#define CAN_BS1_2TQ                   CAN_BS1_TQ(2U)
+#define CAN_BS1_3TQ                   CAN_BS1_TQ(3U)
+#define CAN_BS1_4TQ                   CAN_BS1_TQ(4U)
+#define CAN_BS1_5TQ                   CAN_BS1_TQ(5U)
+#define CAN_BS1_6TQ                   CAN_BS1_TQ(6U)
+#define CAN_BS1_7TQ                   CAN_BS1_TQ(7U)
+#define CAN_BS1_8TQ                   CAN_BS1_TQ(8U)
+#define CAN_BS1_9TQ                   CAN_BS1_TQ(9U)
+#define CAN_BS1_10TQ                  CAN_BS1_TQ(10U)
+#define CAN_BS1_11TQ                  CAN_BS1_TQ(11U)
+#define CAN_BS1_12TQ                  CAN_BS1_TQ(12U)
+#define CAN_BS1_13TQ                  CAN_BS1_TQ(13U)
+#define CAN_BS1_14TQ                  CAN_BS1_TQ(14U)
+#define CAN_BS1_15TQ                  CAN_BS1_TQ(15U)
+#define CAN_BS1_16TQ                  CAN_BS1_TQ(16U)
+#define CAN_BS2_1TQ                   CAN_BS2_TQ(1U)
+#define CAN_BS2_2TQ                   CAN_BS2_TQ(2U)
+#define CAN_BS2_3TQ                   CAN_BS2_TQ(3U)
+#define CAN_BS2_4TQ                   CAN_BS2_TQ(4U)
+#define CAN_BS2_5TQ                   CAN_BS2_TQ(5U)
+#define CAN_BS2_6TQ                   CAN_BS2_TQ(6U)
+#define CAN_BS2_7TQ                   CAN_BS2_TQ(7U)
+#define CAN_BS2_8TQ                   CAN_BS2_TQ(8U)
+
+#define CAN_ID_STD                    0x00000000U
+#define CAN_ID_EXT                    0x00000004U
+#define CAN_RTR_DATA                  0x00000000U
+#define CAN_RTR_REMOTE                0x00000002U
+
+#define CAN_TX_MAILBOX0               0x00000001U
+#define CAN_TX_MAILBOX1               0x00000002U
+#define CAN_TX_MAILBOX2               0x00000004U
+
+#define CAN_RX_FIFO0                  0x00000000U
+#define CAN_RX_FIFO1                  0x00000001U
+
+#define CAN_FILTERMODE_IDMASK         0x00000000U
+#define CAN_FILTERMODE_IDLIST         0x00000001U
+#define CAN_FILTERSCALE_16BIT         0x00000000U
+#define CAN_FILTERSCALE_32BIT         0x00000001U
+#define CAN_FILTER_FIFO0              0x00000000U
+#define CAN_FILTER_FIFO1              0x00000001U
+#define CAN_FILTER_DISABLE            0x00000000U
+#define CAN_FILTER_ENABLE             0x00000001U
+
+#define CAN_IT_TX_MAILBOX_EMPTY       CAN_IER_TMEIE
+#define CAN_IT_RX_FIFO0_MSG_PENDING   CAN_IER_FMPIE0
+#define CAN_IT_RX_FIFO0_FULL          CAN_IER_FFIE0
+#define CAN_IT_RX_FIFO0_OVERRUN       CAN_IER_FOVIE0
+#define CAN_IT_RX_FIFO1_MSG_PENDING   CAN_IER_FMPIE1
+#define CAN_IT_RX_FIFO1_FULL          CAN_IER_FFIE1
+#define CAN_IT_RX_FIFO1_OVERRUN       CAN_IER_FOVIE1
+#define CAN_IT_ERROR_WARNING          CAN_IER_EWGIE
+#define CAN_IT_ERROR_PASSIVE          CAN_IER_EPVIE
+#define CAN_IT_BUSOFF                 CAN_IER_BOFIE
+#define CAN_IT_LAST_ERROR_CODE        CAN_IER_LECIE
+#define CAN_IT_ERROR                  CAN_IER_ERRIE
+
+/* ----- HAL API ---------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig);
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader,
+                                       uint8_t aData[], uint32_t *pTxMailbox);
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo,
+                                       CAN_RxHeaderTypeDef *pHeader, uint8_t aData[]);
+uint32_t          HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef *hcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs);
+void              HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan);
+uint32_t          HAL_CAN_GetError(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan);
+
+/* Weak callbacks, overridden by the driver */
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan);
+
+/* ----- Emulation control ------------------------------------------------ */
+
+/* Return an instance to its reset state (hooks are cleared too) */
+void     HAL_Emu_CAN_Reset(CAN_TypeDef *can);
+/* A frame from another node. Returns 0 when stored in a FIFO, -1 if it was
+ * filtered out, lost to an overrun or the controller is not on the bus. */
+int      HAL_Emu_CAN_Receive(CAN_TypeDef *can, const CAN_Message_t *msg);
+/* With tx_hold: send up to `max` pending mailboxes, returns the number sent */
+uint32_t HAL_Emu_CAN_Transmit(CAN_TypeDef *can, uint32_t max);
+/* Force the error counters; TEC above 255 means bus-off */
+void     HAL_Emu_CAN_SetErrorCounters(CAN_TypeDef *can, uint16_t tec, uint8_t rec);
+/* Any enabled interrupt source active (TX, RX0, RX1 or SCE line) */
+uint8_t  HAL_Emu_CAN_IntPending(const CAN_TypeDef *can);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STM32F4XX_HAL_CAN_H */
@@ -0,0 +1,8 @@
+#ifndef STM32H7XX_HAL_H
+#define STM32H7XX_HAL_H
+
+/* Host stand-in for the STM32H7 HAL: only the FDCAN module is emulated */
+#include "hal_emu.h"
+#include "stm32h7xx_hal_fdcan.h"
+
+#endif /* STM32H7XX_HAL_H */
@@ -0,0 +1,455 @@
+#ifndef STM32H7XX_HAL_FDCAN_H
+#define STM32H7XX_HAL_FDCAN_H
+
+#include "hal_emu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Emulated FDCAN peripheral and HAL FDCAN API (STM32H7 HAL naming).
+ *
+ * Classic frames only.  Each instance models its message RAM sections:
+ * standard and extended filter elements, RX FIFO 0/1 in blocking mode, the
+ * TX event FIFO and dedicated TX buffers followed by a TX FIFO or queue.
+ * HAL_FDCAN_Init checks the layout against the 2560 words of the H7
+ * message RAM as the HAL does, and clears it.  Sharing the RAM between
+ * FDCAN1 and FDCAN2 is not checked.
+ *
+ * TX follows the bxCAN emulation: requests go out at once unless tx_hold
+ * is set, on_tx returns non-zero for a TX error, and with automatic
+ * retransmission disabled a failed buffer is cancelled (TXBCF).  The
+ * new-message, watermark and status-change flags are edge events, as in
+ * the hardware.
+ */
+
+/* ----- Registers -------------------------------------------------------- */
+
+typedef struct {
+    uint32_t r0;     /* ESI XTD RTR ID, as in the message RAM */
+    uint32_t r1;     /* ANMF FIDX / MM EFC, DLC */
+    uint8_t  data[8];
+} FDCAN_EmuElement_t;
+
+typedef struct FDCAN_Emu FDCAN_GlobalTypeDef;
+
+struct FDCAN_Emu {
+    volatile uint32_t  CCCR;
+    volatile uint32_t  NBTP;
+    volatile uint32_t  TEST;
+    volatile uint32_t  ECR;
+    volatile uint32_t  PSR;
+    volatile uint32_t  IR;
+    volatile uint32_t  IE;
+    volatile uint32_t  ILS;
+    volatile uint32_t  ILE;
+    volatile uint32_t  GFC;
+    volatile uint32_t  XIDAM;
+    volatile uint32_t  RXF0S;
+    volatile uint32_t  RXF1S;
+    volatile uint32_t  TXBC;
+    volatile uint32_t  TXFQS;
+    volatile uint32_t  TXBRP;
+    volatile uint32_t  TXBTO;
+    volatile uint32_t  TXBCF;
+    volatile uint32_t  TXBTIE;
+    volatile uint32_t  TXBCIE;
+    volatile uint32_t  TXEFS;
+
+    /* Emulation state: message RAM and section sizes from Init */
+    uint32_t           std_filters[128];
+    uint32_t           ext_filters[64][2];
+    FDCAN_EmuElement_t rx_fifo[2][64];
+    FDCAN_EmuElement_t tx_buf[32];
+    FDCAN_EmuElement_t tx_event[32];
+    uint8_t            std_nbr, ext_nbr;
+    uint8_t            rx_len[2], rx_get[2], rx_wm[2];
+    uint8_t            tx_ded, tx_fq, tx_get;
+    uint8_t            ev_len, ev_get, ev_wm;
+    uint32_t           mode;
+    int              (*on_tx)(FDCAN_GlobalTypeDef *fd, const CAN_Message_t *msg, void *user);
+    void              *user;
+    uint8_t            tx_hold;
+    uint32_t           tx_frames;
+    uint32_t           tx_errors;
+    uint32_t           rx_frames;
+    uint32_t           rx_dropped;    /* rejected, or offline */
+    uint32_t           rx_overruns;
+};
+
+extern FDCAN_GlobalTypeDef hal_emu_fdcan[2];
+#define FDCAN1 (&hal_emu_fdcan[0])
+#define FDCAN2 (&hal_emu_fdcan[1])
+
+#define FDCAN_CCCR_INIT       0x00000001U
+#define FDCAN_CCCR_CCE        0x00000002U
+#define FDCAN_CCCR_MON        0x00000020U
+#define FDCAN_CCCR_DAR        0x00000040U
+#define FDCAN_CCCR_TEST       0x00000080U
+#define FDCAN_TEST_LBCK       0x00000010U
+
+#define FDCAN_ECR_TEC         0x000000FFU
+#define FDCAN_ECR_REC_Pos     8U
+#define FDCAN_ECR_REC         0x00007F00U
+#define FDCAN_ECR_RP          0x00008000U
+#define FDCAN_ECR_CEL_Pos     16U
+#define FDCAN_ECR_CEL         0x00FF0000U
+
+#define FDCAN_PSR_LEC         0x00000007U
+#define FDCAN_PSR_ACT         0x00000018U
+#define FDCAN_PSR_EP          0x00000020U
+#define FDCAN_PSR_EW          0x00000040U
+#define FDCAN_PSR_BO          0x00000080U
+#define FDCAN_PSR_DLEC        0x00000700U
+
+#define FDCAN_IR_RF0N         0x00000001U
+#define FDCAN_IR_RF0W         0x00000002U
+#define FDCAN_IR_RF0F         0x00000004U
+#define FDCAN_IR_RF0L         0x00000008U
+#define FDCAN_IR_RF1N         0x00000010U
+#define FDCAN_IR_RF1W         0x00000020U
+#define FDCAN_IR_RF1F         0x00000040U
+#define FDCAN_IR_RF1L         0x00000080U
+#define FDCAN_IR_HPM          0x00000100U
+#define FDCAN_IR_TC           0x00000200U
+#define FDCAN_IR_TCF          0x00000400U
+#define FDCAN_IR_TFE          0x00000800U
+#define FDCAN_IR_TEFN         0x00001000U
+#define FDCAN_IR_TEFW         0x00002000U
+#define FDCAN_IR_TEFF         0x00004000U
+#define FDCAN_IR_TEFL         0x00008000U
+#define FDCAN_IR_TSW          0x00010000U
+#define FDCAN_IR_MRAF         0x00020000U
+#define FDCAN_IR_TOO          0x00040000U
+#define FDCAN_IR_DRX          0x00080000U
+#define FDCAN_IR_ELO          0x00400000U
+#define FDCAN_IR_EP           0x00800000U
+#define FDCAN_IR_EW           0x01000000U
+#define FDCAN_IR_BO           0x02000000U
+#define FDCAN_IR_WDI          0x04000000U
+#define FDCAN_IR_PEA          0x08000000U
+#define FDCAN_IR_PED          0x10000000U
+#define FDCAN_IR_ARA          0x20000000U
+
+#define FDCAN_ILE_EINT0       0x00000001U
+#define FDCAN_ILE_EINT1       0x00000002U
+
+#define FDCAN_RXFS_FL         0x0000007FU
+#define FDCAN_RXFS_GI_Pos     8U
+#define FDCAN_RXFS_PI_Pos     16U
+#define FDCAN_RXFS_F          0x01000000U
+#define FDCAN_RXFS_RFL        0x02000000U
+
+#define FDCAN_TXBC_TFQM       0x40000000U
+#define FDCAN_TXFQS_TFFL      0x0000003FU
+#define FDCAN_TXFQS_TFGI_Pos  8U
+#define FDCAN_TXFQS_TFQPI_Pos 16U
+#define FDCAN_TXFQS_TFQF      0x00200000U
+#define FDCAN_TXEFS_EFFL      0x0000003FU
+#define FDCAN_TXEFS_EFF       0x01000000U
+#define FDCAN_TXEFS_TEFL      0x02000000U
+
+/* H7 message RAM, shared by all instances */
+#define FDCAN_MESSAGE_RAM_WORDS 2560U
+
+/* ----- HAL types and constants ------------------------------------------ */
+
+typedef enum {
+    HAL_FDCAN_STATE_RESET = 0x00U,
+    HAL_FDCAN_STATE_READY = 0x01U,
+    HAL_FDCAN_STATE_BUSY  = 0x02U,
+    HAL_FDCAN_STATE_ERROR = 0x03U
+} HAL_FDCAN_StateTypeDef;
+
+typedef struct {
+    uint32_t        FrameFormat;
+    uint32_t        Mode;
+    FunctionalState AutoRetransmission;
+    FunctionalState TransmitPause;
+    FunctionalState ProtocolException;
+    uint32_t        NominalPrescaler;
+    uint32_t        NominalSyncJumpWidth;
+    uint32_t        NominalTimeSeg1;
+    uint32_t        NominalTimeSeg2;
+    uint32_t        DataPrescaler;
+    uint32_t        DataSyncJumpWidth;
+    uint32_t        DataTimeSeg1;
+    uint32_t        DataTimeSeg2;
+    uint32_t        MessageRAMOffset;
+    uint32_t        StdFiltersNbr;
+    uint32_t        ExtFiltersNbr;
+    uint32_t        RxFifo0ElmtsNbr;
+    uint32_t        RxFifo0ElmtSize;
+    uint32_t        RxFifo1ElmtsNbr;
+    uint32_t        RxFifo1ElmtSize;
+    uint32_t        RxBuffersNbr;
+    uint32_t        RxBufferSize;
+    uint32_t        TxEventsNbr;
+    uint32_t        TxBuffersNbr;
+    uint32_t        TxFifoQueueElmtsNbr;
+    uint32_t        TxFifoQueueMode;
+    uint32_t        TxElmtSize;
+} FDCAN_InitTypeDef;
+
+typedef struct {
+    uint32_t IdType;
+    uint32_t FilterIndex;
+    uint32_t FilterType;
+    uint32_t FilterConfig;
+    uint32_t FilterID1;
+    uint32_t FilterID2;
+    uint32_t RxBufferIndex;
+    uint32_t IsCalibrationMsg;
+} FDCAN_FilterTypeDef;
+
+typedef struct {
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t TxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t TxEventFifoControl;
+    uint32_t MessageMarker;
+} FDCAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t RxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t RxTimestamp;
+    uint32_t FilterIndex;
+    uint32_t IsFilterMatchingFrame;
+} FDCAN_RxHeaderTypeDef;
+
+typedef struct {
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t TxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t TxTimestamp;
+    uint32_t MessageMarker;
+    uint32_t EventType;
+} FDCAN_TxEventFifoTypeDef;
+
+typedef struct {
+    uint32_t TxErrorCnt;
+    uint32_t RxErrorCnt;
+    uint32_t RxErrorPassive;
+    uint32_t ErrorLogging;
+} FDCAN_ErrorCountersTypeDef;
+
+typedef struct {
+    uint32_t LastErrorCode;
+    uint32_t DataLastErrorCode;
+    uint32_t Activity;
+    uint32_t ErrorPassive;
+    uint32_t Warning;
+    uint32_t BusOff;
+    uint32_t RxESIflag;
+    uint32_t RxBRSflag;
+    uint32_t RxFDFflag;
+    uint32_t ProtocolException;
+    uint32_t TDCvalue;
+} FDCAN_ProtocolStatusTypeDef;
+
+typedef struct {
+    FDCAN_GlobalTypeDef             *Instance;
+    FDCAN_InitTypeDef                Init;
+    uint32_t                         LatestTxFifoQRequest;
+    volatile HAL_FDCAN_StateTypeDef  State;
+    volatile uint32_t                ErrorCode;
+} FDCAN_HandleTypeDef;
+
+#define HAL_FDCAN_ERROR_NONE              0x00000000U
+#define HAL_FDCAN_ERROR_TIMEOUT           0x00000001U
+#define HAL_FDCAN_ERROR_NOT_INITIALIZED   0x00000002U
+#define HAL_FDCAN_ERROR_NOT_READY         0x00000004U
+#define HAL_FDCAN_ERROR_NOT_STARTED       0x00000008U
+#define HAL_FDCAN_ERROR_NOT_SUPPORTED     0x00000010U
+#define HAL_FDCAN_ERROR_PARAM             0x00000020U
+#define HAL_FDCAN_ERROR_PENDING           0x00000040U
+#define HAL_FDCAN_ERROR_RAM_ACCESS        0x00000080U
+#define HAL_FDCAN_ERROR_FIFO_EMPTY        0x00000100U
+#define HAL_FDCAN_ERROR_FIFO_FULL         0x00000200U
+#define HAL_FDCAN_ERROR_LOG_OVERFLOW      FDCAN_IR_ELO
+#define HAL_FDCAN_ERROR_RAM_WDG           FDCAN_IR_WDI
+#define HAL_FDCAN_ERROR_PROTOCOL_ARBT     FDCAN_IR_PEA
+#define HAL_FDCAN_ERROR_PROTOCOL_DATA     FDCAN_IR_PED
+#define HAL_FDCAN_ERROR_RESERVED_AREA     FDCAN_IR_ARA
+
+#define FDCAN_FRAME_CLASSIC               0x00000000U
+#define FDCAN_FRAME_FD_NO_BRS             0x00000100U
+#define FDCAN_FRAME_FD_BRS                0x00000300U
+
+#define FDCAN_MODE_NORMAL                 0x00000000U
+#define FDCAN_MODE_RESTRICTED_OPERATION   0x00000001U
+#define FDCAN_MODE_BUS_MONITORING         0x00000002U
+#define FDCAN_MODE_INTERNAL_LOOPBACK      0x00000003U
+#define FDCAN_MODE_EXTERNAL_LOOPBACK      0x00000004U
+
+/* Element size in words, as the HAL encodes it */
+#define FDCAN_DATA_BYTES_8                0x00000004U
+#define FDCAN_DATA_BYTES_12               0x00000005U
+#define FDCAN_DATA_BYTES_16               0x00000006U
+#define FDCAN_DATA_BYTES_20               0x00000007U
+#define FDCAN_DATA_BYTES_24               0x00000008U
+#define FDCAN_DATA_BYTES_32               0x0000000AU
+#define FDCAN_DATA_BYTES_48               0x0000000EU
+#define FDCAN_DATA_BYTES_64               0x00000012U
+
+#define FDCAN_TX_FIFO_OPERATION           0x00000000U
+#define FDCAN_TX_QUEUE_OPERATION          FDCAN_TXBC_TFQM
+
+#define FDCAN_STANDARD_ID                 0x00000000U
+#define FDCAN_EXTENDED_ID                 0x40000000U
+#define FDCAN_DATA_FRAME                  0x00000000U
+#define FDCAN_REMOTE_FRAME                0x20000000U
+#define FDCAN_DLC_BYTES_0                 0x00000000U
+#define FDCAN_DLC_BYTES_1                 0x00010000U
+#define FDCAN_DLC_BYTES_2                 0x00020000U
+#define FDCAN_DLC_BYTES_3                 0x00030000U
+#define FDCAN_DLC_BYTES_4                 0x00040000U
+#define FDCAN_DLC_BYTES_5                 0x00050000U
+#define FDCAN_DLC_BYTES_6                 0x00060000U
+#define FDCAN_DLC_BYTES_7                 0x00070000U
+#define FDCAN_DLC_BYTES_8                 0x00080000U
+#define FDCAN_ESI_ACTIVE                  0x00000000U
+#define FDCAN_ESI_PASSIVE                 0x80000000U
+#define FDCAN_BRS_OFF                     0x00000000U
+#define FDCAN_BRS_ON                      0x00100000U
+#define FDCAN_CLASSIC_CAN                 0x00000000U
+#define FDCAN_FD_CAN                      0x00200000U
+#define FDCAN_NO_TX_EVENTS                0x00000000U
+#define FDCAN_STORE_TX_EVENTS             0x00800000U
+
+#define FDCAN_FILTER_RANGE                0x00000000U
+#define FDCAN_FILTER_DUAL                 0x00000001U
+#define FDCAN_FILTER_MASK                 0x00000002U
+#define FDCAN_FILTER_RANGE_NO_EIDM        0x00000003U
+#define FDCAN_FILTER_DISABLE              0x00000000U
+#define FDCAN_FILTER_TO_RXFIFO0           0x00000001U
+#define FDCAN_FILTER_TO_RXFIFO1           0x00000002U
+#define FDCAN_FILTER_REJECT               0x00000003U
+#define FDCAN_FILTER_HP                   0x00000004U
+#define FDCAN_FILTER_TO_RXFIFO0_HP        0x00000005U
+#define FDCAN_FILTER_TO_RXFIFO1_HP        0x00000006U
+#define FDCAN_FILTER_TO_RXBUFFER          0x00000007U
+
+#define FDCAN_ACCEPT_IN_RX_FIFO0          0x00000000U
+#define FDCAN_ACCEPT_IN_RX_FIFO1          0x00000001U
+#define FDCAN_REJECT                      0x00000002U
+#define FDCAN_FILTER_REMOTE               0x00000000U
+#define FDCAN_REJECT_REMOTE               0x00000001U
+
+#define FDCAN_RX_FIFO0                    0x00000040U
+#define FDCAN_RX_FIFO1                    0x00000041U
+
+#define FDCAN_CFG_TX_EVENT_FIFO           0x00000000U
+#define FDCAN_CFG_RX_FIFO0                0x00000001U
+#define FDCAN_CFG_RX_FIFO1                0x00000002U
+
+#define FDCAN_INTERRUPT_LINE0             0x00000001U
+#define FDCAN_INTERRUPT_LINE1             0x00000002U
+
+#define FDCAN_IT_RX_FIFO0_NEW_MESSAGE     FDCAN_IR_RF0N
+#define FDCAN_IT_RX_FIFO0_WATERMARK       FDCAN_IR_RF0W
+#define FDCAN_IT_RX_FIFO0_FULL            FDCAN_IR_RF0F
+#define FDCAN_IT_RX_FIFO0_MESSAGE_LOST    FDCAN_IR_RF0L
+#define FDCAN_IT_RX_FIFO1_NEW_MESSAGE     FDCAN_IR_RF1N
+#define FDCAN_IT_RX_FIFO1_WATERMARK       FDCAN_IR_RF1W
+#define FDCAN_IT_RX_FIFO1_FULL            FDCAN_IR_RF1F
+#define FDCAN_IT_RX_FIFO1_MESSAGE_LOST    FDCAN_IR_RF1L
+#define FDCAN_IT_RX_HIGH_PRIORITY_MSG     FDCAN_IR_HPM
+#define FDCAN_IT_TX_COMPLETE              FDCAN_IR_TC
+#define FDCAN_IT_TX_ABORT_COMPLETE        FDCAN_IR_TCF
+#define FDCAN_IT_TX_FIFO_EMPTY            FDCAN_IR_TFE
+#define FDCAN_IT_TX_EVT_FIFO_NEW_DATA     FDCAN_IR_TEFN
+#define FDCAN_IT_TX_EVT_FIFO_WATERMARK    FDCAN_IR_TEFW
+#define FDCAN_IT_TX_EVT_FIFO_FULL         FDCAN_IR_TEFF
+#define FDCAN_IT_TX_EVT_FIFO_ELT_LOST     FDCAN_IR_TEFL
+#define FDCAN_IT_TIMESTAMP_WRAPAROUND     FDCAN_IR_TSW
+#define FDCAN_IT_RAM_ACCESS_FAILURE       FDCAN_IR_MRAF
+#define FDCAN_IT_TIMEOUT_OCCURRED         FDCAN_IR_TOO
+#define FDCAN_IT_RX_BUFFER_NEW_MESSAGE    FDCAN_IR_DRX
+#define FDCAN_IT_ERROR_LOGGING_OVERFLOW   FDCAN_IR_ELO
+#define FDCAN_IT_ERROR_PASSIVE            FDCAN_IR_EP
+#define FDCAN_IT_ERROR_WARNING            FDCAN_IR_EW
+#define FDCAN_IT_BUS_OFF                  FDCAN_IR_BO
+#define FDCAN_IT_RAM_WATCHDOG             FDCAN_IR_WDI
+#define FDCAN_IT_ARB_PROTOCOL_ERROR       FDCAN_IR_PEA
+#define FDCAN_IT_DATA_PROTOCOL_ERROR      FDCAN_IR_PED
+#define FDCAN_IT_RESERVED_ADDRESS_ACCESS  FDCAN_IR_ARA
+
+/* ----- HAL API ---------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef *hfdcan, FDCAN_FilterTypeDef *sFilterConfig);
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan, uint32_t NonMatchingStd,
+                                               uint32_t NonMatchingExt, uint32_t RejectRemoteStd,
+                                               uint32_t RejectRemoteExt);
+HAL_StatusTypeDef HAL_FDCAN_ConfigFifoWatermark(FDCAN_HandleTypeDef *hfdcan, uint32_t FIFO,
+                                                uint32_t Watermark);
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan,
+                                                FDCAN_TxHeaderTypeDef *pTxHeader, uint8_t *pTxData);
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxBuffer(FDCAN_HandleTypeDef *hfdcan,
+                                                 FDCAN_TxHeaderTypeDef *pTxHeader, uint8_t *pTxData,
+                                                 uint32_t BufferIndex);
+HAL_StatusTypeDef HAL_FDCAN_EnableTxBufferRequest(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndex);
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndex);
+uint32_t          HAL_FDCAN_GetTxFifoFreeLevel(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan, uint32_t RxLocation,
+                                         FDCAN_RxHeaderTypeDef *pRxHeader, uint8_t *pRxData);
+uint32_t          HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan, FDCAN_TxEventFifoTypeDef *pTxEvent);
+HAL_StatusTypeDef HAL_FDCAN_GetErrorCounters(FDCAN_HandleTypeDef *hfdcan,
+                                             FDCAN_ErrorCountersTypeDef *ErrorCounters);
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(FDCAN_HandleTypeDef *hfdcan,
+                                              FDCAN_ProtocolStatusTypeDef *ProtocolStatus);
+HAL_StatusTypeDef HAL_FDCAN_ConfigInterruptLines(FDCAN_HandleTypeDef *hfdcan, uint32_t ITList,
+                                                 uint32_t InterruptLine);
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan, uint32_t ActiveITs,
+                                                 uint32_t BufferIndexes);
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef *hfdcan, uint32_t InactiveITs);
+void              HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef *hfdcan);
+uint32_t          HAL_FDCAN_GetError(FDCAN_HandleTypeDef *hfdcan);
+
+/* Weak callbacks, overridden by the driver */
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs);
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs);
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t TxEventFifoITs);
+void HAL_FDCAN_TxFifoEmptyCallback(FDCAN_HandleTypeDef *hfdcan);
+void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes);
+void HAL_FDCAN_TxBufferAbortCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes);
+void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan);
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t ErrorStatusITs);
+
+/* ----- Emulation control ------------------------------------------------ */
+
+void     HAL_Emu_FDCAN_Reset(FDCAN_GlobalTypeDef *fd);
+/* A frame from another node. Returns 0 when stored in a FIFO, -1 if it was
+ * rejected, lost or the controller is not on the bus. */
+int      HAL_Emu_FDCAN_Receive(FDCAN_GlobalTypeDef *fd, const CAN_Message_t *msg);
+/* With tx_hold: send up to `max` pending buffers, returns the number ended */
+uint32_t HAL_Emu_FDCAN_Transmit(FDCAN_GlobalTypeDef *fd, uint32_t max);
+/* Force the error counters; TEC above 255 means bus-off */
+void     HAL_Emu_FDCAN_SetErrorCounters(FDCAN_GlobalTypeDef *fd, uint16_t tec, uint8_t rec);
+/* Pending interrupt lines: bit 0 for line 0, bit 1 for line 1 */
+uint8_t  HAL_Emu_FDCAN_IntPending(const FDCAN_GlobalTypeDef *fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STM32H7XX_HAL_FDCAN_H */
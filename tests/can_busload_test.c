@@ -0,0 +1,67 @@
+/*
+ * Bus load meter at low bitrates, where one frame is several milliseconds
+ * of bus time and longer than a bucket.
+ *
+ *   cc -O2 -Ican tests/can_busload_test.c can/can_busload.c -o can_busload_test
+ *   ./can_busload_test
+ *
+ * For each bitrate it checks the worst case time of a standard 8 byte frame
+ * against its bit length, then records such frames back to back for two
+ * windows and expects the window load of a saturated bus.
+ */
+#include <stdio.h>
+#include "can_busload.h"
+
+static int failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static CAN_BusLoad_t meter;
+
+static void saturate(uint32_t bitrate)
+{
+    CAN_BusLoadConfig_t cfg = { .bitrate = bitrate, .stuff = CAN_STUFF_WORST };
+    CAN_Message_t msg = { .id = 0x123, .dlc = 8 };
+    uint32_t bits = CAN_BusLoad_FrameBits(0, 0, NULL, 8, 0, CAN_STUFF_WORST, NULL);
+    /* bus time in 100 ns units */
+    uint32_t units = (uint32_t)((uint64_t)bits * 10000000U / bitrate);
+    uint32_t frame_us = units / 10U;
+    uint32_t window_us = CAN_BUSLOAD_BUCKETS * CAN_BUSLOAD_BUCKET_MS * 1000U;
+
+    CAN_BusLoad_Init(&meter, &cfg, 0);
+    CHECK(meter.classic_units[0][8] == units);
+
+    /* each frame is recorded when its last bit is on the wire */
+    uint32_t now = 0, frames = 0;
+    while (now + frame_us <= 2U * window_us) {
+        now += frame_us;
+        CAN_BusLoad_Record(&meter, &msg, now);
+        ++frames;
+    }
+    CAN_BusLoadReport_t r;
+    CAN_BusLoad_Report(&meter, &r, now);
+    printf("%6lu bit/s: %lu bits, %lu us per frame, window %u permille\n",
+           (unsigned long)bitrate, (unsigned long)bits, (unsigned long)frame_us,
+           r.window_permille);
+    CHECK(r.frames == frames);
+    /* within one frame of the window, which is the recording granularity */
+    uint32_t slack = (frame_us * 1000U + window_us - 1U) / window_us;
+    CHECK(r.window_permille >= 1000U - slack);
+    CHECK(r.burst_permille == 1000U);
+}
+
+int main(void)
+{
+    saturate(20000);
+    saturate(10000);
+    CHECK(meter.classic_units[0][8] == 135000U);
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures != 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Multi-producer stress test for the manager's queues and processing
+ * contexts, run on Linux with the pthread port:
+ *
+ *   cc -O2 -pthread -Ican tests/can_stress_test.c can/can_manager.c \
+ *      can/can_queue.c can/can_busload.c can/can_mailbox.c can/can_merge.c \
+ *      can/can_request.c can/can_os_pthread.c -o can_stress_test
+ *
+ * Producer threads send numbered frames with CAN_SendMessageTimeout while
+ * reader threads drain a numbered RX stream with CAN_WaitMessage. At the
+ * same time CAN_Manager_Process runs in a loop, another thread keeps calling
+ * CAN_Manager_ProcessInstance, and a third starts and stops the instance
+ * thread. The fake driver checks that it is never entered by two processing
+ * contexts at once, that every producer's frames reach it once and in order,
+ * and the readers check every RX frame arrives exactly once.
+ */
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "can_manager.h"
+
+#define PRODUCERS   4
+#define READERS     2
+#define TX_PER_PROD 20000U
+#define RX_TOTAL    40000U
+#define RX_QUEUE    16U
+
+static CAN_DriverContext_t fake_ctx;
+static atomic_int in_driver;
+static atomic_int overlaps;
+static uint32_t tx_next[PRODUCERS];   /* only touched by the single consumer */
+static atomic_uint tx_seen;
+static uint32_t tx_order_errors;
+static uint32_t rx_made;
+static atomic_uint rx_taken;
+static atomic_uchar rx_seen[RX_TOTAL];
+static atomic_int rx_errors;
+static atomic_int done;
+
+static void enter_driver(void)
+{
+    if (atomic_fetch_add(&in_driver, 1) != 0)
+        atomic_fetch_add(&overlaps, 1);
+}
+
+static void leave_driver(void)
+{
+    atomic_fetch_sub(&in_driver, 1);
+}
+
+static CAN_Result_t fake_init(ICANDriver *drv, const CAN_Config_t *cfg)
+{
+    (void)drv;
+    (void)cfg;
+    return CAN_OK;
+}
+
+static CAN_Result_t fake_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
+{
+    (void)timeout;
+    enter_driver();
+    uint8_t p = msg->data[0];
+    uint32_t seq;
+    memcpy(&seq, &msg->data[4], sizeof(seq));
+    if (p >= PRODUCERS || seq != tx_next[p])
+        tx_order_errors++;
+    else
+        tx_next[p]++;
+    atomic_fetch_add(&tx_seen, 1);
+    CAN_DriverContext_t *ctx = (CAN_DriverContext_t *)drv->ctx;
+    CAN_Manager_TxDone(ctx->inst_id, ctx->tx_handle, 1);
+    leave_driver();
+    return CAN_OK;
+}
+
+static CAN_Result_t fake_receive(ICANDriver *drv, CAN_Message_t *msg)
+{
+    (void)drv;
+    enter_driver();
+    /* never more frames outstanding than the RX queue holds, so none drop */
+    CAN_Result_t res = CAN_ERROR;
+    if (rx_made < RX_TOTAL && rx_made - atomic_load(&rx_taken) < RX_QUEUE) {
+        memset(msg, 0, sizeof(*msg));
+        msg->id = 0x200;
+        msg->dlc = 4;
+        memcpy(msg->data, &rx_made, sizeof(rx_made));
+        rx_made++;
+        res = CAN_OK;
+    }
+    leave_driver();
+    return res;
+}
+
+static ICANDriver fake_driver = {
+    .init = fake_init,
+    .send = fake_send,
+    .receive = fake_receive,
+    .ctx = &fake_ctx,
+};
+
+static uint8_t inst;
+
+static void producer(void *arg)
+{
+    uint8_t p = (uint8_t)(uintptr_t)arg;
+    CAN_Message_t m;
+    memset(&m, 0, sizeof(m));
+    m.id = 0x100 + p;
+    m.dlc = 8;
+    m.data[0] = p;
+    for (uint32_t seq = 0; seq < TX_PER_PROD; ++seq) {
+        memcpy(&m.data[4], &seq, sizeof(seq));
+        while (CAN_SendMessageTimeout(inst, &m, 100) != CAN_OK)
+            ;
+    }
+}
+
+static void reader(void *arg)
+{
+    (void)arg;
+    uint32_t last = 0;
+    int first = 1;
+    CAN_Message_t m;
+    while (atomic_load(&rx_taken) < RX_TOTAL) {
+        if (CAN_WaitMessage(inst, &m, 10) != 0)
+            continue;
+        uint32_t seq;
+        memcpy(&seq, m.data, sizeof(seq));
+        /* one reader's frames come out of the queue in order */
+        if (seq >= RX_TOTAL || atomic_exchange(&rx_seen[seq], 1) || (!first && seq <= last))
+            atomic_fetch_add(&rx_errors, 1);
+        first = 0;
+        last = seq;
+        atomic_fetch_add(&rx_taken, 1);
+    }
+}
+
+static void process_instance(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&done)) {
+        CAN_Manager_ProcessInstance(inst);
+        can_os_yield();
+    }
+}
+
+static uint32_t starts, rejected;
+
+static void toggler(void *arg)
+{
+    (void)arg;
+    can_os_thread_attr_t attr = { .name = "can-stress" };
+    while (!atomic_load(&done)) {
+        if (CAN_Manager_StartThread(inst, &attr, 1) == CAN_OK) {
+            starts++;
+            can_os_sleep_ms(1);
+            CAN_Manager_StopThread(inst);
+        } else {
+            rejected++;
+        }
+        can_os_yield();
+    }
+}
+
+static void run_process(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&done))
+        CAN_Manager_Process();
+}
+
+int main(void)
+{
+    CAN_Config_t cfg = { .bitrate = 500000 };
+    CAN_QueueConfig_t q = { .tx_len = 16, .rx_len = RX_QUEUE };
+    int id = CAN_Manager_AddInterfaceEx(&fake_driver, &cfg, &q);
+    if (id < 0) {
+        printf("AddInterface failed\n");
+        return 1;
+    }
+    inst = (uint8_t)id;
+
+    can_os_thread_t prod[PRODUCERS], rd[READERS], proc, single, toggle;
+    can_os_thread_attr_t attr = { .name = "stress" };
+    can_os_thread_create(&proc, &attr, run_process, NULL);
+    can_os_thread_create(&single, &attr, process_instance, NULL);
+    can_os_thread_create(&toggle, &attr, toggler, NULL);
+    for (uintptr_t i = 0; i < READERS; ++i)
+        can_os_thread_create(&rd[i], &attr, reader, (void *)i);
+    for (uintptr_t i = 0; i < PRODUCERS; ++i)
+        can_os_thread_create(&prod[i], &attr, producer, (void *)i);
+
+    for (int i = 0; i < PRODUCERS; ++i)
+        can_os_thread_join(&prod[i]);
+    for (int i = 0; i < READERS; ++i)
+        can_os_thread_join(&rd[i]);
+    /* the last frames may still sit in the TX queue */
+    for (int i = 0; i < 1000 && atomic_load(&tx_seen) < PRODUCERS * TX_PER_PROD; ++i)
+        can_os_sleep_ms(1);
+    atomic_store(&done, 1);
+    can_os_thread_join(&toggle);
+    can_os_thread_join(&single);
+    can_os_thread_join(&proc);
+    CAN_Manager_StopThread(inst);
+
+    int fail = atomic_load(&overlaps) || tx_order_errors || atomic_load(&rx_errors) ||
+               atomic_load(&tx_seen) != PRODUCERS * TX_PER_PROD || atomic_load(&rx_taken) != RX_TOTAL;
+    printf("tx %u/%u order errors %u, rx %u/%u errors %d, overlapping passes %d\n",
+           atomic_load(&tx_seen), PRODUCERS * TX_PER_PROD, tx_order_errors, atomic_load(&rx_taken), RX_TOTAL,
+           atomic_load(&rx_errors), atomic_load(&overlaps));
+    printf("instance thread started %u times, %u starts refused during a pass\n", starts,
+           rejected);
+    printf("%s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
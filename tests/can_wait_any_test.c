@@ -0,0 +1,138 @@
+/*
+ * Two CAN_WaitAny callers blocked at once on different instances, run on
+ * Linux with the pthread port:
+ *
+ *   cc -O2 -pthread -Ican tests/can_wait_any_test.c can/can_manager.c \
+ *      can/can_queue.c can/can_busload.c can/can_mailbox.c can/can_merge.c \
+ *      can/can_request.c can/can_os_pthread.c -o can_wait_any_test
+ *
+ * One waiter watches instance 0, the other instance 1. Frames arrive on
+ * the two instances in turn, each while both waiters are blocked, and the
+ * waiter of that instance must return it well before its timeout instead
+ * of sleeping through a wakeup the other waiter took.
+ */
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "can_manager.h"
+
+#define ROUNDS       40U
+#define WAIT_MS      2000U   /* waiter timeout */
+#define DEADLINE_MS  200U    /* a frame must be taken within this */
+
+typedef struct {
+    CAN_DriverContext_t ctx;
+    atomic_uint         pending;
+} Fake_t;
+
+static Fake_t fake[2];
+static atomic_uint taken[2];
+static atomic_int wrong;
+static atomic_int done;
+static uint8_t inst[2];
+
+static CAN_Result_t fake_init(ICANDriver *drv, const CAN_Config_t *cfg)
+{
+    (void)drv;
+    (void)cfg;
+    return CAN_OK;
+}
+
+static CAN_Result_t fake_send(ICANDriver *drv, const CAN_Message_t *msg, uint32_t timeout)
+{
+    (void)drv;
+    (void)msg;
+    (void)timeout;
+    return CAN_OK;
+}
+
+static CAN_Result_t fake_receive(ICANDriver *drv, CAN_Message_t *msg)
+{
+    Fake_t *f = (Fake_t *)drv->ctx;
+    if (!atomic_load(&f->pending))
+        return CAN_ERROR;
+    atomic_fetch_sub(&f->pending, 1);
+    memset(msg, 0, sizeof(*msg));
+    msg->id = 0x100U + (uint32_t)(f - fake);
+    msg->dlc = 1;
+    return CAN_OK;
+}
+
+static ICANDriver drv[2] = {
+    { .init = fake_init, .send = fake_send, .receive = fake_receive, .ctx = &fake[0] },
+    { .init = fake_init, .send = fake_send, .receive = fake_receive, .ctx = &fake[1] },
+};
+
+static void waiter(void *arg)
+{
+    uint8_t k = (uint8_t)(uintptr_t)arg;
+    CAN_Message_t m;
+    while (!atomic_load(&done)) {
+        int id = CAN_WaitAny(&inst[k], 1, &m, WAIT_MS);
+        if (id < 0)
+            continue;
+        if (id != inst[k] || m.id != 0x100U + k)
+            atomic_fetch_add(&wrong, 1);
+        atomic_fetch_add(&taken[k], 1);
+    }
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+int main(void)
+{
+    CAN_Config_t cfg = { .mode = CAN_OPMODE_NORMAL, .bitrate = 500000 };
+    CAN_Manager_Init();
+    for (uint8_t k = 0; k < 2U; ++k) {
+        int id = CAN_Manager_AddInterface(&drv[k], &cfg);
+        if (id < 0) {
+            printf("AddInterface failed\n");
+            return 1;
+        }
+        inst[k] = (uint8_t)id;
+    }
+
+    can_os_thread_t t[2];
+    can_os_thread_attr_t attr = { .name = "wait-any" };
+    for (uint8_t k = 0; k < 2U; ++k)
+        can_os_thread_create(&t[k], &attr, waiter, (void *)(uintptr_t)k);
+
+    int late = 0;
+    uint64_t worst = 0;
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        uint8_t k = (uint8_t)(r % 2U);
+        uint32_t before = atomic_load(&taken[k]);
+        /* let both waiters block before the frame arrives */
+        can_os_sleep_ms(5);
+        uint64_t t0 = now_ms();
+        atomic_fetch_add(&fake[k].pending, 1);
+        CAN_Manager_ProcessInstance(inst[k]);
+        while (atomic_load(&taken[k]) == before && now_ms() - t0 < WAIT_MS + 500U)
+            can_os_sleep_ms(1);
+        uint64_t dt = now_ms() - t0;
+        if (dt > worst)
+            worst = dt;
+        if (atomic_load(&taken[k]) == before || dt > DEADLINE_MS) {
+            printf("round %lu: instance %u frame taken after %lu ms\n", (unsigned long)r,
+                   inst[k], (unsigned long)dt);
+            late++;
+        }
+    }
+    atomic_store(&done, 1);
+    for (uint8_t k = 0; k < 2U; ++k)
+        can_os_thread_join(&t[k]);
+
+    printf("rounds %u, taken %u/%u, slowest %lu ms, wrong %d\n", ROUNDS,
+           atomic_load(&taken[0]), atomic_load(&taken[1]), (unsigned long)worst,
+           atomic_load(&wrong));
+    int fail = late || atomic_load(&wrong) ||
+               atomic_load(&taken[0]) + atomic_load(&taken[1]) != ROUNDS;
+    printf("%s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
@@ -0,0 +1,132 @@
+/*
+ * Driver cost bench on the STM32 HAL emulation: the unmodified bxCAN and
+ * FDCAN drivers under the manager, RX and TX, interrupt driven and polled.
+ *
+ *   cc -O2 -DCAN_OS_NONE -DSTM32F4xx -DSTM32H7xx -Ican -Ican/hal_emu \
+ *      tests/hal_emu_bench.c can/can_manager.c can/can_queue.c \
+ *      can/can_mailbox.c can/can_busload.c can/can_merge.c can/can_request.c \
+ *      can/can_os_none.c can/can_trace.c can/can_stm32_bxcan.c \
+ *      can/can_stm32_fdcan.c can/hal_emu/hal_emu.c can/hal_emu/hal_emu_bxcan.c \
+ *      can/hal_emu/hal_emu_fdcan.c -o hal_emu_bench
+ *   ./hal_emu_bench [-v]
+ *
+ * For each case it prints the HAL cycles per frame estimated by the cost
+ * model (see hal_emu.h) and the host time per frame, which covers the
+ * manager, the driver and the emulation itself. -v adds the per-call
+ * HAL_Emu_Report of every case. Simulated time advances one frame time
+ * (250 us) per frame, so periodic work such as error polling runs at its
+ * real rate.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "can_manager.h"
+#include "can_stm32_bxcan.h"
+#include "can_stm32_fdcan.h"
+
+#define BENCH_FRAMES   100000U
+#define BENCH_FRAME_US 250U
+
+/* Global so a CAN_STATIC_CONFIG table can name them */
+ICANDriver bench_bx;
+ICANDriver bench_fd;
+static BxCAN_Context bx_ctx;
+static FDCAN_Context fd_ctx;
+
+typedef struct {
+    const char *name;
+    ICANDriver *drv;
+    uint8_t     id;
+    int       (*inject)(const CAN_Message_t *msg);
+    uint8_t   (*int_pending)(void);
+} Bench_Port_t;
+
+static int bx_inject(const CAN_Message_t *msg) { return HAL_Emu_CAN_Receive(CAN1, msg); }
+static uint8_t bx_pending(void) { return HAL_Emu_CAN_IntPending(CAN1); }
+static int fd_inject(const CAN_Message_t *msg) { return HAL_Emu_FDCAN_Receive(FDCAN1, msg); }
+static uint8_t fd_pending(void) { return HAL_Emu_FDCAN_IntPending(FDCAN1); }
+
+static int verbose;
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/* One frame time: the ISR runs if it is due, then a processing pass over
+ * this interface only, so the idle one is not charged to it */
+static void bench_step(const Bench_Port_t *p, uint8_t irq)
+{
+    can_os_tick_us(BENCH_FRAME_US);
+    if (irq) {
+        while (p->int_pending())
+            p->drv->irq_handler(p->drv);
+    }
+    CAN_Manager_ProcessInstance(p->id);
+}
+
+static int bench_case(const Bench_Port_t *p, uint8_t irq, uint8_t tx)
+{
+    CAN_Reconfig_t rc = { .set = CAN_RECONF_IRQ, .use_interrupts = irq };
+    if (CAN_Reconfigure(p->id, &rc, NULL) != CAN_OK) {
+        printf("%s: cannot switch interrupts\n", p->name);
+        return 1;
+    }
+    CAN_Message_t msg = { .id = 0x123, .dlc = 8 };
+    CAN_Message_t out;
+    uint32_t done = 0;
+    HAL_Emu_ResetStats();
+    uint64_t t0 = host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        msg.data[0] = (uint8_t)i;
+        if (tx) {
+            done += CAN_SendMessage(p->id, &msg) == CAN_OK;
+        } else if (p->inject(&msg) != 0) {
+            break;
+        }
+        bench_step(p, irq);
+        while (!tx && CAN_GetMessage(p->id, &out) == 0)
+            ++done;
+    }
+    uint64_t ns = host_ns() - t0;
+    uint32_t frames = HAL_Emu_Frames();
+    printf("%-6s %s %-6s %8lu %12.1f %12.1f\n", p->name, tx ? "TX" : "RX",
+           irq ? "irq" : "polled", (unsigned long)done,
+           frames ? (double)HAL_Emu_Cycles() / frames : 0.0,
+           done ? (double)ns / done : 0.0);
+    if (verbose)
+        HAL_Emu_Report(stdout);
+    return done != BENCH_FRAMES;
+}
+
+int main(int argc, char **argv)
+{
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    CAN_Config_t cfg = { .mode = CAN_OPMODE_NORMAL, .bitrate = 500000 };
+
+    CAN_Manager_Init();
+    BxCAN_SetupDriver(&bench_bx, &bx_ctx, CAN1);
+    FDCAN_SetupDriver(&bench_fd, &fd_ctx, FDCAN1);
+    int bx = CAN_Manager_AddInterface(&bench_bx, &cfg);
+    int fd = CAN_Manager_AddInterface(&bench_fd, &cfg);
+    if (bx < 0 || fd < 0) {
+        printf("AddInterface failed\n");
+        return 1;
+    }
+    const Bench_Port_t ports[] = {
+        { "bxCAN", &bench_bx, (uint8_t)bx, bx_inject, bx_pending },
+        { "FDCAN", &bench_fd, (uint8_t)fd, fd_inject, fd_pending },
+    };
+
+    int fail = 0;
+    printf("case             frames  HAL cyc/frm  host ns/frm\n");
+    for (unsigned i = 0; i < sizeof(ports) / sizeof(ports[0]); ++i) {
+        for (uint8_t tx = 0; tx < 2; ++tx) {
+            fail |= bench_case(&ports[i], 1, tx);
+            fail |= bench_case(&ports[i], 0, tx);
+        }
+    }
+    return fail;
+}
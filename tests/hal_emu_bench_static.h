@@ -0,0 +1,8 @@
+/* CAN_STATIC_CONFIG table for hal_emu_bench.c, see "Static driver binding"
+ * in the README:
+ *
+ *   cc ... -DCAN_STATIC_CONFIG='"hal_emu_bench_static.h"' -Itests ...
+ */
+#define CAN_STATIC_INSTANCES(X)     \
+    X(bench_bx, BxCAN, 16, 16)      \
+    X(bench_fd, FDCAN, 16, 16)
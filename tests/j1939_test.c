@@ -0,0 +1,194 @@
+/*
+ * Two J1939 nodes on an emulated bus: CAN1 and CAN2 of the bxCAN HAL
+ * emulation wired back to back, polled, on simulated time.
+ *
+ *   cc -O2 -DCAN_OS_NONE -DSTM32F4xx -Ican -Ican/hal_emu tests/j1939_test.c \
+ *      can/can_j1939.c can/can_manager.c can/can_queue.c can/can_mailbox.c \
+ *      can/can_busload.c can/can_merge.c can/can_request.c can/can_os_none.c \
+ *      can/can_trace.c can/can_stm32_bxcan.c can/hal_emu/hal_emu.c \
+ *      can/hal_emu/hal_emu_bxcan.c -o j1939_test
+ *   ./j1939_test
+ *
+ * Both nodes prefer the same address, so the claim is contested. The test
+ * then checks a single frame, a BAM, a 1785 byte RTS/CTS connection, and a
+ * BAM and two connections running at once, comparing every byte.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "can_manager.h"
+#include "can_j1939.h"
+#include "can_stm32_bxcan.h"
+
+#define NODE_A_NAME (0x2000ULL | J1939_NAME_ARBITRARY)
+#define NODE_B_NAME (0x1000ULL | J1939_NAME_ARBITRARY)   /* lower: wins */
+#define PREFERRED   0x80U
+
+typedef struct {
+    uint32_t pgn;
+    uint8_t  sa;
+    uint16_t len;
+    uint8_t  data[J1939_TP_MAX_LEN];
+    uint32_t count;
+} Node_Rx_t;
+
+typedef struct {
+    uint32_t ok;
+    uint32_t failed;
+} Node_TxDone_t;
+
+static J1939_t node_a, node_b;
+static Node_Rx_t rx_a, rx_b;
+static Node_TxDone_t done_a, done_b;
+static uint8_t pattern[J1939_TP_MAX_LEN];
+static int failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/* Every frame one controller sends is received by the other */
+static int wire(CAN_TypeDef *can, const CAN_Message_t *msg, void *user)
+{
+    (void)can;
+    HAL_Emu_CAN_Receive((CAN_TypeDef *)user, msg);
+    return 0;
+}
+
+static void on_msg(J1939_t *j, const J1939_Msg_t *msg, void *user)
+{
+    (void)j;
+    Node_Rx_t *rx = (Node_Rx_t *)user;
+    rx->pgn = msg->pgn;
+    rx->sa = msg->sa;
+    rx->len = msg->len;
+    memcpy(rx->data, msg->data, msg->len);
+    rx->count++;
+}
+
+static void on_tx_done(J1939_t *j, uint32_t pgn, uint8_t da, CAN_Result_t res, void *user)
+{
+    (void)j;
+    (void)pgn;
+    (void)da;
+    Node_TxDone_t *d = (Node_TxDone_t *)user;
+    if (res == CAN_OK)
+        d->ok++;
+    else
+        d->failed++;
+}
+
+/* Advance the bus by `ms` one millisecond steps */
+static void run(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; ++i) {
+        can_os_tick_us(1000);
+        CAN_Manager_Process();
+        J1939_Process(&node_a);
+        J1939_Process(&node_b);
+    }
+}
+
+static void reset_counters(void)
+{
+    memset(&rx_a, 0, sizeof(rx_a));
+    memset(&rx_b, 0, sizeof(rx_b));
+    memset(&done_a, 0, sizeof(done_a));
+    memset(&done_b, 0, sizeof(done_b));
+}
+
+static int same(const Node_Rx_t *rx, uint32_t pgn, uint8_t sa, const uint8_t *data, uint16_t len)
+{
+    return rx->pgn == pgn && rx->sa == sa && rx->len == len && memcmp(rx->data, data, len) == 0;
+}
+
+int main(void)
+{
+    static BxCAN_Context bx1, bx2;
+    static ICANDriver drv1, drv2;
+    CAN_Config_t cfg = { .mode = CAN_OPMODE_NORMAL, .bitrate = 250000 };
+
+    for (uint32_t i = 0; i < sizeof(pattern); ++i)
+        pattern[i] = (uint8_t)(i * 7U + i / 251U);
+
+    CAN_Manager_Init();
+    BxCAN_SetupDriver(&drv1, &bx1, CAN1);
+    BxCAN_SetupDriver(&drv2, &bx2, CAN2);
+    int id_a = CAN_Manager_AddInterface(&drv1, &cfg);
+    int id_b = CAN_Manager_AddInterface(&drv2, &cfg);
+    if (id_a < 0 || id_b < 0) {
+        printf("AddInterface failed\n");
+        return 1;
+    }
+    CAN1->on_tx = wire;
+    CAN1->user = CAN2;
+    CAN2->on_tx = wire;
+    CAN2->user = CAN1;
+
+    J1939_Init(&node_a, (uint8_t)id_a, NODE_A_NAME, PREFERRED);
+    J1939_Init(&node_b, (uint8_t)id_b, NODE_B_NAME, PREFERRED);
+    J1939_Register(&node_a, J1939_PGN_ANY, on_msg, &rx_a);
+    J1939_Register(&node_b, J1939_PGN_ANY, on_msg, &rx_b);
+    J1939_SetTxDone(&node_a, on_tx_done, &done_a);
+    J1939_SetTxDone(&node_b, on_tx_done, &done_b);
+
+    /* Address claim: both want PREFERRED, the lower NAME keeps it and the
+     * other picks a free address */
+    J1939_Start(&node_a);
+    J1939_Start(&node_b);
+    run(600);
+    uint8_t addr_a, addr_b;
+    CHECK(J1939_GetClaimState(&node_a, &addr_a) == J1939_CLAIM_DONE);
+    CHECK(J1939_GetClaimState(&node_b, &addr_b) == J1939_CLAIM_DONE);
+    CHECK(addr_b == PREFERRED);
+    CHECK(addr_a != PREFERRED && addr_a >= 128U && addr_a <= 247U);
+    CHECK(node_a.stats.claims_lost == 1 && node_b.stats.claims_lost == 0);
+    printf("claim: A at 0x%02x, B at 0x%02x\n", addr_a, addr_b);
+
+    /* Single frame */
+    reset_counters();
+    CHECK(J1939_Send(&node_a, 0xFEF1, 6, J1939_GLOBAL_ADDR, pattern, 8) == CAN_OK);
+    run(5);
+    CHECK(rx_b.count == 1 && same(&rx_b, 0xFEF1, addr_a, pattern, 8));
+
+    /* BAM: 100 bytes, 15 packets J1939_BAM_GAP_MS apart */
+    reset_counters();
+    CHECK(J1939_Send(&node_a, 0xFECA, 6, J1939_GLOBAL_ADDR, pattern, 100) == CAN_OK);
+    run(15 * J1939_BAM_GAP_MS + 100);
+    CHECK(rx_b.count == 1 && same(&rx_b, 0xFECA, addr_a, pattern, 100));
+    CHECK(done_a.ok == 1 && done_a.failed == 0);
+    printf("BAM: %u bytes received\n", rx_b.len);
+
+    /* RTS/CTS at the maximum size, 255 packets in CTS windows */
+    reset_counters();
+    CHECK(J1939_Send(&node_a, 0xEF00, 6, addr_b, pattern, J1939_TP_MAX_LEN) == CAN_OK);
+    run(2000);
+    CHECK(rx_b.count == 1 && same(&rx_b, 0xEF00, addr_a, pattern, J1939_TP_MAX_LEN));
+    CHECK(done_a.ok == 1 && done_a.failed == 0);
+    CHECK(node_a.pool_used == 0 && node_b.pool_used == 0);
+    printf("RTS/CTS: %u bytes received\n", rx_b.len);
+
+    /* A BAM from A while A and B each open a connection to the other */
+    reset_counters();
+    CHECK(J1939_Send(&node_a, 0xFECA, 6, J1939_GLOBAL_ADDR, pattern + 1, 200) == CAN_OK);
+    CHECK(J1939_Send(&node_a, 0xEF00, 6, addr_b, pattern + 2, 600) == CAN_OK);
+    CHECK(J1939_Send(&node_b, 0xEF00, 6, addr_a, pattern + 3, 900) == CAN_OK);
+    run(3000);
+    CHECK(rx_b.count == 2 && rx_a.count == 1);
+    CHECK(same(&rx_a, 0xEF00, addr_b, pattern + 3, 900));
+    CHECK(done_a.ok == 2 && done_b.ok == 1 && done_a.failed == 0 && done_b.failed == 0);
+    CHECK(node_a.stats.tp_rx_aborted == 0 && node_b.stats.tp_rx_aborted == 0);
+    printf("concurrent: A got %u, B got %u messages\n", rx_a.count, rx_b.count);
+
+    CAN_RxStats_t st;
+    CAN_GetRxStats((uint8_t)id_a, &st);
+    CHECK(st.overruns[CAN_RX_FIFO_MAIN] == 0 && st.dropped[CAN_RX_FIFO_MAIN] == 0);
+    CAN_GetRxStats((uint8_t)id_b, &st);
+    CHECK(st.overruns[CAN_RX_FIFO_MAIN] == 0 && st.dropped[CAN_RX_FIFO_MAIN] == 0);
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures != 0;
+}